@@ -0,0 +1,80 @@
+/*
+ * Replacement of the global operator new that counts allocations, see alloc_guard.h
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "alloc_guard.h"
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#include <unistd.h>
+#endif //__GLIBC__
+
+#ifndef ALLOC_GUARD
+#error alloc_guard.cpp requires -DALLOC_GUARD
+#endif //ALLOC_GUARD
+
+
+namespace alloc_guard
+{
+    namespace
+    {
+        std::atomic<size_t> num_allocations{0};
+        // Armed per thread, so that helper threads, e.g. of the diagnostics, may allocate during a guarded step
+        thread_local bool armed{false};
+
+        void* allocate(const size_t nbytes)
+        {
+            num_allocations.fetch_add(1, std::memory_order_relaxed);
+            if(armed)
+            {
+                // Disarm first, writing the backtrace may allocate. Link with -rdynamic for function names.
+                armed = false;
+                fprintf(stderr, "alloc_guard: Allocation of %zu bytes while the guard is armed\n", nbytes);
+#ifdef __GLIBC__
+                void* frames[64];
+                backtrace_symbols_fd(frames, backtrace(frames, 64), STDERR_FILENO);
+#endif //__GLIBC__
+                std::abort();
+            }
+            return(std::malloc(nbytes == 0 ? 1 : nbytes));
+        }
+    }
+
+    void arm() {armed = true;}
+    void disarm() {armed = false;}
+    bool is_armed() {return(armed);}
+    size_t get_num_allocations() {return(num_allocations.load(std::memory_order_relaxed));}
+}
+
+
+void* operator new(size_t nbytes)
+{
+    void* ptr{alloc_guard :: allocate(nbytes)};
+    if(ptr == nullptr)
+        throw std::bad_alloc();
+    return(ptr);
+}
+
+
+void* operator new[](size_t nbytes)
+{
+    void* ptr{alloc_guard :: allocate(nbytes)};
+    if(ptr == nullptr)
+        throw std::bad_alloc();
+    return(ptr);
+}
+
+
+void* operator new(size_t nbytes, const std::nothrow_t&) noexcept {return(alloc_guard :: allocate(nbytes));}
+void* operator new[](size_t nbytes, const std::nothrow_t&) noexcept {return(alloc_guard :: allocate(nbytes));}
+
+void operator delete(void* ptr) noexcept {std::free(ptr);}
+void operator delete[](void* ptr) noexcept {std::free(ptr);}
+void operator delete(void* ptr, size_t) noexcept {std::free(ptr);}
+void operator delete[](void* ptr, size_t) noexcept {std::free(ptr);}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {std::free(ptr);}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {std::free(ptr);}
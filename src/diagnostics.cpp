@@ -5,6 +5,7 @@
 
 
 #include <iostream>
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <fstream>
@@ -12,6 +13,8 @@
 #include <vector>
 #include "diagnostics.h"
 #include "utility.h"
+#include "logger.h"
+#include "profiler.h"
 
 using namespace std;
 
@@ -50,11 +53,13 @@ void diag_com_t::update_com(const cuda_array_bc_nogp<twodads::real_t, allocator_
         C_old = C;
         for(size_t n = 0; n < vec.get_geom().get_nx(); n++)
         {
-            x = vec.get_geom().x_left + (n + vec.get_geom().cellshift) * vec.get_geom().delta_x;
+            x = vec.get_geom().get_x(n);
+            // Width of the cell on stretched grids, relative to delta_x
+            const twodads::real_t w{vec.get_geom().get_dxds(static_cast<twodads::real_t>(n) + vec.get_geom().get_cellshift())};
             for(size_t m = 0; m < vec.get_geom().get_my(); m++)
             {
                 y = vec.get_geom().y_lo + (m + vec.get_geom().cellshift) * vec.get_geom().delta_y;
-                current_val = addr -> get_elem(data_ptr, n, m);
+                current_val = addr -> get_elem(data_ptr, n, m) * w;
 
                 sum += current_val;
                 sum_x += current_val * x;
@@ -92,6 +97,7 @@ const std::map<twodads::diagnostic_t, std::string> diagnostic_t :: filename_str_
 
 diagnostic_t :: diagnostic_t(const slab_config_js& config) :
     slab_layout(config.get_geom()),
+    file_prefix(config.get_file_prefix()),
     // Map member functions to each diagnostic type defined in 2dads_types.h
     diag_func_map{
         std::map<twodads::diagnostic_t, dfun_ptr_t>
@@ -137,16 +143,16 @@ diagnostic_t :: diagnostic_t(const slab_config_js& config) :
         out_file.exceptions(ofstream::badbit);
         try
         {
-            out_file.open(filename_str_map.at(it), ios::trunc);
+            out_file.open(file_prefix + filename_str_map.at(it), ios::trunc);
             if(!out_file)
             {
-                err_msg << "Diagnostics: Could not open file" << filename_str_map.at(it) << "." << std::endl;
+                err_msg << "Diagnostics: Could not open file" << file_prefix + filename_str_map.at(it) << "." << std::endl;
                 throw new diagnostics_error(err_msg.str());
             }
         }
         catch (diagnostics_error err)
         {
-            std :: cerr << err.what();
+            LOG_MESSAGE(logger::level_t::error, "%s", err.what());
             std :: exit(1);
         } 
         out_file << header_str_map.at(it);
@@ -218,13 +224,38 @@ void diagnostic_t::write_diagnostics(const twodads::real_t time, const slab_conf
 }
 
 
+std::vector<twodads::field_t> diagnostic_t :: get_required_fields(const slab_config_js& config)
+{
+    // Fields read by each diagnostic routine. diag_max does not read any field.
+    static const std::map<twodads::diagnostic_t, std::vector<twodads::field_t>> required_fields_map
+    {
+        {twodads::diagnostic_t::diag_com_theta, {twodads::field_t::f_theta}},
+        {twodads::diagnostic_t::diag_com_tau, {twodads::field_t::f_tau}},
+        {twodads::diagnostic_t::diag_max_theta, {}},
+        {twodads::diagnostic_t::diag_max_tau, {}},
+        {twodads::diagnostic_t::diag_probes, {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_strmf, twodads::field_t::f_strmf_y}}
+    };
+
+    std::vector<twodads::field_t> fields;
+    for(auto dname : config.get_diagnostics())
+    {
+        for(auto fname : required_fields_map.at(dname))
+        {
+            if(std::find(fields.begin(), fields.end(), fname) == fields.end())
+                fields.push_back(fname);
+        }
+    }
+    return(fields);
+}
+
+
 void diagnostic_t::diag_com(const twodads::field_t fieldname, diag_com_t& com, const std::string filename, const twodads::real_t time) 
 {  
     std::ofstream out_file;
     const arr_real* const* arr_ptr2{data_ptr_map.at(fieldname)};
 
     //Update center-of-mass 
-    com.update_com(**arr_ptr2, 1, time);
+    com.update_com(**arr_ptr2, 0, time);
 
 	// Write to out_file file
 	out_file.open(filename, std::ios::app);	
@@ -288,8 +319,8 @@ void diagnostic_t::diag_probes(const twodads::real_t time)
 
     // Vector of probe_types. No probe values are not initialized
     std::vector<probe_type> probe_data{
-        {twodads::field_t::f_theta, 1, std::vector<twodads::real_t>{}},
-        {twodads::field_t::f_omega, 1, std::vector<twodads::real_t>{}},
+        {twodads::field_t::f_theta, 0, std::vector<twodads::real_t>{}},
+        {twodads::field_t::f_omega, 0, std::vector<twodads::real_t>{}},
         {twodads::field_t::f_strmf, 0, std::vector<twodads::real_t>{}},
         {twodads::field_t::f_strmf_y, 0, std::vector<twodads::real_t>{}},
     };
@@ -322,30 +353,21 @@ void diagnostic_t::diag_probes(const twodads::real_t time)
             std::get<2>(it).push_back((*address_ptr).get_elem((*arr_ptr2) -> get_tlev_ptr(tlev), n_pr * delta_n, probe_my));
         }
 
-        std::cout << "In first loop" << std::endl;
-        for(auto vec_it : std::get<2>(it))
+        if(logger :: logger_t :: get().is_enabled(logger::level_t::debug))
         {
-            std::cout << vec_it << "\t";
+            std::stringstream probe_str;
+            for(auto vec_it : std::get<2>(it))
+                probe_str << vec_it << "\t";
+            LOG_MESSAGE(logger::level_t::debug, "diag_probes: %s", probe_str.str().c_str());
         }
-        std::cout << std::endl;
     }
 
-    std::cout << "In second loop" << std::endl;
-    for(auto it : probe_data)
-    {
-        for(auto vec_it : std::get<2>(it))
-        {
-            std::cout << vec_it << "\t";
-        }
-        std::cout << std::endl;
-    }
-
-    std::cout << "Writing" << std::endl;
+    LOG_MESSAGE(logger::level_t::debug, "diag_probes: Writing probes at t = %g", time);
     // Write out this for n probes
     // #1: time    #2: n    #3: omega   #4: phi #5: phi_y
     for (size_t npr = 0; npr < n_probes; npr++ )
     {
-        filename << "probe" << setw(3) << setfill('0') << npr << ".dat";
+        filename << file_prefix << "probe" << setw(3) << setfill('0') << npr << ".dat";
         out_file.open(filename.str().data(), ofstream::app );
         if ( out_file.is_open() )
         {
@@ -484,6 +506,169 @@ void diagnostic_t::diag_probes(const twodads::real_t time)
 
 
 
+//**********************************************************************************
+//*                           Diagnostics thread                                   *
+//**********************************************************************************
+
+
+diagnostic_queue_t :: diagnostic_queue_t(const slab_config_js& _config) :
+    config(_config),
+    diagnostic(_config),
+    fields(diagnostic_t :: get_required_fields(_config)),
+    num_buffers(_config.get_diag_buffers()),
+    buffers(std::max<size_t>(num_buffers, 1)),
+    buffer_time(std::max<size_t>(num_buffers, 1), 0.0),
+    head(0),
+    num_pending(0),
+    stop(false),
+    error(nullptr)
+{
+    // Derivatives have the boundary values of the field, as in slab_bc
+    const std::map<twodads::field_t, twodads::field_t> bvals_field_map
+    {
+        {twodads::field_t::f_theta, twodads::field_t::f_theta}, {twodads::field_t::f_theta_x, twodads::field_t::f_theta}, {twodads::field_t::f_theta_y, twodads::field_t::f_theta},
+        {twodads::field_t::f_omega, twodads::field_t::f_omega}, {twodads::field_t::f_omega_x, twodads::field_t::f_omega}, {twodads::field_t::f_omega_y, twodads::field_t::f_omega},
+        {twodads::field_t::f_tau, twodads::field_t::f_tau}, {twodads::field_t::f_tau_x, twodads::field_t::f_tau}, {twodads::field_t::f_tau_y, twodads::field_t::f_tau},
+        {twodads::field_t::f_strmf, twodads::field_t::f_strmf}, {twodads::field_t::f_strmf_x, twodads::field_t::f_strmf}, {twodads::field_t::f_strmf_y, twodads::field_t::f_strmf}
+    };
+    for(size_t b = 0; b < buffers.size(); b++)
+    {
+        for(auto fname : fields)
+        {
+            arr_real* arr{new arr_real(config.get_geom(), config.get_bvals(bvals_field_map.at(fname)), 1)};
+            arr -> set_tag("diagnostics", std::string("buffer_") + slab_config_js :: get_field_name(fname));
+            buffers[b].push_back(arr);
+        }
+    }
+    if(num_buffers > 0)
+        worker = std::thread([this] () -> void {run();});
+}
+
+
+diagnostic_queue_t :: ~diagnostic_queue_t()
+{
+    if(worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+    if(error != nullptr)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch(const std::exception& err)
+        {
+            LOG_MESSAGE(logger::level_t::error, "Diagnostics: %s", err.what());
+        }
+    }
+    for(auto& buffer : buffers)
+    {
+        for(auto arr : buffer)
+            delete arr;
+    }
+}
+
+
+diagnostic_queue_t::arr_real* diagnostic_queue_t :: acquire(const twodads::field_t fname)
+{
+    const size_t idx{static_cast<size_t>(std::find(fields.begin(), fields.end(), fname) - fields.begin())};
+    if(idx == fields.size())
+        throw diagnostics_error(std::string("acquire: ") + slab_config_js :: get_field_name(fname) + " is not read by the diagnostics");
+
+    if(num_buffers == 0)
+        return(buffers[0][idx]);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this] () -> bool {return(num_pending < num_buffers);});
+    rethrow_error();
+    return(buffers[(head + num_pending) % num_buffers][idx]);
+}
+
+
+void diagnostic_queue_t :: submit(const twodads::real_t time)
+{
+    if(num_buffers == 0)
+    {
+        buffer_time[0] = time;
+        evaluate(0);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] () -> bool {return(num_pending < num_buffers);});
+        buffer_time[(head + num_pending) % num_buffers] = time;
+        num_pending++;
+    }
+    cv.notify_all();
+}
+
+
+void diagnostic_queue_t :: wait()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this] () -> bool {return(num_pending == 0);});
+    rethrow_error();
+}
+
+
+void diagnostic_queue_t :: rethrow_error()
+{
+    if(error != nullptr)
+    {
+        std::exception_ptr err{error};
+        error = nullptr;
+        std::rethrow_exception(err);
+    }
+}
+
+
+void diagnostic_queue_t :: evaluate(const size_t b)
+{
+    PROFILE_SCOPE("diagnostic_queue_t::evaluate", fields.size() * config.get_geom().get_nelem_per_t() * sizeof(value_t));
+    for(size_t idx = 0; idx < fields.size(); idx++)
+        diagnostic.init_field_ptr(fields[idx], buffers[b][idx]);
+    diagnostic.write_diagnostics(buffer_time[b], config);
+}
+
+
+void diagnostic_queue_t :: run()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while(true)
+    {
+        cv.wait(lock, [this] () -> bool {return(num_pending > 0 || stop);});
+        // Evaluate the submitted buffers before stopping
+        if(num_pending == 0)
+            break;
+
+        // The buffer at head is not written until it is released below
+        lock.unlock();
+        std::exception_ptr err{nullptr};
+        try
+        {
+            evaluate(head);
+        }
+        catch(...)
+        {
+            err = std::current_exception();
+        }
+        lock.lock();
+        if(err != nullptr && error == nullptr)
+            error = err;
+        head = (head + 1) % num_buffers;
+        num_pending--;
+        cv.notify_all();
+    }
+}
+
+
 diagnostic_t :: ~diagnostic_t() 
 {
     theta_ptr = nullptr;
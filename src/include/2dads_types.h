@@ -5,6 +5,7 @@
 #include <cassert>
 #include <vector>
 #include <cmath>
+#include <limits>
 
 #if defined(__clang__) && defined(__CUDA__) && defined(__CUDA_ARCH__)
 #define CUDAMEMBER __host__ __device__
@@ -120,6 +121,62 @@ namespace twodads {
 
     */
     constexpr real_t beta[3][3] = {{1.0, 0.0, 0.0}, {2.0, -1.0, 0.0}, {3.0, -3.0, 1.0}};
+
+    /**
+     .. cpp:function:: inline void stiff_coeffs(const size_t order, const real_t* dt, real_t* alpha_v, real_t* beta_v)
+
+     :param const size_t order: Order of the time integration, 1..3
+     :param const real_t* dt: Step sizes, dt[0] = t^{0} - t^{-1}, dt[k] = t^{-k} - t^{-k-1}. Requires order elements.
+     :param real_t* alpha_v: Coefficients for the implicit part, order + 1 elements are written
+     :param real_t* beta_v: Coefficients for the explicit part, order elements are written
+
+     Coefficients of the stiffly stable scheme for variable step sizes,
+     alpha_0 u^{0} = sum_k alpha_k u^{-k} + dt[0] * (sum_k beta_k N^{-k} + L u^{0}).
+     alpha is the derivative of the polynomial interpolating u^{0}...u^{-order} at t^{0},
+     beta extrapolates N^{-1}...N^{-order} to t^{0}. For constant step sizes they are
+     equal to alpha[order - 1] and beta[order - 1].
+
+    */
+    inline void stiff_coeffs(const size_t order, const real_t* dt, real_t* alpha_v, real_t* beta_v)
+    {
+        assert(order > 0 && order < 4);
+        // Time of the levels, normalized to the current step: tau[0] = 0, tau[1] = -1, ...
+        real_t tau[4] = {0.0, 0.0, 0.0, 0.0};
+        for(size_t k = 1; k < order + 1; k++)
+            tau[k] = tau[k - 1] - dt[k - 1] / dt[0];
+
+        // d/dt of the Lagrange polynomials through tau[0]...tau[order] at tau[0]
+        alpha_v[0] = 0.0;
+        for(size_t i = 1; i < order + 1; i++)
+            alpha_v[0] += 1.0 / (tau[0] - tau[i]);
+        for(size_t k = 1; k < order + 1; k++)
+        {
+            real_t num{1.0};
+            real_t denom{tau[k] - tau[0]};
+            for(size_t i = 1; i < order + 1; i++)
+            {
+                if(i == k)
+                    continue;
+                num *= tau[0] - tau[i];
+                denom *= tau[k] - tau[i];
+            }
+            alpha_v[k] = -num / denom;
+        }
+
+        // Lagrange polynomials through tau[1]...tau[order], evaluated at tau[0]
+        for(size_t k = 1; k < order + 1; k++)
+        {
+            real_t val{1.0};
+            for(size_t i = 1; i < order + 1; i++)
+            {
+                if(i == k)
+                    continue;
+                val *= (tau[0] - tau[i]) / (tau[k] - tau[i]);
+            }
+            beta_v[k - 1] = val;
+        }
+    }
+
     enum class tint_order_t {o1_t, o2_t, o3_t};
 
 
@@ -142,6 +199,8 @@ namespace twodads {
      bc_neumann    Neumann boundary condition
      bc_periodic   Periodic boundary condition
      bc_null       No boundary condition. Interpolation will throw an error.
+                   The finite difference operators treat it as the edge of a
+                   subdomain, see slab_config_js :: get_subdomain.
      ============  =========================================================
 
     */
@@ -177,6 +236,43 @@ namespace twodads {
     */
     enum class dft_t {dft_1d, dft_2d};
 
+    /**
+     .. cpp:enum-class:: solver_t
+
+     Defines the solver used for the linear systems in the radial direction
+
+     ==================  ===============================================================
+     Value               Description
+     ==================  ===============================================================
+     solver_tridiag      Tridiagonal solver, LAPACKE_zgtsv (host) or cusparse (device).
+                         On the host, solver_spike is used if My21 < number of threads
+     solver_r2r          Diagonalization by real-to-real DFTs in x (host only)
+     solver_thomas       Thomas algorithm, LU factors are computed once (host only)
+     solver_thomas_simd  Thomas algorithm, vectorized over Fourier modes (host only)
+     solver_thomas_real  As solver_thomas_simd, for real coefficients (host only)
+     solver_spike        Partitioned solver, parallel along x (host only)
+     solver_spike_mpi    Partitioned solver, x distributed over MPI ranks (host, USE_MPI)
+     ==================  ===============================================================
+
+    */
+    enum class solver_t {solver_tridiag, solver_r2r, solver_thomas, solver_thomas_simd, solver_thomas_real, solver_spike, solver_spike_mpi};
+
+    /**
+     .. cpp:enum-class:: scheme_t
+
+     Defines the time integration scheme
+
+     ==================  ====================================================================
+     Value               Description
+     ==================  ====================================================================
+     scheme_karniadakis  Stiffly-stable multi-step scheme, orders 1-3, starts with lower order
+     scheme_ark          Additive Runge-Kutta scheme ARK3(2)4L[2]SA, cell-centered grid only
+     scheme_etdrk4       Exponential time differencing RK4, vertex-centered grid only
+     ==================  ====================================================================
+
+    */
+    enum class scheme_t {scheme_karniadakis, scheme_ark, scheme_etdrk4};
+
 
     struct slab_layout_t
     {
@@ -193,11 +289,12 @@ namespace twodads {
 
         slab_layout_t(real_t _xl, real_t _dx, real_t _yl, real_t _dy, 
                 size_t _nx, size_t _pad_x, size_t _my, size_t _pad_y, 
-                twodads::grid_t _grid) :
+                twodads::grid_t _grid, real_t _stretch_x = 0.0) :
             x_left(_xl), delta_x(_dx), y_lo(_yl), delta_y(_dy), 
             Nx(_nx), pad_x(_pad_x), My(_my), pad_y(_pad_y),
             grid(_grid), 
-            cellshift(grid == twodads::grid_t::vertex_centered ? 0.0 : 0.5) 
+            cellshift(grid == twodads::grid_t::vertex_centered ? 0.0 : 0.5),
+            stretch_x(_stretch_x)
             {};
 
 
@@ -212,6 +309,7 @@ namespace twodads {
             os << "\tMy = " << sl.get_my();
             os << "\tpad_y = " << sl.get_pad_y();
             os << "\tcellshift = " << sl.get_cellshift();
+            os << "\tstretch_x = " << sl.get_stretch_x();
             os << std::endl;
             return(os);
         }
@@ -269,9 +367,102 @@ namespace twodads {
           
           :param const size_t n: Discretization point.
 
-         Calculates the x-coordinate of a discretization point.
+         Calculates the x-coordinate of a discretization point. For a stretched grid
+         the points are given by the mapping
+
+           ..math:: x(\xi) = x_\mathrm{left} + L_x \left(\xi - \frac{a}{2\pi} \sin 2\pi\xi \right), \quad \xi = (n + \mathrm{cellshift}) / N_x
+
+         with :math:`a` = stretch_x. This clusters points at both boundaries, the ratio of
+         the largest to the smallest grid spacing is :math:`(1 + a) / (1 - a)`.
         */
-        CUDAMEMBER inline real_t get_x(const size_t n) const {return(get_xleft() + (static_cast<real_t>(n) + get_cellshift()) * get_deltax());};
+        CUDAMEMBER inline real_t get_x(const size_t n) const 
+        {
+            if(get_stretch_x() == 0.0)
+                return(get_xleft() + (static_cast<real_t>(n) + get_cellshift()) * get_deltax());
+            const real_t xi{(static_cast<real_t>(n) + get_cellshift()) / static_cast<real_t>(get_nx())};
+            return(get_xleft() + get_Lx() * (xi - get_stretch_x() * sin(TWOPI * xi) / TWOPI));
+        };
+
+        /**
+         .. cpp:function:: inline real_t get_dxds(const real_t s) const
+
+          :param const real_t s: Fractional index of the discretization point, n + cellshift.
+
+         First metric coefficient of the grid mapping, :math:`x_s / \triangle_x`, with
+         s the continuous grid index. Unity on uniform grids. Evaluated at s = 0 and s = Nx it gives
+         the grid spacing at the domain boundaries.
+        */
+        CUDAMEMBER inline real_t get_dxds(const real_t s) const 
+        {
+            return(1.0 - get_stretch_x() * cos(TWOPI * s / static_cast<real_t>(get_nx())));
+        };
+
+        /**
+         .. cpp:function:: inline real_t get_d2xds2(const real_t s) const
+
+          :param const real_t s: Fractional index of the discretization point, n + cellshift.
+
+         Second metric coefficient of the grid mapping, :math:`x_{ss} / \triangle_x`. 
+         Zero on uniform grids. Derivatives on the stretched grid are computed from the
+         derivatives with respect to s:
+
+           ..math:: f_x = \frac{f_s}{x_s}, \quad f_{xx} = \frac{1}{x_s^2} \left(f_{ss} - \frac{x_{ss}}{x_s} f_s\right)
+        */
+        CUDAMEMBER inline real_t get_d2xds2(const real_t s) const 
+        {
+            return(get_stretch_x() * TWOPI * sin(TWOPI * s / static_cast<real_t>(get_nx())) / static_cast<real_t>(get_nx()));
+        };
+
+        /**
+         .. cpp:function:: inline real_t get_d2dx2_lower(const size_t n) const
+
+          :param const size_t n: Discretization point.
+
+         Weight of the point n-1 in the three-point approximation of the second
+         x-derivative at the point n, in units of :math:`1 / \triangle_x^2`. Unity on uniform grids.
+        */
+        CUDAMEMBER inline real_t get_d2dx2_lower(const size_t n) const
+        {
+            const real_t s{static_cast<real_t>(n) + get_cellshift()};
+            const real_t x_s{get_dxds(s)};
+            return((1.0 + 0.5 * get_d2xds2(s) / x_s) / (x_s * x_s));
+        };
+
+        /**
+         .. cpp:function:: inline real_t get_d2dx2_upper(const size_t n) const
+
+          :param const size_t n: Discretization point.
+
+         Weight of the point n+1 in the three-point approximation of the second
+         x-derivative at the point n, in units of :math:`1 / \triangle_x^2`. Unity on uniform grids.
+        */
+        CUDAMEMBER inline real_t get_d2dx2_upper(const size_t n) const
+        {
+            const real_t s{static_cast<real_t>(n) + get_cellshift()};
+            const real_t x_s{get_dxds(s)};
+            return((1.0 - 0.5 * get_d2xds2(s) / x_s) / (x_s * x_s));
+        };
+
+        /**
+         .. cpp:function:: inline real_t get_d2dx2_center(const size_t n) const
+
+          :param const size_t n: Discretization point.
+
+         Weight of the point n in the three-point approximation of the second
+         x-derivative at the point n, in units of :math:`1 / \triangle_x^2`. -2 on uniform grids.
+        */
+        CUDAMEMBER inline real_t get_d2dx2_center(const size_t n) const
+        {
+            const real_t x_s{get_dxds(static_cast<real_t>(n) + get_cellshift())};
+            return(-2.0 / (x_s * x_s));
+        };
+
+        /**
+         .. cpp:function:: inline real_t get_deltax_min() const
+
+         Returns the smallest grid spacing in x-direction.
+        */
+        CUDAMEMBER inline real_t get_deltax_min() const {return(get_deltax() * (1.0 - fabs(get_stretch_x())));};
 
         /**
          .. cpp:function:: inline real_t get_y(const size_t m) const
@@ -371,6 +562,14 @@ namespace twodads {
         */
         CUDAMEMBER inline real_t get_cellshift() const {return(cellshift);};
 
+        /**
+         .. cpp:function:: inline twodads::real_t get_stretch_x() const
+
+         Returns the stretching parameter of the grid in x-direction. 0 for a uniform grid.
+
+        */
+        CUDAMEMBER inline real_t get_stretch_x() const {return(stretch_x);};
+
         /**
          .. cpp:member:: const real_t x_left
 
@@ -449,6 +648,14 @@ namespace twodads {
         */
         const real_t cellshift;
 
+        /**
+         .. cpp:member:: const twodads::real_t stretch_x
+
+         Stretching parameter of the grid in x-direction, 0 <= stretch_x < 1. See get_x.
+
+        */
+        const real_t stretch_x;
+
         // Align slab_layout_t at 8 byte boundaries(as for real_t)
         // Do this, otherwise you get differently aligned structures when
         // compiling in g++ and nvcc. Also, don't forget the -maligned-double flag
@@ -461,6 +668,89 @@ namespace twodads {
     } __attribute__ ((aligned (8)));
 
 
+    struct region_t
+    {
+        /**
+         .. cpp:namespace-push:: region_t
+
+        */
+
+        /**
+         .. cpp:class:: region_t
+
+         Rectangular index range :math:`n_\mathrm{lo} \leq n < n_\mathrm{hi}`, :math:`m_\mathrm{lo} \leq m < m_\mathrm{hi}` of an array.
+         Used to restrict apply and elementwise of cuda_array_bc_nogp to a part of the domain, f.ex. the boundary rows.
+         Upper bounds beyond the array are clipped, see clip.
+
+        */
+        CUDAMEMBER region_t(const size_t _n_lo, const size_t _n_hi, const size_t _m_lo, const size_t _m_hi) :
+            n_lo(_n_lo), n_hi(_n_hi), m_lo(_m_lo), m_hi(_m_hi) {};
+
+        /**
+         .. cpp:function:: static region_t rows(const size_t n_lo, const size_t n_hi)
+
+         Returns the region of all columns in rows n_lo .. n_hi - 1.
+
+        */
+        static region_t rows(const size_t _n_lo, const size_t _n_hi) {return(region_t(_n_lo, _n_hi, 0, std::numeric_limits<size_t>::max()));};
+
+        /**
+         .. cpp:function:: static region_t row(const size_t n)
+
+         Returns the region of all columns in row n.
+
+        */
+        static region_t row(const size_t _n) {return(rows(_n, _n + 1));};
+
+        /**
+         .. cpp:function:: static region_t cols(const size_t m_lo, const size_t m_hi)
+
+         Returns the region of all rows in columns m_lo .. m_hi - 1.
+
+        */
+        static region_t cols(const size_t _m_lo, const size_t _m_hi) {return(region_t(0, std::numeric_limits<size_t>::max(), _m_lo, _m_hi));};
+
+        /**
+         .. cpp:function:: static region_t elem(const size_t n, const size_t m)
+
+         Returns the region containing the single element (n, m).
+
+        */
+        static region_t elem(const size_t _n, const size_t _m) {return(region_t(_n, _n + 1, _m, _m + 1));};
+
+        /**
+         .. cpp:function:: region_t clip(const size_t nx, const size_t my) const
+
+         Returns the intersection with the index range 0 .. nx - 1, 0 .. my - 1.
+         
+        */
+        CUDAMEMBER inline region_t clip(const size_t nx, const size_t my) const
+        {
+            const size_t n_hi_c{n_hi < nx ? n_hi : nx};
+            const size_t m_hi_c{m_hi < my ? m_hi : my};
+            return(region_t(n_lo < n_hi_c ? n_lo : n_hi_c, n_hi_c, m_lo < m_hi_c ? m_lo : m_hi_c, m_hi_c));
+        }
+
+        CUDAMEMBER inline size_t get_n_lo() const {return(n_lo);};
+        CUDAMEMBER inline size_t get_n_hi() const {return(n_hi);};
+        CUDAMEMBER inline size_t get_m_lo() const {return(m_lo);};
+        CUDAMEMBER inline size_t get_m_hi() const {return(m_hi);};
+        CUDAMEMBER inline size_t get_num_rows() const {return(n_hi - n_lo);};
+        CUDAMEMBER inline size_t get_num_cols() const {return(m_hi - m_lo);};
+
+        private:
+            const size_t n_lo;
+            const size_t n_hi;
+            const size_t m_lo;
+            const size_t m_hi;
+
+        /**
+         .. cpp:namespace-pop::
+
+        */
+    };
+
+
 
 
 
@@ -577,11 +867,13 @@ namespace twodads {
      .. cpp:class:: stiff_params_t
 
      Stores data for the Karniadakis time integrator (stiffly-stable time integration scheme).
+     The implicit part is diff * nabla^2 u - hv * (-nabla^2)^p u, with p = hv_order. In Fourier 
+     space this is -(diff * k^2 + hv * k^(2p)) u.
 
     */
         public:
-            CUDAMEMBER stiff_params_t(real_t dt, real_t lx, real_t ly, real_t d, real_t h, size_t my, size_t nx21, size_t l) :
-                delta_t(dt), length_x(lx), length_y(ly), diff(d), hv(h), My(my), Nx21(nx21), level(l) {};
+            CUDAMEMBER stiff_params_t(real_t dt, real_t lx, real_t ly, real_t d, real_t h, size_t my, size_t nx21, size_t l, size_t hvo = 3) :
+                delta_t(dt), length_x(lx), length_y(ly), diff(d), hv(h), My(my), Nx21(nx21), level(l), hv_order(hvo) {};
             CUDAMEMBER real_t get_deltat() const {return(delta_t);};
             CUDAMEMBER real_t get_lengthx() const {return(length_x);};
             CUDAMEMBER real_t get_lengthy() const {return(length_y);};
@@ -590,6 +882,7 @@ namespace twodads {
             CUDAMEMBER size_t get_my() const {return(My);};
             CUDAMEMBER size_t get_nx21() const {return(Nx21);};
             CUDAMEMBER size_t get_tlevs() const {return(level);};
+            CUDAMEMBER size_t get_hv_order() const {return(hv_order);};
         private:
             const real_t delta_t;
             const real_t length_x;
@@ -599,6 +892,7 @@ namespace twodads {
             const size_t My;
             const size_t Nx21;
             const size_t level;
+            const size_t hv_order;
     } __attribute__ ((aligned (8)));
     /**
      .. cpp:namespace-pop
@@ -688,6 +982,7 @@ namespace twodads {
      init_sine            Initializes a sine function
      init_turbulent_bath  Initializes a turbulent bath
      init_lamb_dipole     Initializes a Lamb dipole
+     init_file            Interpolates a snapshot from an output file
      ===================  ========================================
 
      Enumerates available initialization functions.
@@ -701,7 +996,8 @@ namespace twodads {
         init_sine,            ///< Initializes sinusoidal profile for theta
         init_mode,            ///< Initializes single modes for theta_hat
         init_turbulent_bath,  ///< Initialize all modes randomly
-        init_lamb_dipole      ///<Lamb Dipole
+        init_lamb_dipole,     ///<Lamb Dipole
+        init_file             ///< Interpolates a snapshot from an output file onto the grid
     };
 
     /**
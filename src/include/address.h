@@ -96,7 +96,7 @@ class address_t
     public:
         CUDA_MEMBER address_t(const twodads::slab_layout_t& _sl, const twodads::bvals_t<T>& _bv) : 
             Nx(_sl.get_nx()), My(_sl.get_my()), pad_My(_sl.get_pad_y()), 
-            deltax(_sl.get_deltax()), deltay(_sl.get_deltay()), bv(_bv),
+            deltax(_sl.get_deltax() * _sl.get_dxds(0.0)), deltay(_sl.get_deltay()), bv(_bv),
             gp_interpolator_left{nullptr}, gp_interpolator_right{nullptr}
             {
                 switch(bv.get_bc_left())
@@ -252,7 +252,8 @@ class address_t
         const size_t My;
         // Number of padding in y
         const size_t pad_My;
-        // Sample discretization in x
+        // Sample discretization in x at the domain boundaries. On stretched grids this is
+        // the grid spacing of the outermost cells, see slab_layout_t::get_dxds
         const T deltax;
         // Sample discretization in y
         const T deltay;
@@ -0,0 +1,115 @@
+/*
+ * Guard against heap allocations in the time steps
+ *
+ * Compiling with -DALLOC_GUARD and linking alloc_guard.cpp replaces the global operator new with a
+ * version that counts the allocations of the program. While the guard is armed, an allocation writes
+ * a message and a backtrace to stderr and aborts the program, so that a debugger or a core dump shows where 
+ * it happened. See the 2dads_alloc_guard target in the Makefile. Without -DALLOC_GUARD all functions are empty.
+ * The guard is armed per thread: helper threads, e.g. of the diagnostics, may allocate during a guarded step.
+ *
+ * main_bc.cpp arms the guard for each time step after the first one, which allocates the stage storage of
+ * the integrators, and pauses it for output, diagnostics, and checkpoints.
+ *
+ * Only allocations with operator new are counted. Memory allocated with malloc, e.g. by FFTW, HDF5,
+ * or LAPACK, is not, neither is device memory.
+ */
+
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+#include <cstddef>
+
+
+namespace alloc_guard
+{
+    /**
+     .. cpp:namespace-push:: alloc_guard
+
+    */
+
+#ifdef ALLOC_GUARD
+    /**
+     .. cpp:function:: void arm()
+
+     Aborts the program on the next allocation of the calling thread.
+
+    */
+    void arm();
+
+    /**
+     .. cpp:function:: void disarm()
+
+     Allows allocations again.
+
+    */
+    void disarm();
+
+    /**
+     .. cpp:function:: bool is_armed()
+
+     Returns true if the guard is armed for the calling thread.
+
+    */
+    bool is_armed();
+
+    /**
+     .. cpp:function:: size_t get_num_allocations()
+
+     Returns the number of allocations of all threads since the start of the program.
+
+    */
+    size_t get_num_allocations();
+#else
+    inline void arm() {};
+    inline void disarm() {};
+    inline bool is_armed() {return(false);};
+    inline size_t get_num_allocations() {return(0);};
+#endif //ALLOC_GUARD
+
+
+    /**
+     .. cpp:class:: scope_t
+
+     Arms the guard for the lifetime of the object if active is true.
+
+    */
+    class scope_t
+    {
+        public:
+            scope_t(const bool _active) : active(_active) {if(active) arm();};
+            ~scope_t() {if(active) disarm();};
+
+            scope_t(const scope_t&) = delete;
+            scope_t& operator=(const scope_t&) = delete;
+
+        private:
+            const bool active;
+    };
+
+
+    /**
+     .. cpp:class:: pause_t
+
+     Disarms the guard for the lifetime of the object, e.g. for output within a guarded scope.
+
+    */
+    class pause_t
+    {
+        public:
+            pause_t() : was_armed(is_armed()) {disarm();};
+            ~pause_t() {if(was_armed) arm();};
+
+            pause_t(const pause_t&) = delete;
+            pause_t& operator=(const pause_t&) = delete;
+
+        private:
+            const bool was_armed;
+    };
+
+    /**
+     .. cpp:namespace-pop::
+
+    */
+}
+
+#endif //ALLOC_GUARD_H
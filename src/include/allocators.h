@@ -9,7 +9,11 @@
 
 #include <memory>
 #include <iostream>
+#include <sstream>
+#include <new>
 #include "error.h"
+#include "footprint.h"
+#include "logger.h"
 
 //#ifdef __CUDACC__
 #if defined(__clang__) && defined(__CUDA__) && defined(__CUDA_ARCH__)
@@ -26,6 +30,7 @@ struct deleter_device
         void operator() (T* p)
         {
             //std::cerr << "deleter_device: freeing memory at " << p << std::endl;
+            footprint :: registry_t :: get().remove(p);
             cudaError_t res;
             if ((res = cudaFree(static_cast<void*>(p))) != cudaSuccess)
             {
@@ -54,8 +59,12 @@ struct allocator_device
         cudaError_t res;
         if((res = cudaMalloc(&ptr, s * sizeof(T))) != cudaSuccess)
         {
-            throw;
+            std::stringstream report;
+            footprint :: registry_t :: get().write_report(report);
+            LOG_MESSAGE(logger::level_t::error, "cudaMalloc of %zu bytes failed. Memory footprint:\n%s", s * sizeof(T), report.str().c_str());
+            throw gpu_error(cudaGetErrorString(res));
         }
+        footprint :: registry_t :: get().add(ptr, s * sizeof(T));
         return ptr_type(static_cast<T*>(ptr));
     }
 
@@ -95,6 +104,7 @@ struct deleter_host
     void operator()(T* p) 
     { 
         //std::cerr << "deleter_host: freeing memory at " << p << std::endl;
+        footprint :: registry_t :: get().remove(p);
         delete [] p; 
     }
 };
@@ -120,7 +130,7 @@ struct allocator_host
         //std::cerr << "allocator_host :: free ... done" << std::endl;
     }
 
-    // Allocate s * sizeof(T) bytes
+    // Allocate s * sizeof(T) bytes. Logs the memory footprint if the allocation fails.
     ptr_type allocate (size_t s) 
     { 
         //std::cerr << "allocator_host :: allocating: " << s  << " * " << sizeof(T);
@@ -130,10 +140,14 @@ struct allocator_host
             //ptr_type ptr{new T[s]};
             ptr.reset(new T[s]);
         }
-        catch(std::exception& ba)
+        catch(std::bad_alloc& ba)
         {
-            std::cerr << "bad_alloc caught: " << ba.what() << '\n';
+            std::stringstream report;
+            footprint :: registry_t :: get().write_report(report);
+            LOG_MESSAGE(logger::level_t::error, "bad_alloc caught: %s allocating %zu bytes. Memory footprint:\n%s", ba.what(), s * sizeof(T), report.str().c_str());
+            throw;
         }
+        footprint :: registry_t :: get().add(ptr.get(), s * sizeof(T));
         //std::cerr << "\t...done. Allocated at " << ptr.get() << std::endl;
         return(ptr);
     } 
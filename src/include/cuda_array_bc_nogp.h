@@ -46,6 +46,8 @@
 #include "address.h"
 #include "error.h"
 #include "allocators.h"
+#include "footprint.h"
+#include "profiler.h"
 
 
 #if defined(__clang__) && defined(__CUDA__) && defined(__CUDA_ARCH__)
@@ -184,6 +186,33 @@ namespace device
     }
     
 
+    // Apply device_func on the elements of region only. Thread (row, col) handles element (n_lo + row, m_lo + col)
+    template <typename T, typename O>
+    __global__
+    void kernel_apply_region(T* array_d_t, O device_func, const twodads::slab_layout_t geom, const twodads::region_t region)
+    {
+        const size_t n{region.get_n_lo() + cuda :: thread_idx :: get_row()};
+        const size_t m{region.get_m_lo() + cuda :: thread_idx :: get_col()};
+        const size_t index{n * (geom.get_my() + geom.get_pad_y()) + m};
+
+        if(n < region.get_n_hi() && m < region.get_m_hi())
+            array_d_t[index] = device_func(array_d_t[index], n, m, geom);
+    }
+
+
+    template <typename T, typename O>
+    __global__
+    void kernel_elementwise_region(T* lhs, T* rhs, O device_func, const twodads::slab_layout_t geom, const twodads::region_t region)
+    {
+        const size_t n{region.get_n_lo() + cuda :: thread_idx :: get_row()};
+        const size_t m{region.get_m_lo() + cuda :: thread_idx :: get_col()};
+        const size_t index{n * (geom.get_my() + geom.get_pad_y()) + m};
+
+        if(n < region.get_n_hi() && m < region.get_m_hi())
+            lhs[index] = device_func(lhs[index], rhs[index]);
+    }
+
+
     // For accessing elements in GPU kernels and interpolating ghost points
     template <typename T>
     __global__
@@ -282,6 +311,33 @@ namespace detail
     }
 
 
+    // Grid that covers region with blocks of size block
+    inline dim3 impl_grid_region(const twodads::region_t& region, const dim3& block)
+    {
+        return(dim3((region.get_num_cols() + block.x - 1) / block.x, (region.get_num_rows() + block.y - 1) / block.y));
+    }
+
+
+    template <typename T, typename F>
+    inline void impl_apply(T* data_ptr, F myfunc, const twodads::slab_layout_t& geom, const twodads::region_t& region, const dim3& block, allocator_device<T>)
+    {
+        if(region.get_num_rows() == 0 || region.get_num_cols() == 0)
+            return;
+        device :: kernel_apply_region<<<impl_grid_region(region, block), block>>>(data_ptr, myfunc, geom, region);
+        gpuErrchk(cudaPeekAtLastError());
+    }
+
+
+    template <typename T, typename F>
+    inline void impl_elementwise(T* x, T* rhs, F myfunc, const twodads::slab_layout_t& geom, const twodads::region_t& region, const dim3& block, allocator_device<T>)
+    {
+        if(region.get_num_rows() == 0 || region.get_num_cols() == 0)
+            return;
+        device :: kernel_elementwise_region<<<impl_grid_region(region, block), block>>>(x, rhs, myfunc, geom, region);
+        gpuErrchk(cudaPeekAtLastError());
+    }
+
+
     template <typename T>
     inline void impl_advance(T** tlev_ptr, const size_t tlevs, allocator_device<T>)
     {
@@ -328,6 +384,7 @@ namespace detail
     template <typename T, typename F>
     void impl_apply(T* data_ptr, F host_func, const twodads::slab_layout_t& geom, const bool is_transformed, const dim3& grid, const dim3& block, allocator_host<T>)
     {
+        PROFILE_SCOPE("host::impl_apply", 2 * geom.get_nelem_per_t() * sizeof(T));
         size_t index{0};
         size_t m{0};
 
@@ -362,6 +419,7 @@ namespace detail
     template <typename T, typename F>
     void impl_elementwise(T* lhs, T* rhs, F host_func, const twodads::slab_layout_t& geom, const bool is_transformed, const dim3& grid, const dim3& block, allocator_host<T>)
     {
+        PROFILE_SCOPE("host::impl_elementwise", 3 * geom.get_nelem_per_t() * sizeof(T));
         //host :: host_elementwise(lhs, rhs, myfunc, geom, transformed);
         size_t index{0};
         size_t m{0};
@@ -393,6 +451,36 @@ namespace detail
         }
     }
 
+    // Region-restricted versions of impl_apply and impl_elementwise. region is clipped to the array.
+    // Regions with less than omp_min_elem elements, f.ex. single rows, are processed by the calling thread.
+    constexpr size_t omp_min_elem{4096};
+
+    template <typename T, typename F>
+    void impl_apply(T* data_ptr, F host_func, const twodads::slab_layout_t& geom, const twodads::region_t& region, const dim3& block, allocator_host<T>)
+    {
+        const size_t my_plus_pad{geom.get_my() + geom.get_pad_y()};
+#pragma omp parallel for if(region.get_num_rows() * region.get_num_cols() >= omp_min_elem)
+        for(size_t n = region.get_n_lo(); n < region.get_n_hi(); n++)
+        {
+            for(size_t m = region.get_m_lo(); m < region.get_m_hi(); m++)
+                data_ptr[n * my_plus_pad + m] = host_func(data_ptr[n * my_plus_pad + m], n, m, geom);
+        }
+    }
+
+
+    template <typename T, typename F>
+    void impl_elementwise(T* lhs, T* rhs, F host_func, const twodads::slab_layout_t& geom, const twodads::region_t& region, const dim3& block, allocator_host<T>)
+    {
+        const size_t my_plus_pad{geom.get_my() + geom.get_pad_y()};
+#pragma omp parallel for if(region.get_num_rows() * region.get_num_cols() >= omp_min_elem)
+        for(size_t n = region.get_n_lo(); n < region.get_n_hi(); n++)
+        {
+            for(size_t m = region.get_m_lo(); m < region.get_m_hi(); m++)
+                lhs[n * my_plus_pad + m] = host_func(lhs[n * my_plus_pad + m], rhs[n * my_plus_pad + m]);
+        }
+    }
+
+
     template <typename T>
     inline void impl_advance(T** tlev_ptr, const size_t tlevs, allocator_host<T>)
     {
@@ -535,6 +623,25 @@ public:
         detail :: impl_apply(get_tlev_ptr(tidx), myfunc, get_geom(), is_transformed(tidx), get_grid_unroll(), get_block(), allocator_type{});   
     }
 
+    /**
+     .. cpp:function:: template <typename F> inline void cuda_array_bc_nogp::apply(F myfunc, const twodads::region_t& region, const size_t tidx)
+
+      Apply F on the array elements in region at tidx. The cost is proportional to the size of the region.
+   
+      ======  ====================================================
+      Input   Description
+      ======  ====================================================
+      myfunc  F, functor taking 2 T as input
+      region  const twodads::region_t&, elements to apply myfunc on
+      tidx    const size_t - Time index on which myfunc is applied
+      ======  ====================================================
+    */
+    template <typename F> inline void apply(F myfunc, const twodads::region_t& region, const size_t tidx)
+    {
+        check_bounds(tidx + 1, 0, 0);
+        detail :: impl_apply(get_tlev_ptr(tidx), myfunc, get_geom(), clip_region(region, is_transformed(tidx)), get_block(), allocator_type{});
+    }
+
     /**
      .. cpp:function:: template <typename F> inline void cuda_array_bc_nogp::elementwise(F myfunc, const cuda_array_bc_nogp<T, allocator>& rhs, const size_t tidx_rhs, const siz_t tidx_lhs)
 
@@ -587,6 +694,59 @@ public:
         check_bounds(tidx_lhs + 1, 0, 0);
         detail :: impl_elementwise(get_tlev_ptr(tidx_lhs), get_tlev_ptr(tidx_rhs), myfunc, get_geom(), is_transformed(tidx_lhs) | is_transformed(tidx_rhs), get_grid(), get_block(), allocator_type{});   
     }
+
+    /**
+     .. cpp:function:: template <typename F> inline void cuda_array_bc_nogp::elementwise(F myfunc, const cuda_array_bc_nogp<T, allocator>& rhs, const twodads::region_t& region, const size_t tidx_lhs, const size_t tidx_rhs)
+
+       Evaluates myfunc(l, r) on the elements l, r of arrays lhs and rhs in region. 
+       Stores result in lhs.
+
+       ========  ==================================================
+       Input     Description
+       ========  ==================================================
+       myfunc    callable, takes two T as input, returns T
+       rhs       const cuda_array_bc_nogp<T, allocator>&, RHS array
+       region    const twodads::region_t&, elements to update
+       tidx_lhs  const size_t, time index of LHS array
+       tidx_rhs  const size_t, time index of RHS array
+       ========  ==================================================
+
+    */
+    template<typename F> inline void elementwise(F myfunc, const cuda_array_bc_nogp<T, allocator>& rhs, const twodads::region_t& region,
+                                                 const size_t tidx_lhs, const size_t tidx_rhs)
+    {
+        rhs.check_bounds(tidx_rhs + 1, 0, 0);
+        check_bounds(tidx_lhs + 1, 0, 0);
+        assert(rhs.get_geom() == get_geom());
+        assert(is_transformed(tidx_lhs) == rhs.is_transformed(tidx_rhs));
+
+        detail :: impl_elementwise(get_tlev_ptr(tidx_lhs), rhs.get_tlev_ptr(tidx_rhs), myfunc, get_geom(), 
+                                   clip_region(region, is_transformed(tidx_lhs) | rhs.is_transformed(tidx_rhs)), get_block(), allocator_type{});
+    }
+
+    /**
+     .. cpp:function:: template <typename F> inline void cuda_array_bc_nogp::elementwise(F myfunc, const twodads::region_t& region, const size_t tidx_lhs, const size_t tidx_rhs)
+
+       Evaluates myfunc(l1, l2) on the elements in region of the array at time indices t1 and t2.
+       Stores result at tidx t1.
+
+       ========  =========================================
+       Input     Description
+       ========  =========================================
+       myfunc    callable, takes two T as input, returns T
+       region    const twodads::region_t&, elements to update
+       tidx_lhs  const size_t, time index t1 for array
+       tidx_rhs  const size_t, time index t2 for array
+       ========  =========================================
+
+    */
+    template<typename F> inline void elementwise(F myfunc, const twodads::region_t& region, const size_t tidx_lhs, const size_t tidx_rhs)
+    {
+        check_bounds(tidx_rhs + 1, 0, 0);
+        check_bounds(tidx_lhs + 1, 0, 0);
+        detail :: impl_elementwise(get_tlev_ptr(tidx_lhs), get_tlev_ptr(tidx_rhs), myfunc, get_geom(), 
+                                   clip_region(region, is_transformed(tidx_lhs) | is_transformed(tidx_rhs)), get_block(), allocator_type{});
+    }
        
 
 	/**
@@ -805,7 +965,32 @@ public:
         return(transformed[tidx]);
     };
 
+    /**
+     .. cpp:function:: inline void cuda_array_bc_nogp :: set_tag(const std::string& owner, const std::string& name)
+
+     Tags the data of the array in the memory footprint, see footprint.h.
+
+     =====  ===========================================================
+     Input  Description
+     =====  ===========================================================
+     owner  const std::string&, component that owns the array
+     name   const std::string&, name of the array within the component
+     =====  ===========================================================
+
+    */
+    inline void set_tag(const std::string& owner, const std::string& name) const
+    {
+        footprint :: registry_t :: get().set_tag(get_data(), owner, name);
+        footprint :: registry_t :: get().set_tag(get_tlev_ptr(), owner, name);
+    }
+
 private:
+    // Clip region to the array. Include the padding elements if the array is transformed, as apply does.
+    inline twodads::region_t clip_region(const twodads::region_t& region, const bool transformed) const
+    {
+        return(region.clip(get_geom().get_nx(), transformed ? get_geom().get_my() + get_geom().get_pad_y() : get_geom().get_my()));
+    }
+
 	const twodads::bvals_t<T> boundaries;
     const twodads::slab_layout_t geom;
     const size_t tlevs;
@@ -874,6 +1059,9 @@ cuda_array_bc_nogp<T, allocator> :: cuda_array_bc_nogp(const cuda_array_bc_nogp<
 {
     my_alloc.copy(rhs -> get_data(), rhs -> get_data() + get_tlevs() * get_geom().get_nelem_per_t(), get_data());
     my_palloc.copy(rhs -> get_tlev_ptr(), rhs -> get_tlev_ptr() + get_tlevs(), get_tlev_ptr());
+    // Copies are accounted to the owner of rhs
+    footprint :: registry_t& fp = footprint :: registry_t :: get();
+    set_tag(fp.get_owner(rhs -> get_data()), fp.get_name(rhs -> get_data()) + " copy");
 };
 
 
@@ -883,6 +1071,9 @@ cuda_array_bc_nogp<T, allocator> :: cuda_array_bc_nogp(const cuda_array_bc_nogp<
 {
     my_alloc.copy(rhs.get_data(), rhs.get_data() + get_tlevs() * get_geom().get_nelem_per_t(), get_data());
     my_palloc.copy(rhs.get_tlev_ptr(), rhs.get_tlev_ptr() + get_tlevs(), get_tlev_ptr());
+    // Copies are accounted to the owner of rhs
+    footprint :: registry_t& fp = footprint :: registry_t :: get();
+    set_tag(fp.get_owner(rhs.get_data()), fp.get_name(rhs.get_data()) + " copy");
 };
 
 
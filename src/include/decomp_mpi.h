@@ -0,0 +1,345 @@
+/*
+ * Distribution of the x-direction of the finite difference grid over MPI ranks
+ */
+
+#ifndef DECOMP_MPI_H
+#define DECOMP_MPI_H
+
+#ifdef USE_MPI
+
+// The C++ bindings of MPI declare MPI::HOST, which clashes with -DHOST
+#ifndef OMPI_SKIP_MPICXX
+#define OMPI_SKIP_MPICXX
+#endif
+#ifndef MPICH_SKIP_MPICXX
+#define MPICH_SKIP_MPICXX
+#endif
+#include <mpi.h>
+#include <vector>
+#include <type_traits>
+#include "2dads_types.h"
+#include "error.h"
+#include "cuda_array_bc_nogp.h"
+#include "derivatives.h"
+#include "profiler.h"
+
+
+class decomp_mpi_t
+{
+    /**
+     .. cpp:class:: decomp_mpi_t
+
+     Communication between the ranks that hold the slabs of a grid decomposed in x, see
+     slab_config_js :: get_subdomain. Rank k holds a contiguous block of rows, the ranks are ordered
+     along x. The y-direction, and with it the DFTs, is not distributed. Each rank sends and receives
+     whole rows of My + pad_y elements: single rows to its neighbours for the finite difference stencils,
+     and all of its rows to the root rank for output and diagnostics.
+
+    */
+    public:
+        static_assert(std::is_same<twodads::real_t, double>::value, "decomp_mpi_t sends twodads::real_t as MPI_DOUBLE");
+
+        /**
+         .. cpp:function:: decomp_mpi_t(const twodads::slab_layout_t& geom, MPI_Comm comm = MPI_COMM_WORLD)
+
+         :param const twodads::slab_layout_t& geom: Layout of the rows of this rank
+         :param MPI_Comm comm: Communicator of the ranks. Collective, all ranks have to construct the object.
+
+        */
+        decomp_mpi_t(const twodads::slab_layout_t& _geom, MPI_Comm _comm = MPI_COMM_WORLD) :
+            geom{_geom}, comm{_comm}
+        {
+            MPI_Comm_rank(comm, &rank);
+            MPI_Comm_size(comm, &num_ranks);
+            MPI_Type_contiguous(static_cast<int>(geom.get_my() + geom.get_pad_y()), MPI_DOUBLE, &row_type);
+            MPI_Type_commit(&row_type);
+
+            const int nx_local{static_cast<int>(geom.get_nx())};
+            row_count.resize(static_cast<size_t>(num_ranks));
+            row_lo.resize(static_cast<size_t>(num_ranks));
+            MPI_Allgather(&nx_local, 1, MPI_INT, row_count.data(), 1, MPI_INT, comm);
+            int n{0};
+            for(size_t p = 0; p < row_count.size(); p++)
+            {
+                row_lo[p] = n;
+                n += row_count[p];
+            }
+            nx_global = static_cast<size_t>(n);
+        }
+
+        ~decomp_mpi_t() {MPI_Type_free(&row_type);}
+
+        decomp_mpi_t(const decomp_mpi_t&) = delete;
+        decomp_mpi_t& operator=(const decomp_mpi_t&) = delete;
+
+        int get_rank() const {return(rank);};
+        int get_num_ranks() const {return(num_ranks);};
+        bool is_root() const {return(rank == 0);};
+        // Rows of this rank and of the whole grid
+        size_t get_nx() const {return(geom.get_nx());};
+        size_t get_nx_global() const {return(nx_global);};
+        // Index of the first row of this rank in the whole grid
+        size_t get_row_lo() const {return(static_cast<size_t>(row_lo[static_cast<size_t>(rank)]));};
+
+        /**
+         .. cpp:function:: void begin_halo(const twodads::real_t* u, twodads::real_t* halo_left, twodads::real_t* halo_right, MPI_Request* req) const
+
+         :param const twodads::real_t* u: Rows of this rank
+         :param twodads::real_t* halo_left: Receives the last row of the left neighbour
+         :param twodads::real_t* halo_right: Receives the first row of the right neighbour
+         :param MPI_Request* req: Four requests, complete them with end_halo
+
+         Starts the exchange of the edge rows with the neighbours. The halos at the domain
+         boundaries are not written. u must not be modified until end_halo returns.
+
+        */
+        void begin_halo(const twodads::real_t* u, twodads::real_t* halo_left, twodads::real_t* halo_right, MPI_Request* req) const
+        {
+            const int stride{static_cast<int>(geom.get_my() + geom.get_pad_y())};
+            const int left{rank > 0 ? rank - 1 : MPI_PROC_NULL};
+            const int right{rank < num_ranks - 1 ? rank + 1 : MPI_PROC_NULL};
+            MPI_Irecv(halo_left, 1, row_type, left, tag_right, comm, &req[0]);
+            MPI_Irecv(halo_right, 1, row_type, right, tag_left, comm, &req[1]);
+            MPI_Isend(u, 1, row_type, left, tag_left, comm, &req[2]);
+            MPI_Isend(u + (static_cast<int>(geom.get_nx()) - 1) * stride, 1, row_type, right, tag_right, comm, &req[3]);
+        }
+
+        void end_halo(MPI_Request* req) const {MPI_Waitall(4, req, MPI_STATUSES_IGNORE);};
+
+        /**
+         .. cpp:function:: void gather(const twodads::real_t* src, twodads::real_t* dst) const
+
+         :param const twodads::real_t* src: Rows of this rank
+         :param twodads::real_t* dst: Rows of the whole grid on the root rank. Ignored on the other ranks.
+
+         Collects the rows of all ranks on the root rank. Collective.
+
+        */
+        void gather(const twodads::real_t* src, twodads::real_t* dst) const
+        {
+            MPI_Gatherv(src, row_count[static_cast<size_t>(rank)], row_type,
+                        dst, row_count.data(), row_lo.data(), row_type, 0, comm);
+        }
+
+        // Largest value and number of non-zero values over all ranks. Collective.
+        twodads::real_t max(const twodads::real_t val) const
+        {
+            twodads::real_t res{val};
+            MPI_Allreduce(&val, &res, 1, MPI_DOUBLE, MPI_MAX, comm);
+            return(res);
+        }
+
+        size_t count(const bool val) const
+        {
+            const int val_int{val ? 1 : 0};
+            int res{0};
+            MPI_Allreduce(&val_int, &res, 1, MPI_INT, MPI_SUM, comm);
+            return(static_cast<size_t>(res));
+        }
+
+    private:
+        // Messages to the left and right neighbour
+        static constexpr int tag_left{1};
+        static constexpr int tag_right{2};
+
+        const twodads::slab_layout_t geom;
+        MPI_Comm comm;
+        MPI_Datatype row_type;
+        int rank;
+        int num_ranks;
+        size_t nx_global;
+        // Number of rows and index of the first row of each rank
+        std::vector<int> row_count;
+        std::vector<int> row_lo;
+};
+
+
+template <typename T>
+class deriv_fd_mpi_t : public deriv_fd_t<T, allocator_host>
+{
+    /**
+     .. cpp:class:: deriv_fd_mpi_t : public deriv_fd_t
+
+     Finite difference derivatives on a subdomain of a grid decomposed in x. dx and the Arakawa bracket
+     compute the interior rows as deriv_fd_t while the edge rows are exchanged with the neighbours, see
+     decomp_mpi_t :: begin_halo. The edge rows are then computed on a copy with three rows, one of them the halo.
+     At the domain boundaries the halo holds the ghost points of the boundary conditions, as interpolated
+     by address_t. The Laplace inversion is that of deriv_fd_t, with the tridiagonal systems solved by
+     solvers :: elliptic_spike_mpi_t. Not shared between slabs, see prepare_shared.
+
+    */
+    public:
+        using deriv_fd_t<T, allocator_host> :: get_geom;
+
+        /**
+         .. cpp:function:: deriv_fd_mpi_t(const twodads::slab_layout_t& geom, const twodads::bvals_t<T>& bvals, const twodads::solver_t solver, const decomp_mpi_t& decomp)
+
+         :param const twodads::slab_layout_t& geom: Layout of the rows of this rank, at least two rows
+         :param const twodads::bvals_t<T>& bvals: Boundary conditions of the Laplace inversion, bc_null at the edges between ranks
+         :param const twodads::solver_t solver: Solver of the Laplace inversion, solver_spike_mpi
+         :param const decomp_mpi_t& decomp: Communication with the other ranks
+
+        */
+        deriv_fd_mpi_t(const twodads::slab_layout_t& _geom, const twodads::bvals_t<T>& _bvals, const twodads::solver_t _solver,
+                       const decomp_mpi_t& _decomp) :
+            deriv_fd_t<T, allocator_host>(_geom, _bvals, _solver),
+            decomp(_decomp),
+            geom_edge{_geom.get_xleft(), _geom.get_deltax(), _geom.get_ylo(), _geom.get_deltay(), 3, 0, _geom.get_my(), _geom.get_pad_y(), _geom.get_grid()},
+            edge_u{geom_edge, twodads::bvals_t<T>(), 1},
+            edge_v{geom_edge, twodads::bvals_t<T>(), 1},
+            edge_res{geom_edge, twodads::bvals_t<T>(), 1},
+            halo_u(2 * (_geom.get_my() + _geom.get_pad_y()), T(0.0)),
+            halo_v(2 * (_geom.get_my() + _geom.get_pad_y()), T(0.0))
+        {
+            if(_geom.get_nx() < 2)
+                throw config_error(std::string("deriv_fd_mpi_t: The subdomain needs at least two rows"));
+            edge_u.set_tag("deriv_fd_mpi_t", "edge_u");
+            edge_v.set_tag("deriv_fd_mpi_t", "edge_v");
+            edge_res.set_tag("deriv_fd_mpi_t", "edge_res");
+        }
+
+        virtual void dx(cuda_array_bc_nogp<T, allocator_host>& src,
+                        cuda_array_bc_nogp<T, allocator_host>& dst,
+                        const size_t t_src, const size_t t_dst, const size_t order)
+        {
+            PROFILE_SCOPE("deriv_fd_mpi_t::dx", 2 * src.get_geom().get_nelem_per_t() * sizeof(T));
+            assert(src.is_transformed(t_src) == false && "deriv_fd_mpi_t :: void dx: src must not be transformed");
+            MPI_Request req[4];
+            decomp.begin_halo(src.get_tlev_ptr(t_src), get_halo_left(halo_u), get_halo_right(halo_u), req);
+            if(order == 1)
+            {
+                auto stencil = [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                               {return(0.5 * (u_right - u_left) * inv_dx);};
+                host :: apply_threepoint_center(src.get_tlev_ptr(t_src), src.get_address_ptr(), dst.get_tlev_ptr(t_dst), stencil, get_geom());
+                decomp.end_halo(req);
+                for(auto edge : {edge_t::left, edge_t::right})
+                {
+                    fill_edge(src, t_src, halo_u, edge_u, edge);
+                    host :: apply_threepoint_center(edge_u.get_tlev_ptr(0), edge_u.get_address_ptr(), edge_res.get_tlev_ptr(0), stencil, geom_edge);
+                    copy_edge(dst, t_dst, edge);
+                }
+            }
+            else if(order == 2)
+            {
+                auto stencil = [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                               {return((u_left + u_right - 2.0 * u_middle - 0.5 * x_ss * (u_right - u_left)) * inv_dx2);};
+                host :: apply_threepoint_center(src.get_tlev_ptr(t_src), src.get_address_ptr(), dst.get_tlev_ptr(t_dst), stencil, get_geom());
+                decomp.end_halo(req);
+                for(auto edge : {edge_t::left, edge_t::right})
+                {
+                    fill_edge(src, t_src, halo_u, edge_u, edge);
+                    host :: apply_threepoint_center(edge_u.get_tlev_ptr(0), edge_u.get_address_ptr(), edge_res.get_tlev_ptr(0), stencil, geom_edge);
+                    copy_edge(dst, t_dst, edge);
+                }
+            }
+            else
+            {
+                decomp.end_halo(req);
+                std::stringstream err_str;
+                err_str << __PRETTY_FUNCTION__ << ": order = " << order << "not implemented";
+                throw(not_implemented_error(err_str.str()));
+            }
+        }
+
+        virtual void pbracket(const cuda_array_bc_nogp<T, allocator_host>& u,
+                              const cuda_array_bc_nogp<T, allocator_host>& v,
+                              cuda_array_bc_nogp<T, allocator_host>& dst,
+                              const size_t t_srcu, const size_t t_srcv, const size_t t_dst)
+        {
+            PROFILE_SCOPE("deriv_fd_mpi_t::pbracket", 3 * u.get_geom().get_nelem_per_t() * sizeof(T));
+            assert(u.is_transformed(t_srcu) == false);
+            assert(v.is_transformed(t_srcv) == false);
+            const size_t Nx{get_geom().get_nx()};
+            const size_t My{get_geom().get_my()};
+
+            // Swap the input parameters as deriv_fd_t :: pbracket
+            MPI_Request req[8];
+            decomp.begin_halo(v.get_tlev_ptr(t_srcv), get_halo_left(halo_v), get_halo_right(halo_v), req);
+            decomp.begin_halo(u.get_tlev_ptr(t_srcu), get_halo_left(halo_u), get_halo_right(halo_u), req + 4);
+
+            host :: arakawa_center(v.get_tlev_ptr(t_srcv), v.get_address_ptr(), u.get_tlev_ptr(t_srcu), u.get_address_ptr(),
+                                   dst.get_tlev_ptr(t_dst), get_geom());
+            // Columns 0 and My - 1 wrap around in y. The rows of this rank are accessed without interpolation.
+            host :: arakawa_single(v.get_tlev_ptr(t_srcv), v.get_address_ptr(), u.get_tlev_ptr(t_srcu), u.get_address_ptr(),
+                                   dst.get_tlev_ptr(t_dst), get_geom(), 1, Nx - 1, 0, 1);
+            host :: arakawa_single(v.get_tlev_ptr(t_srcv), v.get_address_ptr(), u.get_tlev_ptr(t_srcu), u.get_address_ptr(),
+                                   dst.get_tlev_ptr(t_dst), get_geom(), 1, Nx - 1, My - 1, My);
+
+            decomp.end_halo(req);
+            decomp.end_halo(req + 4);
+            for(auto edge : {edge_t::left, edge_t::right})
+            {
+                fill_edge(v, t_srcv, halo_v, edge_v, edge);
+                fill_edge(u, t_srcu, halo_u, edge_u, edge);
+                host :: arakawa_single(edge_v.get_tlev_ptr(0), edge_v.get_address_ptr(), edge_u.get_tlev_ptr(0), edge_u.get_address_ptr(),
+                                       edge_res.get_tlev_ptr(0), geom_edge, 1, 2, 0, My);
+                copy_edge(dst, t_dst, edge);
+            }
+        }
+
+        // The halo buffers are written in each call
+        virtual bool prepare_shared() {return(false);}
+
+    private:
+        enum class edge_t {left, right};
+
+        const decomp_mpi_t& decomp;
+        // Three rows around an edge row of the subdomain: halo, edge row, and its interior neighbour
+        const twodads::slab_layout_t geom_edge;
+        cuda_array_bc_nogp<T, allocator_host> edge_u;
+        cuda_array_bc_nogp<T, allocator_host> edge_v;
+        cuda_array_bc_nogp<T, allocator_host> edge_res;
+        // Left and right halo rows of the two inputs
+        std::vector<T> halo_u;
+        std::vector<T> halo_v;
+
+        T* get_halo_left(std::vector<T>& halo) {return(halo.data());};
+        T* get_halo_right(std::vector<T>& halo) {return(halo.data() + halo.size() / 2);};
+
+        // Copies the rows around an edge into edge_arr. At the domain boundaries the halo is
+        // replaced by the ghost points of the boundary conditions of src.
+        void fill_edge(const cuda_array_bc_nogp<T, allocator_host>& src, const size_t t_src, std::vector<T>& halo,
+                       cuda_array_bc_nogp<T, allocator_host>& edge_arr, const edge_t edge)
+        {
+            const size_t Nx{get_geom().get_nx()};
+            const size_t My{get_geom().get_my()};
+            const size_t stride{My + get_geom().get_pad_y()};
+            const T* u{src.get_tlev_ptr(t_src)};
+            T* e{edge_arr.get_tlev_ptr(0)};
+            if(edge == edge_t::left)
+            {
+                T* halo_left{get_halo_left(halo)};
+                if(decomp.get_rank() == 0)
+                {
+                    for(size_t m = 0; m < My; m++)
+                        halo_left[m] = src.get_address_ptr() -> interp_gp_left(u[m]);
+                }
+                std::copy(halo_left, halo_left + stride, e);
+                std::copy(u, u + 2 * stride, e + stride);
+            }
+            else
+            {
+                T* halo_right{get_halo_right(halo)};
+                if(decomp.get_rank() == decomp.get_num_ranks() - 1)
+                {
+                    for(size_t m = 0; m < My; m++)
+                        halo_right[m] = src.get_address_ptr() -> interp_gp_right(u[(Nx - 1) * stride + m]);
+                }
+                std::copy(u + (Nx - 2) * stride, u + Nx * stride, e);
+                std::copy(halo_right, halo_right + stride, e + 2 * stride);
+            }
+        }
+
+        // Copies the middle row of edge_res into the edge row of dst
+        void copy_edge(cuda_array_bc_nogp<T, allocator_host>& dst, const size_t t_dst, const edge_t edge)
+        {
+            const size_t stride{get_geom().get_my() + get_geom().get_pad_y()};
+            const size_t row{edge == edge_t::left ? 0 : get_geom().get_nx() - 1};
+            std::copy(edge_res.get_tlev_ptr(0) + stride, edge_res.get_tlev_ptr(0) + stride + get_geom().get_my(),
+                      dst.get_tlev_ptr(t_dst) + row * stride);
+        }
+};
+
+#endif //USE_MPI
+
+#endif //DECOMP_MPI_H
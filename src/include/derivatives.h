@@ -8,6 +8,8 @@
 #include "dft_type.h"
 #include "solvers.h"
 #include "utility.h"
+#include "profiler.h"
+#include "logger.h"
 
 #include <iostream>
 #include <cassert>
@@ -35,15 +37,17 @@ void kernel_threepoint_center(const T* u, address_t<T>** address_u,
     const int col{static_cast<int>(cuda :: thread_idx :: get_col())};
     const int row{static_cast<int>(cuda :: thread_idx :: get_row())};
     const size_t index{row * (geom.get_my() + geom.get_pad_y()) + col};
-    const T inv_dx{1.0 / geom.get_deltax()};
+    const T x_s{geom.get_dxds(static_cast<T>(row) + geom.get_cellshift())};
+    const T inv_dx{1.0 / (geom.get_deltax() * x_s)};
     const T inv_dx2{inv_dx * inv_dx};
+    const T x_ss{geom.get_d2xds2(static_cast<T>(row) + geom.get_cellshift()) / x_s};
 
     if(row > 0 && row < static_cast<int>(geom.get_nx() - 1) && col >= 0 && col < static_cast<int>(geom.get_my()))
     {
         result[index] = stencil_func((**address_u).get_elem(u, row - 1, col),
                                      (**address_u).get_elem(u, row    , col),
                                      (**address_u).get_elem(u, row + 1, col),
-                                     inv_dx, inv_dx2);
+                                     inv_dx, inv_dx2, x_ss);
     }
 }
 
@@ -57,15 +61,17 @@ void kernel_threepoint_single_row(const T* u, address_t<T>** address_u,
 {
     const int col{static_cast<int>(cuda :: thread_idx :: get_col())};
     const size_t index{row * (geom.get_my() + geom.get_pad_y()) + col};
-    const T inv_dx{1.0 / geom.get_deltax()};
+    const T x_s{geom.get_dxds(static_cast<T>(row) + geom.get_cellshift())};
+    const T inv_dx{1.0 / (geom.get_deltax() * x_s)};
     const T inv_dx2{inv_dx * inv_dx};
+    const T x_ss{geom.get_d2xds2(static_cast<T>(row) + geom.get_cellshift()) / x_s};
 
     if(col >= 0 && col < static_cast<int>(geom.get_my()))
     {
         result[index] = stencil_func((**address_u)(u, row - 1, col),
                                      (**address_u)(u, row    , col),
                                      (**address_u)(u, row + 1, col),
-                                     inv_dx, inv_dx2);
+                                     inv_dx, inv_dx2, x_ss);
     }
 }
 
@@ -83,7 +89,7 @@ void kernel_arakawa_center(const T* u, address_t<T>** address_u,
     const int row{static_cast<int>(cuda :: thread_idx :: get_row())};
     const size_t index{row * (geom.get_my() + geom.get_pad_y()) + col}; 
 
-    const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_deltay())};
+    const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_dxds(static_cast<T>(row) + geom.get_cellshift()) * geom.get_deltay())};
     // This checks whether we are at an inside point when calling this kernel with a thread layout
     // that covers the entire grid
 
@@ -170,7 +176,7 @@ void kernel_arakawa_single_row(const T* u, address_t<T>** address_u,
     const int col{static_cast<int>(cuda :: thread_idx :: get_col())};
     const size_t index{row * (geom.get_my() + geom.get_pad_y()) + col}; 
 
-    const T inv_dx_dy{1.0 / (12.0 * geom.get_deltax() * geom.get_deltay())};
+    const T inv_dx_dy{1.0 / (12.0 * geom.get_deltax() * geom.get_dxds(static_cast<T>(row) + geom.get_cellshift()) * geom.get_deltay())};
 
     if(col < static_cast<int>(geom.get_my()))
     {
@@ -245,7 +251,7 @@ void kernel_arakawa_single_col(const T* u, address_t<T>** address_u,
 {
     const int row{static_cast<int>(cuda :: thread_idx :: get_row())};
     const size_t index{row * (geom.get_my() + geom.get_pad_y()) + col}; 
-    const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_deltay())};
+    const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_dxds(static_cast<T>(row) + geom.get_cellshift()) * geom.get_deltay())};
 
     if(row > 0 && row < static_cast<int>(geom.get_nx() - 1))
     {
@@ -318,17 +324,20 @@ namespace host
     template <typename T, typename O>
     void apply_threepoint_center(T* u, address_t<T>* address_u, T* res, O stencil_func, const twodads::slab_layout_t& geom)
     {
-        const T inv_dx{1.0 / geom.get_deltax()};
-        const T inv_dx2{inv_dx * inv_dx};
-
         for(size_t n = 1; n < geom.get_nx() - 1; n++)
         {
+            // Metric coefficients of the grid mapping, see slab_layout_t::get_d2xds2
+            const T x_s{geom.get_dxds(static_cast<T>(n) + geom.get_cellshift())};
+            const T inv_dx{1.0 / (geom.get_deltax() * x_s)};
+            const T inv_dx2{inv_dx * inv_dx};
+            const T x_ss{geom.get_d2xds2(static_cast<T>(n) + geom.get_cellshift()) / x_s};
+
             for(size_t m = 0; m < geom.get_my(); m++)
             {
                 res[n * (geom.get_my() + geom.get_pad_y()) + m] = stencil_func((*address_u).get_elem(u, n - 1, m),
                                                                                (*address_u).get_elem(u, n    , m),
                                                                                (*address_u).get_elem(u, n + 1, m),
-                                                                               inv_dx, inv_dx2);
+                                                                               inv_dx, inv_dx2, x_ss);
             }
         }
     }
@@ -336,19 +345,22 @@ namespace host
 
     template <typename T, typename O> 
     void apply_threepoint(T* u, address_t<T>* address_u, T* res, O stencil_func, const twodads::slab_layout_t& geom,
-                          std::vector<size_t>& row_vals, std::vector<size_t>& col_vals)
+                          const size_t row_start, const size_t row_end,
+                          const size_t col_start, const size_t col_end)
     {
-        const T inv_dx{1.0 / geom.get_deltax()};
-        const T inv_dx2{inv_dx * inv_dx};
-
-        for(auto row : row_vals)
+        for(size_t row = row_start; row < row_end; row++)
         {
-            for(auto col : col_vals)
+            const T x_s{geom.get_dxds(static_cast<T>(row) + geom.get_cellshift())};
+            const T inv_dx{1.0 / (geom.get_deltax() * x_s)};
+            const T inv_dx2{inv_dx * inv_dx};
+            const T x_ss{geom.get_d2xds2(static_cast<T>(row) + geom.get_cellshift()) / x_s};
+
+            for(size_t col = col_start; col < col_end; col++)
             {
                 res[row * (geom.get_my() + geom.get_pad_y()) + col] = stencil_func((*address_u)(u, row - 1, col),
                                                                                    (*address_u)(u, row    , col),
                                                                                    (*address_u)(u, row + 1, col),
-                                                                                   inv_dx, inv_dx2);
+                                                                                   inv_dx, inv_dx2, x_ss);
             }
         }
     }
@@ -373,10 +385,11 @@ namespace host
                         const T* v, address_t<T>* address_v, 
                         T* result, const twodads::slab_layout_t& geom)
     {
-        const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_deltay())};
         size_t index{0};
         for(size_t row = 1; row < geom.get_nx() - 1; row++)
         {
+            // The x-derivatives are scaled by the metric coefficient of the grid mapping
+            const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_dxds(static_cast<T>(row) + geom.get_cellshift()) * geom.get_deltay())};
            for(size_t col = 1; col < geom.get_my() - 1; col++)
             {
             index = (row * (geom.get_my() + geom.get_pad_y()) + col);
@@ -448,14 +461,14 @@ namespace host
     void arakawa_single(const T* u, address_t<T>* address_u, 
                         const T* v, address_t<T>* address_v, 
                         T* result, const twodads::slab_layout_t& geom,
-                        std::vector<size_t> row_vals,
-                        std::vector<size_t> col_vals)
+                        const size_t row_start, const size_t row_end,
+                        const size_t col_start, const size_t col_end)
     {
-        const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_deltay())};
         size_t index{0};
-        for(size_t row : row_vals)
+        for(size_t row = row_start; row < row_end; row++)
         {
-            for(size_t col : col_vals)
+            const T inv_dx_dy{-1.0 / (12.0 * geom.get_deltax() * geom.get_dxds(static_cast<T>(row) + geom.get_cellshift()) * geom.get_deltay())};
+            for(size_t col = col_start; col < col_end; col++)
             {
                 index = (row * (geom.get_my() + geom.get_pad_y()) + col);
                 result[index] = 
@@ -544,14 +557,14 @@ namespace detail
                 // Call kernel that accesses elements with get_elem; no wrapping/interpolation
                 device :: kernel_threepoint_center<<<in.get_grid(), in.get_block()>>>(in.get_tlev_ptr(t_src), in.get_address_2ptr(),
                         out.get_tlev_ptr(t_dst), 
-                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
+                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
                         {return(0.5 * (u_right - u_left) * inv_dx);},
                         out.get_geom());
                 gpuErrchk(cudaPeekAtLastError());
                 // Call kernel that accesses elements with operator(); interpolates ghost point values
                 device :: kernel_threepoint_single_row<<<grid_single_row, block_single_row>>>(in.get_tlev_ptr(t_src), in.get_address_2ptr(),
                         out.get_tlev_ptr(t_dst), 
-                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
+                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
                         {return(0.5 * (u_right - u_left) * inv_dx);},
                         out.get_geom(), 0);
                 gpuErrchk(cudaPeekAtLastError());
@@ -559,7 +572,7 @@ namespace detail
                 // Call kernel that accesses elements with operator(); interpolates ghost point values
                 device :: kernel_threepoint_single_row<<<grid_single_row, block_single_row>>>(in.get_tlev_ptr(t_src), in.get_address_2ptr(),
                         out.get_tlev_ptr(t_dst), 
-                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
+                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
                         {return(0.5 * (u_right - u_left) * inv_dx);},
                         out.get_geom(), out.get_geom().get_nx() - 1);
                 gpuErrchk(cudaPeekAtLastError());
@@ -569,24 +582,24 @@ namespace detail
                 // Call kernel that accesses elements with get_elem; no wrapping around
                 device :: kernel_threepoint_center<<<in.get_grid(), in.get_block()>>>(in.get_tlev_ptr(t_src), in.get_address_2ptr(),
                         out.get_tlev_ptr(t_dst), 
-                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
-                        {return((u_left + u_right - 2.0 * u_middle) * inv_dx2);},
+                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                        {return((u_left + u_right - 2.0 * u_middle - 0.5 * x_ss * (u_right - u_left)) * inv_dx2);},
                         out.get_geom());
                 gpuErrchk(cudaPeekAtLastError());
 
                 // Call kernel that accesses elements with operator(); interpolates ghost point values
                 device :: kernel_threepoint_single_row<<<grid_single_row, block_single_row>>>(in.get_tlev_ptr(t_src), in.get_address_2ptr(),
                         out.get_tlev_ptr(t_dst), 
-                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
-                        {return((u_left + u_right - 2.0 * u_middle) * inv_dx2);}, 
+                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                        {return((u_left + u_right - 2.0 * u_middle - 0.5 * x_ss * (u_right - u_left)) * inv_dx2);}, 
                         out.get_geom(), 0);
                 gpuErrchk(cudaPeekAtLastError());
 
                 // Call kernel that accesses elements with operator(); interpolates ghost point values
                 device :: kernel_threepoint_single_row<<<grid_single_row, block_single_row>>>(in.get_tlev_ptr(t_src), in.get_address_2ptr(),
                         out.get_tlev_ptr(t_dst), 
-                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
-                        {return((u_left + u_right - 2.0 * u_middle) * inv_dx2);},
+                        [] __device__ (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                        {return((u_left + u_right - 2.0 * u_middle - 0.5 * x_ss * (u_right - u_left)) * inv_dx2);},
                         out.get_geom(), out.get_geom().get_nx() - 1);
                 gpuErrchk(cudaPeekAtLastError());
             }
@@ -635,7 +648,7 @@ namespace detail
         template <typename T>
         void impl_arakawa(const cuda_array_bc_nogp<T, allocator_device>& u,
                         const cuda_array_bc_nogp<T, allocator_device>& v,
-                        cuda_array_bc_nogp<T, allocator_device> res,
+                        cuda_array_bc_nogp<T, allocator_device>& res,
                         const size_t t_srcu, const size_t t_srcv, 
                         const size_t t_dst, allocator_device<T>)
         {
@@ -700,56 +713,50 @@ namespace detail
                     cuda_array_bc_nogp<T, allocator_host>& out,
                     const size_t t_src, const size_t t_dst, const size_t order, allocator_host<T>)
         {
-            std::vector<size_t> col_vals(in.get_geom().get_my());
-            std::vector<size_t> row_vals(1);
-
-            row_vals[0] = 0;
-            for(size_t m = 0; m < in.get_geom().get_my(); m++)
-                col_vals[m] = m;
+            const size_t Nx{in.get_geom().get_nx()};
+            const size_t My{in.get_geom().get_my()};
 
             if(order == 1)
             // Calculate the first derivative
             {
                 // Apply threepoint stencil in interior domain, no interpolation here
                 host :: apply_threepoint_center(in.get_tlev_ptr(t_src), in.get_address_ptr(), out.get_tlev_ptr(t_dst), 
-                                                [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
+                                                [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
                                                 {return(0.5 * (u_right - u_left) * inv_dx);}, 
                                                 out.get_geom());
 
                 // Call expensive interpolation routine only for 2 rows
                 // 1) row n=0, m = 0...my-1
                 host :: apply_threepoint(in.get_tlev_ptr(t_src), in.get_address_ptr(), out.get_tlev_ptr(t_dst), 
-                                         [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
+                                         [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
                                          {return(0.5 * (u_right - u_left) * inv_dx);},
-                                         out.get_geom(), row_vals, col_vals);
+                                         out.get_geom(), 0, 1, 0, My);
 
                 // 2) row n=Nx - 1, m = 0..My-1
-                row_vals[0] = in.get_geom().get_nx() - 1;
                 host :: apply_threepoint(in.get_tlev_ptr(t_src), in.get_address_ptr(), out.get_tlev_ptr(t_dst), 
-                                         [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
+                                         [] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
                                          {return(0.5 * (u_right - u_left) * inv_dx);},
-                                         out.get_geom(), row_vals, col_vals);
+                                         out.get_geom(), Nx - 1, Nx, 0, My);
             }
             else if (order == 2)
             // Calculate the second derivative
             {
                 // Apply threepoint stencil in interior domain, no interpolation here
                 host :: apply_threepoint_center(in.get_tlev_ptr(t_src), in.get_address_ptr(), out.get_tlev_ptr(t_dst), 
-                                                [=] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
-                                                {return((u_left + u_right - 2.0 * u_middle) * inv_dx2);},
+                                                [=] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                                                {return((u_left + u_right - 2.0 * u_middle - 0.5 * x_ss * (u_right - u_left)) * inv_dx2);},
                                                 out.get_geom());
 
                 // Call expensive interpolation routine only for 2 columns
                 host :: apply_threepoint(in.get_tlev_ptr(t_src), in.get_address_ptr(), out.get_tlev_ptr(t_dst),
-                                        [=] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
-                                        {return((u_left + u_right - 2.0 * u_middle) * inv_dx2);},
-                                        out.get_geom(), row_vals, col_vals);
+                                        [=] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                                        {return((u_left + u_right - 2.0 * u_middle - 0.5 * x_ss * (u_right - u_left)) * inv_dx2);},
+                                        out.get_geom(), 0, 1, 0, My);
 
-                row_vals[0] = in.get_geom().get_nx() - 1;
                 host :: apply_threepoint(in.get_tlev_ptr(t_src), in.get_address_ptr(), out.get_tlev_ptr(t_dst),
-                                        [=] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2) -> T
-                                        {return((u_left + u_right - 2.0 * u_middle) * inv_dx2);},
-                                        out.get_geom(), row_vals, col_vals);
+                                        [=] (T u_left, T u_middle, T u_right, T inv_dx, T inv_dx2, T x_ss) -> T
+                                        {return((u_left + u_right - 2.0 * u_middle - 0.5 * x_ss * (u_right - u_left)) * inv_dx2);},
+                                        out.get_geom(), Nx - 1, Nx, 0, My);
                 }
             else
             {
@@ -802,60 +809,51 @@ namespace detail
         template <typename T>
         void impl_arakawa(const cuda_array_bc_nogp<T, allocator_host>& u,
                         const cuda_array_bc_nogp<T, allocator_host>& v,
-                        cuda_array_bc_nogp<T, allocator_host> res,
+                        cuda_array_bc_nogp<T, allocator_host>& res,
                         const size_t t_srcu, const size_t t_srcv, 
                         const size_t t_dst, allocator_host<T>)
         {
-            std::vector<size_t> col_vals(0);
-            std::vector<size_t> row_vals(0);
+            const size_t Nx{u.get_geom().get_nx()};
+            const size_t My{u.get_geom().get_my()};
 
             // Uses address with direct element access, no interpolation
-            host :: arakawa_center(u.get_tlev_ptr(t_srcu), u.get_address_ptr(),
-                                v.get_tlev_ptr(t_srcv), v.get_address_ptr(),
-                                res.get_tlev_ptr(t_dst),
-                                u.get_geom());
+            {
+                PROFILE_SCOPE("host::arakawa_center", 3 * u.get_geom().get_nelem_per_t() * sizeof(T));
+                host :: arakawa_center(u.get_tlev_ptr(t_srcu), u.get_address_ptr(),
+                                       v.get_tlev_ptr(t_srcv), v.get_address_ptr(),
+                                       res.get_tlev_ptr(t_dst),
+                                       u.get_geom());
+            }
+            // The boundary rows and columns access the ghost points through address_t
+            PROFILE_SCOPE("host::arakawa_single", 6 * (u.get_geom().get_nx() + u.get_geom().get_my()) * sizeof(T));
 
             // Arakawa kernel for col 0, n = 0..Nx-1. Call arakawa method that calls interpolator
             // for element access
-            col_vals.resize(1);
-            col_vals[0] = 0;
-            row_vals.resize(u.get_geom().get_nx());
-            for(size_t n = 0; n < u.get_geom().get_nx(); n++)
-                row_vals[n] = n;
-
             host :: arakawa_single(u.get_tlev_ptr(t_srcu), u.get_address_ptr(), 
                                 v.get_tlev_ptr(t_srcv), v.get_address_ptr(),
                                 res.get_tlev_ptr(t_dst),
                                 u.get_geom(),
-                                row_vals, col_vals);
+                                0, Nx, 0, 1);
 
             //Arakawa kernel for col = My-1, n = 0..Nx-1
-            col_vals[0] = u.get_geom().get_my() - 1;
             host :: arakawa_single(u.get_tlev_ptr(t_srcu), u.get_address_ptr(), 
                                 v.get_tlev_ptr(t_srcv), v.get_address_ptr(),
                                 res.get_tlev_ptr(t_dst),
                                 u.get_geom(),
-                                row_vals, col_vals);
+                                0, Nx, My - 1, My);
 
             // Arakawa kernel for col 0..My-1, row n = 0
-            col_vals.resize(u.get_geom().get_my());
-            row_vals.resize(1);
-            row_vals[0] = 0;
-            for(size_t m = 0; m < u.get_geom().get_my(); m++)
-                col_vals[m] = m;
-
             host :: arakawa_single(u.get_tlev_ptr(t_srcu), u.get_address_ptr(), 
                                 v.get_tlev_ptr(t_srcv), v.get_address_ptr(),
                                 res.get_tlev_ptr(t_dst),
                                 u.get_geom(),
-                                row_vals, col_vals);
+                                0, 1, 0, My);
             // Arakawa kernel for col 0..My-1, row n = Nx - 1
-            row_vals[0] = u.get_geom().get_nx() - 1;
             host :: arakawa_single(u.get_tlev_ptr(t_srcu), u.get_address_ptr(), 
                                 v.get_tlev_ptr(t_srcv), v.get_address_ptr(),
                                 res.get_tlev_ptr(t_dst),
                                 u.get_geom(),
-                                row_vals, col_vals);
+                                Nx - 1, Nx, 0, My);
         }
 
         template <typename T>
@@ -1185,6 +1183,16 @@ class deriv_base_t
                           cuda_array_bc_nogp<T, allocator>&,
                           const size_t, const size_t, const size_t) = 0;
 
+    /**
+     .. cpp:function:: virtual bool deriv_base_t :: prepare_shared()
+
+     Prepares the object to be used by several simulations that run at the same time, see shared_objects_t.
+     Returns true if the members only read data of the object afterwards. Returns false, the default,
+     if they write to scratch storage of the object, which can then not be shared.
+
+    */
+    virtual bool prepare_shared() {return(false);}
+
     /**
      .. cpp:namespace-pop::
 
@@ -1219,21 +1227,30 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
 
         #ifdef HOST
         using dft_library_t = fftw_object_t<T>;
-        using elliptic_t = solvers :: elliptic_mkl_t;
         #endif //HOST
 
         #ifdef DEVICE
         using dft_library_t = cufft_object_t<T>;
-        using elliptic_t = solvers :: elliptic_cublas_t;
         #endif //DEVICE
 
-        deriv_fd_t(const twodads::slab_layout_t&);    
+        /**
+         .. cpp:function:: deriv_fd_t(const twodads::slab_layout_t& geom, const twodads::bvals_t<T>& bvals, const twodads::solver_t solver)
+
+         :param const twodads::slab_layout_t& geom: Layout of the real fields
+         :param const twodads::bvals_t<T>& bvals: Boundary conditions of the Laplace inversion. Defaults to Dirichlet.
+         :param const twodads::solver_t solver: Solver used for the Laplace inversion. Defaults to the tridiagonal solver.
+
+        */
+        deriv_fd_t(const twodads::slab_layout_t&, 
+                   const twodads::bvals_t<T>& = twodads::bvals_t<T>(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, T(0.0), T(0.0)),
+                   const twodads::solver_t = twodads::solver_t::solver_tridiag);
         ~deriv_fd_t() {delete my_solver;}
 
         virtual void dx(cuda_array_bc_nogp<T, allocator>& src,
                         cuda_array_bc_nogp<T, allocator>& dst,
                         const size_t t_src, const size_t t_dst, const size_t order)
         {
+            PROFILE_SCOPE("deriv_fd_t::dx", 2 * src.get_geom().get_nelem_per_t() * sizeof(T));
             assert(src.is_transformed(t_src) == false && "deriv_fd_t :: void dx: src must not be transformed");
             if(order < 3)
                 detail :: fd :: impl_dx(src, dst, t_src, t_dst, order, allocator<T>{});
@@ -1250,6 +1267,7 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
                         cuda_array_bc_nogp<T, allocator>& dst,
                         const size_t t_src, const size_t t_dst, const size_t order)
         {
+            PROFILE_SCOPE("deriv_fd_t::dy", 2 * src.get_geom().get_nelem_per_t() * sizeof(T));
             assert(src.is_transformed(t_src) == true && "deriv_fd_t :: void dy: src must be transformed");
 
             // Multiply with ky coefficients
@@ -1268,6 +1286,8 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
                                     cuda_array_bc_nogp<T, allocator>& dst,
                                     const size_t t_src, const size_t t_dst)
         {
+            // Source, solution, and the three diagonals
+            PROFILE_SCOPE("deriv_fd_t::invert_laplace", 5 * src.get_geom().get_nelem_per_t() * sizeof(T));
             assert(src.get_geom() == dst.get_geom() && "deriv_fd_t :: invert_laplace: src and dst need to have the same geometry");
             assert(src.get_geom() == get_geom());
             assert(src.get_bvals() == dst.get_bvals() && "deriv_fd_t :: invert_laplace: src and dst need to have the same boundary values");
@@ -1279,52 +1299,58 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
             // Note that we take the DFT of the boundary value. For a real boundary
             // value, this is just the value multiplied by the number of Fourier modes.
             // See http://fftw.org/fftw3_doc/The-1d-Real_002ddata-DFT.html#The-1d-Real_002ddata-DFT
-            T bval_left_hat{src.get_bvals().get_bv_left() * static_cast<T>(src.get_my())};
-            T bval_right_hat{src.get_bvals().get_bv_right() * static_cast<T>(src.get_my())};
+            //
+            // The ghost points are eliminated as in init_diagonals. Their weight in the stencil
+            // of the outermost rows multiplies the boundary value.
+            const twodads::slab_layout_t geom{src.get_geom()};
+            const T bval_left_hat{src.get_bvals().get_bv_left() * static_cast<T>(src.get_my())};
+            const T bval_right_hat{src.get_bvals().get_bv_right() * static_cast<T>(src.get_my())};
+            // Grid spacing at the domain boundaries
+            const T deltax_bnd{geom.get_deltax() * geom.get_dxds(0.0)};
+            const T inv_dx2{1.0 / (geom.get_deltax() * geom.get_deltax())};
             T add_to_boundary_left{0.0};
             T add_to_boundary_right{0.0};
             switch(src.get_bvals().get_bc_left())
             {
                 case twodads::bc_t::bc_dirichlet:
-                    add_to_boundary_left = -2.0 * bval_left_hat;
+                    add_to_boundary_left = -2.0 * bval_left_hat * geom.get_d2dx2_lower(0) * inv_dx2;
                     break;
                 case twodads::bc_t::bc_neumann:
-                    add_to_boundary_left = -1.0 * src.get_geom().get_deltax() * bval_left_hat;
+                    add_to_boundary_left = deltax_bnd * bval_left_hat * geom.get_d2dx2_lower(0) * inv_dx2;
                     break;
                 case twodads::bc_t::bc_periodic:
-                    std::cerr << "Periodic boundary conditions not implemented by this class. We shouldn't be here!." << std::endl;
+                    LOG_MESSAGE(logger::level_t::error, "Periodic boundary conditions not implemented by this class. We shouldn't be here!");
                     break;
                 case twodads::bc_t::bc_null:
-                    std::cerr << "Null boundary conditions not implemented by this class. We shouldn't be here!'" << std::endl;
+                    // Edge of a subdomain, no boundary term
                     break;
             }
 
             switch(src.get_bvals().get_bc_right())
             {
                 case twodads::bc_t::bc_dirichlet:
-                    add_to_boundary_right = -2.0 * bval_right_hat;
+                    add_to_boundary_right = -2.0 * bval_right_hat * geom.get_d2dx2_upper(geom.get_nx() - 1) * inv_dx2;
                     break;
                 case twodads::bc_t::bc_neumann:
-                    add_to_boundary_right = src.get_geom().get_deltax() * bval_right_hat;
+                    add_to_boundary_right = -1.0 * deltax_bnd * bval_right_hat * geom.get_d2dx2_upper(geom.get_nx() - 1) * inv_dx2;
                     break;
                 case twodads::bc_t::bc_periodic:
-                    std::cerr << "Periodic boundary conditions not implemented by this class. We shouldn't be here!." << std::endl;
+                    LOG_MESSAGE(logger::level_t::error, "Periodic boundary conditions not implemented by this class. We shouldn't be here!");
                     break;
                 case twodads::bc_t::bc_null:
-                    std::cerr << "Null boundary conditions not implemented by this class. We shouldn't be here!'" << std::endl;
+                    // Edge of a subdomain, no boundary term
                     break;
             }    
 
             //Add boundary terms to b before solving Ax=b
             src.apply([=] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
             {
-            if(n == 0  && m == 0)
                 return(input + add_to_boundary_left);
-            else if(n == geom.get_nx() - 1 && m == 0)
+            }, twodads::region_t::elem(0, 0), t_src);
+            src.apply([=] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+            {
                 return(input + add_to_boundary_right);
-            else
-                return(input);
-            }, t_src);
+            }, twodads::region_t::elem(src.get_geom().get_nx() - 1, 0), t_src);
                 
             detail :: fd :: impl_invert_laplace(src, dst, t_src, t_dst,  
                                                 get_diag(), get_diag_u(), get_diag_l(),
@@ -1334,13 +1360,12 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
             // Remove boundary terms after solving the system
             src.apply([=] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
             {
-            if(n == 0  && m == 0)
                 return(input - add_to_boundary_left);
-            else if(n == geom.get_nx() - 1 && m == 0)
+            }, twodads::region_t::elem(0, 0), t_src);
+            src.apply([=] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+            {
                 return(input - add_to_boundary_right);
-            else
-                return(input);
-            }, t_src);
+            }, twodads::region_t::elem(src.get_geom().get_nx() - 1, 0), t_src);
         }
 
         virtual void pbracket(const cuda_array_bc_nogp<T, allocator>& u,
@@ -1348,6 +1373,7 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
                               cuda_array_bc_nogp<T, allocator>& dst,
                               const size_t t_srcu, const size_t t_srcv, const size_t t_dst)
         {
+            PROFILE_SCOPE("deriv_fd_t::pbracket", 3 * u.get_geom().get_nelem_per_t() * sizeof(T));
             assert(u.is_transformed(t_srcu) == false);
             assert(v.is_transformed(t_srcv) == false);
             // The Arakawa scheme computes -{f,g} = {g,f}.
@@ -1367,6 +1393,17 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
         }
 
 
+        // dx, dy, and pbracket only read the coefficients. The Laplace inversion can be shared
+        // if the solver does not write to a workspace. Compute its factorization now.
+        virtual bool prepare_shared()
+        {
+#ifndef __CUDACC__
+            return(get_ell_solver() -> prepare(get_diag_l().get_tlev_ptr(0) + 1, get_diag().get_tlev_ptr(0), get_diag_u().get_tlev_ptr(0)));
+#else
+            return(false);
+#endif //__CUDACC__
+        }
+
         void init_diagonals();
 
         cmplx_arr& get_coeffs_dy1() {return(coeffs_dy1);};
@@ -1380,14 +1417,17 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
         twodads::slab_layout_t get_geom_my21() const {return(geom_my21);};
         // Layouf of the diagonals, i.e. My21 * Nx
         twodads::slab_layout_t get_geom_transpose() const {return(geom_transpose);};
+        // Boundary conditions of the Laplace inversion
+        twodads::bvals_t<T> get_bvals() const {return(bvals);};
 
-        inline elliptic_t* get_ell_solver() {return(my_solver);};
+        inline solvers :: elliptic_base_t* get_ell_solver() {return(my_solver);};
 
     private:
         const twodads::slab_layout_t geom;          // Layout for Nx * My arrays
         const twodads::slab_layout_t geom_my21;     // Layout for spectrally transformed NX * My21 arrays
         const twodads::slab_layout_t geom_transpose;     // Transposed complex layout (My21 * Nx) for the tridiagonal solver
-        elliptic_t* my_solver;
+        const twodads::bvals_t<T> bvals;            // Boundary conditions used to set up the diagonals
+        solvers :: elliptic_base_t* my_solver;
 
         // Coefficient storage for spectral derivation
         cmplx_arr coeffs_dy1;
@@ -1405,7 +1445,7 @@ class deriv_fd_t : public deriv_base_t<T, allocator>
 
 
 template <typename T, template <typename> class allocator>
-deriv_fd_t<T, allocator> :: deriv_fd_t(const twodads::slab_layout_t& _geom) :
+deriv_fd_t<T, allocator> :: deriv_fd_t(const twodads::slab_layout_t& _geom, const twodads::bvals_t<T>& _bvals, const twodads::solver_t _solver) :
     geom{_geom},
     geom_my21{get_geom().get_xleft(), 
               get_geom().get_deltax(), 
@@ -1421,7 +1461,8 @@ deriv_fd_t<T, allocator> :: deriv_fd_t(const twodads::slab_layout_t& _geom) :
                    (get_geom().get_my() + get_geom().get_pad_y()) / 2, 0,
                    get_geom().get_nx(), 0,
                    get_geom().get_grid()},
-    my_solver{new elliptic_t(get_geom())},
+    bvals{_bvals},
+    my_solver{solvers :: create_elliptic(get_geom(), _solver, get_bvals().get_bc_left(), get_bvals().get_bc_right())},
     // Very fancy way of initializing a complex Nx * My / 2 + 1 array
     coeffs_dy1{get_geom_my21(), twodads::bvals_t<CuCmplx<T>>(), 1},
     coeffs_dy2{get_geom_my21(), twodads::bvals_t<CuCmplx<T>>(), 1},
@@ -1433,6 +1474,12 @@ deriv_fd_t<T, allocator> :: deriv_fd_t(const twodads::slab_layout_t& _geom) :
     // Lambdas in the constructor.
     utility :: bispectral :: init_deriv_coeffs(get_coeffs_dy1(), get_coeffs_dy2(), get_geom_my21(), allocator<T>{});
     init_diagonals();
+
+    coeffs_dy1.set_tag("deriv_fd_t", "coeffs_dy1");
+    coeffs_dy2.set_tag("deriv_fd_t", "coeffs_dy2");
+    diag.set_tag("deriv_fd_t", "diag");
+    diag_l.set_tag("deriv_fd_t", "diag_l");
+    diag_u.set_tag("deriv_fd_t", "diag_u");
 }
 
 // Remember that the diagonals are transposed:
@@ -1449,7 +1496,28 @@ deriv_fd_t<T, allocator> :: deriv_fd_t(const twodads::slab_layout_t& _geom) :
 template <typename T, template <typename> class allocator>
 void deriv_fd_t<T, allocator> :: init_diagonals() 
 {
-    diag.apply([] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
+    // The first and last element on the main diagonal depend on the boundary condition.
+    // The ghost point is eliminated with u_{-1} = 2 u_b - u_0 for bc_dirichlet and
+    // u_{-1} = u_0 - dx u_b' for bc_neumann. On a uniform grid this gives
+    // -3 / dx^2 for bc_dirichlet
+    // -1 / dx^2 for bc_neumann
+    // bc_null marks the edge of a subdomain. The neighbouring point is an unknown of the
+    // next subdomain, which the distributed solver couples, see elliptic_spike_mpi_t.
+    auto ghost_weight = [] (const twodads::bc_t bc) -> T
+    {
+        if(bc == twodads::bc_t::bc_neumann)
+            return(T(1.0));
+        if(bc == twodads::bc_t::bc_null)
+            return(T(0.0));
+        return(T(-1.0));
+    };
+    const T ghost_left{ghost_weight(get_bvals().get_bc_left())};
+    const T ghost_right{ghost_weight(get_bvals().get_bc_right())};
+    // The weights of the finite difference stencil vary along x on stretched grids.
+    // They are computed from the geometry in configuration space.
+    const twodads::slab_layout_t geom_x{get_geom()};
+
+    diag.apply([=] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
     {
         // ky runs with index n (the kernel addressing function, see cuda::thread_idx
         // We are transposed, Lx = dx * (2 * nx - 1) as we have cut nx roughly in half
@@ -1458,42 +1526,40 @@ void deriv_fd_t<T, allocator> :: init_diagonals()
         const CuCmplx<T> inv_dx2{1.0 / (geom.get_deltay() * geom.get_deltay())};
         if(m > 0 && m < geom.get_my() - 1)
         {
-            // Use shitty notation ... * (-2.0) because operator* is not a friend of CuCmplx<T>
-            return (inv_dx2 * (-2.0) - ky2);
+            return (inv_dx2 * geom_x.get_d2dx2_center(m) - ky2);
         }
         else if (m == 0)
         {
-            return(inv_dx2 * (-3.0) - ky2);
+            return(inv_dx2 * (geom_x.get_d2dx2_center(m) + geom_x.get_d2dx2_lower(m) * ghost_left) - ky2);
         }
         else if (m == geom.get_my() - 1)
         {
-            return(inv_dx2 * (-3.0) - ky2);
+            return(inv_dx2 * (geom_x.get_d2dx2_center(m) + geom_x.get_d2dx2_upper(m) * ghost_right) - ky2);
         }
         return(-1.0);
     }, 0);
 
-    diag_l.apply([] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
+    diag_l.apply([=] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
     {
         // CUBLAS requires the first element in the lower diagonal to be zero.
         // Remember to shift the pointer in the MKL implementation when passing to the
         // MKL caller routine in solver
-        const CuCmplx<T> inv_dx2 = 1.0 / (geom.get_deltay() * geom.get_deltay());
+        const CuCmplx<T> inv_dx2{1.0 / (geom.get_deltay() * geom.get_deltay())};
         if(m > 0)
-            //return(inv_dx2);
-            return(inv_dx2);
+            return(inv_dx2 * geom_x.get_d2dx2_lower(m));
         else if(m == 0)
             return(0.0);
         return(-1.0);
     }, 0);
 
-    diag_u.apply([] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
+    diag_u.apply([=] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
     {
         // CUBLAS requires the last element in the upper diagonal to be zero.
         // Remember to shift the pointer in the MKL implementation when passing to the
         // MKL caller routine in solver
         const CuCmplx<T> inv_dx2{1.0 / (geom.get_deltay() * geom.get_deltay())};
         if(m < geom.get_my() - 1)
-            return(inv_dx2);
+            return(inv_dx2 * geom_x.get_d2dx2_upper(m));
         else if(m == geom.get_my() - 1)
             return(0.0);  
         return(-1.0);  
@@ -1549,12 +1615,16 @@ class deriv_spectral_t : public deriv_base_t<T, allocator>
                 tmp_arr(get_geom(), twodads::bvals_t<T>(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0), 1)                   
         {
             utility :: bispectral :: init_deriv_coeffs(get_coeffs_d1(), get_coeffs_d2(), get_geom_my21(), allocator<T>{});
+            coeffs_d1.set_tag("deriv_spectral_t", "coeffs_d1");
+            coeffs_d2.set_tag("deriv_spectral_t", "coeffs_d2");
+            tmp_arr.set_tag("deriv_spectral_t", "tmp_arr");
         }
 
         virtual void dx(cuda_array_bc_nogp<T, allocator>& src,
                         cuda_array_bc_nogp<T, allocator>& dst,
                         const size_t t_src, const size_t t_dst, const size_t order)
         {
+            PROFILE_SCOPE("deriv_spectral_t::dx", 2 * src.get_geom().get_nelem_per_t() * sizeof(T));
             assert(src.is_transformed(t_src));
             detail :: bispectral :: impl_deriv(src, dst, t_src, t_dst, direction::x, order, get_coeffs_d1(), get_coeffs_d2(), get_geom_my21(), allocator<T>{});
             dst.set_transformed(t_dst, true);
@@ -1564,6 +1634,7 @@ class deriv_spectral_t : public deriv_base_t<T, allocator>
                         cuda_array_bc_nogp<T, allocator>& dst,
                         const size_t t_src, const size_t t_dst, const size_t order)
         {
+            PROFILE_SCOPE("deriv_spectral_t::dy", 2 * src.get_geom().get_nelem_per_t() * sizeof(T));
             assert(src.is_transformed(t_src));
             detail :: bispectral :: impl_deriv(src, dst, t_src, t_dst, direction::y, order, get_coeffs_d1(), get_coeffs_d2(), get_geom_my21(), allocator<T>{});
             dst.set_transformed(t_dst, true);
@@ -1574,6 +1645,7 @@ class deriv_spectral_t : public deriv_base_t<T, allocator>
                                     cuda_array_bc_nogp<T, allocator>& dst,
                                     const size_t t_src, const size_t t_dst)
         {
+            PROFILE_SCOPE("deriv_spectral_t::invert_laplace", 2 * src.get_geom().get_nelem_per_t() * sizeof(T));
             assert(src.get_geom() == dst.get_geom());
             assert(src.get_geom() == get_geom());
             assert(src.get_bvals() == dst.get_bvals());
@@ -1601,6 +1673,7 @@ class deriv_spectral_t : public deriv_base_t<T, allocator>
                       cuda_array_bc_nogp<T, allocator>& dst,
                       const size_t t_src_f, const size_t t_src_g, const size_t t_dst)
         {
+            PROFILE_SCOPE("deriv_spectral_t::pbracket", 5 * dst.get_geom().get_nelem_per_t() * sizeof(T));
             assert(f_x.get_geom() == f_y.get_geom());
             assert(f_x.get_geom() == g_x.get_geom());
             assert(f_x.get_geom() == g_y.get_geom());
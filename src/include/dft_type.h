@@ -13,6 +13,7 @@
 // https://github.com/FFTW/fftw3/issues/18
 #include "error.h"
 #include "cucmplx.h"
+#include "profiler.h"
 
 #ifndef __CUDACC__
 #include "fftw3.h"
@@ -364,10 +365,12 @@ class cufft_object_t : public dft_object_t<T>
 
         virtual void dft_r2c(T* arr_in, CuCmplx<T>* arr_out)
         {
+            PROFILE_SCOPE("cufft_object_t::dft_r2c", 2 * get_geom().get_nelem_per_t() * sizeof(T));
             cufft :: call_dft_r2c(get_plan_r2c(), arr_in, arr_out);
         }
         virtual void dft_c2r(CuCmplx<T>* arr_in, T* arr_out)
         {
+            PROFILE_SCOPE("cufft_object_t::dft_c2r", 2 * get_geom().get_nelem_per_t() * sizeof(T));
             cufft :: call_dft_c2r(get_plan_c2r(), arr_in, arr_out);
         }
 
@@ -406,11 +409,13 @@ class fftw_object_t : public dft_object_t<T>
 
         virtual void dft_r2c(T* arr_in, CuCmplx<T>* arr_out)
         {
+            PROFILE_SCOPE("fftw_object_t::dft_r2c", 2 * get_geom().get_nelem_per_t() * sizeof(T));
             fftw :: call_dft_r2c(get_plan_r2c(), arr_in, arr_out);
         }
 
         virtual void dft_c2r(CuCmplx<T>* arr_in, T* arr_out)
         {
+            PROFILE_SCOPE("fftw_object_t::dft_c2r", 2 * get_geom().get_nelem_per_t() * sizeof(T));
             fftw :: call_dft_c2r(get_plan_c2r(), arr_in, arr_out);
         }
 
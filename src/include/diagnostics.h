@@ -6,6 +6,11 @@
 #ifndef DIAGNOSTICS_H
 #define DIAGNOSTICS_H
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "2dads_types.h"
 #include "slab_config.h"
 #include "cuda_array_bc_nogp.h"
@@ -191,13 +196,8 @@ class diagnostic_t {
         // All diagnostic functions are required to have the same signature
         using dfun_ptr_t = void (diagnostic_t::*)(const twodads::real_t);
 
-#ifdef DEVICE
-        using arr_real = cuda_array_bc_nogp<value_t, allocator_device>;
-#endif
-
-#ifdef HOST
+        // The diagnostics are evaluated on host copies of the fields with a single time level, see diagnostic_queue_t
         using arr_real = cuda_array_bc_nogp<value_t, allocator_host>;
-#endif
 
         /**
          .. cpp:function diagnostic_t(const slab_config_js& sc)
@@ -231,8 +231,20 @@ class diagnostic_t {
         */
         void write_diagnostics(const twodads::real_t, const slab_config_js&);
 
+        /**
+         .. cpp:function static std::vector<twodads::field_t> get_required_fields(const slab_config_js& sc)
+
+         :param const slab_config_js& sc: Slab configuration
+
+         Returns the fields read by the diagnostic routines specified in the configuration.
+
+        */
+        static std::vector<twodads::field_t> get_required_fields(const slab_config_js&);
+
     private:
         const twodads::slab_layout_t slab_layout;
+        // Put in front of the file names, see slab_config_js :: get_file_prefix
+        const std::string file_prefix;
 
         /**
          .. cpp:function inline void diag_com_theta(const twodads::real_t time) const
@@ -243,7 +255,7 @@ class diagnostic_t {
         
         */
         inline void diag_com_theta(const twodads::real_t time) 
-        { diag_com(twodads::field_t::f_theta, com_theta, filename_str_map.at(twodads::diagnostic_t::diag_com_theta), time); }
+        { diag_com(twodads::field_t::f_theta, com_theta, file_prefix + filename_str_map.at(twodads::diagnostic_t::diag_com_theta), time); }
 
         /**
          .. cpp:function inline void diag_com_tau(const twodads::real_t time) const
@@ -254,7 +266,7 @@ class diagnostic_t {
         
         */
         inline void diag_com_tau(const twodads::real_t time) 
-        { diag_com(twodads::field_t::f_tau, com_tau, filename_str_map.at(twodads::diagnostic_t::diag_com_tau), time); }
+        { diag_com(twodads::field_t::f_tau, com_tau, file_prefix + filename_str_map.at(twodads::diagnostic_t::diag_com_tau), time); }
 
         /**
          .. cpp:function inline void diag_max_theta(const twodads::real_t time) 
@@ -265,7 +277,7 @@ class diagnostic_t {
         
         */
         inline void diag_max_theta(const twodads::real_t time) 
-        { diag_max(twodads::field_t::f_theta, filename_str_map.at(twodads::diagnostic_t::diag_max_theta), time); }
+        { diag_max(twodads::field_t::f_theta, file_prefix + filename_str_map.at(twodads::diagnostic_t::diag_max_theta), time); }
 
         /**
          .. cpp:function inline void diag_max_tau(const twodads::real_t time) 
@@ -276,7 +288,7 @@ class diagnostic_t {
         
         */
         inline void diag_max_tau(const twodads::real_t time) 
-        {diag_max(twodads::field_t::f_tau, filename_str_map.at(twodads::diagnostic_t::diag_max_tau), time); }
+        {diag_max(twodads::field_t::f_tau, file_prefix + filename_str_map.at(twodads::diagnostic_t::diag_max_tau), time); }
 
         /**
          .. cpp:function void diag_probes(const twodads::real_t time)
@@ -352,4 +364,118 @@ class diagnostic_t {
     */
 };
 
+
+class diagnostic_queue_t
+{
+    /**
+     .. cpp:namespace-push:: diagnostic_queue_t
+
+    */
+
+    /**
+     .. cpp:class:: diagnostic_queue_t
+
+     Evaluates the diagnostics on a separate thread, while the time integration continues.
+
+     The caller copies the fields returned by get_required_fields into a free buffer, obtained with acquire,
+     and passes it to the thread with submit. The thread evaluates the buffers in the order they were submitted,
+     so that the diagnostics are written in the order of the time steps. acquire blocks while all buffers
+     wait for the thread. With zero buffers, submit evaluates the diagnostics in the calling thread.
+
+     An exception thrown by a diagnostic routine is rethrown by the next call of acquire or wait.
+
+    */
+
+    public:
+        using value_t = twodads::real_t;
+        using arr_real = diagnostic_t::arr_real;
+
+        /**
+         .. cpp:function diagnostic_queue_t(const slab_config_js& sc)
+
+         :param const slab_config_js& sc: Slab configuration
+
+         Allocates 2dads.diagnostics.buffers buffers and starts the thread.
+
+        */
+        diagnostic_queue_t(const slab_config_js&);
+
+        /**
+         .. cpp:function ~diagnostic_queue_t()
+
+         Evaluates the submitted buffers and stops the thread.
+
+        */
+        ~diagnostic_queue_t();
+
+        diagnostic_queue_t(const diagnostic_queue_t&) = delete;
+        diagnostic_queue_t& operator=(const diagnostic_queue_t&) = delete;
+
+        /**
+         .. cpp:function const std::vector<twodads::field_t>& get_required_fields() const
+
+         Returns the fields to copy into a buffer.
+
+        */
+        const std::vector<twodads::field_t>& get_required_fields() const {return(fields);};
+
+        /**
+         .. cpp:function arr_real* acquire(const twodads::field_t fname)
+
+         :param const twodads::field_t fname: Name of a required field
+
+         Waits until a buffer is free and returns its array for fname.
+         The array has the geometry and the boundary values of the field and a single time level.
+
+        */
+        arr_real* acquire(const twodads::field_t);
+
+        /**
+         .. cpp:function void submit(const twodads::real_t time)
+
+         :param const twodads::real_t time: Simulation time of the fields in the buffer
+
+         Passes the buffer to the thread.
+
+        */
+        void submit(const twodads::real_t);
+
+        /**
+         .. cpp:function void wait()
+
+         Waits until all submitted buffers are evaluated.
+
+        */
+        void wait();
+
+    private:
+        // Evaluates the diagnostics of the buffer at head
+        void evaluate(const size_t);
+        void run();
+        // Requires the lock
+        void rethrow_error();
+
+        const slab_config_js config;
+        diagnostic_t diagnostic;
+        const std::vector<twodads::field_t> fields;
+        const size_t num_buffers;
+        // Arrays of each buffer, in the order of fields, and the time of the submitted buffers.
+        // Buffers are filled and evaluated in a ring: head is the oldest submitted buffer, num_pending
+        // buffers following it wait for the thread.
+        std::vector<std::vector<arr_real*>> buffers;
+        std::vector<twodads::real_t> buffer_time;
+        size_t head;
+        size_t num_pending;
+        bool stop;
+        std::exception_ptr error;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::thread worker;
+
+    /**
+     .. cpp:namespace-pop::
+
+    */
+};
+
 #endif //DIAGNOSTICS_H	
@@ -0,0 +1,340 @@
+/*
+ * Memory footprint of the arrays
+ *
+ * The allocators in allocators.h register each allocation with the registry and remove it when
+ * the memory is freed. An allocation is tagged with the component that owns it, e.g. "slab_bc" or
+ * "deriv_fd_t", and a name within the component, e.g. "theta" or "diag". cuda_array_bc_nogp :: set_tag
+ * tags both allocations of an array. Arrays are tagged after construction, allocations that are never
+ * tagged are listed as "untagged".
+ *
+ * The registry keeps the current and the largest number of bytes, in total and per component.
+ * The report is written on request and by the allocators when an allocation fails.
+ * Memory allocated without the allocators, e.g. by FFTW, cuFFT, or std::vector, is not included.
+ */
+
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <ios>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+namespace footprint
+{
+    /**
+     .. cpp:namespace-push:: footprint
+
+    */
+
+    /**
+     .. cpp:class:: registry_t
+
+     Registry of the allocations of the program. All member functions are thread safe.
+
+    */
+    class registry_t
+    {
+        public:
+            /**
+             .. cpp:function:: static registry_t& get()
+
+             Returns the registry of the program. The registry is never destroyed, so that arrays
+             with static storage duration can be freed at exit.
+
+            */
+            static registry_t& get()
+            {
+                static registry_t* registry{new registry_t()};
+                return(*registry);
+            }
+
+            /**
+             .. cpp:function:: void add(const void* ptr, const size_t nbytes)
+
+             :param const void* ptr: Address of the allocation
+             :param const size_t nbytes: Size of the allocation in bytes
+
+             Registers an untagged allocation.
+
+            */
+            void add(const void* ptr, const size_t nbytes)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                allocations[ptr] = allocation_t{nbytes, untagged, std::string()};
+                add_bytes(untagged, nbytes);
+                total_bytes += nbytes;
+                peak_bytes = std::max(peak_bytes, total_bytes);
+            }
+
+            /**
+             .. cpp:function:: void remove(const void* ptr)
+
+             :param const void* ptr: Address of the allocation
+
+             Removes the allocation at ptr from the registry. Addresses that are not registered are ignored.
+
+            */
+            void remove(const void* ptr)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = allocations.find(ptr);
+                if(it == allocations.end())
+                    return;
+                components[it -> second.owner].bytes -= it -> second.nbytes;
+                total_bytes -= it -> second.nbytes;
+                allocations.erase(it);
+            }
+
+            /**
+             .. cpp:function:: void set_tag(const void* ptr, const std::string& owner, const std::string& name)
+
+             :param const void* ptr: Address of the allocation
+             :param const std::string& owner: Component that owns the allocation
+             :param const std::string& name: Name of the allocation within the component
+
+             Tags the allocation at ptr and moves its bytes to the owning component.
+
+            */
+            void set_tag(const void* ptr, const std::string& owner, const std::string& name)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = allocations.find(ptr);
+                if(it == allocations.end())
+                    return;
+                components[it -> second.owner].bytes -= it -> second.nbytes;
+                add_bytes(owner, it -> second.nbytes);
+                it -> second.owner = owner;
+                it -> second.name = name;
+            }
+
+            /**
+             .. cpp:function:: std::string get_owner(const void* ptr)
+
+             Returns the component that owns the allocation at ptr, or an empty string if ptr is not registered.
+
+            */
+            std::string get_owner(const void* ptr)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = allocations.find(ptr);
+                return(it == allocations.end() ? std::string() : it -> second.owner);
+            }
+
+            /**
+             .. cpp:function:: std::string get_name(const void* ptr)
+
+             Returns the name of the allocation at ptr, or an empty string if ptr is not registered.
+
+            */
+            std::string get_name(const void* ptr)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = allocations.find(ptr);
+                return(it == allocations.end() ? std::string() : it -> second.name);
+            }
+
+            /**
+             .. cpp:function:: size_t get_total_bytes()
+
+             Returns the number of bytes currently allocated.
+
+            */
+            size_t get_total_bytes()
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                return(total_bytes);
+            }
+
+            /**
+             .. cpp:function:: size_t get_peak_bytes()
+
+             Returns the largest number of bytes allocated at any time since the start or the last call of reset_peak.
+
+            */
+            size_t get_peak_bytes()
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                return(peak_bytes);
+            }
+
+            /**
+             .. cpp:function:: size_t get_num_allocations()
+
+             Returns the number of live allocations.
+
+            */
+            size_t get_num_allocations()
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                return(allocations.size());
+            }
+
+            /**
+             .. cpp:function:: size_t get_component_bytes(const std::string& owner)
+
+             Returns the number of bytes currently allocated by the component.
+
+            */
+            size_t get_component_bytes(const std::string& owner)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = components.find(owner);
+                return(it == components.end() ? 0 : it -> second.bytes);
+            }
+
+            /**
+             .. cpp:function:: size_t get_component_peak_bytes(const std::string& owner)
+
+             Returns the largest number of bytes allocated by the component at any time.
+
+            */
+            size_t get_component_peak_bytes(const std::string& owner)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = components.find(owner);
+                return(it == components.end() ? 0 : it -> second.peak_bytes);
+            }
+
+            /**
+             .. cpp:function:: void reset_peak()
+
+             Sets the peak bytes, in total and per component, to the bytes currently allocated.
+
+            */
+            void reset_peak()
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                peak_bytes = total_bytes;
+                for(auto& it : components)
+                    it.second.peak_bytes = (it.first == untagged ? 0 : it.second.bytes);
+            }
+
+            /**
+             .. cpp:function:: void write_report(std::ostream& os)
+
+             Writes the footprint as a JSON object: {"total_bytes": ..., "peak_bytes": ..., "allocations": ...,
+             "components": {"owner": {"bytes": ..., "peak_bytes": ..., "allocations": ..., "names": {"name": ..., ...}}, ...}}.
+             Components are listed with decreasing bytes, "names" gives the bytes currently allocated per name.
+             Components without live allocations are listed with their peak. "untagged" has no peak, as all
+             arrays are untagged until set_tag is called.
+
+            */
+            void write_report(std::ostream& os)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+
+                // Live bytes and allocations per name in each component
+                std::map<std::string, std::map<std::string, size_t>> names;
+                std::map<std::string, size_t> num_alloc;
+                for(const auto& it : allocations)
+                {
+                    names[it.second.owner][it.second.name] += it.second.nbytes;
+                    num_alloc[it.second.owner]++;
+                }
+
+                std::vector<std::pair<std::string, const component_t*>> sorted;
+                for(const auto& it : components)
+                {
+                    if(it.second.bytes > 0 || it.second.peak_bytes > 0)
+                        sorted.push_back(std::make_pair(it.first, &it.second));
+                }
+                std::sort(sorted.begin(), sorted.end(), [] (const std::pair<std::string, const component_t*>& a, const std::pair<std::string, const component_t*>& b) -> bool
+                          {return(a.second -> bytes != b.second -> bytes ? a.second -> bytes > b.second -> bytes : a.second -> peak_bytes > b.second -> peak_bytes);});
+
+                os << "{\n    \"total_bytes\": " << total_bytes << ",\n    \"peak_bytes\": " << peak_bytes;
+                os << ",\n    \"allocations\": " << allocations.size() << ",\n    \"components\": {";
+                for(size_t c = 0; c < sorted.size(); c++)
+                {
+                    os << (c == 0 ? "\n" : ",\n");
+                    os << "        \"" << escape(sorted[c].first) << "\": {";
+                    os << "\"bytes\": " << sorted[c].second -> bytes;
+                    if(sorted[c].first != untagged)
+                        os << ", \"peak_bytes\": " << sorted[c].second -> peak_bytes;
+                    os << ", \"allocations\": " << num_alloc[sorted[c].first];
+                    os << ", \"names\": {";
+                    size_t n{0};
+                    for(const auto& it : names[sorted[c].first])
+                        os << (n++ == 0 ? "\"" : ", \"") << escape(it.first) << "\": " << it.second;
+                    os << "}}";
+                }
+                os << "\n    }\n}\n";
+            }
+
+            /**
+             .. cpp:function:: void write_report(const std::string& fname)
+
+             Writes the report to the file fname. Throws std::ios_base::failure if the file can not be written.
+
+            */
+            void write_report(const std::string& fname)
+            {
+                std::ofstream ofs(fname);
+                if(!ofs)
+                    throw std::ios_base::failure(std::string("write_report: Could not open ") + fname);
+                write_report(ofs);
+                if(!ofs)
+                    throw std::ios_base::failure(std::string("write_report: Error writing ") + fname);
+            }
+
+        private:
+            registry_t() : total_bytes(0), peak_bytes(0) {}
+            registry_t(const registry_t&) = delete;
+            registry_t& operator=(const registry_t&) = delete;
+
+            struct allocation_t
+            {
+                size_t nbytes;
+                std::string owner;
+                std::string name;
+            };
+
+            struct component_t
+            {
+                size_t bytes;
+                size_t peak_bytes;
+            };
+
+            // Requires the lock
+            void add_bytes(const std::string& owner, const size_t nbytes)
+            {
+                component_t& comp = components[owner];
+                comp.bytes += nbytes;
+                if(owner != untagged)
+                    comp.peak_bytes = std::max(comp.peak_bytes, comp.bytes);
+            }
+
+            static std::string escape(const std::string& str)
+            {
+                std::string res;
+                for(const char c : str)
+                {
+                    if(c == '"' || c == '\\')
+                        res.push_back('\\');
+                    res.push_back(c);
+                }
+                return(res);
+            }
+
+            const std::string untagged{"untagged"};
+
+            std::mutex mtx;
+            std::map<const void*, allocation_t> allocations;
+            std::map<std::string, component_t> components;
+            size_t total_bytes;
+            size_t peak_bytes;
+    };
+
+    /**
+     .. cpp:namespace-pop::
+
+    */
+}
+
+#endif //FOOTPRINT_H
@@ -9,11 +9,17 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cmath>
 #include "error.h"
 #include "cuda_array_bc_nogp.h"
 #include "dft_type.h"
 #include "solvers.h"
+#include "utility.h"
 #include "2dads_types.h"
+#include "profiler.h"
 
 
 namespace detail
@@ -35,6 +41,28 @@ namespace detail
                             diag_u.get_tlev_ptr(0));
     }
 
+
+    template <typename T>
+    void impl_solve_tridiagonal_batch(CuCmplx<T>** rhs, const size_t num_rhs,
+                                      const cuda_array_bc_nogp<CuCmplx<T>, allocator_device>& diag_u,
+                                      const cuda_array_bc_nogp<CuCmplx<T>, allocator_device>& diag,
+                                      const cuda_array_bc_nogp<CuCmplx<T>, allocator_device>& diag_l,
+                                      solvers :: elliptic_base_t* ell_solver,
+                                      allocator_device<T>)
+    {   
+        for(size_t k = 0; k < num_rhs; k++)
+            ell_solver -> solve(rhs[k], rhs[k], diag_l.get_tlev_ptr(0), diag.get_tlev_ptr(0), diag_u.get_tlev_ptr(0));
+    }
+
+
+    // The banded solver for the hyperviscosity runs on the host only
+    template <typename T>
+    solvers :: banded_real_t* impl_create_banded(const twodads::slab_layout_t& geom, const size_t bw, allocator_device<T>)
+    {
+        throw not_implemented_error(std::string("Hyperviscosity is not implemented for the finite difference integrators on the device"));
+        return(nullptr);
+    }
+
 #endif //__CUDACC__
 
 #ifndef __CUDACC__
@@ -54,7 +82,86 @@ namespace detail
                             diag.get_tlev_ptr(0),
                             diag_u.get_tlev_ptr(0));  
     }
+
+
+    template <typename T>
+    void impl_solve_tridiagonal_batch(CuCmplx<T>** rhs, const size_t num_rhs,
+                                      const cuda_array_bc_nogp<CuCmplx<T>, allocator_host>& diag_u,
+                                      const cuda_array_bc_nogp<CuCmplx<T>, allocator_host>& diag,
+                                      const cuda_array_bc_nogp<CuCmplx<T>, allocator_host>& diag_l,
+                                      solvers :: elliptic_base_t* ell_solver,
+                                      allocator_host<T>)
+    {
+        ell_solver -> solve_batch(rhs, num_rhs,
+                                  diag_l.get_tlev_ptr(0) + 1,
+                                  diag.get_tlev_ptr(0),
+                                  diag_u.get_tlev_ptr(0));
+    }
+
+
+    template <typename T>
+    solvers :: banded_real_t* impl_create_banded(const twodads::slab_layout_t& geom, const size_t bw, allocator_host<T>)
+    {
+        return(new solvers :: banded_real_t(geom, bw));
+    }
 #endif //__CUDACC__
+
+    // Set both real and imaginary value to k^2. 
+    // slab_bc instantiates the integrator as T = twodads::real_t
+    // ky modes are aligned in memory, ky(m=0), ky(m=0), ky(m=1), ky(m=2), ...
+    // count ky modes by (m - (m%2))/2, m = 0...My/2+1
+    template <typename T, template<typename> class allocator>
+    void impl_init_k2_map(cuda_array_bc_nogp<T, allocator>& k2_map)
+    {
+        k2_map.apply([] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+                      {
+                        const T kx{twodads::TWOPI * ( (n < geom.get_nx() / 2 + 1) ? T(n) : (T(n) - T(geom.get_nx())) ) / geom.get_Lx()};
+                        const T ky{twodads::TWOPI * T(m - (m % 2)) * 0.5 / geom.get_Ly()};
+                        return(kx * kx + ky * ky);
+                      }, 0);
+    }
+
+
+    // Damping of the hyperviscosity, k^(2p) = (k^2)^p
+    template <typename T>
+    CUDAMEMBER inline T hv_power(const T k2, const size_t p)
+    {
+        T result{1.0};
+        for(size_t i = 0; i < p; i++)
+            result *= k2;
+        return(result);
+    }
+
+
+    // phi-functions of exponential integrators for real arguments,
+    // phi_0(z) = exp(z), phi_{k+1}(z) = (phi_k(z) - 1 / k!) / z
+    // The recursion cancels for small |z|, there we sum the Taylor series phi_k(z) = sum_j z^j / (j + k)!
+    template <typename T>
+    CUDAMEMBER inline T etd_phi(const size_t k, const T z)
+    {
+        if(fabs(z) < T(1.0))
+        {
+            T term{1.0};
+            for(size_t j = 2; j < k + 1; j++)
+                term /= T(j);
+            T sum{term};
+            for(size_t j = 1; j < 20; j++)
+            {
+                term *= z / T(j + k);
+                sum += term;
+            }
+            return(sum);
+        }
+
+        T phi{exp(z)};
+        T inv_fact{1.0};
+        for(size_t j = 0; j < k; j++)
+        {
+            phi = (phi - inv_fact) / z;
+            inv_fact /= T(j + 1);
+        }
+        return(phi);
+    }
 }
 
 
@@ -93,6 +200,107 @@ class integrator_base_t
         virtual void integrate(cuda_array_bc_nogp<T, allocator>&, 
                                const cuda_array_bc_nogp<T, allocator>&, 
                                const size_t, const size_t, const size_t, const size_t, const size_t) = 0;
+
+        /**
+         .. cpp:function:: virtual void integrate_batch(const std::vector<cuda_array_bc_nogp<T, allocator>*>& fields, const std::vector<const cuda_array_bc_nogp<T, allocator>*>& explicit_parts, const size_t t_src1, const size_t t_src2, const size_t t_src3, const size_t t_dst, const size_t order)
+
+         :param const std::vector<cuda_array_bc_nogp<T, allocator>*>& fields: Fields to be integrated.
+         :param const std::vector<const cuda_array_bc_nogp<T, allocator>*>& explicit_parts: Explicit parts, one for each field.
+
+         Integrates several fields that share the parameters of this integrator, i.e. time step, diffusion coefficient and
+         type of the boundary conditions. Remaining parameters are the same as for integrate.
+         The default implementation calls integrate for each field.
+
+        */
+        virtual void integrate_batch(const std::vector<cuda_array_bc_nogp<T, allocator>*>& fields,
+                                     const std::vector<const cuda_array_bc_nogp<T, allocator>*>& explicit_parts,
+                                     const size_t t_src1, const size_t t_src2, const size_t t_src3, const size_t t_dst, const size_t order)
+        {
+            assert(fields.size() == explicit_parts.size());
+            for(size_t f = 0; f < fields.size(); f++)
+                integrate(*fields[f], *explicit_parts[f], t_src1, t_src2, t_src3, t_dst, order);
+        }
+
+        /**
+         .. cpp:function:: virtual void set_deltat(const T dt) = 0
+
+         :param const T dt: Size of the next time step.
+
+         Sets the size of the next time step. Call this once before each time step when the step size varies.
+         The sizes of the previous steps are kept to compute the coefficients of the scheme
+         for variable step sizes, see twodads::stiff_coeffs. Without calls to set_deltat, all steps have 
+         the size given by the stiff_params_t passed to the constructor.
+
+        */
+        virtual void set_deltat(const T) = 0;
+
+        /**
+         .. cpp:type:: rhs_func_t = std::function<void(const std::vector<cuda_array_bc_nogp<T, allocator>*>&, const size_t, const std::vector<cuda_array_bc_nogp<T, allocator>*>&, const size_t)>
+
+         Computes the explicit parts of a set of fields. The first two arguments give the fields and the time index
+         of their data. The explicit parts are written to the arrays given by the last two arguments.
+
+        */
+        using rhs_func_t = std::function<void(const std::vector<cuda_array_bc_nogp<T, allocator>*>&, const size_t, 
+                                              const std::vector<cuda_array_bc_nogp<T, allocator>*>&, const size_t)>;
+
+        /**
+         .. cpp:function:: virtual void integrate_stages(const std::vector<cuda_array_bc_nogp<T, allocator>*>& fields, const size_t t_src, const size_t t_dst, const rhs_func_t& rhs_func)
+
+         :param const std::vector<cuda_array_bc_nogp<T, allocator>*> fields: Fields to be integrated.
+         :param const size_t t_src: Time index of the data at the current time.
+         :param const size_t t_dst: Time index where the data at the next time is written to. May be equal to t_src.
+         :param const rhs_func_t& rhs_func: Computes the explicit parts of all fields at the stages.
+
+         Interface to single-step, multi-stage schemes. Advances the fields by one time step, evaluating the
+         explicit parts with rhs_func at the intermediate stages. Multi-step schemes throw a not_implemented_error.
+
+        */
+        virtual void integrate_stages(const std::vector<cuda_array_bc_nogp<T, allocator>*>&, const size_t, const size_t, const rhs_func_t&)
+        {
+            throw not_implemented_error(std::string("integrate_stages: Not implemented for multi-step schemes"));
+        }
+
+        /**
+         .. cpp:function:: virtual T get_deltat() const = 0
+
+         Returns the size of the current time step.
+
+        */
+        virtual T get_deltat() const = 0;
+
+        /**
+         .. cpp:function:: virtual T get_error_estimate() const
+
+         Returns an estimate of the local error of the last time step, for schemes with an embedded error estimate.
+         Other schemes throw a not_implemented_error.
+
+        */
+        virtual T get_error_estimate() const
+        {
+            throw not_implemented_error(std::string("get_error_estimate: Not implemented for this scheme"));
+        }
+
+        /**
+         .. cpp:function:: virtual void get_state(std::vector<T>& state) const = 0
+
+         Writes the state of the integrator that is not stored in the fields, i.e. the sizes of the 
+         previous time steps and the error estimate, to state. Used to write checkpoints and the
+         snapshots of slab_bc. Does not allocate if state already has the capacity.
+
+        */
+        virtual void get_state(std::vector<T>&) const = 0;
+
+        /**
+         .. cpp:function:: virtual void set_state(const std::vector<T>& state) = 0
+
+         :param const std::vector<T>& state: State as returned by get_state.
+
+         Restores the state of the integrator from a checkpoint. Throws a config_error if the size
+         of state does not match the scheme.
+
+        */
+        virtual void set_state(const std::vector<T>&) = 0;
 };
 
 
@@ -105,19 +313,32 @@ class integrator_karniadakis_fd_t : public integrator_base_t<T, allocator>
 
       Implements Karniadakis time integration using finit-difference / semi-spectral methods.
 
+      With hyperviscosity, hv != 0, the implicit part includes -hv (ky^2 - d^2/dx^2)^p, where d^2/dx^2 is the 
+      finite difference operator with the ghost points of homogeneous boundary conditions. 
+      The linear system then has 2p + 1 diagonals and is solved by solvers::banded_real_t instead of the tridiagonal solver.
+      The hyperviscosity acts on u - u_b, where the lift u_b is a polynomial in x that satisfies the boundary conditions.
+
     */
     public:
 #ifdef DEVICE
     using dft_t = cufft_object_t<T>;
-    using elliptic_t = solvers :: elliptic_cublas_t;
 #endif // DEVICE
 
 #ifdef HOST
     using dft_t = fftw_object_t<T>;
-    using elliptic_t = solvers :: elliptic_mkl_t;
 #endif // HOST
 
-        integrator_karniadakis_fd_t(const twodads::slab_layout_t& _sl, const twodads::bvals_t<T>& _bv, const twodads::stiff_params_t& _sp) :
+        /**
+         .. cpp:function:: integrator_karniadakis_fd_t(const twodads::slab_layout_t& sl, const twodads::bvals_t<T>& bv, const twodads::stiff_params_t& sp, const twodads::solver_t solver)
+
+         :param const twodads::slab_layout_t& sl: Layout of the real fields
+         :param const twodads::bvals_t<T>& bv: Boundary conditions of the integrated field
+         :param const twodads::stiff_params_t& sp: Parameters of the time integration
+         :param const twodads::solver_t solver: Solver for the implicit diffusion step. Defaults to the tridiagonal solver.
+
+        */
+        integrator_karniadakis_fd_t(const twodads::slab_layout_t& _sl, const twodads::bvals_t<T>& _bv, const twodads::stiff_params_t& _sp,
+                                    const twodads::solver_t _solver = twodads::solver_t::solver_tridiag) :
             geom{_sl}, bvals{_bv}, stiff_params{_sp},  
             geom_transpose{get_geom().get_ylo(),
                            get_geom().get_deltay(),
@@ -127,27 +348,52 @@ class integrator_karniadakis_fd_t : public integrator_base_t<T, allocator>
                            get_geom().get_nx(), 0,
                            get_geom().get_grid()},
             myfft{new dft_t(get_geom(), twodads::dft_t::dft_1d)},   
-            my_solver{new elliptic_t(get_geom())},
+            my_solver{solvers :: create_elliptic(get_geom(), _solver, get_bvals().get_bc_left(), get_bvals().get_bc_right())},
+            hv_solver{_sp.get_hv() != 0.0 ? detail :: impl_create_banded(get_geom(), _sp.get_hv_order(), allocator<T>{}) : nullptr},
+            hv_num_threads{solvers :: get_max_threads()},
+            hv_work(hv_solver != nullptr ? 2 * get_geom().get_nx() * (2 * _sp.get_hv_order() + 1) * static_cast<size_t>(hv_num_threads) : 0),
+            hv_lift(hv_solver != nullptr ? 2 * get_geom().get_nx() : 0),
+            deltat{_sp.get_deltat(), _sp.get_deltat(), _sp.get_deltat()},
             diag_order{1},
             // Pass a complex bvals_t to these guys. They don't really need it though.
             diag(get_geom_transpose(), twodads::bvals_t<CuCmplx<T>>(twodads::bc_t::bc_null, twodads::bc_t::bc_null, CuCmplx<T>{0.0}, CuCmplx<T>{0.0}), 1),
             diag_l(get_geom_transpose(), twodads::bvals_t<CuCmplx<T>>(twodads::bc_t::bc_null, twodads::bc_t::bc_null, CuCmplx<T>{0.0}, CuCmplx<T>{0.0}), 1),
             diag_u(get_geom_transpose(), twodads::bvals_t<CuCmplx<T>>(twodads::bc_t::bc_null, twodads::bc_t::bc_null, CuCmplx<T>{0.0}, CuCmplx<T>{0.0}), 1)
         {
+            diag.set_tag("integrator_karniadakis_fd_t", "diag");
+            diag_l.set_tag("integrator_karniadakis_fd_t", "diag_l");
+            diag_u.set_tag("integrator_karniadakis_fd_t", "diag_u");
             init_diagonal(1, bvals.get_bc_left(), bvals.get_bc_right());
             init_diagonals_ul();
         }
         ~integrator_karniadakis_fd_t() 
         {
+            delete hv_solver;
             delete my_solver;
             delete myfft;
         }
         
         void integrate(cuda_array_bc_nogp<T, allocator>&, const cuda_array_bc_nogp<T, allocator>&, const size_t, const size_t, const size_t, const size_t, const size_t);
+        // Combines the time levels of each field in one pass and solves the linear systems of all fields in one solver call.
+        void integrate_batch(const std::vector<cuda_array_bc_nogp<T, allocator>*>&, const std::vector<const cuda_array_bc_nogp<T, allocator>*>&, 
+                             const size_t, const size_t, const size_t, const size_t, const size_t);
+        // Solves the linear system of the given order for all fields. The right hand sides are read in real space from t_dst,
+        // the solution is written to t_dst in Fourier space.
+        void solve_implicit(const std::vector<cuda_array_bc_nogp<T, allocator>*>&, const size_t, const size_t);
+
+        // Changing the step size updates the upper and lower diagonals. The main diagonal is updated 
+        // in the next call to integrate, as it also depends on the order.
+        void set_deltat(const T);
+        inline T get_deltat() const {return(deltat[0]);};
+
+        // The state are the sizes of the current and the two previous time steps
+        void get_state(std::vector<T>& state) const {state.assign({deltat[0], deltat[1], deltat[2]});};
+        void set_state(const std::vector<T>&);
 
         // init_diagonals() initializes the diagonal elements used for elliptic solver.
         // The main diagonal depends on the order of the integrator and is called in constructor for first level
-        // and subsequently the first time when a higher level integrator routine is called
+        // and subsequently the first time when a higher level integrator routine is called.
+        // With variable step sizes it is called again when alpha_0 or the step size change.
         void init_diagonal(const size_t, const twodads::bc_t, const twodads::bc_t);
         // It should really be private, but then nvcc complains
         // An explicit __device__ lambda cannot be defined in a member function that has private or protected access within its class
@@ -159,13 +405,18 @@ class integrator_karniadakis_fd_t : public integrator_base_t<T, allocator>
         inline twodads::stiff_params_t get_tint_params() const {return(stiff_params);};
         inline twodads::slab_layout_t get_geom_transpose() const {return(geom_transpose);};
 
-        inline cuda_array_bc_nogp<CuCmplx<T>, allocator> get_diag() const {return(diag);};
-        inline cuda_array_bc_nogp<CuCmplx<T>, allocator> get_diag_u() const {return(diag_u);};
-        inline cuda_array_bc_nogp<CuCmplx<T>, allocator> get_diag_l() const {return(diag_l);};
+        inline const cuda_array_bc_nogp<CuCmplx<T>, allocator>& get_diag() const {return(diag);};
+        inline const cuda_array_bc_nogp<CuCmplx<T>, allocator>& get_diag_u() const {return(diag_u);};
+        inline const cuda_array_bc_nogp<CuCmplx<T>, allocator>& get_diag_l() const {return(diag_l);};
+
+        inline T get_rx() const {return(get_tint_params().get_diff() * get_deltat() / (get_geom().get_deltax() * get_geom().get_deltax()));};
 
-        inline T get_rx() const {return(get_tint_params().get_diff() * get_tint_params().get_deltat() / (get_geom().get_deltax() * get_geom().get_deltax()));};
+        inline solvers :: elliptic_base_t* get_ell_solver() {return(my_solver);};
+
+        // Adds coeff * (ky^2 - d^2/dx^2)^p (u - u_b) to dst. u_hat and dst are in Fourier space, 
+        // bv gives the lift u_b. The boundary conditions need to be the ones of the last call to init_diagonal.
+        void apply_hypervisc(const T*, T*, const T, const twodads::bvals_t<T>&) const;
 
-        inline elliptic_t* get_ell_solver() {return(my_solver);};
     private:
         // Diagonal elements for elliptic solver
         const twodads::slab_layout_t geom;
@@ -178,11 +429,48 @@ class integrator_karniadakis_fd_t : public integrator_base_t<T, allocator>
         // Fourier transformation happens in the time integration where we solve
         // in each fourier mode
         dft_t* myfft;
-        elliptic_t* my_solver;
-
+        solvers :: elliptic_base_t* my_solver;
+        // Solver for the banded system with hyperviscosity, nullptr for hv = 0
+        solvers :: banded_real_t* hv_solver;
+
+        // Finite difference weights of d^2/dx^2, in units of 1 / dx^2, with the ghost points of
+        // homogeneous boundary conditions eliminated. Set by init_diagonal if hv != 0.
+        std::vector<T> hv_lower;
+        std::vector<T> hv_center;
+        std::vector<T> hv_upper;
+        // Sets the band of the linear system alpha_0 + dt (diff (ky^2 - d^2/dx^2) + hv (ky^2 - d^2/dx^2)^p) and factorizes it
+        void init_hv_band(const T);
+        // Overwrites the column v with (ky^2 - d^2/dx^2)^p v, tmp is used as storage
+        void hv_apply_column(T*, T*, const T) const;
+        // (-d^2/dx^2)^p u_b for the ky=0 mode, in Fourier space. Zero for vanishing boundary values.
+        // Returns a pointer to hv_lift, which is overwritten by the next call.
+        const T* get_hv_lift(const twodads::bvals_t<T>&) const;
+        // Storage of init_hv_band and apply_hypervisc, 2 Nx (2 bw + 1) elements for each thread, and of get_hv_lift, 2 Nx elements.
+        // They are allocated by the constructor so that the time steps do not allocate.
+        const int hv_num_threads;
+        mutable std::vector<T> hv_work;
+        mutable std::vector<T> hv_lift;
+        // Storage of the calling thread in hv_work
+        T* get_hv_work() const {return(hv_work.data() + hv_work.size() / static_cast<size_t>(hv_num_threads) * static_cast<size_t>(solvers :: get_thread_num()));};
+        // Pointers to the right hand sides of solve_implicit
+        std::vector<CuCmplx<T>*> batch_rhs;
+
+        // Size of the current and the two previous time steps
+        T deltat[3];
+
+        // Order, alpha_0 and step size the main diagonal was computed for
         size_t diag_order;
+        T diag_alpha0;
+        T diag_deltat;
         void set_diag_order(const size_t o) {diag_order = o;};
         size_t get_diag_order() const {return(diag_order);};
+        // Returns true if the main diagonal is up to date for a time step of the given order
+        bool is_diag_valid(const size_t) const;
+
+        // alpha_0 and step size used for the system of each order. Stored factorizations of the solver
+        // are discarded when they change.
+        T sys_alpha0[3]{0.0, 0.0, 0.0};
+        T sys_deltat[3]{0.0, 0.0, 0.0};
 
         cuda_array_bc_nogp<CuCmplx<T>, allocator> diag;
         cuda_array_bc_nogp<CuCmplx<T>, allocator> diag_l;
@@ -195,42 +483,53 @@ void integrator_karniadakis_fd_t<T, allocator> :: init_diagonal(const size_t ord
                                                                 const twodads::bc_t bc_left,
                                                                 const twodads::bc_t bc_right)
 {
+    PROFILE_SCOPE("integrator_karniadakis_fd_t::init_diagonal", 3 * get_geom().get_nelem_per_t() * sizeof(T));
     // Get values from members not passed to the lambda so we can pass them by value into the lambda function, [=] capture
     const T rx{get_rx()};
-    const T alpha0{twodads::alpha[order - 1][0]};
+    T alpha_v[4];
+    T beta_v[3];
+    twodads::stiff_coeffs(order, deltat, alpha_v, beta_v);
+    const T alpha0{alpha_v[0]};
     
     // Initialize the main diagonal to alpha_0 + 2 * rx + ky^2 * diff * dt
     // The first and last element on the main diagonal depend on boundary condition
     // 3 * rx for bc_dirichlet
     // 1 * rx for bc_neumann
+    // On stretched grids the finite difference weights vary along x, see slab_layout_t::get_d2dx2_center.
+    // The sign of the ghost point weight is stored in val_left and val_right.
     T val_left{0.0};
     T val_right{0.0};
+    const twodads::slab_layout_t geom_x{get_geom()};
 
     switch(bc_left)
     {
         case twodads::bc_t::bc_dirichlet:
-            val_left = T(3.0);
+            val_left = T(1.0);
             break;
         case twodads::bc_t::bc_neumann:
-            val_right = T(1.0);
+            val_left = T(-1.0);
             break;
-        case twodads::bc_t::bc_periodic:
-            // Fall through
         case twodads::bc_t::bc_null:
+            // Edge of a subdomain, the neighbouring point is coupled by the distributed solver
+            val_left = T(0.0);
+            break;
+        case twodads::bc_t::bc_periodic:
             throw not_implemented_error("integrator_karniadakis_fd_t does not handle periodic boundary conditions");
     }
 
     switch(bc_right)
     {
         case twodads::bc_t::bc_dirichlet:
-            val_right = T(3.0);
+            val_right = T(1.0);
             break;
         case twodads::bc_t::bc_neumann:
-            val_right = T(1.0);
+            val_right = T(-1.0);
             break;
-        case twodads::bc_t::bc_periodic:
-            // Fall through
         case twodads::bc_t::bc_null:
+            // Edge of a subdomain, the neighbouring point is coupled by the distributed solver
+            val_right = T(0.0);
+            break;
+        case twodads::bc_t::bc_periodic:
             throw not_implemented_error("integrator_karniadakis_fd_t does not handle periodic boundary conditions");        
     }
 
@@ -240,14 +539,238 @@ void integrator_karniadakis_fd_t<T, allocator> :: init_diagonal(const size_t ord
         const T ky2{twodads::TWOPI * twodads::TWOPI * static_cast<T>(n * n) / (Lx * Lx)};
         
         if (m == 0)
-            return(CuCmplx<T>(alpha0 + val_left * rx + ky2 * rx * geom.get_deltax() * geom.get_deltax(), 0.0));
+            return(CuCmplx<T>(alpha0 + (val_left * geom_x.get_d2dx2_lower(m) - geom_x.get_d2dx2_center(m)) * rx + ky2 * rx * geom.get_deltax() * geom.get_deltax(), 0.0));
         else if (m == geom.get_my() - 1)
-            return(CuCmplx<T>(alpha0 + val_right * rx + ky2 * rx * geom.get_deltax() * geom.get_deltax(), 0.0));
+            return(CuCmplx<T>(alpha0 + (val_right * geom_x.get_d2dx2_upper(m) - geom_x.get_d2dx2_center(m)) * rx + ky2 * rx * geom.get_deltax() * geom.get_deltax(), 0.0));
         else
-            return(CuCmplx<T>(alpha0 + 2.0 * rx + ky2 * rx * geom.get_deltax() * geom.get_deltax(), 0.0));
+            return(CuCmplx<T>(alpha0 - geom_x.get_d2dx2_center(m) * rx + ky2 * rx * geom.get_deltax() * geom.get_deltax(), 0.0));
     }, 0);
 
     set_diag_order(order);
+    diag_alpha0 = alpha0;
+    diag_deltat = get_deltat();
+
+    if(hv_solver != nullptr)
+    {
+        const size_t Nx{get_geom().get_nx()};
+        hv_lower.resize(Nx);
+        hv_center.resize(Nx);
+        hv_upper.resize(Nx);
+        for(size_t n = 0; n < Nx; n++)
+        {
+            hv_lower[n] = get_geom().get_d2dx2_lower(n);
+            hv_center[n] = get_geom().get_d2dx2_center(n);
+            hv_upper[n] = get_geom().get_d2dx2_upper(n);
+        }
+        hv_center[0] -= val_left * hv_lower[0];
+        hv_center[Nx - 1] -= val_right * hv_upper[Nx - 1];
+        init_hv_band(alpha0);
+    }
+
+    // Solvers that store a factorization keep one for each order
+    get_ell_solver() -> set_system(order - 1);
+    if(sys_alpha0[order - 1] != alpha0 || sys_deltat[order - 1] != get_deltat())
+    {
+        // invalidate discards the factorizations of all orders
+        get_ell_solver() -> invalidate();
+        for(size_t o = 0; o < 3; o++)
+        {
+            sys_alpha0[o] = 0.0;
+            sys_deltat[o] = 0.0;
+        }
+        sys_alpha0[order - 1] = alpha0;
+        sys_deltat[order - 1] = get_deltat();
+    }
+}
+
+
+template <typename T, template<typename> class allocator>
+bool integrator_karniadakis_fd_t<T, allocator> :: is_diag_valid(const size_t order) const
+{
+    T alpha_v[4];
+    T beta_v[3];
+    twodads::stiff_coeffs(order, deltat, alpha_v, beta_v);
+    return((get_diag_order() == order) && (diag_alpha0 == alpha_v[0]) && (diag_deltat == get_deltat()));
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_karniadakis_fd_t<T, allocator> :: hv_apply_column(T* v, T* tmp, const T ky2) const
+{
+    const size_t Nx{get_geom().get_nx()};
+    const T inv_dx2{1.0 / (get_geom().get_deltax() * get_geom().get_deltax())};
+    for(size_t q = 0; q < get_tint_params().get_hv_order(); q++)
+    {
+        for(size_t n = 0; n < Nx; n++)
+        {
+            T result{(ky2 - hv_center[n] * inv_dx2) * v[n]};
+            if(n > 0)
+                result -= hv_lower[n] * inv_dx2 * v[n - 1];
+            if(n < Nx - 1)
+                result -= hv_upper[n] * inv_dx2 * v[n + 1];
+            tmp[n] = result;
+        }
+        for(size_t n = 0; n < Nx; n++)
+            v[n] = tmp[n];
+    }
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_karniadakis_fd_t<T, allocator> :: init_hv_band(const T alpha0)
+{
+    // Computes the band of P = (ky^2 - d^2/dx^2)^p for each mode by p multiplications with the 
+    // tridiagonal matrix, starting from the identity. The band of P has p diagonals above and below the main diagonal.
+    const size_t Nx{get_geom().get_nx()};
+    const size_t My21{hv_solver -> get_my21()};
+    const int bw{static_cast<int>(hv_solver -> get_bw())};
+    const size_t width{static_cast<size_t>(2 * bw + 1)};
+    const T inv_dx2{1.0 / (get_geom().get_deltax() * get_geom().get_deltax())};
+    const T dt_hv{get_deltat() * get_tint_params().get_hv()};
+    const T dt_diff{get_deltat() * get_tint_params().get_diff()};
+    const T rx{get_rx()};
+    const T Ly{get_geom().get_Ly()};
+    T* band{hv_solver -> get_band_ptr()};
+
+#pragma omp parallel for num_threads(hv_num_threads) schedule(static)
+    for(size_t m = 0; m < My21; m++)
+    {
+        const T ky{twodads::TWOPI * static_cast<T>(m) / Ly};
+        const T ky2{ky * ky};
+        // P_{n, n + j} is stored at n * width + bw + j. P and Q are in the storage of this thread.
+        T* P{get_hv_work()};
+        T* Q{P + Nx * width};
+        std::fill(P, P + 2 * Nx * width, T(0.0));
+        for(size_t n = 0; n < Nx; n++)
+            P[n * width + bw] = 1.0;
+
+        for(int q = 0; q < bw; q++)
+        {
+            for(size_t n = 0; n < Nx; n++)
+            {
+                // Row n of the tridiagonal matrix, M_{n, n + d} for d = -1, 0, 1
+                const T M_n[3] = {n > 0 ? -hv_lower[n] * inv_dx2 : T(0.0), 
+                                  ky2 - hv_center[n] * inv_dx2, 
+                                  n < Nx - 1 ? -hv_upper[n] * inv_dx2 : T(0.0)};
+                for(int j = -bw; j <= bw; j++)
+                {
+                    T result{0.0};
+                    for(int d = -1; d <= 1; d++)
+                    {
+                        const int row{static_cast<int>(n) + d};
+                        if(row < 0 || row >= static_cast<int>(Nx) || j - d < -bw || j - d > bw)
+                            continue;
+                        result += M_n[d + 1] * P[static_cast<size_t>(row) * width + bw + j - d];
+                    }
+                    Q[n * width + bw + j] = result;
+                }
+            }
+            std::swap(P, Q);
+        }
+
+        // A = alpha_0 + dt diff (ky^2 - d^2/dx^2) + dt hv P. d^2/dx^2 includes the ghost points, as in init_diagonal.
+        for(size_t n = 0; n < Nx; n++)
+        {
+            for(int j = -bw; j <= bw; j++)
+            {
+                T a{dt_hv * P[n * width + bw + j]};
+                if(j == 0)
+                    a += alpha0 + dt_diff * ky2 - rx * hv_center[n];
+                else if(j == -1 && n > 0)
+                    a -= rx * hv_lower[n];
+                else if(j == 1 && n < Nx - 1)
+                    a -= rx * hv_upper[n];
+                band[hv_solver -> idx(n, j, m)] = a;
+            }
+        }
+    }
+    hv_solver -> factorize();
+}
+
+
+template <typename T, template<typename> class allocator>
+const T* integrator_karniadakis_fd_t<T, allocator> :: get_hv_lift(const twodads::bvals_t<T>& bv) const
+{
+    const size_t Nx{get_geom().get_nx()};
+    T* lift{hv_lift.data()};
+    std::fill(lift, lift + Nx, T(0.0));
+    if(bv.get_bv_left() == 0.0 && bv.get_bv_right() == 0.0)
+        return(lift);
+
+    // u_b is linear for Dirichlet boundaries and for a single Neumann boundary. With two Neumann boundaries
+    // u_b is quadratic. The ky=0 mode is the y-average times My.
+    const T x_l{get_geom().get_xleft()};
+    const T Lx{get_geom().get_Lx()};
+    const T b_l{bv.get_bv_left()};
+    const T b_r{bv.get_bv_right()};
+    const bool dirichlet_l{bv.get_bc_left() == twodads::bc_t::bc_dirichlet};
+    const bool dirichlet_r{bv.get_bc_right() == twodads::bc_t::bc_dirichlet};
+    for(size_t n = 0; n < Nx; n++)
+    {
+        const T xi{get_geom().get_x(n) - x_l};
+        T u_b{0.0};
+        if(dirichlet_l && dirichlet_r)
+            u_b = b_l + (b_r - b_l) * xi / Lx;
+        else if(dirichlet_l)
+            u_b = b_l + b_r * xi;
+        else if(dirichlet_r)
+            u_b = b_r + b_l * (xi - Lx);
+        else
+            u_b = b_l * xi + 0.5 * (b_r - b_l) * xi * xi / Lx;
+        lift[n] = u_b * static_cast<T>(get_geom().get_my());
+    }
+
+    hv_apply_column(lift, lift + Nx, T(0.0));
+    return(lift);
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_karniadakis_fd_t<T, allocator> :: apply_hypervisc(const T* u_hat, T* dst, const T coeff, const twodads::bvals_t<T>& bv) const
+{
+    assert(hv_solver != nullptr);
+    const size_t Nx{get_geom().get_nx()};
+    const size_t stride{get_geom().get_my() + get_geom().get_pad_y()};
+    const T Ly{get_geom().get_Ly()};
+    const T* lift{get_hv_lift(bv)};
+
+    // Real and imaginary parts are columns m = 2 * k and m = 2 * k + 1 of mode k.
+#pragma omp parallel for num_threads(hv_num_threads) schedule(static)
+    for(size_t m = 0; m < stride; m++)
+    {
+        const T ky{twodads::TWOPI * static_cast<T>(m / 2) / Ly};
+        T* col{get_hv_work()};
+        T* tmp{col + Nx};
+        for(size_t n = 0; n < Nx; n++)
+            col[n] = u_hat[n * stride + m];
+        hv_apply_column(col, tmp, ky * ky);
+        for(size_t n = 0; n < Nx; n++)
+            dst[n * stride + m] += coeff * (col[n] - (m == 0 ? lift[n] : T(0.0)));
+    }
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_karniadakis_fd_t<T, allocator> :: set_deltat(const T dt)
+{
+    const T dt_old{get_deltat()};
+    deltat[2] = deltat[1];
+    deltat[1] = deltat[0];
+    deltat[0] = dt;
+    if(dt != dt_old)
+        init_diagonals_ul();
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_karniadakis_fd_t<T, allocator> :: set_state(const std::vector<T>& state)
+{
+    if(state.size() != 3)
+        throw config_error(std::string("integrator_karniadakis_fd_t: set_state expects the sizes of 3 time steps"));
+    // Shift in the step sizes from the oldest one. This updates the diagonals if needed.
+    set_deltat(state[2]);
+    set_deltat(state[1]);
+    set_deltat(state[0]);
 }
 
 
@@ -258,6 +781,7 @@ void integrator_karniadakis_fd_t<T, allocator> :: init_diagonals_ul()
     // ->  Lx = dx * (2 * nx - 1) as we have cut nx roughly in half
 
     const T rx{get_rx()};
+    const twodads::slab_layout_t geom_x{get_geom()};
     diag_l.apply([=] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
     {
         // CUBLAS requires the first element in the lower diagonal to be zero.
@@ -265,7 +789,7 @@ void integrator_karniadakis_fd_t<T, allocator> :: init_diagonals_ul()
         // MKL caller routine in solver as to skip the first element
         if(m == 0)
             return(0.0);
-        return(CuCmplx<T>{-1. * rx, 0.0});
+        return(CuCmplx<T>{-1. * rx * geom_x.get_d2dx2_lower(m), 0.0});
     }, 0);
 
     diag_u.apply([=] LAMBDACALLER (CuCmplx<T> dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> CuCmplx<T>
@@ -274,7 +798,7 @@ void integrator_karniadakis_fd_t<T, allocator> :: init_diagonals_ul()
         // The MKL solver doesn't care about the last element.
         if(m == geom.get_my() - 1)
             return(0.0);  
-        return(CuCmplx<T>{-1. * rx, 0.0});  
+        return(CuCmplx<T>{-1. * rx * geom_x.get_d2dx2_upper(m), 0.0});  
     }, 0);
 }
 
@@ -304,142 +828,512 @@ void integrator_karniadakis_fd_t<T, allocator> :: integrate(cuda_array_bc_nogp<T
                                                          const size_t t_src1, const size_t t_src2, const size_t t_src3, 
                                                          const size_t t_dst, const size_t order) 
 {
+    integrate_batch({&field}, {&explicit_part}, t_src1, t_src2, t_src3, t_dst, order);
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_karniadakis_fd_t<T, allocator> :: integrate_batch(const std::vector<cuda_array_bc_nogp<T, allocator>*>& fields,
+                                                               const std::vector<const cuda_array_bc_nogp<T, allocator>*>& explicit_parts,
+                                                               const size_t t_src1, const size_t t_src2, const size_t t_src3, 
+                                                               const size_t t_dst, const size_t order) 
+{
+    PROFILE_SCOPE("integrator_karniadakis_fd_t::integrate_batch", fields.size() * (2 * order + 1) * get_geom().get_nelem_per_t() * sizeof(T));
     // Set up the data for time integrations:
     // Sum up the implicit and explicit terms into t_dst 
     // Fourier transform the sum
     // Add boundary terms to ky=0 mode for n=0, Nx-1
-    // Call tridiagonal solver
+    // Call tridiagonal solver for all fields
     // Return result in Fourier space
 
-    //std::cout << "integrate, order = " << order << "\tt_src1 = " << t_src1 << "\tt_src2 = " << t_src2;
-    //std::cout << "\tt_src3 = " << t_src3 << "\tt_dst = " << t_dst << std::endl;
+    assert(fields.size() == explicit_parts.size());
+    assert(order > 0 && order < 4);
+
+    // Coefficients of the explicit combination. The lambdas capture the arrays by value, [=] capture.
+    const size_t t_src[3] = {t_src1, t_src2, t_src3};
+    T alpha_v[4];
+    T beta_v[3];
+    twodads::stiff_coeffs(order, deltat, alpha_v, beta_v);
+    T alpha_k[3] = {0.0, 0.0, 0.0};
+    T beta_dt_k[3] = {0.0, 0.0, 0.0};
+    for(size_t k = 0; k < order; k++)
+    {
+        alpha_k[k] = alpha_v[k + 1];
+        beta_dt_k[k] = beta_v[k] * get_deltat();
+    }
 
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        cuda_array_bc_nogp<T, allocator>& field = *fields[f];
+        const cuda_array_bc_nogp<T, allocator>& explicit_part = *explicit_parts[f];
 
-    // In the following we define local constants for the coefficients such that the
-    // __device__ lambdas can capture them by value, [=] capture.
-    // They are stored in a host array, which __device__ functions cannot capture by value yet :/
+        // Pointers to u^{-k} and N^{-k}, k = 1..order. The data of the explicit part is at t_src - 1.
+        const T* u_k[3] = {nullptr, nullptr, nullptr};
+        const T* n_k[3] = {nullptr, nullptr, nullptr};
+        for(size_t k = 0; k < order; k++)
+        {
+            assert(field.is_transformed(t_src[k]) == false);
+            assert(explicit_part.is_transformed(t_src[k] - 1) == false);
+            u_k[k] = field.get_tlev_ptr(t_src[k]);
+            n_k[k] = explicit_part.get_tlev_ptr(t_src[k] - 1);
+        }
 
-    if(order == 1)
-    {
-        assert(field.is_transformed(t_src1) == false);
-        assert(explicit_part.is_transformed(t_dst) == false);
-        // Initialize the main diagonal for first order time step
-        if(get_diag_order() != 1) 
-            init_diagonal(1, field.get_bvals().get_bc_left(), field.get_bvals().get_bc_right());
+        // u^{0} = sum_k alpha_k u^{-k} + dt beta_k N^{-k} in a single pass
+        field.set_transformed(t_dst, false);
+        field.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            const size_t index{n * (geom.get_my() + geom.get_pad_y()) + m};
+            T result{0.0};
+            for(size_t k = 0; k < order; k++)
+                result += alpha_k[k] * u_k[k][index] + beta_dt_k[k] * n_k[k][index];
+            return(result);
+        }, t_dst);
+    }
 
-        const T alpha1{twodads::alpha[0][1]}; // 1.0
-        const T beta1_dt{twodads::beta[0][0] * get_tint_params().get_deltat()}; // 1.0 dt
+    solve_implicit(fields, t_dst, order);
+}
 
-        // u^{0} = alpha_1 u^{-1}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(rhs * alpha1);}, t_dst, t_src1);
 
-        // u^{0} += beta_1 N^{-1}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T{return(lhs + rhs * beta1_dt);}, explicit_part, t_dst, t_src1 - 1);
+template <typename T, template<typename> class allocator>
+void integrator_karniadakis_fd_t<T, allocator> :: solve_implicit(const std::vector<cuda_array_bc_nogp<T, allocator>*>& fields,
+                                                                 const size_t t_dst, const size_t order)
+{
+    PROFILE_SCOPE("integrator_karniadakis_fd_t::solve_implicit", fields.size() * 2 * get_geom().get_nelem_per_t() * sizeof(T));
+    assert(order > 0 && order < 4);
 
+    // All fields share the linear system. It depends on the boundary conditions
+    for(auto field : fields)
+    {
+        if(field -> get_bvals().get_bc_left() != fields.front() -> get_bvals().get_bc_left() ||
+           field -> get_bvals().get_bc_right() != fields.front() -> get_bvals().get_bc_right())
+            throw not_implemented_error(std::string("integrate_batch: All fields need to have the same boundary conditions"));
     }
-    else if(order == 2)
+
+    // Initialize the main diagonal for the time step of this order
+    if(!is_diag_valid(order)) 
+        init_diagonal(order, fields.front() -> get_bvals().get_bc_left(), fields.front() -> get_bvals().get_bc_right());
+
+    for(auto field_ptr : fields)
     {
-        // Initialize main diagonal for second order time step
-        if(get_diag_order() != 2) 
-            init_diagonal(2, field.get_bvals().get_bc_left(), field.get_bvals().get_bc_right());
+        cuda_array_bc_nogp<T, allocator>& field = *field_ptr;
+        assert(field.is_transformed(t_dst) == false);
+
+        (*myfft).dft_r2c(field.get_tlev_ptr(t_dst), reinterpret_cast<CuCmplx<T>*>(field.get_tlev_ptr(t_dst)));
+        field.set_transformed(t_dst, true);
+
+        // Treat the boundary conditions
+        // Real part of the Fourier transform of the left boundary value
+        const T bval_left_hat{field.get_bvals().get_bv_left() * static_cast<T>(field.get_my())};
+        // Real part of the Fourier transform of the right boundary value
+        const T bval_right_hat{field.get_bvals().get_bv_right() * static_cast<T>(field.get_my())};
+
+        // This is the value we later add to the ky=0 mode in the n=0 row
+        T add_to_boundary_left{0.0};
+        // This is the value we later add to the ky=0 mode in the n=Nx-1 row
+        T add_to_boundary_right{0.0};
+        switch(field.get_bvals().get_bc_left())
+        {
+            case twodads::bc_t::bc_dirichlet:
+                add_to_boundary_left = bval_left_hat * get_rx() * 2.0 * get_geom().get_d2dx2_lower(0);
+                break;
+            case twodads::bc_t::bc_neumann:
+                add_to_boundary_left = -1.0 * bval_left_hat * get_rx() * field.get_geom().get_deltax() * get_geom().get_dxds(0.0) * get_geom().get_d2dx2_lower(0);
+                break;
+            case twodads::bc_t::bc_null:
+                // Edge of a subdomain, no boundary term
+                break;
+            case twodads::bc_t::bc_periodic:
+            default:
+                throw not_implemented_error(std::string("Periodic boundary conditions not supported by this integrator"));
+                //break; 
+        }
 
-        // Sum up previous time steps in t_dst:
-        const T alpha1{twodads::alpha[1][1]}; // 2
-        const T alpha2{twodads::alpha[1][2]}; // -1/2
-        
-        const T beta1_dt{twodads::beta[1][0] * get_tint_params().get_deltat()}; // 2 dt
-        const T beta2_dt{twodads::beta[1][1] * get_tint_params().get_deltat()}; // -1 dt
+        switch(field.get_bvals().get_bc_right())
+        {
+            case twodads::bc_t::bc_dirichlet:
+                add_to_boundary_right = bval_right_hat * get_rx() * 2.0 * get_geom().get_d2dx2_upper(get_geom().get_nx() - 1);
+                break;
+            case twodads::bc_t::bc_neumann:
+                add_to_boundary_right = bval_right_hat * get_rx() * field.get_geom().get_deltax() * get_geom().get_dxds(0.0) * get_geom().get_d2dx2_upper(get_geom().get_nx() - 1);
+                break;
+            case twodads::bc_t::bc_null:
+                // Edge of a subdomain, no boundary term
+                break;
+            case twodads::bc_t::bc_periodic:
+            default:
+                throw not_implemented_error(std::string("Periodic boundary conditions not supported by this integrator"));
+                //break;         
+        }
+        // Add boundary terms, i.e. the real part of the fourier transform. (field is defined as T->twodads::real_t)
+        field.apply([=] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            return(input + add_to_boundary_left);
+        }, twodads::region_t::elem(0, 0), t_dst);
+        field.apply([=] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            return(input + add_to_boundary_right);
+        }, twodads::region_t::elem(field.get_geom().get_nx() - 1, 0), t_dst);
 
-        // u^{0} = alpha_2 * u^{-2}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T { return(rhs * alpha2);}, t_dst, t_src2);
-        // u^{0} += alpha_1 * u^{-1}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T { return(lhs + rhs * alpha1);}, t_dst, t_src1);
-        // u^{0} += dt * beta_2 * N^{-2}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T{return(lhs + rhs * beta2_dt);}, explicit_part, t_dst, t_src2 - 1);
-        // u^{0} += dt * beta_1 * N^{-1}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T{return(lhs + rhs * beta1_dt);}, explicit_part, t_dst, t_src1 - 1);
+        // The hyperviscosity acts on u - u_b. Add dt hv (-d^2/dx^2)^p u_b to the ky=0 mode.
+        // hv_solver is only created on the host, where the data can be accessed directly.
+        if(hv_solver != nullptr)
+        {
+            const T* lift{get_hv_lift(field.get_bvals())};
+            const T dt_hv{get_deltat() * get_tint_params().get_hv()};
+            const size_t stride{field.get_geom().get_my() + field.get_geom().get_pad_y()};
+            T* u_hat{field.get_tlev_ptr(t_dst)};
+            for(size_t n = 0; n < get_geom().get_nx(); n++)
+                u_hat[n * stride] += dt_hv * lift[n];
+        }
     }
 
-    else if (order == 3)
-    {   
-        if(get_diag_order() != 3) 
-            init_diagonal(3, field.get_bvals().get_bc_left(), field.get_bvals().get_bc_right());
+    // Solve the linear system for all fields at once. Resizing to the same number of fields does not allocate.
+    batch_rhs.resize(fields.size());
+    for(size_t k = 0; k < fields.size(); k++)
+        batch_rhs[k] = reinterpret_cast<CuCmplx<T>*>(fields[k] -> get_tlev_ptr(t_dst));
+    if(hv_solver != nullptr)
+    {
+        hv_solver -> solve_batch(batch_rhs.data(), batch_rhs.size());
+    }
+    else
+    {
+        detail :: impl_solve_tridiagonal_batch(batch_rhs.data(), batch_rhs.size(), get_diag_u(), get_diag(), get_diag_l(), get_ell_solver(), allocator<T>{});
+    }
+}
 
-        // Sum up previous time steps in t_dst:
-        const T alpha1{twodads::alpha[2][1]}; // 3
-        const T alpha2{twodads::alpha[2][2]}; // -3/2
-        const T alpha3{twodads::alpha[2][3]}; // 1/3
-        
-        const T beta1_dt{twodads::beta[2][0] * get_tint_params().get_deltat()}; // 3
-        const T beta2_dt{twodads::beta[2][1] * get_tint_params().get_deltat()}; // -3
-        const T beta3_dt{twodads::beta[2][2] * get_tint_params().get_deltat()}; // 1
-        
-        // u^{0} = alpha_3 * u^{-3}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T { return(rhs * alpha3);}, t_dst, t_src3);
-        // u^{0} += alpha_2 * u^{-2}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T { return(lhs + rhs * alpha2);}, t_dst, t_src2);        
-        // u^{0} += alpha_1 * u^{-1}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T { return(lhs + rhs * alpha1);}, t_dst, t_src1);
-        // u^{0} += dt * beta_3 * N^{-3}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T{ return(lhs + rhs * beta3_dt);}, explicit_part, t_dst, t_src3 - 1);
-        // u^{0} += dt * beta_2 * N^{-2}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T{ return(lhs + rhs * beta2_dt);}, explicit_part, t_dst, t_src2 - 1);
-        // u^{0} += dt * beta_1 * N^{-1}
-        field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T{ return(lhs + rhs * beta1_dt);}, explicit_part, t_dst, t_src1 - 1);
-    }
-
-    (*myfft).dft_r2c(field.get_tlev_ptr(t_dst), reinterpret_cast<CuCmplx<T>*>(field.get_tlev_ptr(t_dst)));
-    field.set_transformed(t_dst, true);
-
-    // Treat the boundary conditions
-    // Real part of the Fourier transform of the left boundary value
-    const T bval_left_hat{field.get_bvals().get_bv_left() * static_cast<T>(field.get_my())};
-    // Real part of the Fourier transform of the right boundary value
-    const T bval_right_hat{field.get_bvals().get_bv_right() * static_cast<T>(field.get_my())};
-
-    // This is the value we later add to the ky=0 mode in the n=0 row
-    T add_to_boundary_left{0.0};
-    // This is the value we later add to the ky=0 mode in the n=Nx-1 row
-    T add_to_boundary_right{0.0};
-    switch(field.get_bvals().get_bc_left())
+
+// Additive Runge-Kutta IMEX scheme for finite-difference / semi-spectral methods. Sub-class of integrator
+template <typename T, template<typename> class allocator>
+class integrator_ark_fd_t : public integrator_base_t<T, allocator>
+{
+    /**
+     .. cpp:class:: template<typename T, template<typename> class allocator> integrator_ark_fd_t : public integrator_base_t<T, allocator>
+
+      Implements the additive Runge-Kutta scheme ARK3(2)4L[2]SA by Kennedy and Carpenter, Appl. Numer. Math. 44, 139 (2003),
+      using finite-difference / semi-spectral methods. The diffusion is treated by the L-stable, singly diagonally implicit
+      part of the tableau, the explicit part by the explicit part of the tableau. Each implicit stage solves the linear system 
+      of a first order Karniadakis step with step size gamma * dt.
+
+      The scheme is single-step and third order accurate from the first step. It only implements integrate_stages.
+      An embedded second order solution gives an estimate of the local error.
+
+    */
+    public:
+        using arr_t = cuda_array_bc_nogp<T, allocator>;
+        using rhs_func_t = typename integrator_base_t<T, allocator>::rhs_func_t;
+#ifdef DEVICE
+        using dft_t = cufft_object_t<T>;
+#endif // DEVICE
+
+#ifdef HOST
+        using dft_t = fftw_object_t<T>;
+#endif // HOST
+
+        /**
+         .. cpp:function:: integrator_ark_fd_t(const twodads::slab_layout_t& sl, const twodads::bvals_t<T>& bv, const twodads::stiff_params_t& sp, const twodads::solver_t solver)
+
+         :param const twodads::slab_layout_t& sl: Layout of the real fields
+         :param const twodads::bvals_t<T>& bv: Boundary conditions of the integrated fields
+         :param const twodads::stiff_params_t& sp: Parameters of the time integration
+         :param const twodads::solver_t solver: Solver for the implicit stages. Defaults to the tridiagonal solver.
+
+        */
+        integrator_ark_fd_t(const twodads::slab_layout_t& _sl, const twodads::bvals_t<T>& _bv, const twodads::stiff_params_t& _sp,
+                            const twodads::solver_t _solver = twodads::solver_t::solver_tridiag) :
+            geom{_sl}, bvals{_bv}, stiff_params{_sp},
+            deltat{_sp.get_deltat()},
+            err_est{0.0},
+            a_expl{{T(0.0), T(0.0), T(0.0), T(0.0)},
+                   {T(1767732205903.0) / T(2027836641118.0), T(0.0), T(0.0), T(0.0)},
+                   {T(5535828885825.0) / T(10492691773637.0), T(788022342437.0) / T(10882634858940.0), T(0.0), T(0.0)},
+                   {T(6485989280629.0) / T(16251701735622.0), T(-4246266847089.0) / T(9704473918619.0), T(10755448449292.0) / T(10357097424841.0), T(0.0)}},
+            a_impl{{T(0.0), T(0.0), T(0.0), T(0.0)},
+                   {T(1767732205903.0) / T(4055673282236.0), T(1767732205903.0) / T(4055673282236.0), T(0.0), T(0.0)},
+                   {T(2746238789719.0) / T(10658868560708.0), T(-640167445237.0) / T(6845629431997.0), T(1767732205903.0) / T(4055673282236.0), T(0.0)},
+                   {T(1471266399579.0) / T(7840856788654.0), T(-4482444167858.0) / T(7529755066697.0), T(11266239266428.0) / T(11593286722821.0), T(1767732205903.0) / T(4055673282236.0)}},
+            b_hat{T(2756255671327.0) / T(12835298489170.0), T(-10771552573575.0) / T(22201958757719.0), 
+                  T(9247589265047.0) / T(10645013368117.0), T(2193209047091.0) / T(5459859503100.0)},
+            myfft{new dft_t(get_geom(), twodads::dft_t::dft_1d)},
+            // Implicit stages solve (1 - gamma dt L) U = r, a first order step of size gamma * dt
+            imp_solver(_sl, _bv, 
+                       twodads::stiff_params_t(get_gamma() * _sp.get_deltat(), _sp.get_lengthx(), _sp.get_lengthy(), _sp.get_diff(), _sp.get_hv(), 
+                                               _sp.get_my(), _sp.get_nx21(), _sp.get_tlevs(), _sp.get_hv_order()),
+                       _solver)
+        {
+        }
+
+        ~integrator_ark_fd_t()
+        {
+            for(auto it : stages)
+                delete it;
+            delete myfft;
+        }
+
+        // Multi-step interface, not implemented
+        void integrate(arr_t&, const arr_t&, const size_t, const size_t, const size_t, const size_t, const size_t)
+        {
+            throw not_implemented_error(std::string("integrator_ark_fd_t: Use integrate_stages"));
+        }
+
+        void integrate_stages(const std::vector<arr_t*>&, const size_t, const size_t, const rhs_func_t&);
+
+        // Changing the step size changes the linear system of the implicit stages
+        void set_deltat(const T dt)
+        {
+            if(dt != get_deltat())
+            {
+                deltat = dt;
+                imp_solver.set_deltat(get_gamma() * dt);
+            }
+        }
+        inline T get_deltat() const {return(deltat);};
+
+        // Maximum norm of the difference between the third and the embedded second order solution of the last step. 
+        // Zero before the first step.
+        inline T get_error_estimate() const {return(err_est);};
+
+        // The state is the step size and the error estimate of the last step
+        void get_state(std::vector<T>& state) const {state.assign({deltat, err_est});};
+        void set_state(const std::vector<T>& state)
+        {
+            if(state.size() != 2)
+                throw config_error(std::string("integrator_ark_fd_t: set_state expects the step size and the error estimate"));
+            set_deltat(state[0]);
+            err_est = state[1];
+        }
+
+        // Computes dt * L u = dt * (diff * nabla^2 - hv * (-nabla^2)^p) u, with u given by src at t_src, in the discretization of the implicit stages. 
+        // The result is written to dst at t_dst in real space, dst at t_tmp is used for the Fourier transformation of u.
+        // It should really be private, but then nvcc complains about the __device__ lambdas
+        void apply_diffusion(const arr_t&, const size_t, arr_t&, const size_t, const size_t);
+
+        // Adds the stage j, with dt N(U_j) at s_n and dt L(U_j) at t_l of stage, to the running sums in stage.
+        // For j = 0 the sums are initialized with u, given by src at t_src. Public for the same reason as apply_diffusion.
+        void add_stage(const arr_t&, const size_t, arr_t&, const size_t, const size_t);
+
+        // Diagonal coefficient of the implicit stages
+        inline T get_gamma() const {return(T(1767732205903.0) / T(4055673282236.0));};
+
+        inline twodads::slab_layout_t get_geom() const {return(geom);};
+        inline twodads::bvals_t<T> get_bvals() const {return(bvals);};
+        inline twodads::stiff_params_t get_tint_params() const {return(stiff_params);};
+
+    private:
+        // Number of stages of the scheme
+        static constexpr size_t num_rk{4};
+        // Time indices in the stage arrays. The stages are not stored, only the running sums over the
+        // stages that are needed later: the right hand sides of the remaining implicit stages, the
+        // solution, and the difference to the embedded solution.
+        static constexpr size_t s_u{0};     // Stage value U_i, right hand side of the linear system
+        static constexpr size_t s_n{1};     // Explicit part N(U_i) of the current stage
+        static constexpr size_t s_r{2};     // Right hand side r_i at s_r + i - 1, i = 1..3. Holds dt L(U_i) once U_i is known
+        static constexpr size_t s_sol{5};   // Solution
+        static constexpr size_t s_err{6};   // Difference to the embedded solution
+        static constexpr size_t num_stages{7};
+
+        const twodads::slab_layout_t geom;
+        const twodads::bvals_t<twodads::real_t> bvals;
+        const twodads::stiff_params_t stiff_params;
+        T deltat;
+        T err_est;
+
+        // Butcher tableaus. The weights of the third order solution are the last row of a_impl.
+        const T a_expl[4][4];
+        const T a_impl[4][4];
+        const T b_hat[4];
+
+        dft_t* myfft;
+        integrator_karniadakis_fd_t<T, allocator> imp_solver;
+        // Stage storage, one array for each field. Allocated on first use.
+        std::vector<arr_t*> stages;
+        // The stages passed to rhs_func, one for each field
+        std::vector<arr_t*> stage_vec;
+};
+
+
+template <typename T, template<typename> class allocator>
+void integrator_ark_fd_t<T, allocator> :: apply_diffusion(const arr_t& src, const size_t t_src, arr_t& dst, const size_t t_tmp, const size_t t_dst)
+{
+    PROFILE_SCOPE("integrator_ark_fd_t::apply_diffusion", 3 * get_geom().get_nelem_per_t() * sizeof(T));
+    // Use the same boundary terms as the linear system, see integrator_karniadakis_fd_t :: init_diagonal
+    // and integrate_batch. The ghost point outside the domain is
+    // u_{-1} = 2 u_b - u_0 for Dirichlet and u_{-1} = u_0 - dx u_b' for Neumann boundary conditions,
+    // with dx the grid spacing at the boundary. Boundary values are added to the real part of the ky=0 mode only.
+    const T rx{get_tint_params().get_diff() * get_deltat() / (get_geom().get_deltax() * get_geom().get_deltax())};
+    const T diff_dt{get_tint_params().get_diff() * get_deltat()};
+    const T bval_left_hat{src.get_bvals().get_bv_left() * static_cast<T>(get_geom().get_my())};
+    const T bval_right_hat{src.get_bvals().get_bv_right() * static_cast<T>(get_geom().get_my())};
+    // u_{-1} = g_left * u_0 + add_left, u_{Nx} = g_right * u_{Nx-1} + add_right
+    T g_left{0.0};
+    T g_right{0.0};
+    T add_left{0.0};
+    T add_right{0.0};
+
+    switch(src.get_bvals().get_bc_left())
     {
         case twodads::bc_t::bc_dirichlet:
-            add_to_boundary_left = bval_left_hat * get_rx() * 2.0;
+            g_left = T(-1.0);
+            add_left = 2.0 * bval_left_hat;
             break;
         case twodads::bc_t::bc_neumann:
-            add_to_boundary_left = -1.0 * bval_left_hat * get_rx() * field.get_geom().get_deltax();
+            g_left = T(1.0);
+            add_left = -1.0 * bval_left_hat * get_geom().get_deltax() * get_geom().get_dxds(0.0);
             break;
         case twodads::bc_t::bc_periodic:
         default:
             throw not_implemented_error(std::string("Periodic boundary conditions not supported by this integrator"));
-            //break; 
     }
 
-    switch(field.get_bvals().get_bc_right())
+    switch(src.get_bvals().get_bc_right())
     {
         case twodads::bc_t::bc_dirichlet:
-            add_to_boundary_right = bval_right_hat * get_rx() * 2.0;
+            g_right = T(-1.0);
+            add_right = 2.0 * bval_right_hat;
             break;
         case twodads::bc_t::bc_neumann:
-            add_to_boundary_right = bval_right_hat * get_rx() * field.get_geom().get_deltax();
+            g_right = T(1.0);
+            add_right = bval_right_hat * get_geom().get_deltax() * get_geom().get_dxds(0.0);
             break;
         case twodads::bc_t::bc_periodic:
         default:
             throw not_implemented_error(std::string("Periodic boundary conditions not supported by this integrator"));
-            //break;         
     }
-    // Add boundary terms, i.e. the real part of the fourier transform. (field is defined as T->twodads::real_t)
-    field.apply([=] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+
+    assert(src.is_transformed(t_src) == false);
+    dst.copy(t_tmp, src, t_src);
+    (*myfft).dft_r2c(dst.get_tlev_ptr(t_tmp), reinterpret_cast<CuCmplx<T>*>(dst.get_tlev_ptr(t_tmp)));
+    dst.set_transformed(t_tmp, true);
+
+    // Real and imaginary part of each mode are treated alike, ky = 2 pi (m / 2) / Ly. Ly as in init_diagonal.
+    const T* u_hat{dst.get_tlev_ptr(t_tmp)};
+    dst.set_transformed(t_dst, true);
+    dst.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
     {
-        if(n == 0  && m == 0)
-            return(input + add_to_boundary_left);
-        else if(n == geom.get_nx() - 1 && m == 0)
-            return(input + add_to_boundary_right);
-        else
-            return(input);
+        const size_t stride{geom.get_my() + geom.get_pad_y()};
+        const T Ly{geom.get_deltay() * T(2 * (stride / 2 - 1))};
+        const T ky{twodads::TWOPI * T(m / 2) / Ly};
+        const T u_0{u_hat[n * stride + m]};
+        const T u_l{n == 0 ? g_left * u_0 + (m == 0 ? add_left : T(0.0)) : u_hat[(n - 1) * stride + m]};
+        const T u_r{n == geom.get_nx() - 1 ? g_right * u_0 + (m == 0 ? add_right : T(0.0)) : u_hat[(n + 1) * stride + m]};
+        return(rx * (geom.get_d2dx2_lower(n) * u_l + geom.get_d2dx2_center(n) * u_0 + geom.get_d2dx2_upper(n) * u_r) - diff_dt * ky * ky * u_0);
     }, t_dst);
 
-    detail :: impl_solve_tridiagonal(field, get_diag_u(), get_diag(), get_diag_l(), t_dst, get_ell_solver(), allocator<T>{});
+    if(get_tint_params().get_hv() != 0.0)
+        imp_solver.apply_hypervisc(u_hat, dst.get_tlev_ptr(t_dst), -get_deltat() * get_tint_params().get_hv(), src.get_bvals());
+
+    (*myfft).dft_c2r(reinterpret_cast<CuCmplx<T>*>(dst.get_tlev_ptr(t_dst)), dst.get_tlev_ptr(t_dst));
+    utility :: normalize(dst, t_dst);
+    dst.set_transformed(t_dst, false);
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_ark_fd_t<T, allocator> :: add_stage(const arr_t& src, const size_t t_src, arr_t& stage, const size_t j, const size_t t_l)
+{
+    const T* u{src.get_tlev_ptr(t_src)};
+    const T* n_j{stage.get_tlev_ptr(s_n)};
+    const T* l_j{stage.get_tlev_ptr(t_l)};
+    const T dt{get_deltat()};
+    const bool first{j == 0};
+
+    // Right hand sides of the remaining implicit stages, r_i += dt a_expl[i][j] N(U_j) + a_impl[i][j] dt L(U_j)
+    for(size_t i = j + 1; i < num_rk; i++)
+    {
+        const T dt_a_expl{dt * a_expl[i][j]};
+        const T a_impl_ij{a_impl[i][j]};
+        stage.set_transformed(s_r + i - 1, false);
+        stage.apply([=] LAMBDACALLER (T r_i, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+            return((first ? u[idx] : r_i) + (dt_a_expl * n_j[idx] + a_impl_ij * l_j[idx]));
+        }, s_r + i - 1);
+    }
+
+    // Solution and difference to the embedded solution
+    const T b{a_impl[num_rk - 1][j]};
+    const T dt_b{dt * b};
+    const T b_err{b - b_hat[j]};
+    const T dt_b_err{dt * b_err};
+    stage.set_transformed(s_sol, false);
+    stage.apply([=] LAMBDACALLER (T sol, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+    {
+        const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+        return((first ? u[idx] : sol) + (dt_b * n_j[idx] + b * l_j[idx]));
+    }, s_sol);
+    stage.set_transformed(s_err, false);
+    stage.apply([=] LAMBDACALLER (T err, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+    {
+        const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+        return((first ? T(0.0) : err) + (dt_b_err * n_j[idx] + b_err * l_j[idx]));
+    }, s_err);
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_ark_fd_t<T, allocator> :: integrate_stages(const std::vector<arr_t*>& fields,
+                                                          const size_t t_src, const size_t t_dst,
+                                                          const rhs_func_t& rhs_func)
+{
+    // Includes the time spent in rhs_func
+    PROFILE_SCOPE("integrator_ark_fd_t::integrate_stages", fields.size() * 2 * get_geom().get_nelem_per_t() * sizeof(T));
+    // Stages of the scheme, N denotes the explicit part and L = diff nabla^2 - hv (-nabla^2)^p:
+    // U_1 = u
+    // U_i = u + dt sum_{j<i} (a_expl[i][j] N(U_j) + a_impl[i][j] L(U_j)) + dt gamma L(U_i),   i = 2..4
+    // u(t + dt) = u + dt sum_j b_j (N(U_j) + L(U_j)),   b_j = a_impl[3][j]
+    // The right hand side r_i of the linear system for U_i is kept, so that dt L(U_i) = (U_i - r_i) / gamma
+    // does not need to be computed explicitly.
+    // Once N(U_j) and L(U_j) are known, they are added to the sums for r_i, i > j, the solution, and the
+    // error estimate, in the order of the stages. This needs 7 instead of 2 * 4 + 1 arrays per field.
+    for(size_t f = stages.size(); f < fields.size(); f++)
+    {
+        stages.push_back(new arr_t(get_geom(), fields[f] -> get_bvals(), num_stages));
+        stages.back() -> set_tag("integrator_ark_fd_t", "stages");
+    }
+    if(stage_vec.size() != fields.size())
+        stage_vec.assign(stages.begin(), stages.begin() + fields.size());
+
+    const T gamma{get_gamma()};
+
+    for(auto it : fields)
+        assert(it -> is_transformed(t_src) == false);
+
+    // First stage, U_1 = u. dt L(u) is stored at s_u, s_r is free to be used for the transformation.
+    rhs_func(fields, t_src, stage_vec, s_n);
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        apply_diffusion(*fields[f], t_src, *stages[f], s_r, s_u);
+        add_stage(*fields[f], t_src, *stages[f], 0, s_u);
+    }
+
+    for(size_t i = 1; i < num_rk; i++)
+    {
+        const size_t s_r_i{s_r + i - 1};
+        for(size_t f = 0; f < fields.size(); f++)
+            stages[f] -> copy(s_u, s_r_i);
+
+        // Solve (1 - gamma dt L) U_i = r_i for all fields and transform U_i back to real space
+        imp_solver.solve_implicit(stage_vec, s_u, 1);
+        for(size_t f = 0; f < fields.size(); f++)
+        {
+            (*myfft).dft_c2r(reinterpret_cast<CuCmplx<T>*>(stages[f] -> get_tlev_ptr(s_u)), stages[f] -> get_tlev_ptr(s_u));
+            utility :: normalize(*stages[f], s_u);
+            stages[f] -> set_transformed(s_u, false);
+
+            // dt L(U_i) = (U_i - r_i) / gamma
+            stages[f] -> elementwise([=] LAMBDACALLER (T lhs, T rhs) -> T {return((rhs - lhs) / gamma);}, s_r_i, s_u);
+        }
+
+        rhs_func(stage_vec, s_u, stage_vec, s_n);
+        for(size_t f = 0; f < fields.size(); f++)
+            add_stage(*fields[f], t_src, *stages[f], i, s_r_i);
+    }
+
+    err_est = T(0.0);
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        err_est = std::max(err_est, utility :: max_abs(*stages[f], s_err));
+        fields[f] -> copy(t_dst, *stages[f], s_sol);
+    }
 }
 
 
@@ -459,9 +1353,11 @@ class integrator_karniadakis_bs_t : public integrator_base_t<T, allocator>
                                     const twodads::bvals_t<T>& _bv,
                                     const twodads::stiff_params_t& _sp) :
             geom{_sl}, bvals{_bv}, stiff_params{_sp},
+            deltat{_sp.get_deltat(), _sp.get_deltat(), _sp.get_deltat()},
             k2_map(get_geom(), twodads::bvals_t<T>(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, T(0.0), T(0.0)), 1)
         {
             k2_map.set_transformed(0, true);
+            k2_map.set_tag("integrator_karniadakis_bs_t", "k2_map");
             init_k2_map();
         }
 
@@ -470,6 +1366,25 @@ class integrator_karniadakis_bs_t : public integrator_base_t<T, allocator>
                     const size_t, const size_t, const size_t,
                     const size_t, const size_t);
 
+        void set_deltat(const T dt) 
+        {
+            deltat[2] = deltat[1];
+            deltat[1] = deltat[0];
+            deltat[0] = dt;
+        }
+        inline T get_deltat() const {return(deltat[0]);};
+
+        // The state are the sizes of the current and the two previous time steps
+        void get_state(std::vector<T>& state) const {state.assign({deltat[0], deltat[1], deltat[2]});};
+        void set_state(const std::vector<T>& state)
+        {
+            if(state.size() != 3)
+                throw config_error(std::string("integrator_karniadakis_bs_t: set_state expects the sizes of 3 time steps"));
+            deltat[0] = state[0];
+            deltat[1] = state[1];
+            deltat[2] = state[2];
+        }
+
         void init_k2_map();
         const cuda_array_bc_nogp<T, allocator>& get_k2_map() const {return(k2_map);};
 
@@ -481,6 +1396,8 @@ class integrator_karniadakis_bs_t : public integrator_base_t<T, allocator>
         const twodads::slab_layout_t geom;
         const twodads::bvals_t<twodads::real_t> bvals;
         const twodads::stiff_params_t stiff_params; 
+        // Size of the current and the two previous time steps
+        T deltat[3];
         cuda_array_bc_nogp<T, allocator> k2_map;
 };
 
@@ -488,16 +1405,7 @@ class integrator_karniadakis_bs_t : public integrator_base_t<T, allocator>
 template<typename T, template<typename> class allocator>
 void integrator_karniadakis_bs_t<T, allocator> :: init_k2_map()
 {
-    // Set both real and imaginary value to k^2. 
-    // slab_bc instantiates the integrator as T = twodads::real_t
-    // ky modes are aligned in memory, ky(m=0), ky(m=0), ky(m=1), ky(m=2), ...
-    // count ky modes by (m - (m%2))/2, m = 0...My/2+1
-    k2_map.apply([] LAMBDACALLER (T input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
-                  {
-                    const T kx{twodads::TWOPI * ( (n < geom.get_nx() / 2 + 1) ? T(n) : (T(n) - T(geom.get_nx())) ) / geom.get_Lx()};
-                    const T ky{twodads::TWOPI * T(m - (m % 2)) * 0.5 / geom.get_Ly()};
-                    return(kx * kx + ky * ky);
-                  }, 0);
+    detail :: impl_init_k2_map(k2_map);
 }
 
 
@@ -507,6 +1415,7 @@ void integrator_karniadakis_bs_t<T, allocator> :: integrate(cuda_array_bc_nogp<T
                                                             const size_t t_src1, const size_t t_src2, const size_t t_src3,
                                                             const size_t t_dst, const size_t order)
 {
+    PROFILE_SCOPE("integrator_karniadakis_bs_t::integrate", (2 * order + 1) * get_geom().get_nelem_per_t() * sizeof(T));
     // Set up the data for time integration:
     // Sum up the implicit and explicit terms into t_dst.
     // Assert that all previous implicit and explicit terms are transformed 
@@ -517,7 +1426,22 @@ void integrator_karniadakis_bs_t<T, allocator> :: integrate(cuda_array_bc_nogp<T
     assert(get_k2_map().is_transformed(0));
 
     const T diff{get_tint_params().get_diff()};
-    const T dt{get_tint_params().get_deltat()};
+    const T hv{get_tint_params().get_hv()};
+    const size_t hv_order{get_tint_params().get_hv_order()};
+    const T dt{get_deltat()};
+
+    // Coefficients for the current step sizes. Copy them to local constants for [=] capture
+    T alpha_v[4] = {0.0, 0.0, 0.0, 0.0};
+    T beta_v[3] = {0.0, 0.0, 0.0};
+    if(order > 0 && order < 4)
+        twodads::stiff_coeffs(order, deltat, alpha_v, beta_v);
+    const T alpha0{alpha_v[0]};
+    const T alpha1{alpha_v[1]};
+    const T alpha2{alpha_v[2]};
+    const T alpha3{alpha_v[3]};
+    const T beta1{beta_v[0]};
+    const T beta2{beta_v[1]};
+    const T beta3{beta_v[2]};
 
     //std::cout << "integrate: order = " << order << ", t_src1 = " << t_src1 << ", t_src2 = " << t_src2 << ", t_src3 = " << t_src3 << ", t_dst = " << t_dst << std::endl;
 
@@ -530,17 +1454,17 @@ void integrator_karniadakis_bs_t<T, allocator> :: integrate(cuda_array_bc_nogp<T
             assert(get_k2_map().is_transformed(0));
     
             // u^{0} = alpha_1 u^{-1}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(rhs * twodads::alpha[order - 1][1]);}, 
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(rhs * alpha1);}, 
                               t_dst, t_src1);
 
             // u^{0} += beta_1 N^{-1}    
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::beta[order - 1][0] * dt);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * beta1 * dt);},
                               explicit_part, t_dst, t_src1 - 1);
-            //std::cout << "order = 1: beta = " << twodads::beta[order - 1][0] << std::endl;
+            //std::cout << "order = 1: beta = " << beta1 << std::endl;
             
-            // u^{0} /= (1.0 + dt * diff * k^2 )
+            // u^{0} /= (1.0 + dt * (diff * k^2 + hv * k^(2p)))
             field.elementwise([=] LAMBDACALLER (T lhs, T k2) -> T 
-                              { return(lhs / (twodads::alpha[order - 1][0] + dt * k2 * diff));},
+                              { return(lhs / (alpha0 + dt * k2 * diff + dt * hv * detail :: hv_power(k2, hv_order)));},
                               get_k2_map(), t_dst, 0);                       
             field.set_transformed(t_dst, true);
             break;
@@ -555,24 +1479,24 @@ void integrator_karniadakis_bs_t<T, allocator> :: integrate(cuda_array_bc_nogp<T
             assert(get_k2_map().is_transformed(0));
             
             // u^{0} = alpha_2 * u^{-2}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(rhs * twodads::alpha[order - 1][2]);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(rhs * alpha2);},
                               t_dst, t_src2);
             // u^{0} += alpha_1 * u^{-1}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::alpha[order - 1][1]);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * alpha1);},
                               t_dst, t_src1);
 
 
             // u^{0} += dt * beta_2 * N^{-2}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::beta[order - 1][1] * dt);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * beta2 * dt);},
                               explicit_part, t_dst, t_src2 - 1);
             // u^{0} += dt * beta_1 * N^{-1}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::beta[order - 1][0] * dt);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * beta1 * dt);},
                               explicit_part, t_dst, t_src1 - 1);
-            //std::cout << "order = 2: beta = " << twodads::beta[order - 1][1] << ", " << twodads::beta[order - 1][0] << std::endl;
+            //std::cout << "order = 2: beta = " << beta2 << ", " << beta1 << std::endl;
 
-            // u^{0} /= (1.5 + dt * diff * k^2)
+            // u^{0} /= (1.5 + dt * (diff * k^2 + hv * k^(2p)))
             field.elementwise([=] LAMBDACALLER (T lhs, T k2) -> T
-                            { return(lhs / (twodads::alpha[order - 1][0] + k2 * dt * diff));},
+                            { return(lhs / (alpha0 + k2 * dt * diff + dt * hv * detail :: hv_power(k2, hv_order)));},
                             get_k2_map(), t_dst, 0);
             field.set_transformed(t_dst, true);
             break;
@@ -588,29 +1512,29 @@ void integrator_karniadakis_bs_t<T, allocator> :: integrate(cuda_array_bc_nogp<T
 
             assert(get_k2_map().is_transformed(0));
             // u^{0} = alpha_3 * u^{-3}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(rhs * twodads::alpha[order - 1][3]);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(rhs * alpha3);},
                             t_dst, t_src3);
             // u^{0} = alpha_2 * u^{-2}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::alpha[order - 1][2]);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * alpha2);},
                             t_dst, t_src2);
             // u^{0} += alpha_1 * u^{-1}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::alpha[order - 1][1]);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * alpha1);},
                             t_dst, t_src1);
 
             // u^{0} += dt * beta_3 * N^{-3}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::beta[order - 1][2] * dt);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * beta3 * dt);},
                             explicit_part, t_dst, t_src3 - 1);
             // u^{0} += dt * beta_2 * N^{-2}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::beta[order - 1][1] * dt);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * beta2 * dt);},
                             explicit_part, t_dst, t_src2 - 1);
             // u^{0} += dt * beta_1 * N^{-1}
-            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * twodads::beta[order - 1][0] * dt);},
+            field.elementwise([=] LAMBDACALLER(T lhs, T rhs) -> T {return(lhs + rhs * beta1 * dt);},
                             explicit_part, t_dst, t_src1 - 1);
-            //std::cout << "order = 3: beta = " << twodads::beta[order - 1][0] << ", " << twodads::beta[order - 1][1] << ", " << twodads::beta[order - 1][2] << std::endl;
+            //std::cout << "order = 3: beta = " << beta1 << ", " << beta2 << ", " << beta3 << std::endl;
 
-            // u^{0} /= (11/6 + dt * (diff * k^2 + hv * k^6))
+            // u^{0} /= (11/6 + dt * (diff * k^2 + hv * k^(2p)))
             field.elementwise([=] LAMBDACALLER (T lhs, T k2) -> T
-                            { return(lhs / (twodads::alpha[order - 1][0] + k2 * dt * diff)); },
+                            { return(lhs / (alpha0 + k2 * dt * diff + dt * hv * detail :: hv_power(k2, hv_order))); },
                             get_k2_map(), t_dst, 0);
             field.set_transformed(t_dst, true);
             break;
@@ -622,5 +1546,248 @@ void integrator_karniadakis_bs_t<T, allocator> :: integrate(cuda_array_bc_nogp<T
 }
 
 
+// Exponential time differencing, fourth order Runge-Kutta, for bispectral layout. 
+// The fields passed to integrate_stages need to be complex
+template <typename T, template<typename> class allocator>
+class integrator_etdrk4_bs_t : public integrator_base_t<T, allocator>
+{
+    /**
+     .. cpp:class:: template<typename T, template<typename> class allocator> integrator_etdrk4_bs_t : public integrator_base_t<T, allocator>
+
+      Implements the ETDRK4 scheme by Cox and Matthews, J. Comput. Phys. 176, 430 (2002), for bi-spectral methods.
+      The diffusion and hyperviscosity, L = -diff * k^2 - hv * k^(2p), are integrated exactly in each Fourier mode. The explicit part is evaluated at 
+      four stages per time step. The coefficients, functions of dt * L, are computed when the step size changes.
+
+      The scheme is single-step and only implements integrate_stages.
+
+    */
+    public:
+        using arr_t = cuda_array_bc_nogp<T, allocator>;
+        using rhs_func_t = typename integrator_base_t<T, allocator>::rhs_func_t;
+
+        integrator_etdrk4_bs_t(const twodads::slab_layout_t& _sl,
+                               const twodads::bvals_t<T>& _bv,
+                               const twodads::stiff_params_t& _sp) :
+            geom{_sl}, bvals{_bv}, stiff_params{_sp},
+            deltat{_sp.get_deltat()},
+            k2_map(get_geom(), twodads::bvals_t<T>(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, T(0.0), T(0.0)), 1),
+            coeffs(get_geom(), twodads::bvals_t<T>(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, T(0.0), T(0.0)), num_coeffs)
+        {
+            k2_map.set_transformed(0, true);
+            k2_map.set_tag("integrator_etdrk4_bs_t", "k2_map");
+            coeffs.set_tag("integrator_etdrk4_bs_t", "coeffs");
+            detail :: impl_init_k2_map(k2_map);
+            init_coeffs();
+        }
+
+        ~integrator_etdrk4_bs_t()
+        {
+            for(auto it : stages)
+                delete it;
+        }
+
+        // Multi-step interface, not implemented
+        void integrate(arr_t&, const arr_t&, const size_t, const size_t, const size_t, const size_t, const size_t)
+        {
+            throw not_implemented_error(std::string("integrator_etdrk4_bs_t: Use integrate_stages"));
+        }
+
+        void integrate_stages(const std::vector<arr_t*>&, const size_t, const size_t, const rhs_func_t&);
+
+        // Recomputes the coefficients if the step size changes
+        void set_deltat(const T dt) 
+        {
+            if(dt != get_deltat())
+            {
+                deltat = dt;
+                init_coeffs();
+            }
+        }
+        inline T get_deltat() const {return(deltat);};
+
+        // The state is the step size
+        void get_state(std::vector<T>& state) const {state.assign({deltat});};
+        void set_state(const std::vector<T>& state)
+        {
+            if(state.size() != 1)
+                throw config_error(std::string("integrator_etdrk4_bs_t: set_state expects the step size"));
+            set_deltat(state[0]);
+        }
+
+        // Computes exp(dt L), exp(dt L / 2) and the phi-function coefficients for the current step size.
+        // It should really be private, but then nvcc complains about the __device__ lambdas
+        void init_coeffs();
+
+        const arr_t& get_k2_map() const {return(k2_map);};
+        const arr_t& get_coeffs() const {return(coeffs);};
+
+        inline twodads::slab_layout_t get_geom() const {return(geom);};
+        inline twodads::bvals_t<T> get_bvals() const {return(bvals);};
+        inline twodads::stiff_params_t get_tint_params() const {return(stiff_params);};
+
+    private:
+        // Time indices of the coefficients
+        static constexpr size_t c_E{0};     // exp(dt L)
+        static constexpr size_t c_E2{1};    // exp(dt L / 2)
+        static constexpr size_t c_Q{2};     // dt / 2 * phi_1(dt L / 2)
+        static constexpr size_t c_f1{3};    // dt * (phi_1 - 3 phi_2 + 4 phi_3)(dt L)
+        static constexpr size_t c_f2{4};    // dt * (phi_2 - 2 phi_3)(dt L)
+        static constexpr size_t c_f3{5};    // dt * (-phi_2 + 4 phi_3)(dt L)
+        static constexpr size_t num_coeffs{6};
+
+        // Time indices in the stage arrays
+        static constexpr size_t s_a{0};     // Stage a
+        static constexpr size_t s_bc{1};    // Stage b, later stage c
+        static constexpr size_t s_nu{2};    // N(u)
+        static constexpr size_t s_na{3};    // N(a), later N(a) + N(b)
+        static constexpr size_t s_nb{4};    // N(b), later N(c)
+        static constexpr size_t num_stages{5};
+
+        const twodads::slab_layout_t geom;
+        const twodads::bvals_t<twodads::real_t> bvals;
+        const twodads::stiff_params_t stiff_params; 
+        T deltat;
+        arr_t k2_map;
+        arr_t coeffs;
+        // Stage storage, one array for each field. Allocated on first use.
+        std::vector<arr_t*> stages;
+        // The stages passed to rhs_func, one for each field
+        std::vector<arr_t*> stage_vec;
+};
+
+
+template <typename T, template<typename> class allocator>
+void integrator_etdrk4_bs_t<T, allocator> :: init_coeffs()
+{
+    const T dt_diff{get_deltat() * get_tint_params().get_diff()};
+    const T dt_hv{get_deltat() * get_tint_params().get_hv()};
+    const size_t hv_order{get_tint_params().get_hv_order()};
+    const T dt{get_deltat()};
+    const T* k2_ptr{get_k2_map().get_tlev_ptr(0)};
+
+    // -dt L = dt * (diff * k^2 + hv * k^(2p)) for the mode at n, m
+    auto dt_damping = [=] LAMBDACALLER (const size_t n, const size_t m, const twodads::slab_layout_t& geom) -> T
+    {
+        const T k2{k2_ptr[n * (geom.get_my() + geom.get_pad_y()) + m]};
+        return(dt_diff * k2 + dt_hv * detail :: hv_power(k2, hv_order));
+    };
+
+    for(size_t c = 0; c < num_coeffs; c++)
+        coeffs.set_transformed(c, true);
+
+    coeffs.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+                 {return(exp(-dt_damping(n, m, geom)));}, c_E);
+    coeffs.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+                 {return(exp(-0.5 * dt_damping(n, m, geom)));}, c_E2);
+    coeffs.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+                 {return(0.5 * dt * detail :: etd_phi(1, -0.5 * dt_damping(n, m, geom)));}, c_Q);
+    coeffs.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+                 {
+                    const T z{-dt_damping(n, m, geom)};
+                    return(dt * (detail :: etd_phi(1, z) - 3.0 * detail :: etd_phi(2, z) + 4.0 * detail :: etd_phi(3, z)));
+                 }, c_f1);
+    coeffs.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+                 {
+                    const T z{-dt_damping(n, m, geom)};
+                    return(dt * (detail :: etd_phi(2, z) - 2.0 * detail :: etd_phi(3, z)));
+                 }, c_f2);
+    coeffs.apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+                 {
+                    const T z{-dt_damping(n, m, geom)};
+                    return(dt * (-1.0 * detail :: etd_phi(2, z) + 4.0 * detail :: etd_phi(3, z)));
+                 }, c_f3);
+}
+
+
+template <typename T, template<typename> class allocator>
+void integrator_etdrk4_bs_t<T, allocator> :: integrate_stages(const std::vector<arr_t*>& fields, 
+                                                              const size_t t_src, const size_t t_dst,
+                                                              const rhs_func_t& rhs_func)
+{
+    // Includes the time spent in rhs_func
+    PROFILE_SCOPE("integrator_etdrk4_bs_t::integrate_stages", fields.size() * 2 * get_geom().get_nelem_per_t() * sizeof(T));
+    // Stages of the scheme, N denotes the explicit part:
+    // a = E2 u + Q N(u)
+    // b = E2 u + Q N(a)
+    // c = E2 a + Q (2 N(b) - N(u))
+    // u(t + dt) = E u + f1 N(u) + 2 f2 (N(a) + N(b)) + f3 N(c)
+    for(size_t f = stages.size(); f < fields.size(); f++)
+    {
+        stages.push_back(new arr_t(get_geom(), fields[f] -> get_bvals(), num_stages));
+        stages.back() -> set_tag("integrator_etdrk4_bs_t", "stages");
+    }
+    if(stage_vec.size() != fields.size())
+        stage_vec.assign(stages.begin(), stages.begin() + fields.size());
+
+    const T* E{get_coeffs().get_tlev_ptr(c_E)};
+    const T* E2{get_coeffs().get_tlev_ptr(c_E2)};
+    const T* Q{get_coeffs().get_tlev_ptr(c_Q)};
+    const T* f1{get_coeffs().get_tlev_ptr(c_f1)};
+    const T* f2{get_coeffs().get_tlev_ptr(c_f2)};
+    const T* f3{get_coeffs().get_tlev_ptr(c_f3)};
+
+    for(auto it : fields)
+        assert(it -> is_transformed(t_src));
+
+    rhs_func(fields, t_src, stage_vec, s_nu);
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        const T* u{fields[f] -> get_tlev_ptr(t_src)};
+        const T* n_u{stages[f] -> get_tlev_ptr(s_nu)};
+        stages[f] -> set_transformed(s_a, true);
+        stages[f] -> apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+            return(E2[idx] * u[idx] + Q[idx] * n_u[idx]);
+        }, s_a);
+    }
+
+    rhs_func(stage_vec, s_a, stage_vec, s_na);
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        const T* u{fields[f] -> get_tlev_ptr(t_src)};
+        const T* n_a{stages[f] -> get_tlev_ptr(s_na)};
+        stages[f] -> set_transformed(s_bc, true);
+        stages[f] -> apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+            return(E2[idx] * u[idx] + Q[idx] * n_a[idx]);
+        }, s_bc);
+    }
+
+    rhs_func(stage_vec, s_bc, stage_vec, s_nb);
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        const T* a{stages[f] -> get_tlev_ptr(s_a)};
+        const T* n_u{stages[f] -> get_tlev_ptr(s_nu)};
+        const T* n_b{stages[f] -> get_tlev_ptr(s_nb)};
+        stages[f] -> set_transformed(s_bc, true);
+        stages[f] -> apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+            return(E2[idx] * a[idx] + Q[idx] * (2.0 * n_b[idx] - n_u[idx]));
+        }, s_bc);
+        // N(a) + N(b), frees s_nb for N(c)
+        stages[f] -> set_transformed(s_na, true);
+        stages[f] -> elementwise([=] LAMBDACALLER (T lhs, T rhs) -> T {return(lhs + rhs);}, s_na, s_nb);
+    }
+
+    rhs_func(stage_vec, s_bc, stage_vec, s_nb);
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        const T* u{fields[f] -> get_tlev_ptr(t_src)};
+        const T* n_u{stages[f] -> get_tlev_ptr(s_nu)};
+        const T* n_ab{stages[f] -> get_tlev_ptr(s_na)};
+        const T* n_c{stages[f] -> get_tlev_ptr(s_nb)};
+        fields[f] -> set_transformed(t_dst, true);
+        fields[f] -> apply([=] LAMBDACALLER (T dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> T
+        {
+            const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+            return(E[idx] * u[idx] + f1[idx] * n_u[idx] + 2.0 * f2[idx] * n_ab[idx] + f3[idx] * n_c[idx]);
+        }, t_dst);
+    }
+}
+
+
 #endif //INTEGRATORS_H
 // End of file integrators.h
@@ -0,0 +1,479 @@
+/*
+ * Leveled and rate-limited log of the simulation
+ *
+ * Messages are formatted with printf syntax into records of fixed length and collected in a buffer.
+ * A background thread writes the buffer every flush interval, so that logging in the time loop neither
+ * flushes a stream nor allocates. Errors are written immediately, together with the buffered records.
+ * Messages below the level of the logger are discarded before they are formatted.
+ *
+ * LOG_EVERY writes a message at most once per interval and call site and appends the number of
+ * messages that were suppressed since the last one, e.g. for the progress of the time steps.
+ *
+ * Records are written as text, "[     1.234s] info: message", or as JSON lines,
+ * {"t": 1.234, "level": "info", "msg": "message"}. Errors and warnings go to stderr, other messages
+ * to stdout, or all records to a log file. Messages longer than max_msg_len are written directly.
+ * When the buffer is full, messages are dropped and their number is written with the next flush.
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <ios>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __GNUC__
+#define LOGGER_PRINTF_FORMAT(fmt_idx, arg_idx) __attribute__((format(printf, fmt_idx, arg_idx)))
+#else
+#define LOGGER_PRINTF_FORMAT(fmt_idx, arg_idx)
+#endif //__GNUC__
+
+
+namespace logger
+{
+    /**
+     .. cpp:namespace-push:: logger
+
+    */
+
+    /**
+     .. cpp:enum-class:: level_t
+
+     Severity of a message: error, warning, info, debug. A logger at level info writes errors,
+     warnings and info messages.
+
+    */
+    enum class level_t {error = 0, warning = 1, info = 2, debug = 3};
+
+
+    /**
+     .. cpp:enum-class:: format_t
+
+     Format of the records: text or json, one object per line.
+
+    */
+    enum class format_t {text, json};
+
+
+    /**
+     .. cpp:var:: constexpr size_t max_msg_len
+
+     Length of the message in a buffered record, including the terminating zero.
+
+    */
+    constexpr size_t max_msg_len{256};
+
+
+    /**
+     .. cpp:var:: constexpr size_t num_records
+
+     Number of records in the buffer.
+
+    */
+    constexpr size_t num_records{4096};
+
+
+    inline const char* get_level_name(const level_t level)
+    {
+        static const char* names[4] = {"error", "warning", "info", "debug"};
+        return(names[static_cast<int>(level)]);
+    }
+
+
+    /**
+     .. cpp:class:: logger_t
+
+     Buffer of the log records and the thread that writes them. All member functions are thread safe.
+
+    */
+    class logger_t
+    {
+        public:
+            /**
+             .. cpp:function:: static logger_t& get()
+
+             Returns the logger of the program. The buffered records are written when the program exits.
+
+            */
+            static logger_t& get()
+            {
+                static logger_t logger;
+                return(logger);
+            }
+
+            /**
+             .. cpp:function:: bool is_enabled(const level_t lvl) const
+
+             Returns true if messages of level lvl are written.
+
+            */
+            bool is_enabled(const level_t lvl) const {return(static_cast<int>(lvl) <= level.load(std::memory_order_relaxed));};
+
+            /**
+             .. cpp:function:: void set_level(const level_t lvl)
+
+             Writes messages of level lvl and more severe ones. Defaults to info.
+
+            */
+            void set_level(const level_t lvl) {level.store(static_cast<int>(lvl), std::memory_order_relaxed);};
+
+            /**
+             .. cpp:function:: void set_format(const format_t fmt)
+
+             Sets the format of the records. Defaults to text.
+
+            */
+            void set_format(const format_t fmt)
+            {
+                std::lock_guard<std::mutex> lock(io_mtx);
+                format = fmt;
+            }
+
+            /**
+             .. cpp:function:: void set_flush_interval(const double seconds)
+
+             Sets the time between two writes of the buffer. Defaults to 0.5s.
+
+            */
+            void set_flush_interval(const double seconds)
+            {
+                flush_interval_us.store(static_cast<int64_t>(seconds * 1e6), std::memory_order_relaxed);
+                cv.notify_all();
+            }
+
+            /**
+             .. cpp:function:: void set_file(const std::string& fname)
+
+             Writes all records to the file fname. An empty name writes to stdout and stderr.
+             Throws std::ios_base::failure if the file can not be opened.
+
+            */
+            void set_file(const std::string& fname)
+            {
+                flush();
+                std::lock_guard<std::mutex> lock(io_mtx);
+                if(file != nullptr)
+                {
+                    fclose(file);
+                    file = nullptr;
+                }
+                if(fname.empty())
+                    return;
+                if((file = fopen(fname.c_str(), "w")) == nullptr)
+                    throw std::ios_base::failure(std::string("logger_t :: set_file: Could not open ") + fname);
+            }
+
+            /**
+             .. cpp:function:: void write(const level_t lvl, const size_t num_suppressed, const char* fmt, ...)
+
+             :param const level_t lvl: Level of the message
+             :param const size_t num_suppressed: Number of similar messages that were not written, see rate_limit_t
+             :param const char* fmt: printf format string of the message
+
+             Formats the message into the buffer. Use the LOG_MESSAGE and LOG_EVERY macros, which skip
+             the formatting if the level is not enabled.
+
+            */
+            LOGGER_PRINTF_FORMAT(4, 5)
+            void write(const level_t lvl, const size_t num_suppressed, const char* fmt, ...)
+            {
+                const double t{std::chrono::duration<double>(clock_t::now() - t_start).count()};
+                va_list args;
+                va_start(args, fmt);
+                char msg[max_msg_len];
+                const int len{vsnprintf(msg, max_msg_len, fmt, args)};
+                va_end(args);
+
+                if(len >= static_cast<int>(max_msg_len))
+                {
+                    // Long messages, e.g. reports, are rare and written directly
+                    std::vector<char> long_msg(static_cast<size_t>(len) + 1);
+                    va_start(args, fmt);
+                    vsnprintf(long_msg.data(), long_msg.size(), fmt, args);
+                    va_end(args);
+                    flush();
+                    std::lock_guard<std::mutex> lock(io_mtx);
+                    write_line(t, lvl, num_suppressed, long_msg.data());
+                    fflush(get_sink(lvl));
+                    return;
+                }
+
+                bool half_full{false};
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if(num_front < num_records)
+                    {
+                        record_t& rec = front[num_front++];
+                        rec.t = t;
+                        rec.level = lvl;
+                        rec.num_suppressed = num_suppressed;
+                        std::copy(msg, msg + std::max(len, 0) + 1, rec.msg);
+                    }
+                    else
+                        num_dropped_pending++;
+                    half_full = num_front > num_records / 2;
+                }
+
+                if(lvl == level_t::error)
+                    flush();
+                else if(half_full)
+                    cv.notify_all();
+            }
+
+            /**
+             .. cpp:function:: void flush()
+
+             Writes the buffered records.
+
+            */
+            void flush()
+            {
+                std::lock_guard<std::mutex> io_lock(io_mtx);
+                size_t num{0};
+                size_t num_dropped{0};
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    std::swap(front, back);
+                    num = num_front;
+                    num_dropped = num_dropped_pending;
+                    num_front = 0;
+                    num_dropped_pending = 0;
+                }
+                for(size_t n = 0; n < num; n++)
+                    write_line(back[n].t, back[n].level, back[n].num_suppressed, back[n].msg);
+                if(num_dropped > 0)
+                {
+                    char msg[max_msg_len];
+                    snprintf(msg, max_msg_len, "%zu messages dropped, the log buffer is full", num_dropped);
+                    write_line(std::chrono::duration<double>(clock_t::now() - t_start).count(), level_t::warning, 0, msg);
+                    total_dropped.fetch_add(num_dropped, std::memory_order_relaxed);
+                }
+                if(file != nullptr)
+                    fflush(file);
+                else
+                {
+                    fflush(stdout);
+                    fflush(stderr);
+                }
+            }
+
+            /**
+             .. cpp:function:: size_t get_num_dropped() const
+
+             Returns the number of messages dropped because the buffer was full, up to the last flush.
+
+            */
+            size_t get_num_dropped() const {return(total_dropped.load(std::memory_order_relaxed));};
+
+        private:
+            using clock_t = std::chrono::steady_clock;
+
+            struct record_t
+            {
+                double t;
+                level_t level;
+                size_t num_suppressed;
+                char msg[max_msg_len];
+            };
+
+            logger_t() :
+                level(static_cast<int>(level_t::info)),
+                flush_interval_us(500000),
+                total_dropped(0),
+                format(format_t::text),
+                file(nullptr),
+                front(num_records),
+                back(num_records),
+                num_front(0),
+                num_dropped_pending(0),
+                stop(false),
+                t_start(clock_t::now()),
+                flusher([this] () -> void {flush_loop();})
+            {}
+
+            ~logger_t()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    stop = true;
+                }
+                cv.notify_all();
+                flusher.join();
+                flush();
+                if(file != nullptr)
+                    fclose(file);
+            }
+
+            logger_t(const logger_t&) = delete;
+            logger_t& operator=(const logger_t&) = delete;
+
+            void flush_loop()
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                while(!stop)
+                {
+                    // Woken early by stop, a half full buffer, or a new flush interval
+                    cv.wait_for(lock, std::chrono::microseconds(flush_interval_us.load(std::memory_order_relaxed)));
+                    lock.unlock();
+                    flush();
+                    lock.lock();
+                }
+            }
+
+            // Requires the io lock
+            FILE* get_sink(const level_t lvl) const
+            {
+                if(file != nullptr)
+                    return(file);
+                return(lvl == level_t::error || lvl == level_t::warning ? stderr : stdout);
+            }
+
+            // Requires the io lock
+            void write_line(const double t, const level_t lvl, const size_t num_suppressed, const char* msg)
+            {
+                FILE* sink{get_sink(lvl)};
+                if(format == format_t::json)
+                {
+                    fprintf(sink, "{\"t\": %.6f, \"level\": \"%s\", \"msg\": \"", t, get_level_name(lvl));
+                    for(const char* c = msg; *c != '\0'; c++)
+                    {
+                        switch(*c)
+                        {
+                            case '"': fputs("\\\"", sink); break;
+                            case '\\': fputs("\\\\", sink); break;
+                            case '\n': fputs("\\n", sink); break;
+                            case '\t': fputs("\\t", sink); break;
+                            default:
+                                if(static_cast<unsigned char>(*c) < 0x20)
+                                    fprintf(sink, "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(*c)));
+                                else
+                                    fputc(*c, sink);
+                        }
+                    }
+                    fputc('"', sink);
+                    if(num_suppressed > 0)
+                        fprintf(sink, ", \"suppressed\": %zu", num_suppressed);
+                    fputs("}\n", sink);
+                }
+                else
+                {
+                    fprintf(sink, "[%11.3fs] %s: %s", t, get_level_name(lvl), msg);
+                    if(num_suppressed > 0)
+                        fprintf(sink, " (%zu similar messages suppressed)", num_suppressed);
+                    fputc('\n', sink);
+                }
+            }
+
+            std::atomic<int> level;
+            std::atomic<int64_t> flush_interval_us;
+            std::atomic<size_t> total_dropped;
+
+            // Sink and format, guarded by io_mtx. Lock io_mtx before mtx.
+            std::mutex io_mtx;
+            format_t format;
+            FILE* file;
+
+            // Buffer, guarded by mtx
+            std::mutex mtx;
+            std::condition_variable cv;
+            std::vector<record_t> front;
+            std::vector<record_t> back;
+            size_t num_front;
+            size_t num_dropped_pending;
+            bool stop;
+
+            const clock_t::time_point t_start;
+            // Started last, after all members are initialized
+            std::thread flusher;
+    };
+
+
+    /**
+     .. cpp:class:: rate_limit_t
+
+     Limits the messages of a call site to one per interval. Thread safe.
+
+    */
+    class rate_limit_t
+    {
+        public:
+            rate_limit_t() : t_last(never), num_suppressed(0) {};
+
+            /**
+             .. cpp:function:: bool allow(const double interval)
+
+             Returns true if no message was allowed in the last interval seconds. Otherwise counts
+             the message as suppressed and returns false.
+
+            */
+            bool allow(const double interval)
+            {
+                const int64_t now{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()};
+                int64_t last{t_last.load(std::memory_order_relaxed)};
+                if((last != never && static_cast<double>(now - last) < interval * 1e9) || !t_last.compare_exchange_strong(last, now))
+                {
+                    num_suppressed.fetch_add(1, std::memory_order_relaxed);
+                    return(false);
+                }
+                return(true);
+            }
+
+            /**
+             .. cpp:function:: size_t take_suppressed()
+
+             Returns the number of suppressed messages and resets it.
+
+            */
+            size_t take_suppressed() {return(num_suppressed.exchange(0, std::memory_order_relaxed));};
+
+        private:
+            static constexpr int64_t never{std::numeric_limits<int64_t>::min()};
+            std::atomic<int64_t> t_last;
+            std::atomic<size_t> num_suppressed;
+    };
+
+    /**
+     .. cpp:namespace-pop::
+
+    */
+}
+
+
+/**
+ .. c:macro:: LOG_MESSAGE(level, fmt, ...)
+
+ Writes a message with printf format fmt if level is enabled, e.g. LOG_MESSAGE(logger::level_t::info, "t = %g", t).
+
+*/
+#define LOG_MESSAGE(lvl, ...) \
+    do { \
+        if(logger::logger_t::get().is_enabled(lvl)) \
+            logger::logger_t::get().write(lvl, 0, __VA_ARGS__); \
+    } while(0)
+
+
+/**
+ .. c:macro:: LOG_EVERY(level, interval, fmt, ...)
+
+ Writes a message at most once per interval seconds from this call site.
+
+*/
+#define LOG_EVERY(lvl, interval, ...) \
+    do { \
+        static logger::rate_limit_t log_rate_limit; \
+        if(logger::logger_t::get().is_enabled(lvl) && log_rate_limit.allow(interval)) \
+            logger::logger_t::get().write(lvl, log_rate_limit.take_suppressed(), __VA_ARGS__); \
+    } while(0)
+
+#endif //LOGGER_H
+// End of file logger.h
@@ -6,8 +6,12 @@
 #ifndef OUTPUT_H
 #define OUTPUT_H
 
-//#include <vector>
+#include <vector>
 #include <map>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <H5Cpp.h>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -35,6 +39,8 @@ public:
     // Output counter and array dimensions
     inline size_t get_output_counter() const {return(output_counter);};
     inline void increment_output_counter() {output_counter++;};
+    // Continue the numbering of the output after a restart
+    inline void set_output_counter(const size_t counter) {output_counter = counter;};
 
     const twodads::slab_layout_t& get_geom() {return(geom);};
     twodads::real_t get_dtout() const {return(dtout);};
@@ -57,6 +63,13 @@ public:
     /// @brief Write output field from a host array 
     void surface(twodads::output_t, const cuda_array_bc_nogp<twodads::real_t, allocator_host>&, const size_t);
     void surface(twodads::output_t, const cuda_array_bc_nogp<twodads::real_t, allocator_host>&, const size_t, const twodads::real_t);
+
+    /// Mapping from field types to dataspace names
+    static const std::map<twodads::output_t, std::string> fname_map;
+
+    /// @brief Lock held by all calls to the HDF5 library.
+    /// @detailed The library is not thread-safe, but several output threads may run in one process, see shared_objects_t.
+    static std::mutex& get_library_mutex();
 private:
     const std::string filename;
     H5File* output_file;
@@ -74,28 +87,99 @@ private:
     Group* group_strmf_x;
     Group* group_strmf_y;
     
+    // The HDF5 objects are created and destroyed while holding get_library_mutex, 
+    // so they are held by pointer and allocated in the body of the constructor.
     DataSpace* dspace_file;
-    
-    DataSpace dspace_theta;
-    DataSpace dspace_theta_x;
-    DataSpace dspace_theta_y;
-    DataSpace dspace_tau;
-    DataSpace dspace_tau_x;
-    DataSpace dspace_tau_y;
-    DataSpace dspace_omega;
-    DataSpace dspace_omega_x;
-    DataSpace dspace_omega_y;
-    DataSpace dspace_strmf;
-    DataSpace dspace_strmf_x;
-    DataSpace dspace_strmf_y;
-    DataSpace dspace_omega_rhs;
-    DataSpace dspace_theta_rhs;
-
-    DSetCreatPropList ds_creatplist;
-    // Mapping from field types to dataspace
+    DSetCreatPropList* ds_creatplist;
+    // Mapping from field types to the dataspace of the host arrays, for the fields in the output list
     std::map<twodads::output_t, DataSpace*> dspace_map;
-    // Mapping from field types to dataspace names
-    static const std::map<twodads::output_t, std::string> fname_map;
+};
+
+
+// Writes output on a separate thread, which owns the output_h5_t object.
+// The caller copies a field into a free buffer of the pool, obtained with acquire, and passes it to
+// the thread with submit. The thread writes the buffers in the order they were submitted. acquire
+// blocks only while all buffers wait for the thread. With zero buffers, submit writes in the calling thread.
+// An exception thrown while writing is rethrown by the next call of acquire or flush.
+class output_queue_t {
+public:
+    using arr_host = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+    /// Creates the output file, allocates 2dads.output.buffers buffers and starts the thread.
+    output_queue_t(const slab_config_js&);
+    /// Writes the submitted buffers and stops the thread.
+    ~output_queue_t();
+
+    output_queue_t(const output_queue_t&) = delete;
+    output_queue_t& operator=(const output_queue_t&) = delete;
+
+    /// @brief Wait for a free buffer and return it. 
+    /// @detailed The buffer has the geometry of the simulation and a single time level.
+    arr_host* acquire();
+    /// @brief Pass the buffer returned by acquire to the thread.
+    /// @detailed It is written as snapshot get_output_counter() of the field, with the given time.
+    void submit(const twodads::output_t, const twodads::real_t);
+    /// Wait until all submitted buffers are written.
+    void flush();
+
+    /// Buffers of the pool, e.g. to page-lock them for copies from the device
+    const std::vector<arr_host*>& get_buffers() const {return(buffers);};
+
+    // Output counter of the next submitted buffer
+    inline size_t get_output_counter() const {return(output_counter);};
+    inline void increment_output_counter() {output_counter++;};
+    inline void set_output_counter(const size_t counter) {output_counter = counter;};
+
+private:
+    // A submitted buffer
+    struct record_t
+    {
+        twodads::output_t field;
+        twodads::real_t time;
+        size_t counter;
+    };
+
+    // Writes buffer b
+    void write(const size_t);
+    void run();
+    // Requires the lock
+    void rethrow_error();
+
+    output_h5_t writer;
+    const size_t num_buffers;
+    size_t output_counter;
+    // Buffers are filled and written in a ring: head is the oldest submitted buffer, num_pending
+    // buffers following it wait for the thread.
+    std::vector<arr_host*> buffers;
+    std::vector<record_t> records;
+    size_t head;
+    size_t num_pending;
+    bool stop;
+    std::exception_ptr error;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+};
+
+
+// Reads snapshots from a file written by output_h5_t
+class input_h5_t {
+public:
+    /// Open the file and read the configuration of the run that wrote it
+    input_h5_t(const std::string&);
+
+    /// Configuration of the run that wrote the file
+    const slab_config_js& get_config() const {return(config);};
+
+    /// @brief Read snapshot number k of a field to time index tidx of a host array. 
+    /// @detailed The array needs the geometry given by get_config().
+    void surface(const twodads::output_t, const size_t, cuda_array_bc_nogp<twodads::real_t, allocator_host>&, const size_t);
+private:
+    // Parses the configuration stored in the file
+    static boost::property_tree::ptree read_config(const std::string&);
+
+    const std::string filename;
+    const slab_config_js config;
 };
 
 #endif //OUTPUT_H
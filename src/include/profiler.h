@@ -0,0 +1,641 @@
+/*
+ * Scoped wall-clock timers for the stages of a time step
+ *
+ * Regions are identified by name. A region records the number of calls, the total, smallest and
+ * largest time per call, and an estimate of the bytes touched by the calls. Timing is switched on
+ * at run time with registry_t :: enable. While disabled, a timed scope costs a load of the enabled
+ * flag. Compiling with -DNO_PROFILER removes the timers altogether.
+ *
+ * Optionally, registry_t :: enable_counters also counts hardware events per region with the Linux 
+ * perf_event_open interface: cycles, instructions, last level cache misses and branch misses.
+ * The counters are opened for each OpenMP thread. If they can not be opened, e.g. for 
+ * perf_event_paranoid > 2 or in a container without the perf_event_open syscall, the report
+ * only contains the times.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ios>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif //__linux__
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif //_OPENMP
+
+#if defined(DEVICE) && defined(__CUDACC__)
+#include <cuda_runtime_api.h>
+#endif
+
+
+namespace profiler
+{
+    /**
+     .. cpp:namespace-push:: profiler
+
+    */
+
+    /**
+     .. cpp:type:: timer_clock_t = std::chrono::steady_clock
+
+     Clock used by the timers.
+
+    */
+    using timer_clock_t = std::chrono::steady_clock;
+
+
+    /**
+     .. cpp:var:: constexpr size_t num_counters
+
+     Number of hardware events counted per region: cycles, instructions, llc_misses, and branch_misses.
+
+    */
+    constexpr size_t num_counters{4};
+
+    // Name of the hardware events in the report
+    inline const char* get_counter_name(const size_t c)
+    {
+        static const char* names[num_counters] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+        return(names[c]);
+    }
+
+
+    /**
+     .. cpp:class:: counters_t
+
+     Hardware event counters of all OpenMP threads of the process. Each thread opens a group 
+     of the available events, which are counted in user space only. Threads created after open, 
+     other than the OpenMP threads, are not counted. Reading the counters costs one system call per thread.
+
+    */
+    class counters_t
+    {
+        public:
+            counters_t() : num_available(0)
+            {
+                for(size_t c = 0; c < num_counters; c++)
+                    available[c] = false;
+            }
+            ~counters_t() {close();}
+
+            counters_t(const counters_t&) = delete;
+            counters_t& operator=(const counters_t&) = delete;
+
+            /**
+             .. cpp:function:: bool open(std::string& err)
+
+             :param std::string& err: Reason why no event can be counted.
+
+             Opens the counters for all OpenMP threads. Events that are not supported by the processor are skipped.
+             Returns false if no event can be counted.
+
+            */
+            bool open(std::string& err)
+            {
+#ifdef __linux__
+                close();
+                // Find the events that can be counted by the calling thread
+                for(size_t c = 0; c < num_counters; c++)
+                {
+                    const int fd{open_event(c, -1)};
+                    if(fd >= 0)
+                    {
+                        available[c] = true;
+                        num_available++;
+                        ::close(fd);
+                    }
+                    else if(err.empty())
+                    {
+                        err = std::string("perf_event_open: ") + std::strerror(errno);
+                    }
+                }
+                if(num_available == 0)
+                    return(false);
+                err.clear();
+
+                // Open a group of the available events for each thread
+                leaders.assign(get_max_threads(), -1);
+                fds.assign(leaders.size() * num_counters, -1);
+                bool success{true};
+#pragma omp parallel
+                {
+                    const size_t t{static_cast<size_t>(get_thread_num())};
+                    for(size_t c = 0; c < num_counters && t < leaders.size(); c++)
+                    {
+                        if(!available[c])
+                            continue;
+                        fds[t * num_counters + c] = open_event(c, leaders[t]);
+                        if(fds[t * num_counters + c] < 0)
+                        {
+#pragma omp critical (profiler_counters_open)
+                            {
+                                success = false;
+                                err = std::string("perf_event_open: ") + std::strerror(errno);
+                            }
+                        }
+                        else if(leaders[t] < 0)
+                        {
+                            leaders[t] = fds[t * num_counters + c];
+                        }
+                    }
+                }
+                if(!success)
+                    close();
+                return(success);
+#else
+                err = std::string("Hardware counters require Linux");
+                return(false);
+#endif //__linux__
+            }
+
+            // Closes the counters of all threads
+            void close()
+            {
+#ifdef __linux__
+                for(const int fd : fds)
+                {
+                    if(fd >= 0)
+                        ::close(fd);
+                }
+#endif //__linux__
+                fds.clear();
+                leaders.clear();
+                num_available = 0;
+                for(size_t c = 0; c < num_counters; c++)
+                    available[c] = false;
+            }
+
+            inline bool is_open() const {return(!leaders.empty());};
+            inline bool is_available(const size_t c) const {return(available[c]);};
+
+            /**
+             .. cpp:function:: void read(uint64_t* counts) const
+
+             :param uint64_t* counts: Array of num_counters elements.
+
+             Writes the counts of all threads, summed up. Unavailable events are zero.
+
+            */
+            void read(uint64_t* counts) const
+            {
+                for(size_t c = 0; c < num_counters; c++)
+                    counts[c] = 0;
+#ifdef __linux__
+                // With PERF_FORMAT_GROUP, read gives the number of events followed by the counts in the order they were opened
+                uint64_t buf[num_counters + 1];
+                for(const int fd : leaders)
+                {
+                    const ssize_t nbytes{static_cast<ssize_t>((num_available + 1) * sizeof(uint64_t))};
+                    if(fd < 0 || ::read(fd, buf, nbytes) != nbytes)
+                        continue;
+                    size_t pos{1};
+                    for(size_t c = 0; c < num_counters; c++)
+                    {
+                        if(available[c])
+                            counts[c] += buf[pos++];
+                    }
+                }
+#endif //__linux__
+            }
+
+        private:
+            static int get_max_threads()
+            {
+#ifdef _OPENMP
+                return(omp_get_max_threads());
+#else
+                return(1);
+#endif //_OPENMP
+            }
+
+            static int get_thread_num()
+            {
+#ifdef _OPENMP
+                return(omp_get_thread_num());
+#else
+                return(0);
+#endif //_OPENMP
+            }
+
+#ifdef __linux__
+            // Opens event c for the calling thread, in the group of group_fd. Returns -1 on failure.
+            static int open_event(const size_t c, const int group_fd)
+            {
+                const uint64_t config[num_counters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                       PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+                struct perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = config[c];
+                attr.read_format = PERF_FORMAT_GROUP;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                return(static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0)));
+            }
+#endif //__linux__
+
+            // File descriptors of the events, num_counters per thread, -1 if not open
+            std::vector<int> fds;
+            // First open event of each thread
+            std::vector<int> leaders;
+            bool available[num_counters];
+            size_t num_available;
+    };
+
+
+    /**
+     .. cpp:class:: region_t
+
+     Statistics of a timed region. Times are in seconds. Regions nest, the time and the hardware
+     events of a region include those of the regions called from it.
+
+    */
+    struct region_t
+    {
+        region_t(const std::string& _name) :
+            name(_name), calls(0), t_total(0.0), t_min(std::numeric_limits<double>::max()), t_max(0.0), bytes(0), counts{0, 0, 0, 0} {}
+
+        /**
+         .. cpp:function:: void add(const double dt, const uint64_t nbytes, const uint64_t* delta)
+
+         :param const double dt: Duration of the call in seconds.
+         :param const uint64_t nbytes: Bytes read and written by the call.
+         :param const uint64_t* delta: Hardware events of the call, num_counters elements. nullptr if not counted.
+
+         Adds a call to the statistics.
+
+        */
+        void add(const double dt, const uint64_t nbytes, const uint64_t* delta)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            calls++;
+            t_total += dt;
+            t_min = std::min(t_min, dt);
+            t_max = std::max(t_max, dt);
+            bytes += nbytes;
+            if(delta != nullptr)
+            {
+                for(size_t c = 0; c < num_counters; c++)
+                    counts[c] += delta[c];
+            }
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            calls = 0;
+            t_total = 0.0;
+            t_min = std::numeric_limits<double>::max();
+            t_max = 0.0;
+            bytes = 0;
+            for(size_t c = 0; c < num_counters; c++)
+                counts[c] = 0;
+        }
+
+        const std::string name;
+        uint64_t calls;
+        double t_total;
+        double t_min;
+        double t_max;
+        uint64_t bytes;
+        uint64_t counts[num_counters];
+        std::mutex mtx;
+    };
+
+
+    /**
+     .. cpp:class:: registry_t
+
+     Holds all regions of the program. Access it through registry_t :: get().
+
+    */
+    class registry_t
+    {
+        public:
+            /**
+             .. cpp:function:: static registry_t& get()
+
+             Returns the registry of the program.
+
+            */
+            static registry_t& get()
+            {
+                static registry_t registry;
+                return(registry);
+            }
+
+            /**
+             .. cpp:function:: region_t* get_region(const std::string& name)
+
+             Returns the region with the given name, creating it on the first call.
+             The pointer remains valid for the lifetime of the program.
+
+            */
+            region_t* get_region(const std::string& name)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = regions.find(name);
+                if(it == regions.end())
+                    it = regions.emplace(name, std::unique_ptr<region_t>(new region_t(name))).first;
+                return(it -> second.get());
+            }
+
+            /**
+             .. cpp:function:: void enable()
+
+             Starts timing. The wall time in the report is measured from the first call.
+
+            */
+            void enable()
+            {
+                if(!is_enabled())
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if(!started)
+                    {
+                        t_start = timer_clock_t::now();
+                        started = true;
+                    }
+                }
+                enabled.store(true, std::memory_order_relaxed);
+            }
+
+            /**
+             .. cpp:function:: void disable()
+
+             Stops timing. Statistics recorded so far are kept.
+
+            */
+            void disable() {enabled.store(false, std::memory_order_relaxed);};
+
+            inline bool is_enabled() const {return(enabled.load(std::memory_order_relaxed));};
+
+            /**
+             .. cpp:function:: bool enable_counters()
+
+             Opens the hardware event counters, see counters_t. Timed scopes that start after the call
+             record the hardware events in addition to the times. Returns false if the counters can not 
+             be opened, get_counter_error gives the reason. Timing continues without the counters then.
+
+            */
+            bool enable_counters()
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if(!counters.is_open() && !counters.open(counter_error))
+                    return(false);
+                counting.store(true, std::memory_order_relaxed);
+                return(true);
+            }
+
+            inline bool is_counting() const {return(counting.load(std::memory_order_relaxed));};
+            inline const counters_t& get_counters() const {return(counters);};
+            inline std::string get_counter_error() const {return(counter_error);};
+
+            /**
+             .. cpp:function:: void reset()
+
+             Clears the statistics of all regions and restarts the wall time.
+
+            */
+            void reset()
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                for(auto& it : regions)
+                    it.second -> reset();
+                t_start = timer_clock_t::now();
+            }
+
+            /**
+             .. cpp:function:: void write_report(std::ostream& os)
+
+             Writes the statistics of all called regions as a JSON object:
+             {"wall_time_s": ..., "counters": [...], "regions": {"name": {"calls": ..., "total_s": ..., "min_s": ...,
+             "max_s": ..., "mean_s": ..., "bytes": ..., "bytes_per_s": ...}, ...}}.
+             Regions are listed with decreasing total time. "counters" lists the hardware events that were counted.
+             Each region then has an entry for each of them, and "ipc", instructions per cycle, if both are counted.
+             If the counters could not be opened, "counters_error" gives the reason.
+
+            */
+            void write_report(std::ostream& os)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                const double wall_time{started ? std::chrono::duration<double>(timer_clock_t::now() - t_start).count() : 0.0};
+
+                std::vector<region_t*> called;
+                for(auto& it : regions)
+                {
+                    if(it.second -> calls > 0)
+                        called.push_back(it.second.get());
+                }
+                std::sort(called.begin(), called.end(), [] (const region_t* a, const region_t* b) -> bool
+                          {return(a -> t_total > b -> t_total);});
+
+                const std::ios_base::fmtflags flags{os.flags()};
+                const std::streamsize prec{os.precision()};
+                os << std::setprecision(9);
+                const bool with_counters{is_counting()};
+                os << "{\n    \"wall_time_s\": " << wall_time << ",\n    \"counters\": [";
+                for(size_t c = 0, num = 0; c < num_counters; c++)
+                {
+                    if(with_counters && counters.is_available(c))
+                        os << (num++ == 0 ? "\"" : ", \"") << get_counter_name(c) << "\"";
+                }
+                os << "],";
+                if(!counter_error.empty())
+                    os << "\n    \"counters_error\": \"" << escape(counter_error) << "\",";
+                os << "\n    \"regions\": {";
+                for(size_t r = 0; r < called.size(); r++)
+                {
+                    region_t* reg{called[r]};
+                    std::lock_guard<std::mutex> lock_r(reg -> mtx);
+                    os << (r == 0 ? "\n" : ",\n");
+                    os << "        \"" << escape(reg -> name) << "\": {";
+                    os << "\"calls\": " << reg -> calls;
+                    os << ", \"total_s\": " << reg -> t_total;
+                    os << ", \"min_s\": " << reg -> t_min;
+                    os << ", \"max_s\": " << reg -> t_max;
+                    os << ", \"mean_s\": " << reg -> t_total / static_cast<double>(reg -> calls);
+                    os << ", \"bytes\": " << reg -> bytes;
+                    os << ", \"bytes_per_s\": " << (reg -> t_total > 0.0 ? static_cast<double>(reg -> bytes) / reg -> t_total : 0.0);
+                    if(with_counters)
+                    {
+                        for(size_t c = 0; c < num_counters; c++)
+                        {
+                            if(counters.is_available(c))
+                                os << ", \"" << get_counter_name(c) << "\": " << reg -> counts[c];
+                        }
+                        if(counters.is_available(0) && counters.is_available(1))
+                            os << ", \"ipc\": " << (reg -> counts[0] > 0 ? static_cast<double>(reg -> counts[1]) / static_cast<double>(reg -> counts[0]) : 0.0);
+                    }
+                    os << "}";
+                }
+                os << "\n    }\n}\n";
+                os.flags(flags);
+                os.precision(prec);
+            }
+
+            /**
+             .. cpp:function:: void write_report(const std::string& fname)
+
+             Writes the report to the file fname. Throws std::ios_base::failure if the file can not be written.
+
+            */
+            void write_report(const std::string& fname)
+            {
+                std::ofstream ofs(fname);
+                if(!ofs)
+                    throw std::ios_base::failure(std::string("write_report: Could not open ") + fname);
+                write_report(ofs);
+                if(!ofs)
+                    throw std::ios_base::failure(std::string("write_report: Error writing ") + fname);
+            }
+
+        private:
+            registry_t() : enabled(false), counting(false), started(false) {}
+            registry_t(const registry_t&) = delete;
+            registry_t& operator=(const registry_t&) = delete;
+
+            static std::string escape(const std::string& str)
+            {
+                std::string res;
+                for(const char c : str)
+                {
+                    if(c == '"' || c == '\\')
+                        res.push_back('\\');
+                    res.push_back(c);
+                }
+                return(res);
+            }
+
+            std::atomic<bool> enabled;
+            std::atomic<bool> counting;
+            bool started;
+            counters_t counters;
+            std::string counter_error;
+            timer_clock_t::time_point t_start;
+            std::map<std::string, std::unique_ptr<region_t>> regions;
+            std::mutex mtx;
+    };
+
+
+    /**
+     .. cpp:class:: scoped_timer_t
+
+     Times its own lifetime and adds it to a region, if the registry is enabled at construction.
+     If the registry counts hardware events, they are read at the start and the end of the scope.
+     With the device implementation, the timer synchronizes the device at the start and the end
+     of the scope, so that the time of asynchronous kernels is attributed to the region that launched them.
+
+    */
+    class scoped_timer_t
+    {
+        public:
+            /**
+             .. cpp:function:: scoped_timer_t(region_t* region, const uint64_t nbytes)
+
+             :param region_t* region: Region that the time is added to.
+             :param const uint64_t nbytes: Estimate of the bytes read and written in the scope.
+
+            */
+            scoped_timer_t(region_t* _region, const uint64_t _nbytes) :
+                region(registry_t :: get().is_enabled() ? _region : nullptr),
+                nbytes(_nbytes),
+                counting(false)
+            {
+                if(region != nullptr)
+                {
+                    sync();
+                    counting = registry_t :: get().is_counting();
+                    if(counting)
+                        registry_t :: get().get_counters().read(counts_start);
+                    t_start = timer_clock_t::now();
+                }
+            }
+
+            ~scoped_timer_t()
+            {
+                if(region != nullptr)
+                {
+                    sync();
+                    const double dt{std::chrono::duration<double>(timer_clock_t::now() - t_start).count()};
+                    if(counting)
+                    {
+                        uint64_t delta[num_counters];
+                        registry_t :: get().get_counters().read(delta);
+                        for(size_t c = 0; c < num_counters; c++)
+                            delta[c] -= counts_start[c];
+                        region -> add(dt, nbytes, delta);
+                    }
+                    else
+                    {
+                        region -> add(dt, nbytes, nullptr);
+                    }
+                }
+            }
+
+            scoped_timer_t(const scoped_timer_t&) = delete;
+            scoped_timer_t& operator=(const scoped_timer_t&) = delete;
+
+        private:
+            static void sync()
+            {
+#if defined(DEVICE) && defined(__CUDACC__)
+                cudaDeviceSynchronize();
+#endif
+            }
+
+            region_t* const region;
+            const uint64_t nbytes;
+            bool counting;
+            uint64_t counts_start[num_counters];
+            timer_clock_t::time_point t_start;
+    };
+
+    /**
+     .. cpp:namespace-pop::
+
+    */
+}
+
+
+/**
+ .. c:macro:: PROFILE_SCOPE(name, nbytes)
+
+ Times the rest of the enclosing scope as region name, with nbytes bytes touched per call.
+ The region is looked up once per call site.
+
+*/
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifndef NO_PROFILER
+#define PROFILE_SCOPE(name, nbytes) \
+    static profiler::region_t* const PROFILE_CONCAT(profile_region_, __LINE__){profiler::registry_t::get().get_region(name)}; \
+    profiler::scoped_timer_t PROFILE_CONCAT(profile_timer_, __LINE__)(PROFILE_CONCAT(profile_region_, __LINE__), static_cast<uint64_t>(nbytes))
+#else
+#define PROFILE_SCOPE(name, nbytes)
+#endif //NO_PROFILER
+
+#endif //PROFILER_H
+// End of file profiler.h
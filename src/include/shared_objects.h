@@ -0,0 +1,150 @@
+/*
+ * Objects shared by slabs that run in the same process
+ */
+
+#ifndef SHARED_OBJECTS_H
+#define SHARED_OBJECTS_H
+
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include "2dads_types.h"
+#include "dft_type.h"
+#include "derivatives.h"
+#include "slab_config.h"
+
+
+class shared_objects_t
+{
+    /**
+     .. cpp:class:: shared_objects_t
+
+     FFT plans and derivation objects for several slab_bc objects in one process, f.ex. the
+     members of an ensemble that vary the model parameters on the same grid. They are created
+     for the first slab that requests them with a given geometry and reused for all others.
+     Objects that write to scratch storage are not shared, see deriv_base_t :: prepare_shared.
+     The slabs are responsible for objects they do not get from here.
+
+     Creating and destroying FFTW plans is not thread-safe. Slabs that run on different threads
+     create and destroy their members while holding the lock returned by get_mutex. Executing the
+     plans and the shared derivation objects from several threads at the same time is safe.
+
+    */
+    public:
+#ifdef DEVICE
+        using dft_library_t = cufft_object_t<twodads::real_t>;
+        using deriv_t = deriv_base_t<twodads::real_t, allocator_device>;
+        using deriv_fd_library_t = deriv_fd_t<twodads::real_t, allocator_device>;
+        using deriv_spectral_library_t = deriv_spectral_t<twodads::real_t, allocator_device>;
+#endif //DEVICE
+#ifdef HOST
+        using dft_library_t = fftw_object_t<twodads::real_t>;
+        using deriv_t = deriv_base_t<twodads::real_t, allocator_host>;
+        using deriv_fd_library_t = deriv_fd_t<twodads::real_t, allocator_host>;
+        using deriv_spectral_library_t = deriv_spectral_t<twodads::real_t, allocator_host>;
+#endif //HOST
+
+        shared_objects_t() {};
+        ~shared_objects_t()
+        {
+            for(auto it : derivs)
+                delete std::get<3>(it);
+            for(auto it : dfts)
+                delete std::get<2>(it);
+        }
+
+        shared_objects_t(const shared_objects_t&) = delete;
+        shared_objects_t& operator=(const shared_objects_t&) = delete;
+
+        /**
+         .. cpp:function:: dft_object_t<twodads::real_t>* get_dft(const slab_config_js& cfg)
+
+         :param const slab_config_js& cfg: Configuration of the slab
+
+         Returns the DFT object for the geometry and DFT type of the configuration.
+
+        */
+        dft_object_t<twodads::real_t>* get_dft(const slab_config_js& cfg)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mtx);
+            const twodads::slab_layout_t geom{cfg.get_geom()};
+            const twodads::dft_t dft_type{cfg.get_dft_t()};
+            for(auto it : dfts)
+            {
+                if(std::get<0>(it) == geom && std::get<1>(it) == dft_type)
+                    return(std::get<2>(it));
+            }
+            dfts.push_back(std::make_tuple(geom, dft_type, new dft_library_t(geom, dft_type)));
+            return(std::get<2>(dfts.back()));
+        }
+
+        /**
+         .. cpp:function:: deriv_t* get_derivs(const slab_config_js& cfg)
+
+         :param const slab_config_js& cfg: Configuration of the slab
+
+         Returns the derivation object for the geometry, boundary conditions of the stream function,
+         and solver of the configuration. Returns nullptr if this derivation object can not be shared.
+         The slab creates its own one then. Unlike the FFT plans, the derivation objects depend on the
+         grid spacing, the domain, and the grid mapping, not only on the number of grid points.
+
+        */
+        deriv_t* get_derivs(const slab_config_js& cfg)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mtx);
+            const twodads::slab_layout_t geom{cfg.get_geom()};
+            const twodads::bvals_t<twodads::real_t> bvals{cfg.get_bvals(twodads::field_t::f_strmf)};
+            const twodads::solver_t solver{cfg.get_solver_t()};
+            for(auto it : derivs)
+            {
+                if(same_grid(std::get<0>(it), geom) && std::get<1>(it) == bvals && std::get<2>(it) == solver)
+                    return(std::get<3>(it));
+            }
+
+            deriv_t* d{nullptr};
+            switch(cfg.get_grid_type())
+            {
+                case twodads::grid_t::vertex_centered:
+                    d = new deriv_spectral_library_t(geom);
+                    break;
+                case twodads::grid_t::cell_centered:
+                    d = new deriv_fd_library_t(geom, bvals, solver);
+                    break;
+            }
+            // Remember objects that can not be shared as nullptr, so that they are not created again
+            if(!d -> prepare_shared())
+            {
+                delete d;
+                d = nullptr;
+            }
+            derivs.push_back(std::make_tuple(geom, bvals, solver, d));
+            return(d);
+        }
+
+        /**
+         .. cpp:function:: std::recursive_mutex& get_mutex()
+
+         Lock to create and destroy the members of a slab, see above.
+
+        */
+        std::recursive_mutex& get_mutex() {return(mtx);};
+
+    private:
+        // slab_layout_t :: operator== only compares the number of grid points and the padding
+        static bool same_grid(twodads::slab_layout_t lhs, const twodads::slab_layout_t& rhs)
+        {
+            return((lhs == rhs) &&
+                   (lhs.get_xleft() == rhs.get_xleft()) &&
+                   (lhs.get_deltax() == rhs.get_deltax()) &&
+                   (lhs.get_ylo() == rhs.get_ylo()) &&
+                   (lhs.get_deltay() == rhs.get_deltay()) &&
+                   (lhs.get_grid() == rhs.get_grid()) &&
+                   (lhs.get_stretch_x() == rhs.get_stretch_x()));
+        }
+
+        std::recursive_mutex mtx;
+        std::vector<std::tuple<twodads::slab_layout_t, twodads::dft_t, dft_object_t<twodads::real_t>*>> dfts;
+        std::vector<std::tuple<twodads::slab_layout_t, twodads::bvals_t<twodads::real_t>, twodads::solver_t, deriv_t*>> derivs;
+};
+
+#endif //SHARED_OBJECTS_H
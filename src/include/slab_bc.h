@@ -6,11 +6,14 @@
 #ifndef SLAB_BC_H
 #define SLAB_BC_H
 
+#include <cstdio>
+#include <cstdint>
 #include <fstream>
 #include <iomanip>
 #include <sstream>
 #include <string>
 #include <map>
+#include <vector>
 #include "2dads_types.h"
 #include "cuda_array_bc_nogp.h"
 #include "utility.h"
@@ -21,6 +24,11 @@
 #include "slab_config.h"
 #include "output.h"
 #include "diagnostics.h"
+#include "shared_objects.h"
+#include "decomp_mpi.h"
+#include "profiler.h"
+#include "footprint.h"
+#include "logger.h"
 
 #ifdef __CUDACC__
 #include "cuda_types.h"
@@ -125,16 +133,44 @@ class slab_bc
         slab_bc(const twodads::slab_layout_t, const twodads::bvals_t<value_t>, const twodads::stiff_params_t);
 
         /**
-         .. cpp:function:: slab_bc(const slab_config_js& cfg)
+         .. cpp:function:: slab_bc(const slab_config_js& cfg, shared_objects_t* shared = nullptr, MPI_Comm comm = MPI_COMM_WORLD)
 
          :param const slab_config_js& cfg: Configuration for the slab.
+         :param shared_objects_t* shared: FFT plans and derivation objects shared with other slabs. 
+         :param MPI_Comm comm: Ranks over which the grid is distributed. Only with USE_MPI.
 
-         Construct a slab from a config object.
+         Construct a slab from a config object. Without shared objects, the slab creates its own
+         and configures the log, see configure_log. With shared objects, the slab holds their lock
+         while it creates and destroys its members, so that slabs on other threads may run meanwhile.
+
+         With more than one rank in comm, the slab holds the rows of slab_config_js :: get_subdomain
+         and the constructor is collective. Neighbouring ranks exchange rows in the derivatives, see
+         deriv_fd_mpi_t, and the rank 0 writes output and diagnostics of the whole grid. Shared objects
+         are not supported then. The rank 0 gathers one field at a time into a single output buffer and
+         the diagnostics into a single set of buffers, see slab_config_js :: get_output_buffers and get_diag_buffers.
+         Besides its subdomain, it holds one output field and the fields of diagnostic_queue_t :: get_required_fields
+         on the whole grid, which limits the grid size to the memory of a single rank.
+
+         Throws config_error for an inconsistent configuration, see slab_config_js :: check_consistency.
 
         */
-        slab_bc(const slab_config_js& cfg);
+#ifdef USE_MPI
+        slab_bc(const slab_config_js& cfg, shared_objects_t* shared = nullptr, MPI_Comm comm = MPI_COMM_WORLD);
+#else
+        slab_bc(const slab_config_js& cfg, shared_objects_t* shared = nullptr);
+#endif //USE_MPI
         ~slab_bc();
 
+        /**
+         .. cpp:function:: static void configure_log(const slab_config_js& cfg)
+
+         :param const slab_config_js& cfg: Configuration of the log
+
+         Sets level, format, and file of the log, see logger.h. Opening the file truncates it.
+
+        */
+        static void configure_log(const slab_config_js&);
+
         /**
          .. cpp:function:: void dft_r2c(const twodads::field_t, const size_t)
 
@@ -165,6 +201,37 @@ class slab_bc
         */
         void initialize();
 
+        /**
+         .. cpp:function:: void init_from_file(const twodads::dyn_field_t fname, const size_t snapshot, const size_t tidx)
+
+         :param const dyn_field_t fname: Name of the field to initialize.
+         :param const size_t snapshot: Number of the snapshot in the output file.
+         :param const size_t tidx: Time index where the field is written to.
+
+         Reads a snapshot of the field from the output file given by init_file in the configuration and
+         interpolates it onto the grid of the slab, see regrid. The file may have a different resolution 
+         but has to cover the same domain. Logarithmic formulations of the field in the file and in the slab 
+         are converted. Called by initialize for fields with init_func file.
+
+        */
+        void init_from_file(const twodads::dyn_field_t, const size_t, const size_t);
+
+        /**
+         .. cpp:function:: void regrid(arr_real& src, arr_real& dst, const size_t tidx)
+
+         :param arr_real& src: Real field on the source grid, time index 0. Overwritten.
+         :param arr_real& dst: Array on the destination grid.
+         :param const size_t tidx: Time index of dst where the interpolated field is written to.
+
+         Interpolates a real field onto a grid of different resolution over the same domain. In the 
+         y-direction the Fourier modes are truncated or padded with zeros. In the x-direction the field
+         is interpolated with Lagrange polynomials of degree 5, periodic for vertex-centered grids and with
+         one-sided stencils at the boundaries otherwise.
+         It should really be private, but then nvcc complains about the __device__ lambdas.
+
+        */
+        void regrid(arr_real&, arr_real&, const size_t);
+
         /**
          .. cpp:function:: void invert_laplace(const twodads::field_t, const twodads::field_t, const size_t, const size_t)
 
@@ -205,6 +272,64 @@ class slab_bc
         */
         void integrate(const twodads::dyn_field_t, const size_t);
 
+        /**
+         .. cpp:function:: void integrate(const std::vector<twodads::dyn_field_t>&, const size_t)
+
+         Integrates several fields in time with a given order. Fields with the same time integration
+         parameters and boundary condition types are passed together to integrate_batch of the
+         tint member.
+
+        */
+        void integrate(const std::vector<twodads::dyn_field_t>&, const size_t);
+
+        /**
+         .. cpp:function:: void integrate_stages(const size_t t_src, const size_t t_dst)
+
+         :param const size_t t_src: Time index of the current data of the dynamic fields.
+         :param const size_t t_dst: Time index where the next time step is written to.
+
+         Advances theta, omega, and tau by one step of a single-step scheme, ark or etdrk4. The right hand
+         sides are evaluated at each stage, using t_dst of the dynamic fields as scratch space.
+         Requires the real fields at t_src to be up to date, i.e. call after invert_laplace and update_real_fields.
+         Leaves the fields at t_dst in Fourier space, as integrate does. All three fields need the
+         same time integration parameters and boundary condition types.
+
+        */
+        void integrate_stages(const size_t, const size_t);
+
+        /**
+         .. cpp:function:: void set_deltat(const twodads::real_t)
+
+         Sets the size of the next time step for all integrators. Call once before each time step 
+         when using adaptive time steps.
+
+        */
+        void set_deltat(const twodads::real_t);
+
+        /**
+         .. cpp:function:: twodads::real_t get_deltat_cfl() 
+
+         Returns the largest time step allowed by the CFL condition for the electric drift,
+         max|strmf_y| / dx + max|strmf_x| / dy, and the optional diffusion limit. 
+         Requires strmf_x and strmf_y in real space, i.e. call after update_real_fields.
+
+        */
+        twodads::real_t get_deltat_cfl();
+
+        /**
+         .. cpp:function:: twodads::real_t adapt_deltat(const twodads::real_t)
+
+         Returns the step size to use instead of the given one. The step size is reduced
+         below the CFL limit when it is exceeded and increased by at most a factor of 
+         deltat_growth when the CFL limit allows it. In between the step size is kept, so that
+         the integrators do not need to refactorize their linear systems after each step.
+         With the ark scheme and a tolerance tol > 0, the error estimate of the last step 
+         limits the step size as well. A step whose error estimate exceeds tol is not repeated,
+         only the following steps are shortened.
+
+        */
+        twodads::real_t adapt_deltat(const twodads::real_t);
+
         /**
          .. cpp:function:: void update_real_fields(const size_t)
 
@@ -225,22 +350,124 @@ class slab_bc
          .. cpp:function:: write_output(const size_t, const twodads::real_t)
 
          Writes the output specified in the slab_config_js member.
+         The fields are copied and written by a separate thread, see output_queue_t. 
+         The call blocks only while all buffers of the thread are in use.
+         On a distributed grid the fields are gathered on rank 0, which writes them. Collective.
 
         */
         void write_output(const size_t, const twodads::real_t);
 
+        /**
+         .. cpp:function:: void flush_output()
+
+         Waits until the output of all calls of write_output is written. Rethrows an exception
+         of the output thread.
+
+        */
+        void flush_output();
+
         /**
          .. cpp:function:: diagnose(const size_te, const twodads::real_t)
 
          Calls the diagnostic functions specified in the slab_config_js member.
+         The fields are copied and evaluated by a separate thread, see diagnostic_queue_t. 
+         The call blocks only while all buffers of the thread are in use.
+         On a distributed grid the fields are gathered on rank 0, which evaluates them. Collective.
 
         */
         void diagnose(const size_t, const twodads::real_t);
 
+        /**
+         .. cpp:function:: void wait_diagnostics()
+
+         Waits until the diagnostics of all calls of diagnose are written. Rethrows an exception
+         of the diagnostic routines.
+
+        */
+        void wait_diagnostics();
+
+        /**
+         .. cpp:function:: void write_checkpoint(const std::string& fname, const size_t tstep, const twodads::real_t time, const twodads::real_t dt)
+
+         :param const std::string& fname: Name of the checkpoint file.
+         :param const size_t tstep: Number of the current time step.
+         :param const twodads::real_t time: Current simulation time.
+         :param const twodads::real_t dt: Current step size of the driver, which may differ from the size of the last step.
+
+         Writes a checkpoint that allows to continue the simulation bitwise identically: all time levels
+         of all fields, including the right hand sides and the derived fields, the state of the integrators, 
+         the output counter, and a hash of the configuration. The data is written with one unbuffered call 
+         per time level into a temporary file, which replaces fname when complete.
+
+        */
+        void write_checkpoint(const std::string&, const size_t, const twodads::real_t, const twodads::real_t);
+
+        /**
+         .. cpp:function:: void read_checkpoint(const std::string& fname, size_t& tstep, twodads::real_t& time, twodads::real_t& dt)
+
+         :param const std::string& fname: Name of the checkpoint file.
+         :param size_t& tstep: Number of the time step of the checkpoint.
+         :param twodads::real_t& time: Simulation time of the checkpoint.
+         :param twodads::real_t& dt: Step size of the driver at the checkpoint.
+
+         Restores the state written by write_checkpoint. Replaces initialize and the bootstrap steps of 
+         the multi-step schemes. Throws a config_error if the checkpoint was written with a different geometry, 
+         model, or integrator.
+
+        */
+        void read_checkpoint(const std::string&, size_t&, twodads::real_t&, twodads::real_t&);
+
+        /**
+         .. cpp:function:: bool is_finite() const
+
+         Returns false if non-finite values were found since the construction or the last call of restore_snapshot.
+         dft_c2r checks the fields while normalizing after the inverse DFT, which covers all fields in
+         update_real_fields. Always returns true if 2dads.watchdog.check is false.
+         On a distributed grid the result covers all ranks. Collective.
+
+        */
+        bool is_finite() const;
+
+        /**
+         .. cpp:function:: std::string get_nonfinite_report() const
+
+         Describes the first non-finite value found: field, time level, grid indices, and coordinates, 
+         and the number of non-finite values in that field.
+
+        */
+        std::string get_nonfinite_report() const;
+
+        /**
+         .. cpp:function:: void save_snapshot()
+
+         Copies all time levels of all fields and the state of the integrators to memory, as they are written
+         to a checkpoint. Requires 2dads.watchdog.retries > 0, which allocates the snapshot in the constructor.
+         Throws a config_error otherwise.
+
+        */
+        void save_snapshot();
+
+        /**
+         .. cpp:function:: void restore_snapshot()
+
+         Restores the fields and the integrators from the last snapshot and clears the non-finite values found
+         since, so that a time step can be repeated with a smaller step size.
+
+        */
+        void restore_snapshot();
+
         arr_real* get_array_ptr(const twodads::field_t fname) const {return(get_field_by_name.at(fname));};
 
         const slab_config_js& get_config() {return(conf);};
 
+        /**
+         .. cpp:function:: bool is_root() const
+
+         Returns true if this slab writes output and diagnostics, i.e. it is not distributed or holds rank 0.
+
+        */
+        bool is_root() const;
+
         /**
          .. cpp:function:: void rhs(const size_t, const size_t)
 
@@ -306,10 +533,56 @@ class slab_bc
         */
         void rhs_tau_log(const size_t, const size_t);
     private:
+        // Largest factor by which the step size increases in adapt_deltat. Also sets the
+        // margin below the CFL limit after a reduction of the step size.
+        static constexpr twodads::real_t deltat_growth{1.25};
+        // Largest factor by which the error estimate reduces the step size in adapt_deltat
+        static constexpr twodads::real_t deltat_shrink{0.2};
+
+        // Returns true if the two fields can be integrated with the same linear system
+        bool same_system(const twodads::dyn_field_t, const twodads::dyn_field_t);
+
+        // Bytes of one time level of a field. Used to estimate the bytes touched by the timed regions, see profiler.h
+        size_t get_nbytes_per_t() const {return(theta.get_geom().get_nelem_per_t() * sizeof(value_t));};
+        // Bytes of field data in a checkpoint
+        size_t get_checkpoint_nbytes() const;
 
         const slab_config_js conf;
-        output_h5_t output;
-        diagnostic_t diagnostic;
+
+        // Parameters used in each time step, read once from the configuration. The accessors of slab_config_js 
+        // parse the property tree and allocate, see alloc_guard.h. On a distributed grid they are read
+        // from the configuration of the whole grid, so that all ranks take the same decisions.
+        struct step_params_t
+        {
+            step_params_t(const slab_config_js&);
+
+            twodads::grid_t grid_type;
+            twodads::scheme_t scheme;
+            std::map<twodads::dyn_field_t, twodads::stiff_params_t> tint_params;
+            // Types of the boundary conditions at the left and right boundary of the dynamic fields, see same_system
+            std::map<twodads::dyn_field_t, std::pair<twodads::bc_t, twodads::bc_t>> bc_types;
+            // Only for the fields whose right hand side uses them
+            std::map<twodads::dyn_field_t, std::vector<twodads::real_t>> model_params;
+            twodads::real_t deltax_min;
+            twodads::real_t deltay;
+            twodads::real_t deltat_max;
+            twodads::real_t cfl;
+            twodads::real_t cfl_diff;
+            twodads::real_t tol;
+            bool watchdog_check;
+        };
+        const step_params_t step_params;
+
+#ifdef USE_MPI
+        // Communication with the other ranks, nullptr if the grid is not distributed
+        decomp_mpi_t* decomp;
+#endif //USE_MPI
+        // Only on the root rank, nullptr on the others. See is_root.
+        output_queue_t* output;
+        diagnostic_queue_t* diagnostic;
+        // Owner of myfft and my_derivs if they are shared, see shared_objects_t. nullptr if the slab owns them.
+        shared_objects_t* shared;
+        bool own_derivs{true};
         dft_object_t<twodads::real_t>* myfft;
 
 #ifdef DEVICE
@@ -345,6 +618,22 @@ class slab_bc
         const std::map<twodads::field_t, arr_real*> get_field_by_name;
         const std::map<twodads::dyn_field_t, arr_real*> get_dfield_by_name;
         const std::map<twodads::output_t, arr_real*> get_output_by_name;
+
+        // theta, omega, and tau, and their explicit parts, as passed to integrate_stages of the integrator
+        const std::vector<arr_real*> dyn_fields;
+        const std::vector<arr_real*> dyn_fields_rhs;
+        // Fields passed to integrate_batch. Kept, so that their storage is reused in each step.
+        std::vector<arr_real*> batch_fields;
+        std::vector<const arr_real*> batch_fields_rhs;
+
+        // First non-finite value found in dft_c2r, see is_finite. count is the number of non-finite values in nonfinite_field.
+        utility :: nonfinite_t nonfinite{0, 0, 0};
+        twodads::field_t nonfinite_field{twodads::field_t::f_theta};
+        size_t nonfinite_tidx{0};
+        // Copies of the fields in get_field_by_name and the states of tint_theta, tint_omega, and tint_tau.
+        // Empty if 2dads.watchdog.retries is 0.
+        std::vector<std::pair<arr_real*, arr_real*>> snapshot_fields;
+        std::vector<std::vector<value_t>> snapshot_states;
         
         rhs_func_ptr theta_rhs_func;
         rhs_func_ptr omega_rhs_func;
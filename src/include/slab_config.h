@@ -15,11 +15,15 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <functional>
+#include <vector>
+#include <cstdint>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
 #include "2dads_types.h"
 #include "error.h"
+#include "logger.h"
 
 // For inverse map lookups
 // http://stackoverflow.com/questions/5749073/reverse-map-lookup
@@ -76,6 +80,14 @@ class slab_config_js
     public:
         slab_config_js(std::string); 
 
+        /**
+         .. cpp:function:: slab_config_js(const boost::property_tree::ptree& pt)
+
+         Construct from a configuration that has already been parsed, f.ex. the one stored in an output file.
+
+        */
+        slab_config_js(const boost::property_tree::ptree&);
+
         const boost::property_tree::ptree& get_pt() const  {return(pt);};
 
         /**
@@ -206,6 +218,24 @@ class slab_config_js
         */
         twodads::grid_t get_grid_type() const {return(grid_map.at(pt.get<std::string>("2dads.geometry.grid_type")));};
 
+        /**
+         .. cpp:function:: twodads::real_t get_stretch_x() const
+
+         Returns the stretching parameter of the grid in x-direction, see slab_layout_t::get_x.
+         Values between 0 and 1 cluster the grid points at the domain boundaries. Defaults to 0, 
+         a uniform grid.
+
+        */
+        twodads::real_t get_stretch_x() const {return(pt.get<twodads::real_t>("2dads.geometry.stretch_x", 0.0));};
+
+        /**
+         .. cpp:function:: bool is_subdomain() const
+
+         Returns true for the configurations returned by get_subdomain. Only they may have bc_null boundaries.
+
+        */
+        bool is_subdomain() const {return(pt.get<bool>("2dads.geometry.subdomain", false));};
+
         /**
          .. cpp:function:: twodads::dft_t get_dft_t() const
 
@@ -243,12 +273,37 @@ class slab_config_js
         twodads::slab_layout_t get_geom() const
         {
             twodads::slab_layout_t sl(get_xleft(), get_deltax(), get_ylow(), get_deltay(),
-                                      get_nx(), get_pad_x(), get_my(), get_pad_y(), get_grid_type());
+                                      get_nx(), get_pad_x(), get_my(), get_pad_y(), get_grid_type(), get_stretch_x());
             return(sl);
         };
 
         std::string get_scheme() const {return(pt.get<std::string>("2dads.integrator.scheme"));};
 
+        /**
+         .. cpp:function:: twodads::scheme_t get_scheme_t() const
+
+         Returns the time integration scheme. Defaults to the Karniadakis scheme when 
+         2dads.integrator.scheme is not specified.
+
+        */
+        twodads::scheme_t get_scheme_t() const
+        {
+            return(map_safe_select(pt.get<std::string>("2dads.integrator.scheme", "karniadakis"), scheme_map));
+        };
+
+        /**
+         .. cpp:function:: twodads::solver_t get_solver_t() const
+
+         Returns the solver used for the Laplace inversion and the implicit part of
+         the finite-difference time integration. Defaults to the tridiagonal solver
+         when 2dads.integrator.solver is not specified.
+
+        */
+        twodads::solver_t get_solver_t() const 
+        {
+            return(map_safe_select(pt.get<std::string>("2dads.integrator.solver", "tridiag"), solver_map));
+        };
+
         /**
          .. cpp:function:: twodads::real_t get_deltat() const
 
@@ -265,6 +320,69 @@ class slab_config_js
         */
         twodads::real_t get_tend() const {return(pt.get<twodads::real_t>("2dads.integrator.tend"));};
 
+        /**
+         .. cpp:function:: bool get_adaptive() const
+
+         Returns true if the size of the time step is adapted to the CFL condition. Defaults to false.
+         The initial step size is given by deltat.
+
+        */
+        bool get_adaptive() const {return(pt.get<bool>("2dads.integrator.adaptive", false));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_cfl() const
+
+         Returns the CFL number for adaptive time steps. Defaults to 0.5.
+
+        */
+        twodads::real_t get_cfl() const {return(pt.get<twodads::real_t>("2dads.integrator.cfl", 0.5));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_cfl_diff() const
+
+         Returns the limit on dt * diff * (1 / dx^2 + 1 / dy^2) for adaptive time steps. The diffusion
+         is treated implicitly, so this limits the error rather than ensuring stability.
+         Defaults to 0, which disables the limit.
+
+        */
+        twodads::real_t get_cfl_diff() const {return(pt.get<twodads::real_t>("2dads.integrator.cfl_diff", 0.0));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_deltat_max() const
+
+         Returns the largest time step for adaptive time steps. Defaults to tout.
+
+        */
+        twodads::real_t get_deltat_max() const {return(pt.get<twodads::real_t>("2dads.integrator.deltat_max", get_tout()));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_tol() const
+
+         Returns the tolerance for the embedded error estimate of the ARK scheme with adaptive time steps.
+         Defaults to 0, which disables the error control. The error control does not reject steps,
+         a step with a larger error estimate is kept and the next step size is reduced.
+
+        */
+        twodads::real_t get_tol() const {return(pt.get<twodads::real_t>("2dads.integrator.tol", 0.0));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_hypervisc() const
+
+         Returns the hyperviscosity coefficient hv. The implicit part of the time integration
+         includes -hv * (-nabla^2)^p for all dynamic fields. Defaults to 0, which disables the hyperviscosity.
+
+        */
+        twodads::real_t get_hypervisc() const {return(pt.get<twodads::real_t>("2dads.integrator.hypervisc", 0.0));};
+
+        /**
+         .. cpp:function:: size_t get_hypervisc_order() const
+
+         Returns the order p of the hyperviscosity, which damps Fourier modes with hv * k^(2p).
+         Has to be in the range 2..8. Defaults to 3.
+
+        */
+        size_t get_hypervisc_order() const {return(pt.get<size_t>("2dads.integrator.hypervisc_order", 3));};
+
         /** 
          .. cpp:function:: twodads::real_t get_tdiag() const
 
@@ -273,6 +391,16 @@ class slab_config_js
         */
         twodads::real_t get_tdiag() const {return(pt.get<twodads::real_t>("2dads.diagnostics.tdiag"));};
 
+        /**
+         .. cpp:function:: size_t get_diag_buffers() const
+
+         Returns the number of field snapshots that wait for the diagnostics thread, see diagnostic_queue_t.
+         slab_bc :: diagnose blocks while all of them are in use. 0 evaluates the diagnostics in the calling
+         thread. Defaults to 2. On a distributed grid, values larger than 1 are reduced to 1.
+
+        */
+        size_t get_diag_buffers() const {return(pt.get<size_t>("2dads.diagnostics.buffers", 2));};
+
         /**
          .. cpp:function:: twodads::real_t get_tout() const
 
@@ -281,6 +409,199 @@ class slab_config_js
         */
         twodads::real_t get_tout() const {return(pt.get<twodads::real_t>("2dads.output.tout"));};
 
+        /**
+         .. cpp:function:: size_t get_output_buffers() const
+
+         Returns the number of field snapshots that wait for the output thread, see output_queue_t.
+         slab_bc :: write_output blocks while all of them are in use. 0 writes the output in the calling
+         thread. Defaults to the number of output fields, so that one output does not block.
+         On a distributed grid, values larger than 1 are reduced to 1, so that the fields pass one at a time.
+
+        */
+        size_t get_output_buffers() const {return(pt.get<size_t>("2dads.output.buffers", get_output().size()));};
+
+        /**
+         .. cpp:function:: std::string get_file_prefix() const
+
+         Returns the prefix of the output file and the diagnostics files, f.ex. run1/ writes run1/output.h5.
+         Defaults to an empty string.
+
+        */
+        std::string get_file_prefix() const {return(pt.get<std::string>("2dads.output.prefix", ""));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_tcheck() const
+
+         Returns the time between checkpoints. Defaults to 0, which disables checkpoints.
+
+        */
+        twodads::real_t get_tcheck() const {return(pt.get<twodads::real_t>("2dads.checkpoint.tcheck", 0.0));};
+
+        /**
+         .. cpp:function:: std::string get_checkpoint_file() const
+
+         Returns the name of the checkpoint file. Defaults to checkpoint.bin.
+
+        */
+        std::string get_checkpoint_file() const {return(pt.get<std::string>("2dads.checkpoint.file", "checkpoint.bin"));};
+
+        /**
+         .. cpp:function:: std::string get_restart_file() const
+
+         Returns the name of the checkpoint file to restart the simulation from. Defaults to an empty string,
+         which starts the simulation from the initial conditions.
+
+        */
+        std::string get_restart_file() const {return(pt.get<std::string>("2dads.checkpoint.restart", ""));};
+
+        /**
+         .. cpp:function:: std::string get_profile_file() const
+
+         Returns the name of the file the timing report of the simulation is written to, see profiler.h. 
+         Defaults to an empty string, which disables the timers.
+
+        */
+        std::string get_profile_file() const {return(pt.get<std::string>("2dads.profile.file", ""));};
+
+        /**
+         .. cpp:function:: bool get_profile_counters() const
+
+         Returns true if the timing report includes hardware events, counted with perf_event_open. 
+         Defaults to false.
+
+        */
+        bool get_profile_counters() const {return(pt.get<bool>("2dads.profile.counters", false));};
+
+        /**
+         .. cpp:function:: std::string get_memory_file() const
+
+         Returns the name of the file the memory footprint of the simulation is written to, see footprint.h.
+         Defaults to an empty string, which writes no report.
+
+        */
+        std::string get_memory_file() const {return(pt.get<std::string>("2dads.memory.file", ""));};
+
+        /**
+         .. cpp:function:: logger::level_t get_log_level() const
+
+         Returns the level of the log, see logger.h: error, warning, info, or debug. Defaults to info.
+
+        */
+        logger::level_t get_log_level() const
+        {
+            return(map_safe_select(pt.get<std::string>("2dads.log.level", "info"), log_level_map));
+        }
+
+        /**
+         .. cpp:function:: logger::format_t get_log_format() const
+
+         Returns the format of the log records: text or json. Defaults to text.
+
+        */
+        logger::format_t get_log_format() const
+        {
+            return(map_safe_select(pt.get<std::string>("2dads.log.format", "text"), log_format_map));
+        }
+
+        /**
+         .. cpp:function:: std::string get_log_file() const
+
+         Returns the name of the file the log is written to. Defaults to an empty string, which
+         writes to stdout and stderr.
+
+        */
+        std::string get_log_file() const {return(pt.get<std::string>("2dads.log.file", ""));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_log_interval() const
+
+         Returns the smallest time in seconds between two progress messages of the time steps. Defaults to 1.0.
+
+        */
+        twodads::real_t get_log_interval() const {return(pt.get<twodads::real_t>("2dads.log.interval", 1.0));};
+
+        /**
+         .. cpp:function:: bool get_watchdog_check() const
+
+         Returns true if the fields are checked for non-finite values in each inverse DFT, see slab_bc :: is_finite.
+         Defaults to true.
+
+        */
+        bool get_watchdog_check() const {return(pt.get<bool>("2dads.watchdog.check", true));};
+
+        /**
+         .. cpp:function:: size_t get_watchdog_retries() const
+
+         Returns how often a time step with non-finite values is repeated with a smaller step size before the
+         simulation stops. A positive number keeps a snapshot of all fields in memory, see slab_bc :: save_snapshot.
+         Defaults to 0.
+
+        */
+        size_t get_watchdog_retries() const {return(pt.get<size_t>("2dads.watchdog.retries", 0));};
+
+        /**
+         .. cpp:function:: twodads::real_t get_watchdog_shrink() const
+
+         Returns the factor by which the step size is reduced when a time step is repeated. Defaults to 0.5.
+
+        */
+        twodads::real_t get_watchdog_shrink() const {return(pt.get<twodads::real_t>("2dads.watchdog.shrink", 0.5));};
+
+        /**
+         .. cpp:function:: size_t get_ensemble_threads() const
+
+         Returns the number of ensemble members that run at the same time. Defaults to 0, which runs
+         as many members as there are OpenMP threads.
+
+        */
+        size_t get_ensemble_threads() const {return(pt.get<size_t>("2dads.ensemble.threads", 0));};
+
+        /**
+         .. cpp:function:: std::vector<slab_config_js> get_ensemble_members() const
+
+         Returns the configurations of the members listed in 2dads.ensemble.members. Each entry overrides
+         values of this configuration, with the same structure below 2dads, f.ex. {"model": {"parameters_theta": [...]}}.
+         Arrays are replaced as a whole. Unless overridden, member k writes its files with the prefix memberk_,
+         see get_file_prefix, and the prefix is also put in front of the checkpoint and restart files.
+         Returns an empty vector if there is no ensemble.
+
+        */
+        std::vector<slab_config_js> get_ensemble_members() const;
+
+        /**
+         .. cpp:function:: slab_config_js get_subdomain(const size_t rank, const size_t num_ranks) const
+
+         :param const size_t rank: Index of the subdomain, the MPI rank.
+         :param const size_t num_ranks: Number of subdomains.
+
+         Returns the configuration of one of num_ranks slabs of the x-direction, see decomp_mpi_t. The rows are split
+         evenly in blocks of four, as Nx, the first subdomains get one more block. Boundary conditions at the edges between subdomains
+         are bc_null and the tridiagonal systems are solved with solver_spike_mpi. Checkpoint, restart, log, profile, and
+         memory files get the prefix rankk_. Throws a config_error if this configuration is inconsistent, see check_consistency,
+         and for grids and integrators that can not be decomposed: vertex-centered or stretched grids, schemes other than
+         karniadakis, hyperviscosity, initialization from a file, Nx not a multiple of four, and fewer than four rows per subdomain.
+
+        */
+        slab_config_js get_subdomain(const size_t, const size_t) const;
+
+        /**
+         .. cpp:function:: static std::string get_field_name(const twodads::field_t fname)
+
+         Returns the name of the field as used in the configuration, e.g. theta_x.
+
+        */
+        static std::string get_field_name(const twodads::field_t);
+
+        /**
+         .. cpp:function:: uint64_t get_hash() const
+
+         Returns a hash of the configuration that a checkpoint depends on: geometry, model, and the
+         scheme, level, and solver of the integrator. Time step, end time, output, and diagnostics
+         may change between a checkpoint and the restart.
+
+        */
+        uint64_t get_hash() const;
+
         /**
          .. cpp:function:: bool get_log_theta() const
 
@@ -329,6 +650,15 @@ class slab_config_js
         */
         std::vector<twodads::real_t> get_initc(const twodads::dyn_field_t) const;
 
+        /**
+         .. cpp:function:: std::string get_init_file() const
+
+         Returns the name of the output file from which the fields with init_func file are initialized. 
+         Their initc gives the number of the snapshot in the file. Defaults to init.h5.
+
+        */
+        std::string get_init_file() const {return(pt.get<std::string>("2dads.initial.init_file", "init.h5"));};
+
         /**
          .. cpp:function:: std::vector<twodads::diagnostic_t> get_diagnostics() const
 
@@ -357,7 +687,8 @@ class slab_config_js
         /**
          .. cpp:function:: bool check_consistency() const
 
-        Checks simulation configuration for self-consistency.
+        Checks simulation configuration for self-consistency. Throws config_error if it is not.
+        bc_null, which has no ghost point, is only allowed at the edges of the subdomains, see get_subdomain.
         */
         bool check_consistency() const;
 
@@ -373,6 +704,10 @@ class slab_config_js
         static const std::map<std::string, twodads::rhs_t> rhs_func_map;
         static const std::map<std::string, twodads::bc_t> bc_map;
         static const std::map<std::string, twodads::grid_t> grid_map;
+        static const std::map<std::string, twodads::solver_t> solver_map;
+        static const std::map<std::string, twodads::scheme_t> scheme_map;
+        static const std::map<std::string, logger::level_t> log_level_map;
+        static const std::map<std::string, logger::format_t> log_format_map;
 };
 
 #endif //CONFIG_H
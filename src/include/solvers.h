@@ -4,16 +4,37 @@
 
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 #include <string.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif //_OPENMP
+
 #include "2dads_types.h"
 #include "error.h"
 #include "cucmplx.h"
+#include "logger.h"
 
 #ifdef HOST
 #include "mkl.h"
+#include "fftw3.h"
 #endif //HOST
 
+#ifdef USE_MPI
+// The C++ bindings of MPI declare MPI::HOST, which clashes with -DHOST
+#ifndef OMPI_SKIP_MPICXX
+#define OMPI_SKIP_MPICXX
+#endif
+#ifndef MPICH_SKIP_MPICXX
+#define MPICH_SKIP_MPICXX
+#endif
+#include <mpi.h>
+#endif //USE_MPI
+
 #ifdef __CUDACC__
 #include <cusolverSp.h>
 #include <cublas_v2.h>
@@ -38,9 +59,40 @@
 // * MKL (zgtsv)
 // * Numerical recipies
 // * cuSparse (zgtsv)
+// * FFTW real-to-real DFTs (diagonalizes the system, host only)
+// * Thomas algorithm with stored factorization (host only)
+// * Thomas algorithm with stored factorization, SIMD over Fourier modes (host only)
+// * Thomas algorithm with stored real factorization, SIMD over Fourier modes (host only)
+// * Partitioned (SPIKE) solver, parallel along x (host only)
+// * Partitioned (SPIKE) solver, x distributed over MPI ranks (host only, USE_MPI)
+//
+// banded_real_t solves real banded systems with 2 bw + 1 diagonals, f.ex. for the hyperviscosity
+// in the finite difference time integration. It does not use the tridiagonal interface of elliptic_base_t.
+//
+// create_elliptic selects the implementation at runtime, see twodads::solver_t
 
 namespace solvers
 {
+    // Number of threads available to the solvers and index of the calling thread.
+    // Fall back to a single thread when compiled without OpenMP.
+    inline int get_max_threads()
+    {
+#ifdef _OPENMP
+        return(omp_get_max_threads());
+#else
+        return(1);
+#endif //_OPENMP
+    }
+
+    inline int get_thread_num()
+    {
+#ifdef _OPENMP
+        return(omp_get_thread_num());
+#else
+        return(0);
+#endif //_OPENMP
+    }
+
     // Wrapper data type for cublasHandle_t
 
 #ifdef __CUDACC__
@@ -113,13 +165,88 @@ namespace solvers
                                CuCmplx<twodads::real_t>*, 
                                CuCmplx<twodads::real_t>*) = 0;
 
+            // Solve the same linear system for num_rhs right-hand sides. dst[k] is overwritten with the k-th solution.
+            // The default implementation calls solve for each right-hand side, solvers with stored factorizations
+            // update all right-hand sides in a single sweep.
+            virtual void solve_batch(CuCmplx<twodads::real_t>** dst, const size_t num_rhs, 
+                                     CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                for(size_t k = 0; k < num_rhs; k++)
+                    solve(dst[k], dst[k], diag_l, diag, diag_u);
+            }
+
             int get_my_int() const {return(My_int);};
             int get_my21_int() const {return(My21_int);};
             int get_nx_int() const {return(Nx_int);};
+
+            // Index of the linear system passed to the next call of solve. Solvers that store a 
+            // factorization of the matrix keep one per system, f.ex. one per order of the time integration.
+            // Solvers without a stored factorization ignore it.
+            void set_system(const size_t s) {system_idx = s;};
+            size_t get_system() const {return(system_idx);};
+            // Discard stored factorizations. Call this when the diagonals change.
+            virtual void invalidate() {};
+            // Compute the stored factorization of the current system now. Afterwards solve only reads
+            // data of the solver and may be called from several threads at the same time, f.ex. by the
+            // members of an ensemble. Returns false for solvers that write to a workspace in solve.
+            virtual bool prepare(CuCmplx<twodads::real_t>*, CuCmplx<twodads::real_t>*, CuCmplx<twodads::real_t>*) {return(false);};
         private:
             const int My_int;
             const int My21_int;
             const int Nx_int;
+            size_t system_idx{0};
+    };
+
+
+    // Solvers that store a factorization for each system index.
+    // The factorization of the current system is computed from the diagonals when get_factor
+    // is called for the first time and reused until invalidate is called. Derived classes
+    // define the data of the factorization, factor_t, and implement factorize.
+    template <typename factor_t>
+    class cached_factor_solver_t : public elliptic_base_t
+    {
+        public:
+            cached_factor_solver_t(const twodads::slab_layout_t& _geom) : elliptic_base_t(_geom)
+            {};
+
+            virtual void invalidate()
+            {
+                for(auto& it : factors)
+                    it.is_valid = false;
+            }
+
+            virtual bool prepare(CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                get_factor(diag_l, diag, diag_u);
+                return(true);
+            }
+
+        protected:
+            // Factorization of the current system, see elliptic_base_t :: set_system
+            const factor_t& get_factor(const CuCmplx<twodads::real_t>* diag_l, const CuCmplx<twodads::real_t>* diag, const CuCmplx<twodads::real_t>* diag_u)
+            {
+                if(get_system() >= factors.size())
+                    factors.resize(get_system() + 1);
+                cache_entry_t& entry = factors[get_system()];
+                if(entry.is_valid == false)
+                {
+                    factorize(entry.f, diag_l, diag, diag_u);
+                    entry.is_valid = true;
+                }
+                return(entry.f);
+            }
+
+            // Compute the factorization from the diagonals. The first Nx-1 elements of diag_l and diag_u
+            // are the lower and upper diagonal of all systems, the main diagonal of mode m starts at diag + m * Nx.
+            virtual void factorize(factor_t& f, const CuCmplx<twodads::real_t>* diag_l, const CuCmplx<twodads::real_t>* diag, const CuCmplx<twodads::real_t>* diag_u) = 0;
+
+        private:
+            struct cache_entry_t
+            {
+                factor_t f;
+                bool is_valid{false};
+            };
+            std::vector<cache_entry_t> factors;
     };
 
 
@@ -139,7 +266,7 @@ namespace solvers
                 cudaError_t err;
                 if( (err = cudaMalloc((void**) &d_tmp_mat, static_cast<size_t>(get_nx_int() * get_my21_int()) * sizeof(cuDoubleComplex))) != cudaSuccess)
                 {
-                    std::cerr << "elliptic::elliptic: Failed to allocate " << static_cast<size_t>(get_nx_int() * get_my21_int()) * sizeof(cuDoubleComplex) << " bytes" << std::endl;
+                    LOG_MESSAGE(logger::level_t::error, "elliptic::elliptic: Failed to allocate %zu bytes", static_cast<size_t>(get_nx_int() * get_my21_int()) * sizeof(cuDoubleComplex));
                 }
             };
 
@@ -229,7 +356,11 @@ namespace solvers
         using elliptic_base_t :: get_nx_int;
 
         public:
-            elliptic_mkl_t(const twodads::slab_layout_t& _geom) : elliptic_base_t(_geom) 
+            // The workspace holds copies of the three diagonals for each thread. 
+            // LAPACKE_zgtsv overwrites them, so they are refreshed before each solve.
+            elliptic_mkl_t(const twodads::slab_layout_t& _geom) : elliptic_base_t(_geom),
+                num_threads{get_max_threads()},
+                workspace(3 * static_cast<size_t>(get_nx_int()) * static_cast<size_t>(num_threads))
             {};
             
             virtual void solve(CuCmplx<twodads::real_t>* dummy, 
@@ -244,19 +375,26 @@ namespace solvers
                            lapack_complex_double* diag_l = reinterpret_cast<lapack_complex_double*>(dummy_diag_l);
                            // In contrast to the cublas library, it accepts the input in row-major
                            // format. Thus do not transpose but solve directly.
-                            
-                            // Temporary copy of the diagonals. They get overwritten when calling LAPACKE_zgtsv
-                            // Update the diagonal values into the dummy copies in each iteration of the solver.
-                            lapack_complex_double* diag_l_copy = new lapack_complex_double[get_nx_int()];
-                            lapack_complex_double* diag_u_copy = new lapack_complex_double[get_nx_int()];
-                            lapack_complex_double* diag_copy = new lapack_complex_double[get_nx_int()];
-
-                            for(size_t m = 0; m < static_cast<size_t>(get_my21_int()); m++)
+
+                            const size_t Nx{static_cast<size_t>(get_nx_int())};
+                            const size_t My21{static_cast<size_t>(get_my21_int())};
+                            // Exceptions may not leave the parallel region. Store the first error
+                            // code of LAPACKE_zgtsv and throw after all modes are solved.
+                            lapack_int res_err{0};
+
+                            // The Fourier modes are independent linear systems, distribute them over the threads.
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+                            for(size_t m = 0; m < My21; m++)
                             { 
                                 lapack_int res{0};
-                                memcpy(diag_l_copy, diag_l, static_cast<size_t>(get_nx_int()) * sizeof(lapack_complex_double));
-                                memcpy(diag_u_copy, diag_u, static_cast<size_t>(get_nx_int()) * sizeof(lapack_complex_double));
-                                memcpy(diag_copy, diag + m * static_cast<size_t>(get_nx_int()), static_cast<size_t>(get_nx_int()) * sizeof(lapack_complex_double));
+                                // Temporary copy of the diagonals in the workspace of this thread.
+                                lapack_complex_double* diag_l_copy = workspace.data() + 3 * Nx * static_cast<size_t>(get_thread_num());
+                                lapack_complex_double* diag_copy = diag_l_copy + Nx;
+                                lapack_complex_double* diag_u_copy = diag_copy + Nx;
+
+                                memcpy(diag_l_copy, diag_l, Nx * sizeof(lapack_complex_double));
+                                memcpy(diag_u_copy, diag_u, Nx * sizeof(lapack_complex_double));
+                                memcpy(diag_copy, diag + m * Nx, Nx * sizeof(lapack_complex_double));
 
                                 if((res = LAPACKE_zgtsv(LAPACK_ROW_MAJOR,
                                                         get_nx_int(),
@@ -267,15 +405,30 @@ namespace solvers
                                                         dst + m, 
                                                         get_my21_int())) != 0)
                                 {
-                                    std :: stringstream err_msg;
-                                    err_msg << "MKL LAPACK_zgtsv: Parameter " << res << " had an illegal value";
-                                    throw(mkl_zgtsv_exception(err_msg.str()));
+#pragma omp critical
+                                    {
+                                        if(res_err == 0)
+                                            res_err = res;
+                                    }
                                 }
                             } 
-                            delete [] diag_copy;
-                            delete [] diag_u_copy;
-                            delete [] diag_l_copy;
+
+                            if(res_err != 0)
+                            {
+                                std :: stringstream err_msg;
+                                // Negative values index an illegal parameter, positive values a zero pivot
+                                if(res_err < 0)
+                                    err_msg << "MKL LAPACK_zgtsv: Parameter " << -res_err << " had an illegal value";
+                                else
+                                    err_msg << "MKL LAPACK_zgtsv: Zero pivot in row " << res_err << ", the system is singular";
+                                throw(mkl_zgtsv_exception(err_msg.str()));
+                            }
                        }
+
+        private:
+            // Number of threads the workspace is allocated for
+            const int num_threads;
+            std::vector<lapack_complex_double> workspace;
     };
 #endif //__CUDACC__
 
@@ -288,7 +441,9 @@ namespace solvers
         using elliptic_base_t :: get_nx_int;
 
         public:
-            elliptic_nr_t(const twodads::slab_layout_t& _geom) : elliptic_base_t(_geom)
+            // The workspace holds gamma of the current system
+            elliptic_nr_t(const twodads::slab_layout_t& _geom) : elliptic_base_t(_geom),
+                gamma(static_cast<size_t>(get_nx_int()))
             {};
 
             virtual void solve(CuCmplx<twodads::real_t>* src, CuCmplx<twodads::real_t>* dst,
@@ -303,7 +458,6 @@ namespace solvers
 
                 size_t j{0};
                 CuCmplx<twodads::real_t> beta;
-                std::vector<CuCmplx<twodads::real_t>> gamma(get_nx_int());
 
                 for(size_t m = 0; m < static_cast<size_t>(get_my21_int()); m++)
                 {
@@ -328,8 +482,1348 @@ namespace solvers
                     }
                 }
             }
+
+        private:
+            std::vector<CuCmplx<twodads::real_t>> gamma;
     };
 
+    // Thomas algorithm with stored factorization.
+    // The LU decomposition of each system is computed on the first call of solve for a 
+    // given system index and reused afterwards. Subsequent solves only perform 
+    // the forward and backward substitution.
+
+    // LU factors of the linear systems for all Fourier modes.
+    // gamma_j = c_{j-1} / beta_{j-1} and 1 / beta_j, with beta_j = b_j - a_j gamma_j
+    // the pivots of the elimination. Stored contiguously for each mode: idx = m * Nx + j.
+    // The lower diagonal, a, is the same for all modes.
+    struct thomas_factor_t
+    {
+        std::vector<CuCmplx<twodads::real_t>> a;
+        std::vector<CuCmplx<twodads::real_t>> gamma;
+        std::vector<CuCmplx<twodads::real_t>> inv_beta;
+    };
+
+    class elliptic_thomas_t : public cached_factor_solver_t<thomas_factor_t>
+    {
+        /**
+         .. cpp:class:: elliptic_thomas_t : public cached_factor_solver_t<thomas_factor_t>
+
+         Tridiagonal solver that stores the factorization of the linear systems. The factorization
+         of the system selected by set_system is computed from the diagonals on the first call of solve.
+         Later calls ignore the diagonals until invalidate is called. Each system requires 
+         storage for 2 Nx My21 + Nx complex numbers.
+
+        */
+        using elliptic_base_t :: get_my_int;
+        using elliptic_base_t :: get_my21_int;
+        using elliptic_base_t :: get_nx_int;
+        using factor_t = thomas_factor_t;
+
+        public:
+            elliptic_thomas_t(const twodads::slab_layout_t& _geom) : cached_factor_solver_t<factor_t>(_geom)
+            {};
+
+            virtual void solve(CuCmplx<twodads::real_t>* dummy, CuCmplx<twodads::real_t>* dst,
+                               CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                const factor_t& f = get_factor(diag_l, diag, diag_u);
+
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const CuCmplx<twodads::real_t>* a{f.a.data()};
+
+#pragma omp parallel for schedule(static)
+                for(size_t m = 0; m < My21; m++)
+                {
+                    // Pointers to the factorization of the current system.
+                    const CuCmplx<twodads::real_t>* inv_beta{f.inv_beta.data() + m * Nx};
+                    const CuCmplx<twodads::real_t>* gamma{f.gamma.data() + m * Nx};
+                    // Forward substitution
+                    dst[m] = dst[m] * inv_beta[0];
+                    for(size_t j = 1; j < Nx; j++)
+                        dst[j * My21 + m] = (dst[j * My21 + m] - a[j] * dst[(j - 1) * My21 + m]) * inv_beta[j];
+                    // Backward substitution
+                    for(size_t j = Nx - 1; j > 0; j--)
+                        dst[(j - 1) * My21 + m] -= gamma[j] * dst[j * My21 + m];
+                }
+            }
+
+        private:
+            // Complex reciprocal 1 / z = conj(z) / |z|^2
+            static CuCmplx<twodads::real_t> reciprocal(const CuCmplx<twodads::real_t> z)
+            {
+                return(z.conj() / (z.re() * z.re() + z.im() * z.im()));
+            }
+
+            // Follow the conventions of elliptic_mkl_t, see cached_factor_solver_t :: factorize.
+            virtual void factorize(factor_t& f, const CuCmplx<twodads::real_t>* diag_l, const CuCmplx<twodads::real_t>* diag, const CuCmplx<twodads::real_t>* diag_u)
+            {
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+
+                f.a.resize(Nx);
+                f.gamma.resize(Nx * My21);
+                f.inv_beta.resize(Nx * My21);
+
+                f.a[0] = CuCmplx<twodads::real_t>(0.0, 0.0);
+                for(size_t j = 1; j < Nx; j++)
+                    f.a[j] = diag_l[j - 1];
+
+                for(size_t m = 0; m < My21; m++)
+                {
+                    const CuCmplx<twodads::real_t>* b{diag + m * Nx};
+                    CuCmplx<twodads::real_t>* gamma{f.gamma.data() + m * Nx};
+                    CuCmplx<twodads::real_t>* inv_beta{f.inv_beta.data() + m * Nx};
+                    CuCmplx<twodads::real_t> beta{b[0]};
+
+                    gamma[0] = CuCmplx<twodads::real_t>(0.0, 0.0);
+                    if(beta.abs() < twodads::epsilon)
+                        throw numerics_error("elliptic_thomas_t :: factorize: Zero pivot");
+                    inv_beta[0] = reciprocal(beta);
+                    for(size_t j = 1; j < Nx; j++)
+                    {
+                        gamma[j] = diag_u[j - 1] * inv_beta[j - 1];
+                        beta = b[j] - f.a[j] * gamma[j];
+                        if(beta.abs() < twodads::epsilon)
+                            throw numerics_error("elliptic_thomas_t :: factorize: Zero pivot");
+                        inv_beta[j] = reciprocal(beta);
+                    }
+                }
+            }
+    };
+
+    // Thomas algorithm with stored factorization, vectorized over the Fourier modes.
+    // In the layout n * My21 + m the systems for consecutive modes are interleaved with unit stride.
+    // The substitution sweeps over n and updates a block of modes with SIMD instructions.
+    // No transposition of the right-hand side is required.
+
+    // LU factors of elliptic_thomas_simd_t, see thomas_factor_t.
+    // gamma and 1 / beta are stored as idx = n * My21 + m, with real and imaginary
+    // parts in separate arrays.
+    struct thomas_simd_factor_t
+    {
+        std::vector<CuCmplx<twodads::real_t>> a;
+        std::vector<twodads::real_t> gamma_re;
+        std::vector<twodads::real_t> gamma_im;
+        std::vector<twodads::real_t> inv_beta_re;
+        std::vector<twodads::real_t> inv_beta_im;
+    };
+
+    class elliptic_thomas_simd_t : public cached_factor_solver_t<thomas_simd_factor_t>
+    {
+        /**
+         .. cpp:class:: elliptic_thomas_simd_t : public cached_factor_solver_t<thomas_simd_factor_t>
+
+         Same algorithm as elliptic_thomas_t, but the factors are stored in the layout 
+         of the right-hand side, idx = n * My21 + m, with separate arrays for real and imaginary part. The modes are divided into blocks of block_size,
+         blocks are distributed over OpenMP threads. Within a block each sweep over n updates 
+         all modes of a row with SIMD instructions.
+
+        */
+        using elliptic_base_t :: get_my_int;
+        using elliptic_base_t :: get_my21_int;
+        using elliptic_base_t :: get_nx_int;
+        using factor_t = thomas_simd_factor_t;
+
+        public:
+            // Number of modes updated by one thread in a sweep
+            static constexpr size_t block_size{64};
+
+            elliptic_thomas_simd_t(const twodads::slab_layout_t& _geom) : cached_factor_solver_t<factor_t>(_geom)
+            {};
+
+            virtual void solve(CuCmplx<twodads::real_t>* dummy, CuCmplx<twodads::real_t>* dst,
+                               CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                solve_batch(&dst, 1, diag_l, diag, diag_u);
+            }
+
+            // Sweep over all right-hand sides at each row, the factors of the row are loaded once.
+            virtual void solve_batch(CuCmplx<twodads::real_t>** dst, const size_t num_rhs,
+                                     CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                const factor_t& f = get_factor(diag_l, diag, diag_u);
+
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const size_t num_blocks{(My21 + block_size - 1) / block_size};
+                const CuCmplx<twodads::real_t>* a{f.a.data()};
+                const twodads::real_t* gamma_re{f.gamma_re.data()};
+                const twodads::real_t* gamma_im{f.gamma_im.data()};
+                const twodads::real_t* inv_beta_re{f.inv_beta_re.data()};
+                const twodads::real_t* inv_beta_im{f.inv_beta_im.data()};
+                // Access real and imaginary part of the right-hand side directly. This allows the 
+                // compiler to vectorize the complex arithmetic in the loops over m.
+
+#pragma omp parallel for schedule(static)
+                for(size_t b = 0; b < num_blocks; b++)
+                {
+                    const size_t m_lo{b * block_size};
+                    const size_t m_hi{std::min(m_lo + block_size, My21)};
+                    // Forward substitution: u_0 = r_0 / beta_0, u_n = (r_n - a_n u_{n-1}) / beta_n
+                    for(size_t k = 0; k < num_rhs; k++)
+                    {
+                        twodads::real_t* rhs{reinterpret_cast<twodads::real_t*>(dst[k])};
+#pragma omp simd
+                        for(size_t m = m_lo; m < m_hi; m++)
+                        {
+                            const twodads::real_t r_re{rhs[2 * m]};
+                            const twodads::real_t r_im{rhs[2 * m + 1]};
+                            rhs[2 * m] = r_re * inv_beta_re[m] - r_im * inv_beta_im[m];
+                            rhs[2 * m + 1] = r_re * inv_beta_im[m] + r_im * inv_beta_re[m];
+                        }
+                    }
+                    for(size_t n = 1; n < Nx; n++)
+                    {
+                        const twodads::real_t* ib_re{inv_beta_re + n * My21};
+                        const twodads::real_t* ib_im{inv_beta_im + n * My21};
+                        const twodads::real_t a_re{a[n].re()};
+                        const twodads::real_t a_im{a[n].im()};
+                        for(size_t k = 0; k < num_rhs; k++)
+                        {
+                            twodads::real_t* row{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * n * My21};
+                            const twodads::real_t* row_prev{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * (n - 1) * My21};
+#pragma omp simd
+                            for(size_t m = m_lo; m < m_hi; m++)
+                            {
+                                const twodads::real_t r_re{row[2 * m] - a_re * row_prev[2 * m] + a_im * row_prev[2 * m + 1]};
+                                const twodads::real_t r_im{row[2 * m + 1] - a_re * row_prev[2 * m + 1] - a_im * row_prev[2 * m]};
+                                row[2 * m] = r_re * ib_re[m] - r_im * ib_im[m];
+                                row[2 * m + 1] = r_re * ib_im[m] + r_im * ib_re[m];
+                            }
+                        }
+                    }
+                    // Backward substitution: u_{n-1} -= gamma_n u_n
+                    for(size_t n = Nx - 1; n > 0; n--)
+                    {
+                        const twodads::real_t* g_re{gamma_re + n * My21};
+                        const twodads::real_t* g_im{gamma_im + n * My21};
+                        for(size_t k = 0; k < num_rhs; k++)
+                        {
+                            twodads::real_t* row{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * (n - 1) * My21};
+                            const twodads::real_t* row_next{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * n * My21};
+#pragma omp simd
+                            for(size_t m = m_lo; m < m_hi; m++)
+                            {
+                                row[2 * m] -= g_re[m] * row_next[2 * m] - g_im[m] * row_next[2 * m + 1];
+                                row[2 * m + 1] -= g_re[m] * row_next[2 * m + 1] + g_im[m] * row_next[2 * m];
+                            }
+                        }
+                    }
+                }
+            }
+
+        private:
+            // The main diagonal of mode m is stored at diag + m * Nx, see elliptic_mkl_t.
+            virtual void factorize(factor_t& f, const CuCmplx<twodads::real_t>* diag_l, const CuCmplx<twodads::real_t>* diag, const CuCmplx<twodads::real_t>* diag_u)
+            {
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+
+                f.a.resize(Nx);
+                f.gamma_re.resize(Nx * My21);
+                f.gamma_im.resize(Nx * My21);
+                f.inv_beta_re.resize(Nx * My21);
+                f.inv_beta_im.resize(Nx * My21);
+
+                f.a[0] = CuCmplx<twodads::real_t>(0.0, 0.0);
+                for(size_t n = 1; n < Nx; n++)
+                    f.a[n] = diag_l[n - 1];
+
+                twodads::real_t min_pivot{std::numeric_limits<twodads::real_t>::max()};
+                for(size_t m = 0; m < My21; m++)
+                {
+                    // beta_0 = b_0, gamma_0 = 0
+                    CuCmplx<twodads::real_t> inv_beta{diag[m * Nx]};
+                    min_pivot = std::min(min_pivot, inv_beta.abs());
+                    inv_beta = inv_beta.conj() / (inv_beta.re() * inv_beta.re() + inv_beta.im() * inv_beta.im());
+                    f.gamma_re[m] = 0.0;
+                    f.gamma_im[m] = 0.0;
+                    f.inv_beta_re[m] = inv_beta.re();
+                    f.inv_beta_im[m] = inv_beta.im();
+                    for(size_t n = 1; n < Nx; n++)
+                    {
+                        // gamma_n = c_{n-1} / beta_{n-1}, beta_n = b_n - a_n gamma_n
+                        const CuCmplx<twodads::real_t> gamma{diag_u[n - 1] * inv_beta};
+                        const CuCmplx<twodads::real_t> beta{diag[m * Nx + n] - f.a[n] * gamma};
+                        min_pivot = std::min(min_pivot, beta.abs());
+                        inv_beta = beta.conj() / (beta.re() * beta.re() + beta.im() * beta.im());
+                        f.gamma_re[n * My21 + m] = gamma.re();
+                        f.gamma_im[n * My21 + m] = gamma.im();
+                        f.inv_beta_re[n * My21 + m] = inv_beta.re();
+                        f.inv_beta_im[n * My21 + m] = inv_beta.im();
+                    }
+                }
+                if(min_pivot < twodads::epsilon)
+                    throw numerics_error("elliptic_thomas_simd_t :: factorize: Zero pivot");
+            }
+    };
+
+    // Thomas algorithm for systems with real coefficients and complex right-hand side.
+    // The diagonals of the Laplace operator and of the implicit time step are real. Storing
+    // the factors as real numbers halves their memory and replaces the complex products
+    // in the substitution by real-by-complex products.
+
+    // Real LU factors of elliptic_thomas_real_t, gamma and 1 / beta are stored as idx = n * My21 + m.
+    struct thomas_real_factor_t
+    {
+        std::vector<twodads::real_t> a;
+        // Upper diagonal, only used by factorize
+        std::vector<twodads::real_t> c;
+        std::vector<twodads::real_t> gamma;
+        std::vector<twodads::real_t> inv_beta;
+    };
+
+    class elliptic_thomas_real_t : public cached_factor_solver_t<thomas_real_factor_t>
+    {
+        /**
+         .. cpp:class:: elliptic_thomas_real_t : public cached_factor_solver_t<thomas_real_factor_t>
+
+         Same algorithm and data layout as elliptic_thomas_simd_t, but the factors are real.
+         Throws a numerics_error if a diagonal passed to solve has a non-vanishing imaginary part.
+
+        */
+        using elliptic_base_t :: get_my_int;
+        using elliptic_base_t :: get_my21_int;
+        using elliptic_base_t :: get_nx_int;
+        using factor_t = thomas_real_factor_t;
+
+        public:
+            // Number of modes updated by one thread in a sweep
+            static constexpr size_t block_size{64};
+
+            elliptic_thomas_real_t(const twodads::slab_layout_t& _geom) : cached_factor_solver_t<factor_t>(_geom)
+            {};
+
+            virtual void solve(CuCmplx<twodads::real_t>* dummy, CuCmplx<twodads::real_t>* dst,
+                               CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                solve_batch(&dst, 1, diag_l, diag, diag_u);
+            }
+
+            // Sweep over all right-hand sides at each row, the factors of the row are loaded once.
+            virtual void solve_batch(CuCmplx<twodads::real_t>** dst, const size_t num_rhs,
+                                     CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                const factor_t& f = get_factor(diag_l, diag, diag_u);
+
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const size_t num_blocks{(My21 + block_size - 1) / block_size};
+                const twodads::real_t* a{f.a.data()};
+                const twodads::real_t* gamma{f.gamma.data()};
+                const twodads::real_t* inv_beta{f.inv_beta.data()};
+
+#pragma omp parallel for schedule(static)
+                for(size_t b = 0; b < num_blocks; b++)
+                {
+                    const size_t m_lo{b * block_size};
+                    const size_t m_hi{std::min(m_lo + block_size, My21)};
+                    // Forward substitution: u_0 = r_0 / beta_0, u_n = (r_n - a_n u_{n-1}) / beta_n
+                    for(size_t k = 0; k < num_rhs; k++)
+                    {
+                        twodads::real_t* rhs{reinterpret_cast<twodads::real_t*>(dst[k])};
+#pragma omp simd
+                        for(size_t m = m_lo; m < m_hi; m++)
+                        {
+                            rhs[2 * m] *= inv_beta[m];
+                            rhs[2 * m + 1] *= inv_beta[m];
+                        }
+                    }
+                    for(size_t n = 1; n < Nx; n++)
+                    {
+                        const twodads::real_t* ib{inv_beta + n * My21};
+                        const twodads::real_t a_n{a[n]};
+                        for(size_t k = 0; k < num_rhs; k++)
+                        {
+                            twodads::real_t* row{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * n * My21};
+                            const twodads::real_t* row_prev{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * (n - 1) * My21};
+#pragma omp simd
+                            for(size_t m = m_lo; m < m_hi; m++)
+                            {
+                                row[2 * m] = (row[2 * m] - a_n * row_prev[2 * m]) * ib[m];
+                                row[2 * m + 1] = (row[2 * m + 1] - a_n * row_prev[2 * m + 1]) * ib[m];
+                            }
+                        }
+                    }
+                    // Backward substitution: u_{n-1} -= gamma_n u_n
+                    for(size_t n = Nx - 1; n > 0; n--)
+                    {
+                        const twodads::real_t* g{gamma + n * My21};
+                        for(size_t k = 0; k < num_rhs; k++)
+                        {
+                            twodads::real_t* row{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * (n - 1) * My21};
+                            const twodads::real_t* row_next{reinterpret_cast<twodads::real_t*>(dst[k]) + 2 * n * My21};
+#pragma omp simd
+                            for(size_t m = m_lo; m < m_hi; m++)
+                            {
+                                row[2 * m] -= g[m] * row_next[2 * m];
+                                row[2 * m + 1] -= g[m] * row_next[2 * m + 1];
+                            }
+                        }
+                    }
+                }
+            }
+
+        private:
+            // Test whether the imaginary part of a coefficient vanishes
+            static twodads::real_t real_part(const CuCmplx<twodads::real_t> z)
+            {
+                if(std::fabs(z.im()) > twodads::epsilon * std::fabs(z.re()))
+                    throw numerics_error("elliptic_thomas_real_t :: factorize: Complex coefficient in tridiagonal matrix");
+                return(z.re());
+            }
+
+            // The main diagonal of mode m is stored at diag + m * Nx, see elliptic_mkl_t.
+            virtual void factorize(factor_t& f, const CuCmplx<twodads::real_t>* diag_l, const CuCmplx<twodads::real_t>* diag, const CuCmplx<twodads::real_t>* diag_u)
+            {
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+
+                f.a.resize(Nx);
+                f.c.resize(Nx);
+                f.gamma.resize(Nx * My21);
+                f.inv_beta.resize(Nx * My21);
+
+                std::vector<twodads::real_t>& c = f.c;
+                f.a[0] = 0.0;
+                c[Nx - 1] = 0.0;
+                for(size_t n = 1; n < Nx; n++)
+                {
+                    f.a[n] = real_part(diag_l[n - 1]);
+                    c[n - 1] = real_part(diag_u[n - 1]);
+                }
+
+                twodads::real_t min_pivot{std::numeric_limits<twodads::real_t>::max()};
+                for(size_t m = 0; m < My21; m++)
+                {
+                    // beta_0 = b_0, gamma_0 = 0
+                    twodads::real_t beta{real_part(diag[m * Nx])};
+                    min_pivot = std::min(min_pivot, std::fabs(beta));
+                    f.gamma[m] = 0.0;
+                    f.inv_beta[m] = 1.0 / beta;
+                    for(size_t n = 1; n < Nx; n++)
+                    {
+                        // gamma_n = c_{n-1} / beta_{n-1}, beta_n = b_n - a_n gamma_n
+                        const twodads::real_t gamma{c[n - 1] * f.inv_beta[(n - 1) * My21 + m]};
+                        beta = real_part(diag[m * Nx + n]) - f.a[n] * gamma;
+                        min_pivot = std::min(min_pivot, std::fabs(beta));
+                        f.gamma[n * My21 + m] = gamma;
+                        f.inv_beta[n * My21 + m] = 1.0 / beta;
+                    }
+                }
+                if(min_pivot < twodads::epsilon)
+                    throw numerics_error("elliptic_thomas_real_t :: factorize: Zero pivot");
+            }
+    };
+
+    // Partitioned (SPIKE-type) tridiagonal solver, parallel in n.
+    // The rows are split into num_parts chunks, separated by a single row. Each chunk
+    // is solved independently. Eliminating the chunks leaves a tridiagonal system with
+    // one unknown per separator, which is solved serially. The solution in each chunk
+    // is then corrected with the separator values.
+    // Use this when there are fewer Fourier modes than threads, f.ex. large Nx and small My.
+
+    // Factorization of elliptic_spike_t.
+    // a, c: lower and upper diagonal, same for all modes. a[n] couples x_n to x_{n-1}, c[n] to x_{n+1}.
+    // gamma, inv_beta: LU factors of the chunks, v, w: spikes. Stored as idx = n * My21 + m.
+    // red_a, red_gamma, red_inv_beta: Lower diagonal and LU factors of the reduced system, 
+    // stored as idx = (k - 1) * My21 + m for separator k.
+    struct spike_factor_t
+    {
+        std::vector<CuCmplx<twodads::real_t>> a;
+        std::vector<CuCmplx<twodads::real_t>> c;
+        std::vector<CuCmplx<twodads::real_t>> gamma;
+        std::vector<CuCmplx<twodads::real_t>> inv_beta;
+        std::vector<CuCmplx<twodads::real_t>> v;
+        std::vector<CuCmplx<twodads::real_t>> w;
+        std::vector<CuCmplx<twodads::real_t>> red_a;
+        std::vector<CuCmplx<twodads::real_t>> red_gamma;
+        std::vector<CuCmplx<twodads::real_t>> red_inv_beta;
+    };
+
+    class elliptic_spike_t : public cached_factor_solver_t<spike_factor_t>
+    {
+        /**
+         .. cpp:class:: elliptic_spike_t : public cached_factor_solver_t<spike_factor_t>
+
+         Partitioned solver for the tridiagonal systems. The x-direction is split into num_parts chunks 
+         :math:`n \in [n_{\mathrm{lo}}, n_{\mathrm{hi}})`, separated by single rows :math:`s_k = n_{\mathrm{hi}}^{k-1}`.
+         On the chunk, the solution is written as
+
+         .. math::
+
+            x = y - v x_{s_k} - w x_{s_{k+1}}
+
+         where :math:`A_k y = r`, :math:`A_k v = a_{n_{\mathrm{lo}}} e_0`, :math:`A_k w = c_{n_{\mathrm{hi}} - 1} e_\mathrm{last}`.
+         The spikes v, w and the LU factors of the chunks and of the reduced system for the separators
+         are computed in the first solve for a system index, see elliptic_thomas_t.
+
+        */
+        using elliptic_base_t :: get_my_int;
+        using elliptic_base_t :: get_my21_int;
+        using elliptic_base_t :: get_nx_int;
+        using factor_t = spike_factor_t;
+
+        public:
+            // Minimal number of rows in a chunk
+            static constexpr size_t min_rows{16};
+
+            /**
+             .. cpp:function:: elliptic_spike_t(const twodads::slab_layout_t& _geom, const size_t _num_parts = get_max_threads())
+
+             :param const twodads::slab_layout_t& _geom: Layout of the real fields
+             :param const size_t _num_parts: Number of chunks. Reduced so that each chunk has at least min_rows rows.
+
+             The chunks are distributed over the OpenMP threads of the calling thread, see get_max_threads.
+             Throws numerics_error if a pivot of the factorization vanishes.
+
+            */
+            elliptic_spike_t(const twodads::slab_layout_t& _geom, const size_t _num_parts = static_cast<size_t>(get_max_threads())) : 
+                cached_factor_solver_t<factor_t>(_geom),
+                num_parts{std::max(std::min(_num_parts, (static_cast<size_t>(get_nx_int()) + 1) / (min_rows + 1)), size_t(1))},
+                part_lo(num_parts), part_hi(num_parts)
+            {
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                // Distribute Nx - (num_parts - 1) rows on the chunks, the remaining rows are separators
+                const size_t num_rows{Nx - (num_parts - 1)};
+                size_t n{0};
+                for(size_t p = 0; p < num_parts; p++)
+                {
+                    part_lo[p] = n;
+                    part_hi[p] = n + num_rows / num_parts + (p < num_rows % num_parts ? 1 : 0);
+                    n = part_hi[p] + 1;
+                }
+            };
+
+            size_t get_num_parts() const {return(num_parts);};
+
+            virtual void solve(CuCmplx<twodads::real_t>* dummy, CuCmplx<twodads::real_t>* dst,
+                               CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                const factor_t& f = get_factor(diag_l, diag, diag_u);
+
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+
+                // Solve A_k y = r on all chunks
+#pragma omp parallel for schedule(static, 1)
+                for(size_t p = 0; p < num_parts; p++)
+                    solve_part(f, p, dst);
+
+                // Reduced system for the separators. Row s_k sees y_{s_k - 1} and y_{s_k + 1}.
+                for(size_t k = 1; k < num_parts; k++)
+                {
+                    const size_t s{part_lo[k] - 1};
+                    const size_t r{k - 1};
+                    for(size_t m = 0; m < My21; m++)
+                    {
+                        CuCmplx<twodads::real_t> rhs{dst[s * My21 + m] - f.a[s] * dst[(s - 1) * My21 + m] - f.c[s] * dst[(s + 1) * My21 + m]};
+                        if(r > 0)
+                            rhs -= f.red_a[r * My21 + m] * dst[(part_lo[k - 1] - 1) * My21 + m];
+                        dst[s * My21 + m] = rhs * f.red_inv_beta[r * My21 + m];
+                    }
+                }
+                for(size_t k = num_parts - 1; k > 1; k--)
+                {
+                    const size_t s{part_lo[k - 1] - 1};
+                    const size_t s_next{part_lo[k] - 1};
+                    for(size_t m = 0; m < My21; m++)
+                        dst[s * My21 + m] -= f.red_gamma[(k - 1) * My21 + m] * dst[s_next * My21 + m];
+                }
+
+                // x = y - v x_{s_k} - w x_{s_{k+1}}
+#pragma omp parallel for schedule(static, 1)
+                for(size_t p = 0; p < num_parts; p++)
+                {
+                    for(size_t n = part_lo[p]; n < part_hi[p]; n++)
+                    {
+                        for(size_t m = 0; m < My21; m++)
+                        {
+                            if(p > 0)
+                                dst[n * My21 + m] -= f.v[n * My21 + m] * dst[(part_lo[p] - 1) * My21 + m];
+                            if(p < num_parts - 1)
+                                dst[n * My21 + m] -= f.w[n * My21 + m] * dst[part_hi[p] * My21 + m];
+                        }
+                    }
+                }
+            }
+
+        private:
+            const size_t num_parts;
+            // Chunk p covers the rows part_lo[p] .. part_hi[p] - 1. Separator rows are part_hi[p].
+            std::vector<size_t> part_lo;
+            std::vector<size_t> part_hi;
+
+            // Complex reciprocal 1 / z = conj(z) / |z|^2. Tracks the smallest pivot, which factorize checks
+            // after the parallel region, as exceptions may not leave it.
+            static CuCmplx<twodads::real_t> reciprocal(const CuCmplx<twodads::real_t> z, twodads::real_t& min_pivot)
+            {
+                min_pivot = std::min(min_pivot, z.abs());
+                return(z.conj() / (z.re() * z.re() + z.im() * z.im()));
+            }
+
+            // Solve A_p x = x in place for all modes, using the LU factors of chunk p
+            void solve_part(const factor_t& f, const size_t p, CuCmplx<twodads::real_t>* x) const
+            {
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const size_t lo{part_lo[p]};
+                const size_t hi{part_hi[p]};
+
+                for(size_t m = 0; m < My21; m++)
+                    x[lo * My21 + m] = x[lo * My21 + m] * f.inv_beta[lo * My21 + m];
+                for(size_t n = lo + 1; n < hi; n++)
+                    for(size_t m = 0; m < My21; m++)
+                        x[n * My21 + m] = (x[n * My21 + m] - f.a[n] * x[(n - 1) * My21 + m]) * f.inv_beta[n * My21 + m];
+                for(size_t n = hi - 1; n > lo; n--)
+                    for(size_t m = 0; m < My21; m++)
+                        x[(n - 1) * My21 + m] -= f.gamma[n * My21 + m] * x[n * My21 + m];
+            }
+
+            // The main diagonal of mode m is stored at diag + m * Nx, see elliptic_mkl_t.
+            virtual void factorize(factor_t& f, const CuCmplx<twodads::real_t>* diag_l, const CuCmplx<twodads::real_t>* diag, const CuCmplx<twodads::real_t>* diag_u)
+            {
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const CuCmplx<twodads::real_t> zero(0.0, 0.0);
+
+                f.a.assign(Nx, zero);
+                f.c.assign(Nx, zero);
+                for(size_t n = 1; n < Nx; n++)
+                {
+                    f.a[n] = diag_l[n - 1];
+                    f.c[n - 1] = diag_u[n - 1];
+                }
+                f.gamma.assign(Nx * My21, zero);
+                f.inv_beta.assign(Nx * My21, zero);
+                f.v.assign(Nx * My21, zero);
+                f.w.assign(Nx * My21, zero);
+                f.red_a.assign((num_parts - 1) * My21, zero);
+                f.red_gamma.assign((num_parts - 1) * My21, zero);
+                f.red_inv_beta.assign((num_parts - 1) * My21, zero);
+                twodads::real_t min_pivot{std::numeric_limits<twodads::real_t>::max()};
+
+                // LU factors and spikes of the chunks
+#pragma omp parallel for schedule(static, 1) reduction(min:min_pivot)
+                for(size_t p = 0; p < num_parts; p++)
+                {
+                    const size_t lo{part_lo[p]};
+                    const size_t hi{part_hi[p]};
+                    for(size_t m = 0; m < My21; m++)
+                    {
+                        f.inv_beta[lo * My21 + m] = reciprocal(diag[m * Nx + lo], min_pivot);
+                        for(size_t n = lo + 1; n < hi; n++)
+                        {
+                            f.gamma[n * My21 + m] = f.c[n - 1] * f.inv_beta[(n - 1) * My21 + m];
+                            f.inv_beta[n * My21 + m] = reciprocal(diag[m * Nx + n] - f.a[n] * f.gamma[n * My21 + m], min_pivot);
+                        }
+                        if(p > 0)
+                            f.v[lo * My21 + m] = f.a[lo];
+                        if(p < num_parts - 1)
+                            f.w[(hi - 1) * My21 + m] = f.c[hi - 1];
+                    }
+                    solve_part(f, p, f.v.data());
+                    solve_part(f, p, f.w.data());
+                }
+
+                // Reduced system for separator k at row s:
+                // (b_s - a_s w_{s-1} - c_s v_{s+1}) x_s - a_s v_{s-1} x_{s_{k-1}} - c_s w_{s+1} x_{s_{k+1}} = r_s - a_s y_{s-1} - c_s y_{s+1}
+                for(size_t m = 0; m < My21; m++)
+                {
+                    for(size_t k = 1; k < num_parts; k++)
+                    {
+                        const size_t s{part_lo[k] - 1};
+                        const size_t r{k - 1};
+                        const CuCmplx<twodads::real_t> b{diag[m * Nx + s] - f.a[s] * f.w[(s - 1) * My21 + m] - f.c[s] * f.v[(s + 1) * My21 + m]};
+                        f.red_a[r * My21 + m] = zero - f.a[s] * f.v[(s - 1) * My21 + m];
+                        if(r == 0)
+                        {
+                            f.red_inv_beta[r * My21 + m] = reciprocal(b, min_pivot);
+                        }
+                        else
+                        {
+                            // Upper diagonal of the previous separator: -c_{s_{k-1}} w_{s_{k-1} + 1}
+                            const size_t s_prev{part_lo[k - 1] - 1};
+                            const CuCmplx<twodads::real_t> c_prev{zero - f.c[s_prev] * f.w[(s_prev + 1) * My21 + m]};
+                            f.red_gamma[r * My21 + m] = c_prev * f.red_inv_beta[(r - 1) * My21 + m];
+                            f.red_inv_beta[r * My21 + m] = reciprocal(b - f.red_a[r * My21 + m] * f.red_gamma[r * My21 + m], min_pivot);
+                        }
+                    }
+                }
+                if(min_pivot < twodads::epsilon)
+                    throw numerics_error("elliptic_spike_t :: factorize: Zero pivot");
+            }
+    };
+
+#ifdef USE_MPI
+    // Partitioned (SPIKE) solver for systems whose rows are distributed over the MPI ranks.
+    // Each rank holds a contiguous block of rows, see slab_config_js :: get_subdomain, and eliminates
+    // its block as elliptic_spike_t eliminates a chunk. The blocks are coupled through the first and
+    // last unknown of each block. These form a block tridiagonal system with 2x2 blocks, which every
+    // rank solves from the ends of the spikes and of the local solutions of all ranks.
+
+    // Factorization of elliptic_spike_mpi_t.
+    // a, c: lower and upper diagonal of the local rows, same for all modes. gamma, inv_beta: LU factors of the
+    // local system, v, w: spikes. Stored as idx = n * My21 + m.
+    // ends: first and last element of v and w of all ranks, idx = (4 p + q) * My21 + m with q = v_0, v_last, w_0, w_last.
+    // red_dinv: inverse of the pivot blocks of the reduced system, 4 elements row-major per interface and mode.
+    // red_m: first row of the multipliers L_j D_{j-1}^{-1}, 2 elements per interface and mode.
+    struct spike_mpi_factor_t
+    {
+        std::vector<CuCmplx<twodads::real_t>> a;
+        std::vector<CuCmplx<twodads::real_t>> c;
+        std::vector<CuCmplx<twodads::real_t>> gamma;
+        std::vector<CuCmplx<twodads::real_t>> inv_beta;
+        std::vector<CuCmplx<twodads::real_t>> v;
+        std::vector<CuCmplx<twodads::real_t>> w;
+        std::vector<CuCmplx<twodads::real_t>> ends;
+        std::vector<CuCmplx<twodads::real_t>> red_dinv;
+        std::vector<CuCmplx<twodads::real_t>> red_m;
+    };
+
+    class elliptic_spike_mpi_t : public cached_factor_solver_t<spike_mpi_factor_t>
+    {
+        /**
+         .. cpp:class:: elliptic_spike_mpi_t : public cached_factor_solver_t<spike_mpi_factor_t>
+
+         Partitioned solver for tridiagonal systems that are distributed over the ranks of an MPI communicator.
+         Rank k holds rows :math:`n \in [0, N_k)` of its subdomain. Its solution is written as
+
+         .. math::
+
+            x = y - v \, l_{k-1} - w \, t_{k+1}
+
+         where :math:`A_k y = r`, :math:`A_k v = a e_0`, :math:`A_k w = c e_\mathrm{last}`, :math:`l_{k-1}` is the last
+         unknown of rank k-1 and :math:`t_{k+1}` the first unknown of rank k+1. The couplings a and c are not stored in the
+         local diagonals. They are taken from the interior rows, which requires a uniform grid in x.
+         The interface unknowns :math:`(l_k, t_{k+1})` satisfy
+
+         .. math::
+
+            l_k + w_\mathrm{last}^k t_{k+1} + v_\mathrm{last}^k l_{k-1} = y_\mathrm{last}^k, \quad
+            v_0^{k+1} l_k + t_{k+1} + w_0^{k+1} t_{k+2} = y_0^{k+1}
+
+         Factorizing a system gathers the ends of v and w of all ranks, each call of solve_batch gathers the ends of y
+         for all right-hand sides. All ranks have to call solve and solve_batch in the same order with the same system index.
+
+        */
+        using elliptic_base_t :: get_my21_int;
+        using elliptic_base_t :: get_nx_int;
+        using factor_t = spike_mpi_factor_t;
+
+        public:
+            /**
+             .. cpp:function:: elliptic_spike_mpi_t(const twodads::slab_layout_t& _geom, MPI_Comm _comm = MPI_COMM_WORLD)
+
+             :param const twodads::slab_layout_t& _geom: Layout of the real fields of the local subdomain, at least two rows
+             :param MPI_Comm _comm: Communicator of the ranks that hold the subdomains, ordered along x
+
+            */
+            elliptic_spike_mpi_t(const twodads::slab_layout_t& _geom, MPI_Comm _comm = MPI_COMM_WORLD) :
+                cached_factor_solver_t<factor_t>(_geom), comm{_comm}
+            {
+                MPI_Comm_rank(comm, &rank);
+                MPI_Comm_size(comm, &num_ranks);
+                if(get_nx_int() < 2)
+                    throw config_error(std::string("elliptic_spike_mpi_t: The subdomain needs at least two rows"));
+            };
+
+            // Factorizing is collective and solve_batch writes to the communication buffers
+            virtual bool prepare(CuCmplx<twodads::real_t>*, CuCmplx<twodads::real_t>*, CuCmplx<twodads::real_t>*) {return(false);};
+
+            virtual void solve(CuCmplx<twodads::real_t>* dummy, CuCmplx<twodads::real_t>* dst,
+                               CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                solve_batch(&dst, 1, diag_l, diag, diag_u);
+            }
+
+            virtual void solve_batch(CuCmplx<twodads::real_t>** dst, const size_t num_rhs, 
+                                     CuCmplx<twodads::real_t>* diag_l, CuCmplx<twodads::real_t>* diag, CuCmplx<twodads::real_t>* diag_u)
+            {
+                const factor_t& f = get_factor(diag_l, diag, diag_u);
+
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const size_t P{static_cast<size_t>(num_ranks)};
+                const size_t k{static_cast<size_t>(rank)};
+
+                // y = A_k^{-1} r
+                for(size_t r = 0; r < num_rhs; r++)
+                    solve_local(f, dst[r]);
+                if(P == 1)
+                    return;
+
+                // First and last row of y for all right-hand sides and ranks
+                send_buf.resize(2 * num_rhs * My21);
+                recv_buf.resize(P * send_buf.size());
+                for(size_t r = 0; r < num_rhs; r++)
+                {
+                    std::copy(dst[r], dst[r] + My21, send_buf.begin() + (2 * r) * My21);
+                    std::copy(dst[r] + (Nx - 1) * My21, dst[r] + Nx * My21, send_buf.begin() + (2 * r + 1) * My21);
+                }
+                MPI_Allgather(send_buf.data(), static_cast<int>(send_buf.size() * sizeof(CuCmplx<twodads::real_t>)), MPI_BYTE,
+                              recv_buf.data(), static_cast<int>(send_buf.size() * sizeof(CuCmplx<twodads::real_t>)), MPI_BYTE, comm);
+
+                // Block Thomas algorithm for the interface unknowns u_j = (l_j, t_{j+1}), j = 0 .. P - 2.
+                // Only l_{k-1} and t_{k+1} are used on this rank.
+                red_work.resize(2 * (P - 1) * My21);
+                for(size_t r = 0; r < num_rhs; r++)
+                {
+                    const CuCmplx<twodads::real_t>* y_ends{recv_buf.data() + 2 * r * My21};
+                    auto y_first = [&] (const size_t p, const size_t m) -> CuCmplx<twodads::real_t> {return(y_ends[p * send_buf.size() + m]);};
+                    auto y_last = [&] (const size_t p, const size_t m) -> CuCmplx<twodads::real_t> {return(y_ends[p * send_buf.size() + My21 + m]);};
+
+#pragma omp parallel for schedule(static)
+                    for(size_t m = 0; m < My21; m++)
+                    {
+                        CuCmplx<twodads::real_t>* g{red_work.data() + 2 * (P - 1) * m};
+                        for(size_t j = 0; j < P - 1; j++)
+                        {
+                            g[2 * j] = y_last(j, m);
+                            g[2 * j + 1] = y_first(j + 1, m);
+                            if(j > 0)
+                                g[2 * j] -= f.red_m[2 * (j * My21 + m)] * g[2 * (j - 1)] + f.red_m[2 * (j * My21 + m) + 1] * g[2 * (j - 1) + 1];
+                        }
+                        for(size_t j = P - 1; j > 0; j--)
+                        {
+                            const CuCmplx<twodads::real_t>* d_inv{f.red_dinv.data() + 4 * ((j - 1) * My21 + m)};
+                            CuCmplx<twodads::real_t> h0{g[2 * (j - 1)]};
+                            CuCmplx<twodads::real_t> h1{g[2 * (j - 1) + 1]};
+                            if(j < P - 1)
+                                h1 -= f.ends[(4 * j + 2) * My21 + m] * g[2 * j + 1];
+                            g[2 * (j - 1)] = d_inv[0] * h0 + d_inv[1] * h1;
+                            g[2 * (j - 1) + 1] = d_inv[2] * h0 + d_inv[3] * h1;
+                        }
+
+                        // x = y - v l_{k-1} - w t_{k+1}
+                        CuCmplx<twodads::real_t>* x{dst[r]};
+                        for(size_t n = 0; n < Nx; n++)
+                        {
+                            if(k > 0)
+                                x[n * My21 + m] -= f.v[n * My21 + m] * g[2 * (k - 1)];
+                            if(k < P - 1)
+                                x[n * My21 + m] -= f.w[n * My21 + m] * g[2 * k + 1];
+                        }
+                    }
+                }
+            }
+
+        private:
+            MPI_Comm comm;
+            int rank;
+            int num_ranks;
+
+            // Ends of the local solutions, sent and gathered in solve_batch, and the interface unknowns of each mode
+            std::vector<CuCmplx<twodads::real_t>> send_buf;
+            std::vector<CuCmplx<twodads::real_t>> recv_buf;
+            std::vector<CuCmplx<twodads::real_t>> red_work;
+
+            static CuCmplx<twodads::real_t> reciprocal(const CuCmplx<twodads::real_t> z)
+            {
+                if(z.abs() < twodads::epsilon)
+                    throw numerics_error("elliptic_spike_mpi_t :: factorize: Zero pivot");
+                return(z.conj() / (z.re() * z.re() + z.im() * z.im()));
+            }
+
+            // Solve A_k x = x in place for all modes, using the LU factors of the local rows
+            void solve_local(const factor_t& f, CuCmplx<twodads::real_t>* x) const
+            {
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+
+#pragma omp parallel for schedule(static)
+                for(size_t m = 0; m < My21; m++)
+                {
+                    x[m] = x[m] * f.inv_beta[m];
+                    for(size_t n = 1; n < Nx; n++)
+                        x[n * My21 + m] = (x[n * My21 + m] - f.a[n] * x[(n - 1) * My21 + m]) * f.inv_beta[n * My21 + m];
+                    for(size_t n = Nx - 1; n > 0; n--)
+                        x[(n - 1) * My21 + m] -= f.gamma[n * My21 + m] * x[n * My21 + m];
+                }
+            }
+
+            // The main diagonal of mode m is stored at diag + m * Nx, see elliptic_mkl_t.
+            virtual void factorize(factor_t& f, const CuCmplx<twodads::real_t>* diag_l, const CuCmplx<twodads::real_t>* diag, const CuCmplx<twodads::real_t>* diag_u)
+            {
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const size_t P{static_cast<size_t>(num_ranks)};
+                const size_t k{static_cast<size_t>(rank)};
+                const CuCmplx<twodads::real_t> zero(0.0, 0.0);
+                const CuCmplx<twodads::real_t> one(1.0, 0.0);
+
+                f.a.assign(Nx, zero);
+                f.c.assign(Nx, zero);
+                for(size_t n = 1; n < Nx; n++)
+                {
+                    f.a[n] = diag_l[n - 1];
+                    f.c[n - 1] = diag_u[n - 1];
+                }
+                f.gamma.assign(Nx * My21, zero);
+                f.inv_beta.assign(Nx * My21, zero);
+                f.v.assign(Nx * My21, zero);
+                f.w.assign(Nx * My21, zero);
+
+                for(size_t m = 0; m < My21; m++)
+                {
+                    f.inv_beta[m] = reciprocal(diag[m * Nx]);
+                    for(size_t n = 1; n < Nx; n++)
+                    {
+                        f.gamma[n * My21 + m] = f.c[n - 1] * f.inv_beta[(n - 1) * My21 + m];
+                        f.inv_beta[n * My21 + m] = reciprocal(diag[m * Nx + n] - f.a[n] * f.gamma[n * My21 + m]);
+                    }
+                    // Couplings to the neighbouring ranks, equal to those of the interior rows on a uniform grid
+                    if(k > 0)
+                        f.v[m] = f.a[1];
+                    if(k < P - 1)
+                        f.w[(Nx - 1) * My21 + m] = f.c[Nx - 2];
+                }
+                solve_local(f, f.v.data());
+                solve_local(f, f.w.data());
+                if(P == 1)
+                    return;
+
+                std::vector<CuCmplx<twodads::real_t>> ends_local(4 * My21);
+                for(size_t m = 0; m < My21; m++)
+                {
+                    ends_local[m] = f.v[m];
+                    ends_local[My21 + m] = f.v[(Nx - 1) * My21 + m];
+                    ends_local[2 * My21 + m] = f.w[m];
+                    ends_local[3 * My21 + m] = f.w[(Nx - 1) * My21 + m];
+                }
+                f.ends.assign(4 * P * My21, zero);
+                MPI_Allgather(ends_local.data(), static_cast<int>(ends_local.size() * sizeof(CuCmplx<twodads::real_t>)), MPI_BYTE,
+                              f.ends.data(), static_cast<int>(ends_local.size() * sizeof(CuCmplx<twodads::real_t>)), MPI_BYTE, comm);
+                auto end = [&] (const size_t p, const size_t q, const size_t m) -> CuCmplx<twodads::real_t> {return(f.ends[(4 * p + q) * My21 + m]);};
+
+                // Block Thomas factorization. D_j = [[1, w_last^j], [v_0^{j+1}, 1]], L_j = [[v_last^j, 0], [0, 0]],
+                // U_j = [[0, 0], [0, w_0^{j+1}]].
+                f.red_dinv.assign(4 * (P - 1) * My21, zero);
+                f.red_m.assign(2 * (P - 1) * My21, zero);
+                for(size_t m = 0; m < My21; m++)
+                {
+                    for(size_t j = 0; j < P - 1; j++)
+                    {
+                        CuCmplx<twodads::real_t> d00{one};
+                        CuCmplx<twodads::real_t> d01{end(j, 3, m)};
+                        const CuCmplx<twodads::real_t> d10{end(j + 1, 0, m)};
+                        const CuCmplx<twodads::real_t> d11{one};
+                        if(j > 0)
+                        {
+                            // M_j = L_j D_{j-1}^{-1}, D_j <- D_j - M_j U_{j-1}
+                            const CuCmplx<twodads::real_t>* d_inv_prev{f.red_dinv.data() + 4 * ((j - 1) * My21 + m)};
+                            const CuCmplx<twodads::real_t> m0{end(j, 1, m) * d_inv_prev[0]};
+                            const CuCmplx<twodads::real_t> m1{end(j, 1, m) * d_inv_prev[1]};
+                            f.red_m[2 * (j * My21 + m)] = m0;
+                            f.red_m[2 * (j * My21 + m) + 1] = m1;
+                            d01 -= m1 * end(j, 2, m);
+                        }
+                        const CuCmplx<twodads::real_t> inv_det{reciprocal(d00 * d11 - d01 * d10)};
+                        CuCmplx<twodads::real_t>* d_inv{f.red_dinv.data() + 4 * (j * My21 + m)};
+                        d_inv[0] = d11 * inv_det;
+                        d_inv[1] = (zero - d01) * inv_det;
+                        d_inv[2] = (zero - d10) * inv_det;
+                        d_inv[3] = d00 * inv_det;
+                    }
+                }
+            }
+    };
+#endif //USE_MPI
+
+    // LU solver for real banded systems, one for each Fourier mode
+    class banded_real_t
+    {
+        /**
+         .. cpp:class:: banded_real_t
+
+         Solves the My21 linear systems :math:`A_m u = r` with real band matrices of half bandwidth bw, 
+         :math:`A_{n, n'} = 0` for :math:`|n - n'| > bw`. Real and imaginary part of the right-hand side are 
+         solved alike. The caller writes the band into the storage returned by get_band_ptr
+         and calls factorize, which overwrites the band with its LU factors. No pivoting is done,
+         so the matrices should be diagonally dominant or positive definite.
+
+         The element :math:`A_{n, n + j}`, :math:`-bw \leq j \leq bw`, of mode m is stored at 
+         :math:`((2 bw + 1) n + bw + j) My21 + m`, so that the sweeps vectorize over the modes.
+
+        */
+        public:
+            // Number of modes updated by one thread in a sweep, see elliptic_thomas_real_t
+            static constexpr size_t block_size{64};
+
+            /**
+             .. cpp:function:: banded_real_t(const twodads::slab_layout_t& geom, const size_t bw)
+
+             :param const twodads::slab_layout_t& geom: Layout of the real fields
+             :param const size_t bw: Number of diagonals above and below the main diagonal
+
+            */
+            banded_real_t(const twodads::slab_layout_t& _geom, const size_t _bw) :
+                Nx{_geom.get_nx()}, My21{(_geom.get_my() + _geom.get_pad_y()) / 2}, bw{_bw},
+                band((2 * _bw + 1) * _geom.get_nx() * ((_geom.get_my() + _geom.get_pad_y()) / 2), 0.0)
+            {}
+
+            size_t get_bw() const {return(bw);};
+            size_t get_nx() const {return(Nx);};
+            size_t get_my21() const {return(My21);};
+            bool is_valid() const {return(valid);};
+            void invalidate() {valid = false;};
+
+            // Index of A_{n, n + j} of mode m in the band storage
+            inline size_t idx(const size_t n, const int j, const size_t m) const 
+            {
+                return(((2 * bw + 1) * n + static_cast<size_t>(static_cast<int>(bw) + j)) * My21 + m);
+            };
+            twodads::real_t* get_band_ptr() {return(band.data());};
+
+            // LU factorization in place. The multipliers are stored below the main diagonal, 
+            // the main diagonal is replaced by the inverse of the pivots.
+            void factorize()
+            {
+                const size_t num_blocks{(My21 + block_size - 1) / block_size};
+                // Number of zero or non-finite pivots. A min-reduction over the pivots would skip NaNs.
+                size_t num_bad_pivots{0};
+                twodads::real_t* A{band.data()};
+
+#pragma omp parallel for schedule(static) reduction(+:num_bad_pivots)
+                for(size_t b = 0; b < num_blocks; b++)
+                {
+                    const size_t m_lo{b * block_size};
+                    const size_t m_hi{std::min(m_lo + block_size, My21)};
+                    for(size_t n = 0; n < Nx; n++)
+                    {
+                        twodads::real_t* piv{A + idx(n, 0, 0)};
+                        for(size_t m = m_lo; m < m_hi; m++)
+                        {
+                            if(!std::isfinite(piv[m]) || std::fabs(piv[m]) < twodads::epsilon)
+                                num_bad_pivots++;
+                            piv[m] = 1.0 / piv[m];
+                        }
+                        // Eliminate A_{i, n} from the rows i = n + 1 .. n + bw
+                        for(size_t i = n + 1; i < std::min(n + bw + 1, Nx); i++)
+                        {
+                            const int d{static_cast<int>(n) - static_cast<int>(i)};
+                            twodads::real_t* l{A + idx(i, d, 0)};
+#pragma omp simd
+                            for(size_t m = m_lo; m < m_hi; m++)
+                                l[m] *= piv[m];
+                            for(size_t j = 1; j < std::min(bw + 1, Nx - n); j++)
+                            {
+                                twodads::real_t* a_ij{A + idx(i, d + static_cast<int>(j), 0)};
+                                const twodads::real_t* a_nj{A + idx(n, static_cast<int>(j), 0)};
+#pragma omp simd
+                                for(size_t m = m_lo; m < m_hi; m++)
+                                    a_ij[m] -= l[m] * a_nj[m];
+                            }
+                        }
+                    }
+                }
+                if(num_bad_pivots > 0)
+                    throw numerics_error("banded_real_t :: factorize: Zero or non-finite pivot");
+                valid = true;
+            }
+
+            // Solve in place for num_rhs right-hand sides. Row n of mode m is at dst[k][n * My21 + m].
+            void solve_batch(CuCmplx<twodads::real_t>** dst, const size_t num_rhs) const
+            {
+                if(!is_valid())
+                    throw numerics_error("banded_real_t :: solve_batch: Matrix is not factorized");
+
+                const size_t num_blocks{(My21 + block_size - 1) / block_size};
+                const twodads::real_t* A{band.data()};
+
+#pragma omp parallel for schedule(static)
+                for(size_t b = 0; b < num_blocks; b++)
+                {
+                    const size_t m_lo{b * block_size};
+                    const size_t m_hi{std::min(m_lo + block_size, My21)};
+                    for(size_t k = 0; k < num_rhs; k++)
+                    {
+                        twodads::real_t* rhs{reinterpret_cast<twodads::real_t*>(dst[k])};
+                        // Forward substitution: r_n -= sum_j L_{n, n - j} r_{n - j}
+                        for(size_t n = 1; n < Nx; n++)
+                        {
+                            twodads::real_t* row{rhs + 2 * n * My21};
+                            for(size_t j = 1; j < std::min(bw + 1, n + 1); j++)
+                            {
+                                const twodads::real_t* l{A + idx(n, -static_cast<int>(j), 0)};
+                                const twodads::real_t* row_prev{rhs + 2 * (n - j) * My21};
+#pragma omp simd
+                                for(size_t m = m_lo; m < m_hi; m++)
+                                {
+                                    row[2 * m] -= l[m] * row_prev[2 * m];
+                                    row[2 * m + 1] -= l[m] * row_prev[2 * m + 1];
+                                }
+                            }
+                        }
+                        // Backward substitution: u_n = (r_n - sum_j U_{n, n + j} u_{n + j}) / U_{n, n}
+                        for(size_t n = Nx; n-- > 0; )
+                        {
+                            twodads::real_t* row{rhs + 2 * n * My21};
+                            for(size_t j = 1; j < std::min(bw + 1, Nx - n); j++)
+                            {
+                                const twodads::real_t* u{A + idx(n, static_cast<int>(j), 0)};
+                                const twodads::real_t* row_next{rhs + 2 * (n + j) * My21};
+#pragma omp simd
+                                for(size_t m = m_lo; m < m_hi; m++)
+                                {
+                                    row[2 * m] -= u[m] * row_next[2 * m];
+                                    row[2 * m + 1] -= u[m] * row_next[2 * m + 1];
+                                }
+                            }
+                            const twodads::real_t* inv_piv{A + idx(n, 0, 0)};
+#pragma omp simd
+                            for(size_t m = m_lo; m < m_hi; m++)
+                            {
+                                row[2 * m] *= inv_piv[m];
+                                row[2 * m + 1] *= inv_piv[m];
+                            }
+                        }
+                    }
+                }
+            }
+
+        private:
+            const size_t Nx;
+            const size_t My21;
+            const size_t bw;
+            std::vector<twodads::real_t> band;
+            bool valid{false};
+    };
+
+
+#ifdef HOST
+    // Direct solver for the tridiagonal systems on the cell-centered grid.
+    // The x-operator is diagonalized by real-to-real DFTs (DST/DCT) in x:
+    // Forward transform the right-hand side, divide each x-mode by the
+    // eigenvalue of the matrix and transform back.
+    class elliptic_r2r_t : public elliptic_base_t
+    {
+        /**
+         .. cpp:class:: elliptic_r2r_t : public elliptic_base_t
+
+         Solves the My21 tridiagonal systems by diagonalizing the x-operator with
+         FFTW real-to-real transforms. This requires a uniform grid and constant off-diagonals.
+         For Dirichlet and Neumann boundaries on a cell-centered grid the eigenvectors are
+         the DFT kernels of type II/III:
+
+         =========  =========  =====================  ==========
+         bc_left    bc_right   Transform fwd / bwd     theta_k
+         =========  =========  =====================  ==========
+         dirichlet  dirichlet  RODFT10 / RODFT01      pi(k+1)/Nx
+         neumann    neumann    REDFT10 / REDFT01      pi k/Nx
+         dirichlet  neumann    RODFT11 / RODFT11      pi(k+1/2)/Nx
+         neumann    dirichlet  REDFT11 / REDFT11      pi(k+1/2)/Nx
+         =========  =========  =====================  ==========
+
+         The eigenvalue of x-mode k for Fourier mode m is diag_m + 2 diag_u cos(theta_k), where diag_m
+         is an interior element of the main diagonal. The boundary elements of the main diagonal
+         are implied by the boundary conditions passed to the constructor and are not read.
+
+        */
+        using elliptic_base_t :: get_my_int;
+        using elliptic_base_t :: get_my21_int;
+        using elliptic_base_t :: get_nx_int;
+
+        public:
+            /**
+             .. cpp:function:: elliptic_r2r_t(const twodads::slab_layout_t& geom, const twodads::bc_t bc_left, const twodads::bc_t bc_right)
+
+             :param const twodads::slab_layout_t& geom: Layout of the real fields
+             :param const twodads::bc_t bc_left: Boundary condition at the left domain boundary
+             :param const twodads::bc_t bc_right: Boundary condition at the right domain boundary
+
+             Plans the forward and backward transformations. Throws not_implemented_error for boundary
+             conditions other than Dirichlet and Neumann and for stretched grids, and config_error for
+             less than two rows, as the factorization reads an interior element of the main diagonal.
+
+            */
+            elliptic_r2r_t(const twodads::slab_layout_t& _geom, const twodads::bc_t _bc_left, const twodads::bc_t _bc_right) : 
+                elliptic_base_t(_geom),
+                cos_theta(static_cast<size_t>(get_nx_int())),
+                diag_int(static_cast<size_t>(get_my21_int()))
+            {
+                if(get_nx_int() < 2)
+                    throw config_error(std::string("elliptic_r2r_t: The grid needs at least two rows"));
+
+                fftw_r2r_kind kind_fwd{FFTW_RODFT10};
+                fftw_r2r_kind kind_bwd{FFTW_RODFT01};
+                twodads::real_t shift{0.0};
+
+                if(_bc_left == twodads::bc_t::bc_dirichlet && _bc_right == twodads::bc_t::bc_dirichlet)
+                {
+                    kind_fwd = FFTW_RODFT10;
+                    kind_bwd = FFTW_RODFT01;
+                    shift = 1.0;
+                }
+                else if(_bc_left == twodads::bc_t::bc_neumann && _bc_right == twodads::bc_t::bc_neumann)
+                {
+                    kind_fwd = FFTW_REDFT10;
+                    kind_bwd = FFTW_REDFT01;
+                    shift = 0.0;
+                }
+                else if(_bc_left == twodads::bc_t::bc_dirichlet && _bc_right == twodads::bc_t::bc_neumann)
+                {
+                    kind_fwd = FFTW_RODFT11;
+                    kind_bwd = FFTW_RODFT11;
+                    shift = 0.5;
+                }
+                else if(_bc_left == twodads::bc_t::bc_neumann && _bc_right == twodads::bc_t::bc_dirichlet)
+                {
+                    kind_fwd = FFTW_REDFT11;
+                    kind_bwd = FFTW_REDFT11;
+                    shift = 0.5;
+                }
+                else
+                {
+                    throw not_implemented_error("elliptic_r2r_t: Only Dirichlet and Neumann boundary conditions are supported");
+                }
+
+                // The transformation diagonalizes the Laplace operator only for constant grid spacing
+                if(_geom.get_stretch_x() != 0.0)
+                {
+                    throw not_implemented_error("elliptic_r2r_t: Stretched grids are not supported");
+                }
+
+                for(size_t k = 0; k < static_cast<size_t>(get_nx_int()); k++)
+                {
+                    cos_theta[k] = cos(twodads::PI * (static_cast<twodads::real_t>(k) + shift) / static_cast<twodads::real_t>(get_nx_int()));
+                }
+
+                // Transform the real and imaginary parts of all My21 modes in one batch.
+                // Consecutive x-values of a mode are 2 * My21 doubles apart, consecutive
+                // transforms start at the next double.
+                int n[]{get_nx_int()};
+                const int howmany{2 * get_my21_int()};
+                const int stride{2 * get_my21_int()};
+                // Plan in-place transformations on a dummy array, see fftw::plan_dft in dft_type.h
+                double* dummy_double = new double[static_cast<size_t>(get_nx_int()) * static_cast<size_t>(stride)];
+                plan_fwd = fftw_plan_many_r2r(1, n, howmany, 
+                                              dummy_double, NULL, stride, 1, 
+                                              dummy_double, NULL, stride, 1, 
+                                              &kind_fwd, FFTW_ESTIMATE);
+                plan_bwd = fftw_plan_many_r2r(1, n, howmany, 
+                                              dummy_double, NULL, stride, 1, 
+                                              dummy_double, NULL, stride, 1, 
+                                              &kind_bwd, FFTW_ESTIMATE);
+                delete [] dummy_double;
+            };
+
+            ~elliptic_r2r_t()
+            {
+                fftw_destroy_plan(plan_fwd);
+                fftw_destroy_plan(plan_bwd);
+            }
+
+            virtual void solve(CuCmplx<twodads::real_t>* dummy, 
+                               CuCmplx<twodads::real_t>* dst,
+                               CuCmplx<twodads::real_t>* diag_l, 
+                               CuCmplx<twodads::real_t>* diag, 
+                               CuCmplx<twodads::real_t>* diag_u)
+            {
+                // As elliptic_mkl_t, solve in-place in dst. The off-diagonals are constant, 
+                // take the first element of the upper diagonal.
+                const size_t Nx{static_cast<size_t>(get_nx_int())};
+                const size_t My21{static_cast<size_t>(get_my21_int())};
+                const twodads::real_t two_off_diag{2.0 * diag_u[0].re()};
+                // Normalization of the forward-backward transformation pair
+                const twodads::real_t norm{2.0 * static_cast<twodads::real_t>(Nx)};
+
+                for(size_t m = 0; m < My21; m++)
+                    diag_int[m] = diag[m * Nx + 1].re();
+
+                fftw_execute_r2r(plan_fwd, reinterpret_cast<double*>(dst), reinterpret_cast<double*>(dst));
+
+                size_t m{0};
+#pragma omp parallel for private(m)
+                for(size_t k = 0; k < Nx; k++)
+                {
+                    for(m = 0; m < My21; m++)
+                    {
+                        const twodads::real_t lambda{(diag_int[m] + two_off_diag * cos_theta[k]) * norm};
+                        // Zero eigenvalue of the ky=0 mode for Neumann boundaries.
+                        // The solution is unique up to a constant, choose zero mean.
+                        if(std::fabs(lambda) < twodads::epsilon)
+                            dst[k * My21 + m] = CuCmplx<twodads::real_t>(0.0, 0.0);
+                        else
+                            dst[k * My21 + m] = dst[k * My21 + m] / lambda;
+                    }
+                }
+
+                fftw_execute_r2r(plan_bwd, reinterpret_cast<double*>(dst), reinterpret_cast<double*>(dst));
+            }
+
+        private:
+            fftw_plan plan_fwd;
+            fftw_plan plan_bwd;
+            // cos(theta_k) for the eigenvalues of the x-modes
+            std::vector<twodads::real_t> cos_theta;
+            // Interior elements of the main diagonal, one per Fourier mode
+            std::vector<twodads::real_t> diag_int;
+    };
+#endif //HOST
+
+
+    /**
+     .. cpp:function:: elliptic_base_t* create_elliptic(const twodads::slab_layout_t& geom, const twodads::solver_t solver, const twodads::bc_t bc_left, const twodads::bc_t bc_right)
+
+     :param const twodads::slab_layout_t& geom: Layout of the real fields
+     :param const twodads::solver_t solver: Type of the solver
+     :param const twodads::bc_t bc_left: Boundary condition at the left domain boundary
+     :param const twodads::bc_t bc_right: Boundary condition at the right domain boundary
+
+     Returns a pointer to a new elliptic solver. The caller takes ownership.
+     On the host, solver_tridiag selects elliptic_spike_t if there are fewer Fourier modes than OpenMP threads.
+
+    */
+    inline elliptic_base_t* create_elliptic(const twodads::slab_layout_t& geom, const twodads::solver_t solver,
+                                            const twodads::bc_t bc_left, const twodads::bc_t bc_right)
+    {
+        switch(solver)
+        {
+            case twodads::solver_t::solver_tridiag:
+#ifdef __CUDACC__
+                return(new elliptic_cublas_t(geom));
+#endif //__CUDACC__
+#ifdef HOST
+                // Fewer systems than threads: parallelize within the systems
+                if(static_cast<int>(geom.get_my() + geom.get_pad_y()) / 2 < get_max_threads() && 
+                   geom.get_nx() >= 2 * (elliptic_spike_t::min_rows + 1))
+                    return(new elliptic_spike_t(geom));
+                return(new elliptic_mkl_t(geom));
+#endif //HOST
+                break;
+            case twodads::solver_t::solver_r2r:
+#ifdef HOST
+                return(new elliptic_r2r_t(geom, bc_left, bc_right));
+#endif //HOST
+                break;
+            case twodads::solver_t::solver_thomas:
+#ifdef HOST
+                return(new elliptic_thomas_t(geom));
+#endif //HOST
+                break;
+            case twodads::solver_t::solver_thomas_simd:
+#ifdef HOST
+                return(new elliptic_thomas_simd_t(geom));
+#endif //HOST
+                break;
+            case twodads::solver_t::solver_thomas_real:
+#ifdef HOST
+                return(new elliptic_thomas_real_t(geom));
+#endif //HOST
+                break;
+            case twodads::solver_t::solver_spike:
+#ifdef HOST
+                return(new elliptic_spike_t(geom));
+#endif //HOST
+                break;
+            case twodads::solver_t::solver_spike_mpi:
+#if defined(HOST) && defined(USE_MPI)
+                return(new elliptic_spike_mpi_t(geom));
+#endif //HOST && USE_MPI
+                break;
+        }
+        throw not_implemented_error("create_elliptic: Solver is not available for this build");
+    }
 }
 
 #endif // SOLVERS_H
@@ -1,6 +1,8 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 
+#include <algorithm>
+#include <cmath>
 #include "cuda_array_bc_nogp.h"
 
 
@@ -123,11 +125,45 @@ void kernel_multiply_map(CuCmplx<T>* in, CuCmplx<T>* map, CuCmplx<T>* out, O op_
 }
 
 
+// Divides by norm and counts the non-finite elements with col < My, see utility :: normalize_check.
+// result[0] is the count, result[1] the smallest linear index of a non-finite element.
+template <typename T>
+__global__
+void kernel_normalize_check(T* data, const T norm, unsigned long long* result, const twodads::slab_layout_t geom, const bool is_transformed)
+{
+    const size_t col{cuda :: thread_idx :: get_col()};
+    const size_t row{cuda :: thread_idx :: get_row()};
+    const size_t index{row * (geom.get_my() + geom.get_pad_y()) + col};
+
+    if(good_idx(row, col, geom, is_transformed))
+    {
+        const T val{data[index] / norm};
+        data[index] = val;
+        if(col < geom.get_my() && !isfinite(val))
+        {
+            atomicAdd(&result[0], 1ULL);
+            atomicMin(&result[1], static_cast<unsigned long long>(index));
+        }
+    }
+}
+
+
 #endif //__CUDACC__
 }
 
 namespace utility
 {
+    /*
+     * Number of non-finite elements in a field and the location of the first one, 
+     * i.e. the one with the smallest index n * (My + pad_y) + m. Returned by normalize_check.
+     */
+    struct nonfinite_t
+    {
+        size_t count;
+        size_t n;
+        size_t m;
+    };
+
     template <typename T>
     void print(const cuda_array_bc_nogp<T, allocator_host>& vec, const size_t tidx, std::ostream& os)
     {
@@ -200,6 +236,38 @@ namespace utility
 
     }
 
+    // Normalizes as normalize and counts the non-finite elements of the field in the same pass.
+    // The padding of transformed arrays is normalized, but not checked.
+    template <typename T>
+    nonfinite_t normalize_check(cuda_array_bc_nogp<T, allocator_host>& vec, const size_t tlev)
+    {
+        PROFILE_SCOPE("utility::normalize_check", 2 * vec.get_geom().get_nelem_per_t() * sizeof(T));
+        T* data_ptr = vec.get_tlev_ptr(tlev);
+        const size_t Nx{vec.get_geom().get_nx()};
+        const size_t My{vec.get_geom().get_my()};
+        const size_t stride{vec.get_geom().get_my() + vec.get_geom().get_pad_y()};
+        const size_t nelem_m{vec.is_transformed(tlev) ? stride : My};
+        const T norm{vec.get_geom().get_grid() == twodads::grid_t::cell_centered ? T(My) : T(Nx * My)};
+        size_t count{0};
+        size_t first{Nx * stride};
+
+#pragma omp parallel for reduction(+: count) reduction(min: first)
+        for(size_t n = 0; n < Nx; n++)
+        {
+            for(size_t m = 0; m < nelem_m; m++)
+            {
+                const T val{data_ptr[n * stride + m] / norm};
+                data_ptr[n * stride + m] = val;
+                if(m < My && !std::isfinite(val))
+                {
+                    count++;
+                    first = std::min(first, n * stride + m);
+                }
+            }
+        }
+        return(nonfinite_t{count, first / stride, first % stride});
+    }
+
     template <typename T>
     T L2(cuda_array_bc_nogp<T, allocator_host>&vec, const size_t tlev)
     {
@@ -237,6 +305,27 @@ namespace utility
         return sum;
     }
 
+    // Maximum of the absolute value of a real field
+    template <typename T>
+    T max_abs(cuda_array_bc_nogp<T, allocator_host>& vec, const size_t tlev)
+    {
+        const T* data_ptr = vec.get_tlev_ptr(tlev);
+        const size_t Nx{vec.get_geom().get_nx()};
+        const size_t My{vec.get_geom().get_my()};
+        const size_t stride{vec.get_geom().get_my() + vec.get_geom().get_pad_y()};
+        T max_val{0.0};
+
+#pragma omp parallel for reduction(max: max_val)
+        for(size_t n = 0; n < Nx; n++)
+        {
+            for(size_t m = 0; m < My; m++)
+            {
+                max_val = std::max(max_val, std::fabs(data_ptr[n * stride + m]));
+            }
+        }
+        return(max_val);
+    }
+
     // Compute the indices where the field is maximal
     template <typename T>
     std::tuple<T, size_t, size_t> max_idx(cuda_array_bc_nogp<T, allocator_host>& vec, const size_t tlev)
@@ -306,6 +395,23 @@ namespace utility
 
 
 
+    // Device memory of the reductions, grown on demand and kept for later calls,
+    // so that L2 and max_abs do not call cudaMalloc in each time step
+    template <typename T>
+    T* get_reduce_scratch(const size_t nelem)
+    {
+        static T* scratch{nullptr};
+        static size_t scratch_nelem{0};
+        if(nelem > scratch_nelem)
+        {
+            cudaFree(scratch);
+            gpuErrchk(cudaMalloc((void**) &scratch, nelem * sizeof(T)));
+            scratch_nelem = nelem;
+        }
+        return(scratch);
+    }
+
+
     template <typename T>
     T L2(cuda_array_bc_nogp<T, allocator_device>& vec, const size_t tlev)
     {
@@ -321,16 +427,11 @@ namespace utility
 
         // temporary value profile
         //T* h_tmp_profile(new T[Nx]);
-        T* d_rval_ptr{nullptr};
-        T* d_tmp_profile{nullptr};
-        T* device_copy{nullptr};
-
-        // Result from 1d->0d reduction on device
-        gpuErrchk(cudaMalloc((void**) &d_rval_ptr, sizeof(T)));
-        // Result from 2d->1d reduction on device
-        gpuErrchk(cudaMalloc((void**) &d_tmp_profile, vec.get_geom().get_nx() * sizeof(T)));
-        // Copy data to non-strided memory layout
-        gpuErrchk(cudaMalloc((void**) &device_copy, vec.get_geom().get_nx() * vec.get_geom().get_my() * sizeof(T)));
+        // Copy data to non-strided memory layout, followed by the result from 2d->1d reduction 
+        // and the result from 1d->0d reduction on device
+        T* device_copy{get_reduce_scratch<T>(vec.get_geom().get_nx() * (vec.get_geom().get_my() + 1) + 1)};
+        T* d_tmp_profile{device_copy + vec.get_geom().get_nx() * vec.get_geom().get_my()};
+        T* d_rval_ptr{d_tmp_profile + vec.get_geom().get_nx()};
 
         // Geometry of the temporary array, no padding
         twodads::slab_layout_t tmp_geom{vec.get_geom().get_xleft(), vec.get_geom().get_deltax(), vec.get_geom().get_ylo(), 
@@ -380,10 +481,6 @@ namespace utility
         gpuErrchk(cudaPeekAtLastError());
         gpuErrchk(cudaMemcpy(&rval, (void*) d_rval_ptr, sizeof(T), cudaMemcpyDeviceToHost));
 
-        cudaFree(device_copy);
-        cudaFree(d_tmp_profile);
-        cudaFree(d_rval_ptr);
-
         return(sqrt(rval / static_cast<T>(tmp_geom.get_nx() * tmp_geom.get_my())));
     }
 
@@ -401,6 +498,50 @@ namespace utility
     }
 
 
+    // Maximum of the absolute value. Reduces as L2, in the scratch memory of the reductions.
+    template <typename T>
+    T max_abs(cuda_array_bc_nogp<T, allocator_device>& vec, const size_t tlev)
+    {
+        const T* data_ptr = vec.get_tlev_ptr(tlev);
+        const size_t shmem_size_row = vec.get_geom().get_nx() * sizeof(T);
+        const dim3 blocksize_row(static_cast<int>(vec.get_geom().get_nx()), 1, 1);
+        const dim3 gridsize_row(1, static_cast<int>(vec.get_geom().get_my()), 1);
+
+        T rval{0.0};
+        T* device_copy{get_reduce_scratch<T>(vec.get_geom().get_nx() * (vec.get_geom().get_my() + 1) + 1)};
+        T* d_tmp_profile{device_copy + vec.get_geom().get_nx() * vec.get_geom().get_my()};
+        T* d_rval_ptr{d_tmp_profile + vec.get_geom().get_nx()};
+
+        twodads::slab_layout_t tmp_geom{vec.get_geom().get_xleft(), vec.get_geom().get_deltax(), vec.get_geom().get_ylo(), 
+                                        vec.get_geom().get_deltay(), vec.get_geom().get_nx(), 0, vec.get_geom().get_my(), 0, 
+                                        vec.get_geom().get_grid()};
+
+        for(size_t n = 0; n < vec.get_geom().get_nx(); n++)
+        {
+            gpuErrchk(cudaMemcpy((void*) (device_copy + n * tmp_geom.get_my()),
+                                 (void*) (data_ptr + n * (vec.get_geom().get_my() + vec.get_geom().get_pad_y())), 
+                                 vec.get_geom().get_my() * sizeof(T), 
+                                 cudaMemcpyDeviceToDevice));
+        }
+
+        device :: kernel_apply_single<<<vec.get_grid(), vec.get_block()>>>(device_copy,
+                                                       [] __device__ (T in, const size_t n, const size_t m, const twodads::slab_layout_t& geom ) -> T 
+                                                       {return(abs(in));}, 
+                                                       tmp_geom);
+        gpuErrchk(cudaPeekAtLastError());
+        device :: kernel_reduce<<<gridsize_row, blocksize_row, shmem_size_row>>>(device_copy, d_tmp_profile, 
+                                                                       [=] __device__ (T op1, T op2) -> T {return(op1 > op2 ? op1 : op2);},
+                                                                       1, tmp_geom.get_nx(), tmp_geom.get_nx(), tmp_geom.get_my());
+        gpuErrchk(cudaPeekAtLastError());
+        device :: kernel_reduce<<<1, tmp_geom.get_nx(), shmem_size_row>>>(d_tmp_profile, d_rval_ptr, 
+                                                       [=] __device__ (T op1, T op2) -> T {return(op1 > op2 ? op1 : op2);},
+                                                       1, tmp_geom.get_nx(), tmp_geom.get_nx(), 1);
+        gpuErrchk(cudaPeekAtLastError());
+        gpuErrchk(cudaMemcpy(&rval, (void*) d_rval_ptr, sizeof(T), cudaMemcpyDeviceToHost));
+        return(rval);
+    }
+
+
     template <typename T>
     void normalize(cuda_array_bc_nogp<T, allocator_device>& vec, const size_t tlev)
     {
@@ -418,6 +559,23 @@ namespace utility
                 break; 
         }
     }
+
+    // Normalizes as normalize and counts the non-finite elements of the field in the same pass.
+    // The count and the location are reduced with atomics in the scratch memory of the reductions.
+    template <typename T>
+    nonfinite_t normalize_check(cuda_array_bc_nogp<T, allocator_device>& vec, const size_t tlev)
+    {
+        const twodads::slab_layout_t geom{vec.get_geom()};
+        const T norm{geom.get_grid() == twodads::grid_t::cell_centered ? T(geom.get_my()) : T(geom.get_nx() * geom.get_my())};
+        unsigned long long result[2] = {0, static_cast<unsigned long long>(geom.get_nx() * (geom.get_my() + geom.get_pad_y()))};
+        unsigned long long* d_result{get_reduce_scratch<unsigned long long>(2)};
+        gpuErrchk(cudaMemcpy(d_result, result, 2 * sizeof(unsigned long long), cudaMemcpyHostToDevice));
+        device :: kernel_normalize_check<<<vec.get_grid(), vec.get_block()>>>(vec.get_tlev_ptr(tlev), norm, d_result, geom, vec.is_transformed(tlev));
+        gpuErrchk(cudaPeekAtLastError());
+        gpuErrchk(cudaMemcpy(result, d_result, 2 * sizeof(unsigned long long), cudaMemcpyDeviceToHost));
+        const size_t stride{geom.get_my() + geom.get_pad_y()};
+        return(nonfinite_t{static_cast<size_t>(result[0]), static_cast<size_t>(result[1]) / stride, static_cast<size_t>(result[1]) % stride});
+    }
 #endif //CUDACC
 
 
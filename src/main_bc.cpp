@@ -4,110 +4,298 @@
 
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
 #include "slab_bc.h"
 //#include "diagonstics.h"
 #include "output.h"
+#include "alloc_guard.h"
+#include "logger.h"
 
 using namespace std;
 
 
-int main(void)
+// Runs the simulation of one configuration. shared is passed to slab_bc.
+void run(const slab_config_js& my_config, shared_objects_t* shared)
 {
-    slab_config_js my_config(std::string("input.json"));
     const size_t order{my_config.get_tint_params(twodads::dyn_field_t::f_theta).get_tlevs()};
+    // Single-step schemes start without bootstrap steps and use time levels 1 and 0 only
+    const bool single_step{my_config.get_scheme_t() != twodads::scheme_t::scheme_karniadakis};
+    // A restart continues from a checkpoint, which replaces the initialization and the bootstrap steps
+    const bool restart{!my_config.get_restart_file().empty()};
     size_t tstep{0};
-    const size_t num_tsteps{static_cast<size_t>(std::round(my_config.get_tend() / my_config.get_deltat()))};
-    const size_t output_step{static_cast<size_t>(std::round(my_config.get_tout() / my_config.get_deltat()))};
-    const size_t diag_step{static_cast<size_t>(std::round(my_config.get_tdiag() / my_config.get_deltat()))};
+    twodads::real_t time{0.0};
+    twodads::real_t dt{my_config.get_deltat()};
 
     {
-        slab_bc my_slab(my_config);
-        my_slab.initialize();
-        // output:
-        // FD: all fields are complex
-
-        std::cout << "Inverting laplace" << std::endl;
-        // input:
-        // FD: src.is_transformed(t_src) = true
-        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
-        // output:
-        // FD: [src, dst].is_transformed(t_dst) = true, 
-        std::cout << "...done. Calculating RHS" << std::endl;
-        
-        // input:
-        // FD: field.is_tranformed(t_src) = true
-        my_slab.update_real_fields(order - 1);
-        // output:
-        // FD: field.is_transformed(t_src) = false
-        std::cout << "...done. Updating real fields" << std::endl;
-
-        // input:
-        // FD: field.is_transformed(t_src) = false
-        my_slab.write_output(order - 1, tstep * my_config.get_deltat());
-        // output:
-        // FD: field.is_transformed(t_src) = false
-
-        // input:
-        // FD: field.is_transformed(t_src) = false
-        my_slab.rhs(order - 2, order - 1);
-        // output:
-        // FD: field.is_transformed(t_dst) = false
-        //     field.is_transformed(t_src) = false
-
-
-        if(order > 2)
+        slab_bc my_slab(my_config, shared);
+        // On a distributed grid each rank reads and writes its own checkpoint, see slab_config_js :: get_subdomain
+        const std::string restart_file{my_slab.get_config().get_restart_file()};
+        const std::string checkpoint_file{my_slab.get_config().get_checkpoint_file()};
+        if(restart)
         {
-        /////////////////////////////////////////////////////////////////////////
-            my_slab.integrate(twodads::dyn_field_t::f_theta, 1);
-            my_slab.integrate(twodads::dyn_field_t::f_omega, 1);
-            my_slab.integrate(twodads::dyn_field_t::f_tau, 1);
-            tstep++;
+            LOG_MESSAGE(logger::level_t::info, "Restarting from %s", restart_file.c_str());
+            my_slab.read_checkpoint(restart_file, tstep, time, dt);
+        }
+        else
+        {
+            my_slab.initialize();
+            // output:
+            // FD: all fields are complex
 
-            my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 2, 0);
-            my_slab.update_real_fields(order - 2);
-            my_slab.write_output(order - 2, tstep * my_config.get_deltat());
-            my_slab.rhs(order - 3, order - 2);
+            LOG_MESSAGE(logger::level_t::debug, "Inverting laplace");
+            // input:
+            // FD: src.is_transformed(t_src) = true
+            my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
+            // output:
+            // FD: [src, dst].is_transformed(t_dst) = true, 
+            LOG_MESSAGE(logger::level_t::debug, "...done. Calculating RHS");
+        
+            // input:
+            // FD: field.is_tranformed(t_src) = true
+            my_slab.update_real_fields(order - 1);
+            // output:
+            // FD: field.is_transformed(t_src) = false
+            LOG_MESSAGE(logger::level_t::debug, "...done. Updating real fields");
 
-            if(order > 3)
+            // input:
+            // FD: field.is_transformed(t_src) = false
+            my_slab.write_output(order - 1, tstep * my_config.get_deltat());
+            // output:
+            // FD: field.is_transformed(t_src) = false
+
+            if(!single_step)
+            {
+                // input:
+                // FD: field.is_transformed(t_src) = false
+                my_slab.rhs(order - 2, order - 1);
+                // output:
+                // FD: field.is_transformed(t_dst) = false
+                //     field.is_transformed(t_src) = false
+            }
+
+            if(!single_step && order > 2)
             {
             /////////////////////////////////////////////////////////////////////////
-                my_slab.integrate(twodads::dyn_field_t::f_theta, 2);
-                my_slab.integrate(twodads::dyn_field_t::f_omega, 2);
-                my_slab.integrate(twodads::dyn_field_t::f_tau, 2);
+                my_slab.integrate({twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau}, 1);
                 tstep++;
+
+                my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 2, 0);
+                my_slab.update_real_fields(order - 2);
+                my_slab.write_output(order - 2, tstep * my_config.get_deltat());
+                my_slab.rhs(order - 3, order - 2);
+
+                if(order > 3)
+                {
+                /////////////////////////////////////////////////////////////////////////
+                    my_slab.integrate({twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau}, 2);
+                    tstep++;
             
-                my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 3, 0);
-                my_slab.update_real_fields(order - 3);
-                my_slab.write_output(order - 3, tstep * my_config.get_deltat());
-                my_slab.rhs(0, order - 3);
+                    my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 3, 0);
+                    my_slab.update_real_fields(order - 3);
+                    my_slab.write_output(order - 3, tstep * my_config.get_deltat());
+                    my_slab.rhs(0, order - 3);
+                }
             }
+            time = static_cast<twodads::real_t>(tstep) * my_config.get_deltat();
         }
 
         /////////////////////////////////////////////////////////////////////////
-        for(; tstep < num_tsteps + 1; tstep++)
+        // Output and diagnostics are written at multiples of tout and tdiag. With adaptive time steps
+        // the step before an output is shortened to end on the output time.
+        // Checkpoints are written after the first step that reaches a multiple of tcheck.
+        // Times closer than t_eps * dt are considered equal.
+        const twodads::real_t t_eps{1e-8};
+        // Read the configuration once, the accessors of slab_config_js allocate the keys
+        const twodads::real_t tout{my_config.get_tout()};
+        const twodads::real_t tdiag{my_config.get_tdiag()};
+        const twodads::real_t tcheck{my_config.get_tcheck()};
+        const twodads::real_t tend{my_config.get_tend()};
+        const bool adaptive{my_config.get_adaptive()};
+        // Progress of the time steps is logged at most once per log_interval seconds, see logger.h
+        const twodads::real_t log_interval{my_config.get_log_interval()};
+        size_t n_out{static_cast<size_t>(std::floor(time / tout + t_eps)) + 1};
+        size_t n_diag{static_cast<size_t>(std::floor(time / tdiag + t_eps)) + 1};
+        const bool write_checkpoints{tcheck > 0.0};
+        size_t n_check{write_checkpoints ? static_cast<size_t>(std::floor(time / tcheck + t_eps)) + 1 : 0};
+        // The first step allocates the stage storage of the integrators. Later steps must not allocate
+        // on the heap, except for output, diagnostics, and checkpoints. See alloc_guard.h.
+        const size_t tstep_first{tstep};
+        const std::vector<twodads::dyn_field_t> dyn_fields{twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau};
+        // A step that gives non-finite values is repeated from a snapshot with a shorter time step,
+        // at most max_retries times. See slab_bc::is_finite.
+        const size_t max_retries{my_config.get_watchdog_retries()};
+        const twodads::real_t dt_shrink{my_config.get_watchdog_shrink()};
+
+        while(time < tend - t_eps * dt)
         {
-        	std::cout << tstep << "/" << num_tsteps << std::endl;
-            my_slab.integrate(twodads::dyn_field_t::f_theta, order - 1);
-            my_slab.integrate(twodads::dyn_field_t::f_omega, order - 1);
-            my_slab.integrate(twodads::dyn_field_t::f_tau, order - 1);
-            my_slab.advance();
-            my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, 1, 0);
+            alloc_guard :: scope_t no_alloc(tstep > tstep_first);
+            if(adaptive)
+                dt = my_slab.adapt_deltat(dt);
+
+            const twodads::real_t t_next_out{static_cast<twodads::real_t>(n_out) * tout};
+            const twodads::real_t t_next_diag{static_cast<twodads::real_t>(n_diag) * tdiag};
+            const twodads::real_t t_next{std::min({t_next_out, t_next_diag, tend})};
+            twodads::real_t dt_step{dt};
+            if(t_next - time < dt * (1.0 - t_eps))
+                dt_step = t_next - time;
+
+            if(max_retries > 0)
+                my_slab.save_snapshot();
+            for(size_t retry = 0; ; retry++)
+            {
+                LOG_EVERY(logger::level_t::info, log_interval, "step %zu: t = %g, dt = %g", tstep, time, dt_step);
+                my_slab.set_deltat(dt_step);
+                if(single_step)
+                    my_slab.integrate_stages(1, 0);
+                else
+                    my_slab.integrate(dyn_fields, order - 1);
+                my_slab.advance();
+                my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, 1, 0);
+
+                my_slab.update_real_fields(1);
+                if(my_slab.is_finite())
+                    break;
 
-            my_slab.update_real_fields(1);
+                alloc_guard :: pause_t io;
+                const std::string report{my_slab.get_nonfinite_report()};
+                LOG_MESSAGE(logger::level_t::error, "step %zu, t = %g, dt = %g: %s", tstep, time, dt_step, report.c_str());
+                if(retry == max_retries)
+                    throw numerics_error(std::string("Time step ") + std::to_string(tstep) + ": " + report);
+                my_slab.restore_snapshot();
+                dt_step *= dt_shrink;
+                dt = std::min(dt, dt_step);
+                LOG_MESSAGE(logger::level_t::warning, "step %zu: repeating the step with dt = %g", tstep, dt_step);
+            }
+            tstep++;
+            time += dt_step;
+            if(std::fabs(time - t_next) < t_eps * dt)
+                time = t_next;
 
-            if((tstep % output_step) == 0)
+            if(time > t_next_out - t_eps * dt)
             {
-                std::cout << "step " << tstep << "/" << num_tsteps << ": writing output" << std::endl;
-                my_slab.write_output(1, tstep * my_config.get_deltat());
+                alloc_guard :: pause_t io;
+                LOG_MESSAGE(logger::level_t::info, "step %zu, t = %g: writing output", tstep, time);
+                my_slab.write_output(1, time);
+                n_out++;
             }
-            if((tstep % diag_step) == 0)
+            if(time > t_next_diag - t_eps * dt)
             {
                 // Logarithmic density field diagnostics are not implemented yet.
-                std::cout << "step " << tstep << "/" << num_tsteps << ": writing diagnostics" << std::endl;
-                my_slab.diagnose(1, tstep * my_config.get_deltat());
+                alloc_guard :: pause_t io;
+                LOG_MESSAGE(logger::level_t::info, "step %zu, t = %g: writing diagnostics", tstep, time);
+                my_slab.diagnose(1, time);
+                n_diag++;
+            }
+            // Single-step schemes compute the explicit part of the first stage in integrate_stages
+            if(!single_step)
+                my_slab.rhs(0, 1);
+
+            if(write_checkpoints && time > static_cast<twodads::real_t>(n_check) * tcheck - t_eps * dt)
+            {
+                alloc_guard :: pause_t io;
+                LOG_MESSAGE(logger::level_t::info, "step %zu, t = %g: writing checkpoint", tstep, time);
+                my_slab.write_checkpoint(checkpoint_file, tstep, time, dt);
+                n_check = static_cast<size_t>(std::floor(time / tcheck + t_eps)) + 1;
+            }
+        }
+        // The threads may still write the output and the diagnostics of the last steps
+        my_slab.flush_output();
+        my_slab.wait_diagnostics();
+    }
+    LOG_MESSAGE(logger::level_t::debug, "Leaving scope");
+}
+
+
+// Runs the members of an ensemble, see slab_config_js :: get_ensemble_members. Each of num_workers threads
+// runs one member at a time with an equal share of the OpenMP threads. Members with the same geometry
+// share FFT plans and derivation objects. A member that fails does not stop the others, the first
+// error is rethrown after all members have finished.
+void run_ensemble(const slab_config_js& my_config, const std::vector<slab_config_js>& members)
+{
+    slab_bc :: configure_log(my_config);
+    const size_t max_threads{static_cast<size_t>(solvers :: get_max_threads())};
+    size_t num_workers{my_config.get_ensemble_threads() > 0 ? my_config.get_ensemble_threads() : max_threads};
+    num_workers = std::min(num_workers, members.size());
+    const int member_threads{static_cast<int>(std::max(max_threads / num_workers, size_t(1)))};
+    LOG_MESSAGE(logger::level_t::info, "Running %zu ensemble members, %zu at a time with %d threads each", members.size(), num_workers, member_threads);
+
+    shared_objects_t shared;
+    std::atomic<size_t> next_member{0};
+    std::vector<std::exception_ptr> errors(members.size(), nullptr);
+    auto worker = [&] () -> void
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(member_threads);
+#endif //_OPENMP
+        for(size_t k = next_member++; k < members.size(); k = next_member++)
+        {
+            const std::string prefix{members[k].get_file_prefix()};
+            LOG_MESSAGE(logger::level_t::info, "Ensemble member %zu (%s): starting", k, prefix.c_str());
+            try
+            {
+                run(members[k], &shared);
+                LOG_MESSAGE(logger::level_t::info, "Ensemble member %zu (%s): done", k, prefix.c_str());
+            }
+            catch(const std::exception& err)
+            {
+                LOG_MESSAGE(logger::level_t::error, "Ensemble member %zu (%s): %s", k, prefix.c_str(), err.what());
+                errors[k] = std::current_exception();
+            }
+            catch(...)
+            {
+                LOG_MESSAGE(logger::level_t::error, "Ensemble member %zu (%s): failed", k, prefix.c_str());
+                errors[k] = std::current_exception();
             }
-            my_slab.rhs(0, 1);
         }
+    };
+
+    std::vector<std::thread> workers;
+    for(size_t w = 0; w < num_workers; w++)
+        workers.emplace_back(worker);
+    for(auto& it : workers)
+        it.join();
+
+    for(auto it : errors)
+    {
+        if(it != nullptr)
+            std::rethrow_exception(it);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+#ifdef USE_MPI
+    // The ranks share the grid of a single configuration, see slab_bc
+    MPI_Init(&argc, &argv);
+    int num_ranks{1};
+    MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+    try
+    {
+#endif //USE_MPI
+    slab_config_js my_config(std::string("input.json"));
+    const std::vector<slab_config_js> members{my_config.get_ensemble_members()};
+    if(members.empty())
+        run(my_config, nullptr);
+#ifdef USE_MPI
+    else if(num_ranks > 1)
+        throw config_error(std::string("Ensembles can not be run on more than one MPI rank"));
+#endif //USE_MPI
+    else
+        run_ensemble(my_config, members);
+#ifdef USE_MPI
+    }
+    catch(const std::exception& err)
+    {
+        // The other ranks wait in collective calls for this one
+        std::cerr << err.what() << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
-    std::cout << "Leaving scope" << std::endl;
+    MPI_Finalize();
+#endif //USE_MPI
 }
@@ -1,12 +1,19 @@
 /*
  * Time integration using the new boundary value array
+ *
+ * Same as main_bc.cpp, with the timers of profiler.h always enabled. Link with gperftools
+ * and set CPUPROFILE for a sampling profile in addition. The report of the timers is
+ * written to the file given by 2dads.profile.file, or to profile.json if none is given.
  */
 
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 #include "slab_bc.h"
-//#include "diagonstics.h"
 #include "output.h"
+#include "profiler.h"
+#include "logger.h"
 
 using namespace std;
 
@@ -15,67 +22,125 @@ int main(void)
 {
     slab_config_js my_config(std::string("input.json"));
     const size_t order{my_config.get_tint_params(twodads::dyn_field_t::f_theta).get_tlevs()};
-    std::cout << "Integrating: order = " << order << std::endl;
+    const bool single_step{my_config.get_scheme_t() != twodads::scheme_t::scheme_karniadakis};
+    const bool restart{!my_config.get_restart_file().empty()};
     size_t tstep{0};
-    const size_t num_tsteps{static_cast<size_t>(std::round(my_config.get_tend() / my_config.get_deltat()))};
-    const size_t output_step{static_cast<size_t>(std::round(my_config.get_tout() / my_config.get_deltat()))};
+    twodads::real_t time{0.0};
+    twodads::real_t dt{my_config.get_deltat()};
 
+    profiler :: registry_t :: get().enable();
+    if(my_config.get_profile_counters() && !profiler :: registry_t :: get().enable_counters())
+        LOG_MESSAGE(logger::level_t::warning, "Hardware counters are not available: %s", profiler :: registry_t :: get().get_counter_error().c_str());
     {
         slab_bc my_slab(my_config);
-        my_slab.initialize();
-
-        std::cout << "Inverting laplace" << std::endl;
-        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
-        std::cout << "...done. Calculating RHS" << std::endl;
-        my_slab.rhs(order - 2, order - 1);
-
-        my_slab.write_output(order - 1, tstep * my_config.get_deltat());
-
-        tstep++;
-
-/////////////////////////////////////////////////////////////////////////
-        my_slab.integrate(twodads::dyn_field_t::f_theta, 1);
-        my_slab.integrate(twodads::dyn_field_t::f_omega, 1);
-        my_slab.integrate(twodads::dyn_field_t::f_tau, 1);
-
-        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 2, 0);
-        my_slab.update_real_fields(order - 2);
-        my_slab.rhs(order - 3, order - 2);
-
-        my_slab.write_output(order - 2, tstep * my_config.get_deltat());
-        tstep++;
+        if(restart)
+        {
+            LOG_MESSAGE(logger::level_t::info, "Restarting from %s", my_config.get_restart_file().c_str());
+            my_slab.read_checkpoint(my_config.get_restart_file(), tstep, time, dt);
+        }
+        else
+        {
+            my_slab.initialize();
+            my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
+            my_slab.update_real_fields(order - 1);
+            my_slab.write_output(order - 1, tstep * my_config.get_deltat());
 
-/////////////////////////////////////////////////////////////////////////
-        my_slab.integrate(twodads::dyn_field_t::f_theta, 2);
-        my_slab.integrate(twodads::dyn_field_t::f_omega, 2);
-        my_slab.integrate(twodads::dyn_field_t::f_tau, 2);
+            if(!single_step)
+                my_slab.rhs(order - 2, order - 1);
 
-        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 3, 0);
-        my_slab.update_real_fields(order - 3);
-        my_slab.rhs(0, order - 3);
+            if(!single_step && order > 2)
+            {
+                my_slab.integrate({twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau}, 1);
+                tstep++;
+
+                my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 2, 0);
+                my_slab.update_real_fields(order - 2);
+                my_slab.write_output(order - 2, tstep * my_config.get_deltat());
+                my_slab.rhs(order - 3, order - 2);
+
+                if(order > 3)
+                {
+                    my_slab.integrate({twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau}, 2);
+                    tstep++;
+
+                    my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 3, 0);
+                    my_slab.update_real_fields(order - 3);
+                    my_slab.write_output(order - 3, tstep * my_config.get_deltat());
+                    my_slab.rhs(0, order - 3);
+                }
+            }
+            time = static_cast<twodads::real_t>(tstep) * my_config.get_deltat();
+        }
 
-        my_slab.write_output(order - 3, tstep * my_config.get_deltat());
+        // See main_bc.cpp for the scheduling of output, diagnostics, and checkpoints
+        const twodads::real_t t_eps{1e-8};
+        size_t n_out{static_cast<size_t>(std::floor(time / my_config.get_tout() + t_eps)) + 1};
+        size_t n_diag{static_cast<size_t>(std::floor(time / my_config.get_tdiag() + t_eps)) + 1};
+        const bool write_checkpoints{my_config.get_tcheck() > 0.0};
+        size_t n_check{write_checkpoints ? static_cast<size_t>(std::floor(time / my_config.get_tcheck() + t_eps)) + 1 : 0};
+        const twodads::real_t log_interval{my_config.get_log_interval()};
 
-        for(; tstep < num_tsteps; tstep++)
+        while(time < my_config.get_tend() - t_eps * dt)
         {
-        	std::cout << tstep << "/" << num_tsteps << std::endl;
-            my_slab.integrate(twodads::dyn_field_t::f_theta, 3);
-            my_slab.integrate(twodads::dyn_field_t::f_omega, 3);
-            my_slab.integrate(twodads::dyn_field_t::f_tau, 3);
-
-            my_slab.invert_laplace(twodads::field_t::f_omega, 
-                                   twodads::field_t::f_strmf, 0, 0);
-            my_slab.rhs(0, 0);
-
-            if((tstep % output_step) == 0)
+            // Time of the complete step, including output
+            PROFILE_SCOPE("main::step", 0);
+            if(my_config.get_adaptive())
+                dt = my_slab.adapt_deltat(dt);
+
+            const twodads::real_t t_next_out{static_cast<twodads::real_t>(n_out) * my_config.get_tout()};
+            const twodads::real_t t_next_diag{static_cast<twodads::real_t>(n_diag) * my_config.get_tdiag()};
+            const twodads::real_t t_next{std::min({t_next_out, t_next_diag, my_config.get_tend()})};
+            twodads::real_t dt_step{dt};
+            if(t_next - time < dt * (1.0 - t_eps))
+                dt_step = t_next - time;
+
+            LOG_EVERY(logger::level_t::info, log_interval, "step %zu: t = %g, dt = %g", tstep, time, dt_step);
+            my_slab.set_deltat(dt_step);
+            if(single_step)
+                my_slab.integrate_stages(1, 0);
+            else
+                my_slab.integrate({twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau}, order - 1);
+            my_slab.advance();
+            my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, 1, 0);
+
+            my_slab.update_real_fields(1);
+            // Profiled runs do not repeat steps, see main_bc.cpp
+            if(!my_slab.is_finite())
+                throw numerics_error(std::string("Time step ") + std::to_string(tstep) + ": " + my_slab.get_nonfinite_report());
+            tstep++;
+            time += dt_step;
+            if(std::fabs(time - t_next) < t_eps * dt)
+                time = t_next;
+
+            if(time > t_next_out - t_eps * dt)
+            {
+                my_slab.write_output(1, time);
+                n_out++;
+            }
+            if(time > t_next_diag - t_eps * dt)
             {
-                std::cout << "step " << tstep << "/" << num_tsteps << ": writing output" << std::endl;
-                my_slab.write_output(0);
+                my_slab.diagnose(1, time);
+                n_diag++;
             }
+            if(!single_step)
+                my_slab.rhs(0, 1);
 
-            my_slab.advance();
+            if(write_checkpoints && time > static_cast<twodads::real_t>(n_check) * my_config.get_tcheck() - t_eps * dt)
+            {
+                my_slab.write_checkpoint(my_config.get_checkpoint_file(), tstep, time, dt);
+                n_check = static_cast<size_t>(std::floor(time / my_config.get_tcheck() + t_eps)) + 1;
+            }
         }
+        // The threads may still write the output and the diagnostics of the last steps
+        my_slab.flush_output();
+        my_slab.wait_diagnostics();
+    }
 
+    // The slab writes the report if a file is configured
+    if(my_config.get_profile_file().empty())
+    {
+        LOG_MESSAGE(logger::level_t::info, "Writing profile.json");
+        profiler :: registry_t :: get().write_report(std::string("profile.json"));
     }
-    std::cout << "Leaving scope" << std::endl;
+    LOG_MESSAGE(logger::level_t::debug, "Leaving scope");
 }
@@ -3,11 +3,21 @@
  *  Output functions for 2dads
  */
 
+#include <algorithm>
 #include "output.h"
+#include "profiler.h"
+#include "logger.h"
 
 //using namespace std;
 using namespace H5;
 
+std::mutex& output_h5_t :: get_library_mutex()
+{
+    static std::mutex h5_mutex;
+    return(h5_mutex);
+}
+
+
 // Constructor of the base class
 output_t :: output_t(slab_config_js config) :
     output_counter(0),
@@ -34,25 +44,32 @@ const std::map<twodads::output_t, std::string> output_h5_t :: fname_map
 };
 
 
-// Initialize DataSpace objects in a later for-loop But populate dspace_map with pointers.
+// All HDF5 objects are created in the constructor body, while holding the library lock.
 output_h5_t :: output_h5_t(const slab_config_js& config) :
     output_t(config),
-    filename("output.h5"),
-    output_file{new H5File(H5std_string(filename.data()), H5F_ACC_TRUNC)},
-	group_theta{new Group(output_file ->   createGroup("/N"))},
-    group_theta_x{new Group(output_file -> createGroup("/Nx"))},
-    group_theta_y{new Group(output_file -> createGroup("/Ny"))},
-	group_tau{new Group(output_file ->     createGroup("/T"))},
-    group_tau_x{new Group(output_file ->   createGroup("/Tx"))},
-    group_tau_y{new Group(output_file ->   createGroup("/Ty"))},
-	group_omega{new Group(output_file ->   createGroup("/O"))},
-    group_omega_x{new Group(output_file -> createGroup("/Ox"))},
-    group_omega_y{new Group(output_file -> createGroup("/Oy"))},
-    group_strmf{new Group(output_file ->   createGroup("/S"))},
-    group_strmf_x{new Group(output_file -> createGroup("/Sx"))},
-    group_strmf_y{new Group(output_file -> createGroup("/Sy"))},
-	dspace_file{nullptr}
+    filename(config.get_file_prefix() + "output.h5"),
+    output_file{nullptr},
+    group_theta{nullptr}, group_theta_x{nullptr}, group_theta_y{nullptr},
+    group_tau{nullptr}, group_tau_x{nullptr}, group_tau_y{nullptr},
+    group_omega{nullptr}, group_omega_x{nullptr}, group_omega_y{nullptr},
+    group_strmf{nullptr}, group_strmf_x{nullptr}, group_strmf_y{nullptr},
+	dspace_file{nullptr},
+    ds_creatplist{nullptr}
 {
+    std::lock_guard<std::mutex> lock(get_library_mutex());
+    output_file = new H5File(H5std_string(filename.data()), H5F_ACC_TRUNC);
+	group_theta = new Group(output_file ->   createGroup("/N"));
+    group_theta_x = new Group(output_file -> createGroup("/Nx"));
+    group_theta_y = new Group(output_file -> createGroup("/Ny"));
+	group_tau = new Group(output_file ->     createGroup("/T"));
+    group_tau_x = new Group(output_file ->   createGroup("/Tx"));
+    group_tau_y = new Group(output_file ->   createGroup("/Ty"));
+	group_omega = new Group(output_file ->   createGroup("/O"));
+    group_omega_x = new Group(output_file -> createGroup("/Ox"));
+    group_omega_y = new Group(output_file -> createGroup("/Oy"));
+    group_strmf = new Group(output_file ->   createGroup("/S"));
+    group_strmf_x = new Group(output_file -> createGroup("/Sx"));
+    group_strmf_y = new Group(output_file -> createGroup("/Sy"));
 
     using boost::property_tree::ptree;
     using boost::property_tree::write_json;
@@ -66,24 +83,9 @@ output_h5_t :: output_h5_t(const slab_config_js& config) :
     // associated with the output fields. This ignores all padding.
     const hsize_t ds_fsize[] = {get_geom().get_nx(), get_geom().get_my()};
 
-    DSetCreatPropList ds_creatplist;  
+    ds_creatplist = new DSetCreatPropList;
     dspace_file = new DataSpace(2, ds_fsize); 
 
-    dspace_map[twodads::output_t::o_theta] = &dspace_theta;
-    dspace_map[twodads::output_t::o_theta_x] = &dspace_theta_x;
-    dspace_map[twodads::output_t::o_theta_y] = &dspace_theta_y;
-    dspace_map[twodads::output_t::o_tau] = &dspace_tau;
-    dspace_map[twodads::output_t::o_tau_x] = &dspace_tau_x;
-    dspace_map[twodads::output_t::o_tau_y] = &dspace_tau_y;
-    dspace_map[twodads::output_t::o_omega] = &dspace_omega;
-    dspace_map[twodads::output_t::o_omega_x] = &dspace_omega_x;
-    dspace_map[twodads::output_t::o_omega_y] = &dspace_omega_y;
-    dspace_map[twodads::output_t::o_strmf] = &dspace_strmf;
-    dspace_map[twodads::output_t::o_strmf_x] = &dspace_strmf_x;
-    dspace_map[twodads::output_t::o_strmf_y] = &dspace_strmf_y;
-
-    DataSpace* dspace;
-
     // Serialize configuration to string and write to file
     // https://support.hdfgroup.org/ftp/HDF5/examples/misc-examples/stratt.cpp
     std::ostringstream config_str;
@@ -104,8 +106,8 @@ output_h5_t :: output_h5_t(const slab_config_js& config) :
 
     for(auto it : config.get_output())
     {
-        dspace = dspace_map.at(it);
-        (*dspace) = DataSpace(2, ds_memsize);
+        DataSpace* dspace{new DataSpace(2, ds_memsize)};
+        dspace_map[it] = dspace;
         // https://www.hdfgroup.org/HDF5/doc/cpplus_RM/class_h5_1_1_data_space.html#a92bd510d1c06ebef292faeff73f40c12
         // Define memory dataspace associated with array.
         // All arrays use the same padding (f.ex. pad_y = 2 for in-place FFTs) in the
@@ -118,6 +120,10 @@ output_h5_t :: output_h5_t(const slab_config_js& config) :
 
 output_h5_t :: ~output_h5_t()
 {
+    std::lock_guard<std::mutex> lock(get_library_mutex());
+    for(auto it : dspace_map)
+        delete it.second;
+    delete ds_creatplist;
     delete dspace_file;
 	delete group_theta;
 	delete group_theta_x;
@@ -139,6 +145,8 @@ void output_h5_t :: surface(twodads::output_t field_name,
                             const cuda_array_bc_nogp<twodads::real_t, allocator_host>& src,
                             const size_t tidx)
 {
+    PROFILE_SCOPE("output_h5_t::surface", src.get_geom().get_nx() * src.get_geom().get_my() * sizeof(twodads::real_t));
+    std::lock_guard<std::mutex> lock(get_library_mutex());
     // Dataset name is /[NOST]/[0-9]*
     const twodads::real_t time{twodads::real_t(get_output_counter()) * get_dtout()};
     std::string dataset_name(fname_map.at(field_name) + "/" + std::to_string(get_output_counter()));
@@ -146,7 +154,7 @@ void output_h5_t :: surface(twodads::output_t field_name,
 
     // Open data file for writing
     output_file = new H5File(filename, H5F_ACC_RDWR);
-    DataSpace* dspace_ptr = dspace_map[field_name];
+    DataSpace* dspace_ptr = dspace_map.at(field_name);
 
     //FloatType float_type(PredType::NATIVE_DOUBLE);
     DataSpace att_space(H5S_SCALAR);
@@ -155,7 +163,7 @@ void output_h5_t :: surface(twodads::output_t field_name,
 	DataSet* dataset = new DataSet(output_file->createDataSet(dataset_name, 
                                                               PredType::NATIVE_DOUBLE, 
                                                               *dspace_file, 
-                                                              ds_creatplist));
+                                                              *ds_creatplist));
     // Write to the data set we just created in the file.
     // Source pointed to by dspace_ptr, created in the constructor
 	dataset -> write(src.get_tlev_ptr(tidx), PredType::NATIVE_DOUBLE, *dspace_ptr);
@@ -179,13 +187,15 @@ void output_h5_t :: surface(twodads::output_t field_name,
                             const size_t tidx,
                             const twodads::real_t time)
 {
+    PROFILE_SCOPE("output_h5_t::surface", src.get_geom().get_nx() * src.get_geom().get_my() * sizeof(twodads::real_t));
+    std::lock_guard<std::mutex> lock(get_library_mutex());
     // Make sure that we write a real dataset
     assert(src.is_transformed(tidx) == false);
     // Dataset name is /[NOST]/[0-9]*
     std::string dataset_name(fname_map.at(field_name) + "/" + std::to_string(get_output_counter()));
 
     output_file = new H5File(filename, H5F_ACC_RDWR);
-    DataSpace* dspace_ptr = dspace_map[field_name];
+    DataSpace* dspace_ptr = dspace_map.at(field_name);
 
     //FloatType float_type(PredType::NATIVE_DOUBLE);
     DataSpace att_space(H5S_SCALAR);
@@ -194,7 +204,7 @@ void output_h5_t :: surface(twodads::output_t field_name,
 	DataSet* dataset = new DataSet(output_file->createDataSet(dataset_name, 
                                                               PredType::NATIVE_DOUBLE, 
                                                               *dspace_file, 
-                                                              ds_creatplist));
+                                                              *ds_creatplist));
     // Write to the data set we just created in the file.
     // Source pointed to by dspace_ptr, created in the constructor
 	dataset -> write(src.get_tlev_ptr(tidx), PredType::NATIVE_DOUBLE, *dspace_ptr);
@@ -207,4 +217,204 @@ void output_h5_t :: surface(twodads::output_t field_name,
     delete output_file;
 }	
 
+
+
+output_queue_t :: output_queue_t(const slab_config_js& config) :
+    writer(config),
+    num_buffers(config.get_output_buffers()),
+    output_counter(0),
+    buffers(std::max<size_t>(num_buffers, 1), nullptr),
+    records(std::max<size_t>(num_buffers, 1)),
+    head(0),
+    num_pending(0),
+    stop(false),
+    error(nullptr)
+{
+    // The fields are written without their boundary values
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+    for(size_t b = 0; b < buffers.size(); b++)
+    {
+        buffers[b] = new arr_host(config.get_geom(), bvals, 1);
+        buffers[b] -> set_tag("output", std::string("buffer_") + std::to_string(b));
+    }
+    if(num_buffers > 0)
+        worker = std::thread([this] () -> void {run();});
+}
+
+
+output_queue_t :: ~output_queue_t()
+{
+    if(worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+    if(error != nullptr)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch(const std::exception& err)
+        {
+            LOG_MESSAGE(logger::level_t::error, "Output: %s", err.what());
+        }
+        catch(const H5::Exception& err)
+        {
+            LOG_MESSAGE(logger::level_t::error, "Output: %s", err.getCDetailMsg());
+        }
+    }
+    for(auto arr : buffers)
+        delete arr;
+}
+
+
+output_queue_t::arr_host* output_queue_t :: acquire()
+{
+    if(num_buffers == 0)
+        return(buffers[0]);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this] () -> bool {return(num_pending < num_buffers);});
+    rethrow_error();
+    return(buffers[(head + num_pending) % num_buffers]);
+}
+
+
+void output_queue_t :: submit(const twodads::output_t field, const twodads::real_t time)
+{
+    if(num_buffers == 0)
+    {
+        records[0] = record_t{field, time, output_counter};
+        write(0);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] () -> bool {return(num_pending < num_buffers);});
+        records[(head + num_pending) % num_buffers] = record_t{field, time, output_counter};
+        num_pending++;
+    }
+    cv.notify_all();
+}
+
+
+void output_queue_t :: flush()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this] () -> bool {return(num_pending == 0);});
+    rethrow_error();
+}
+
+
+void output_queue_t :: rethrow_error()
+{
+    if(error != nullptr)
+    {
+        std::exception_ptr err{error};
+        error = nullptr;
+        std::rethrow_exception(err);
+    }
+}
+
+
+void output_queue_t :: write(const size_t b)
+{
+    // Only this function calls the writer, from the thread or, without buffers, from the caller
+    writer.set_output_counter(records[b].counter);
+    writer.surface(records[b].field, *buffers[b], 0, records[b].time);
+}
+
+
+void output_queue_t :: run()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while(true)
+    {
+        cv.wait(lock, [this] () -> bool {return(num_pending > 0 || stop);});
+        // Write the submitted buffers before stopping
+        if(num_pending == 0)
+            break;
+
+        // The buffer at head is not filled again until it is released below
+        lock.unlock();
+        std::exception_ptr err{nullptr};
+        try
+        {
+            write(head);
+        }
+        catch(...)
+        {
+            err = std::current_exception();
+        }
+        lock.lock();
+        if(err != nullptr && error == nullptr)
+            error = err;
+        head = (head + 1) % num_buffers;
+        num_pending--;
+        cv.notify_all();
+    }
+}
+
+
+input_h5_t :: input_h5_t(const std::string& _filename) :
+    filename(_filename),
+    config(read_config(_filename))
+{
+}
+
+
+boost::property_tree::ptree input_h5_t :: read_config(const std::string& fname)
+{
+    // The configuration is stored as a string in the dataset input.json, see output_h5_t :: output_h5_t
+    std::lock_guard<std::mutex> lock(output_h5_t :: get_library_mutex());
+    H5File input_file(H5std_string(fname.data()), H5F_ACC_RDONLY);
+    DataSet dset_config{input_file.openDataSet(H5std_string("input.json"))};
+    std::string config_str;
+    dset_config.read(config_str, dset_config.getStrType());
+
+    std::istringstream config_stream(config_str);
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(config_stream, pt);
+    return(pt);
+}
+
+
+void input_h5_t :: surface(const twodads::output_t field_name, const size_t snapshot,
+                           cuda_array_bc_nogp<twodads::real_t, allocator_host>& dst, const size_t tidx)
+{
+    const twodads::slab_layout_t geom{get_config().get_geom()};
+    assert(dst.get_geom() == geom);
+
+    std::lock_guard<std::mutex> lock(output_h5_t :: get_library_mutex());
+    H5File input_file(H5std_string(filename.data()), H5F_ACC_RDONLY);
+    const std::string dataset_name(output_h5_t::fname_map.at(field_name) + std::to_string(snapshot));
+    if(!input_file.exists(dataset_name))
+        throw config_error(std::string("input_h5_t: ") + filename + std::string(" has no dataset ") + dataset_name);
+    DataSet dataset{input_file.openDataSet(dataset_name)};
+
+    // The dataset has no padding, the memory dataspace selects the same hyperslab as in output_h5_t
+    const hsize_t ds_memsize[] = {geom.get_nx() + geom.get_pad_x(), geom.get_my() + geom.get_pad_y()};
+    const hsize_t ds_fsize[] = {geom.get_nx(), geom.get_my()};
+    const hsize_t offset[] = {0, 0};
+
+    DataSpace dspace_file{dataset.getSpace()};
+    hsize_t ds_dims[2];
+    if(dspace_file.getSimpleExtentNdims() != 2)
+        throw config_error(std::string("input_h5_t: ") + dataset_name + std::string(" is not a 2d dataset"));
+    dspace_file.getSimpleExtentDims(ds_dims);
+    if(ds_dims[0] != ds_fsize[0] || ds_dims[1] != ds_fsize[1])
+        throw config_error(std::string("input_h5_t: Size of ") + dataset_name + std::string(" does not match the stored configuration"));
+
+    DataSpace dspace_mem(2, ds_memsize);
+    dspace_mem.selectHyperslab(H5S_SELECT_SET, ds_fsize, offset, NULL, NULL);
+    dataset.read(dst.get_tlev_ptr(tidx), PredType::NATIVE_DOUBLE, dspace_mem, dspace_file);
+    dst.set_transformed(tidx, false);
+}
+
 // End of file output.cpp
\ No newline at end of file
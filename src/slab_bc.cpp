@@ -7,17 +7,121 @@
 using namespace std;
 
 map<twodads::rhs_t, slab_bc::rhs_func_ptr> slab_bc :: rhs_func_map = slab_bc::create_rhs_func_map();
+constexpr twodads::real_t slab_bc :: deltat_growth;
+constexpr twodads::real_t slab_bc :: deltat_shrink;
 
-slab_bc :: slab_bc(const slab_config_js& _conf) :
-    conf(_conf),
-    output(_conf),
-    diagnostic(_conf),
+namespace
+{
+    // Throws config_error for inconsistent configurations, before the members allocate memory
+    const slab_config_js& checked_config(const slab_config_js& cfg)
+    {
+        cfg.check_consistency();
+        return(cfg);
+    }
+}
+
+#ifdef USE_MPI
+namespace
+{
+    int get_comm_size(MPI_Comm comm)
+    {
+        int num_ranks{1};
+        MPI_Comm_size(comm, &num_ranks);
+        return(num_ranks);
+    }
+
+    // Configuration of the rows this rank holds, see slab_config_js :: get_subdomain
+    slab_config_js get_local_config(const slab_config_js& cfg, MPI_Comm comm)
+    {
+        int rank{0};
+        MPI_Comm_rank(comm, &rank);
+        const int num_ranks{get_comm_size(comm)};
+        if(num_ranks == 1)
+            return(cfg);
+        return(cfg.get_subdomain(static_cast<size_t>(rank), static_cast<size_t>(num_ranks)));
+    }
+
+    // Communication with the other ranks, nullptr if comm has a single rank
+    decomp_mpi_t* create_decomp(const slab_config_js& cfg, MPI_Comm comm, const shared_objects_t* shared)
+    {
+        if(get_comm_size(comm) == 1)
+            return(nullptr);
+        if(shared != nullptr)
+            throw config_error(std::string("slab_bc: Shared objects are not supported on a distributed grid"));
+        return(new decomp_mpi_t(cfg.get_geom(), comm));
+    }
+
+    bool is_root_rank(MPI_Comm comm)
+    {
+        int rank{0};
+        MPI_Comm_rank(comm, &rank);
+        return(rank == 0);
+    }
+
+    // Configuration of the output and diagnostics queues of the root. On a distributed grid, each
+    // buffer holds the whole grid, so that the root gathers the fields through a single buffer per queue.
+    slab_config_js get_root_config(const slab_config_js& cfg, MPI_Comm comm)
+    {
+        if(get_comm_size(comm) == 1)
+            return(cfg);
+        boost::property_tree::ptree pt{cfg.get_pt()};
+        pt.put("2dads.output.buffers", std::min<size_t>(cfg.get_output_buffers(), 1));
+        pt.put("2dads.diagnostics.buffers", std::min<size_t>(cfg.get_diag_buffers(), 1));
+        return(slab_config_js(pt));
+    }
+}
+#endif //USE_MPI
+
+slab_bc :: step_params_t :: step_params_t(const slab_config_js& _conf) :
+    grid_type{_conf.get_grid_type()},
+    scheme{_conf.get_scheme_t()},
+    deltax_min{_conf.get_geom().get_deltax_min()},
+    deltay{_conf.get_deltay()},
+    deltat_max{_conf.get_deltat_max()},
+    cfl{_conf.get_cfl()},
+    cfl_diff{_conf.get_cfl_diff()},
+    tol{_conf.get_tol()},
+    watchdog_check{_conf.get_watchdog_check()}
+{
+    for(auto fname : {twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau})
+        tint_params.emplace(fname, _conf.get_tint_params(fname));
+    for(auto it : {std::make_pair(twodads::dyn_field_t::f_theta, twodads::field_t::f_theta),
+                   std::make_pair(twodads::dyn_field_t::f_omega, twodads::field_t::f_omega),
+                   std::make_pair(twodads::dyn_field_t::f_tau, twodads::field_t::f_tau)})
+    {
+        const twodads::bvals_t<twodads::real_t> bvals{_conf.get_bvals(it.second)};
+        bc_types.emplace(it.first, std::make_pair(bvals.get_bc_left(), bvals.get_bc_right()));
+    }
+    if(_conf.get_rhs_t(twodads::dyn_field_t::f_theta) == twodads::rhs_t::rhs_theta_log)
+        model_params.emplace(twodads::dyn_field_t::f_theta, _conf.get_model_params(twodads::dyn_field_t::f_theta));
+    if(_conf.get_rhs_t(twodads::dyn_field_t::f_omega) == twodads::rhs_t::rhs_omega_ic)
+        model_params.emplace(twodads::dyn_field_t::f_omega, _conf.get_model_params(twodads::dyn_field_t::f_omega));
+}
+
+
+#ifdef USE_MPI
+slab_bc :: slab_bc(const slab_config_js& _conf, shared_objects_t* _shared, MPI_Comm comm) :
+    conf(checked_config(get_local_config(_conf, comm))),
+    step_params(_conf),
+    decomp{create_decomp(get_config(), comm, _shared)},
+    // Output and diagnostics cover the whole grid
+    output{is_root_rank(comm) ? new output_queue_t(get_root_config(_conf, comm)) : nullptr},
+    diagnostic{is_root_rank(comm) ? new diagnostic_queue_t(get_root_config(_conf, comm)) : nullptr},
+#else
+slab_bc :: slab_bc(const slab_config_js& _conf, shared_objects_t* _shared) :
+    conf(checked_config(_conf)),
+    step_params(_conf),
+    output{new output_queue_t(_conf)},
+    diagnostic{new diagnostic_queue_t(_conf)},
+#endif //USE_MPI
+    shared{_shared},
 #ifdef DEVICE
-    myfft{new cufft_object_t<twodads::real_t>(get_config().get_geom(), get_config().get_dft_t())},
+    myfft{shared == nullptr ? new cufft_object_t<twodads::real_t>(get_config().get_geom(), get_config().get_dft_t()) : shared -> get_dft(get_config())},
 #endif //DEVICE
 #ifdef HOST
-    myfft{new fftw_object_t<twodads::real_t>(get_config().get_geom(), get_config().get_dft_t())},
+    myfft{shared == nullptr ? new fftw_object_t<twodads::real_t>(get_config().get_geom(), get_config().get_dft_t()) : shared -> get_dft(get_config())},
 #endif //HOST
+    my_derivs{nullptr},
     tint_theta{nullptr},
     tint_omega{nullptr},
     tint_tau{nullptr},
@@ -68,72 +172,149 @@ slab_bc :: slab_bc(const slab_config_js& _conf) :
                         {twodads::output_t::o_strmf,    &strmf},
                         {twodads::output_t::o_strmf_x,  &strmf_x},
                         {twodads::output_t::o_strmf_y,  &strmf_y}},
+    dyn_fields{&theta, &omega, &tau},
+    dyn_fields_rhs{&theta_rhs, &omega_rhs, &tau_rhs},
     theta_rhs_func{rhs_func_map.at(get_config().get_rhs_t(twodads::dyn_field_t::f_theta))},
     omega_rhs_func{rhs_func_map.at(get_config().get_rhs_t(twodads::dyn_field_t::f_omega))},
     tau_rhs_func{rhs_func_map.at(get_config().get_rhs_t(twodads::dyn_field_t::f_tau))}
 {
-    puts(__PRETTY_FUNCTION__);
+    // Configure the log before writing to it. Slabs with shared objects write to the log of their owner.
+    if(shared == nullptr)
+        configure_log(get_config());
+    LOG_MESSAGE(logger::level_t::debug, "%s", __PRETTY_FUNCTION__);
+
+    // The derivation objects and integrators create FFTW plans, see shared_objects_t
+    std::unique_lock<std::recursive_mutex> setup_lock;
+    if(shared != nullptr)
+    {
+        setup_lock = std::unique_lock<std::recursive_mutex>(shared -> get_mutex());
+        my_derivs = shared -> get_derivs(get_config());
+        own_derivs = (my_derivs == nullptr);
+    }
     switch(get_config().get_grid_type())
     {
         case twodads::grid_t::vertex_centered:
 #ifdef HOST
-            my_derivs = new deriv_spectral_t<value_t, allocator_host>(get_config().get_geom());
-            tint_theta = new integrator_karniadakis_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
-            tint_omega = new integrator_karniadakis_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
-            tint_tau = new integrator_karniadakis_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            if(own_derivs)
+                my_derivs = new deriv_spectral_t<value_t, allocator_host>(get_config().get_geom());
+            if(get_config().get_scheme_t() == twodads::scheme_t::scheme_etdrk4)
+            {
+                tint_theta = new integrator_etdrk4_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
+                tint_omega = new integrator_etdrk4_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
+                tint_tau = new integrator_etdrk4_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            }
+            else
+            {
+                tint_theta = new integrator_karniadakis_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
+                tint_omega = new integrator_karniadakis_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
+                tint_tau = new integrator_karniadakis_bs_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            }
 #endif //HOST
 #ifdef DEVICE
-            my_derivs = new deriv_spectral_t<value_t, allocator_device>(get_config().get_geom());
-            tint_theta = new integrator_karniadakis_bs_t<value_t, allocator_devicet>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
-            tint_omega = new integrator_karniadakis_bs_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
-            tint_tau = new integrator_karniadakis_bs_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            if(own_derivs)
+                my_derivs = new deriv_spectral_t<value_t, allocator_device>(get_config().get_geom());
+            if(get_config().get_scheme_t() == twodads::scheme_t::scheme_etdrk4)
+            {
+                tint_theta = new integrator_etdrk4_bs_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
+                tint_omega = new integrator_etdrk4_bs_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
+                tint_tau = new integrator_etdrk4_bs_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            }
+            else
+            {
+                tint_theta = new integrator_karniadakis_bs_t<value_t, allocator_devicet>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
+                tint_omega = new integrator_karniadakis_bs_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
+                tint_tau = new integrator_karniadakis_bs_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            }
 #endif //DEVICE
             break;
 
         case twodads::grid_t::cell_centered:
 #ifdef HOST
-            my_derivs = new deriv_fd_t<value_t, allocator_host>(get_config().get_geom());
-            tint_theta = new integrator_karniadakis_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
-            tint_omega = new integrator_karniadakis_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
-            tint_tau = new integrator_karniadakis_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            if(own_derivs)
+            {
+#ifdef USE_MPI
+                if(decomp != nullptr)
+                    my_derivs = new deriv_fd_mpi_t<value_t>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_strmf), get_config().get_solver_t(), *decomp);
+                else
+#endif //USE_MPI
+                my_derivs = new deriv_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_strmf), get_config().get_solver_t());
+            }
+            if(get_config().get_scheme_t() == twodads::scheme_t::scheme_ark)
+            {
+                tint_theta = new integrator_ark_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta), get_config().get_solver_t());
+                tint_omega = new integrator_ark_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega), get_config().get_solver_t());
+                tint_tau = new integrator_ark_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau), get_config().get_solver_t());
+            }
+            else
+            {
+                tint_theta = new integrator_karniadakis_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta), get_config().get_solver_t());
+                tint_omega = new integrator_karniadakis_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega), get_config().get_solver_t());
+                tint_tau = new integrator_karniadakis_fd_t<value_t, allocator_host>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau), get_config().get_solver_t());
+            }
 #endif //HOST
 #ifdef DEVICE
-            my_derivs = new deriv_fd_t<value_t, allocator_device>(get_config().get_geom());
-            tint_theta = new integrator_karniadakis_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta));
-            tint_omega = new integrator_karniadakis_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega));
-            tint_tau = new integrator_karniadakis_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau));
+            if(own_derivs)
+                my_derivs = new deriv_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_strmf), get_config().get_solver_t());
+            if(get_config().get_scheme_t() == twodads::scheme_t::scheme_ark)
+            {
+                tint_theta = new integrator_ark_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta), get_config().get_solver_t());
+                tint_omega = new integrator_ark_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega), get_config().get_solver_t());
+                tint_tau = new integrator_ark_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau), get_config().get_solver_t());
+            }
+            else
+            {
+                tint_theta = new integrator_karniadakis_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_theta), get_config().get_tint_params(twodads::dyn_field_t::f_theta), get_config().get_solver_t());
+                tint_omega = new integrator_karniadakis_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_omega), get_config().get_tint_params(twodads::dyn_field_t::f_omega), get_config().get_solver_t());
+                tint_tau = new integrator_karniadakis_fd_t<value_t, allocator_device>(get_config().get_geom(), get_config().get_bvals(twodads::field_t::f_tau), get_config().get_tint_params(twodads::dyn_field_t::f_tau), get_config().get_solver_t());
+            }
 #endif //DEVICE
             break;
     }
- 
-    try
+
+    // Tag the fields in the memory footprint, see footprint.h
+    const std::vector<std::pair<std::string, arr_real*>> fields{ {"theta", &theta}, {"theta_x", &theta_x}, {"theta_y", &theta_y},
+                                                                 {"omega", &omega}, {"omega_x", &omega_x}, {"omega_y", &omega_y},
+                                                                 {"tau", &tau}, {"tau_x", &tau_x}, {"tau_y", &tau_y}, {"tmp", &tmp},
+                                                                 {"strmf", &strmf}, {"strmf_x", &strmf_x}, {"strmf_y", &strmf_y},
+                                                                 {"theta_rhs", &theta_rhs}, {"omega_rhs", &omega_rhs}, {"tau_rhs", &tau_rhs}};
+    for(const auto& it : fields)
+        it.second -> set_tag("slab_bc", it.first);
+
+#ifdef DEVICE
+    // Page-lock the output buffers for faster copies from the device
+    for(auto it : output -> get_buffers())
+        gpuErrchk(cudaHostRegister(it -> get_tlev_ptr(0), get_nbytes_per_t(), cudaHostRegisterDefault));
+#endif //DEVICE
+
+    // Snapshot for repeating time steps with non-finite values, see save_snapshot
+    if(get_config().get_watchdog_retries() > 0)
     {
-        conf.check_consistency();    
+        for(auto it : get_field_by_name)
+        {
+            arr_real* copy{new arr_real(it.second -> get_geom(), it.second -> get_bvals(), it.second -> get_tlevs())};
+            copy -> set_tag("slab_bc", std::string("snapshot_") + slab_config_js :: get_field_name(it.first));
+            snapshot_fields.push_back(std::make_pair(it.second, copy));
+        }
+        // Reserve the storage of the integrator states
+        snapshot_states.resize(3);
+        tint_theta -> get_state(snapshot_states[0]);
+        tint_omega -> get_state(snapshot_states[1]);
+        tint_tau -> get_state(snapshot_states[2]);
     }
-    catch (config_error e)
+
+    // Time the stages of the simulation when a profile report is requested
+    if(!get_config().get_profile_file().empty())
     {
-        std::cerr << "Error in slab configuration: " << e.what() << std::endl;
+        profiler :: registry_t :: get().enable();
+        if(get_config().get_profile_counters() && !profiler :: registry_t :: get().enable_counters())
+            LOG_MESSAGE(logger::level_t::warning, "Hardware counters are not available: %s", profiler :: registry_t :: get().get_counter_error().c_str());
     }
-
-    // Set data pointers of diagnostic data member
-    // This routine should be constant as to forbid overwriting of the simulation data
-    diagnostic.init_field_ptr(twodads::field_t::f_theta,   &theta);
-    diagnostic.init_field_ptr(twodads::field_t::f_theta_x, &theta_x);
-    diagnostic.init_field_ptr(twodads::field_t::f_theta_y, &theta_y);
-    diagnostic.init_field_ptr(twodads::field_t::f_omega,   &omega);
-    diagnostic.init_field_ptr(twodads::field_t::f_omega_x, &omega_x);
-    diagnostic.init_field_ptr(twodads::field_t::f_omega_y, &omega_y);
-    diagnostic.init_field_ptr(twodads::field_t::f_tau,     &tau);
-    diagnostic.init_field_ptr(twodads::field_t::f_tau_x,   &tau_x);
-    diagnostic.init_field_ptr(twodads::field_t::f_tau_y,   &tau_y);
-    diagnostic.init_field_ptr(twodads::field_t::f_strmf,   &strmf);
-    diagnostic.init_field_ptr(twodads::field_t::f_strmf_x, &strmf_x);
-    diagnostic.init_field_ptr(twodads::field_t::f_strmf_y, &strmf_y);
 }
 
 
 void slab_bc :: dft_r2c(const twodads::field_t fname, const size_t tidx)
 {
+    PROFILE_SCOPE("slab_bc::dft_r2c", 2 * get_nbytes_per_t());
     arr_real* arr{get_field_by_name.at(fname)};
     assert(((*arr).is_transformed(tidx) == false) && "slab_bc :: dft_r2c: Array is already transformed");
 
@@ -144,17 +325,33 @@ void slab_bc :: dft_r2c(const twodads::field_t fname, const size_t tidx)
 
 void slab_bc :: dft_c2r(const twodads::field_t fname, const size_t tidx)
 {
+    PROFILE_SCOPE("slab_bc::dft_c2r", 2 * get_nbytes_per_t());
     arr_real* arr{get_field_by_name.at(fname)};
     assert((*arr).is_transformed(tidx) && "slab_bc :: dft_c2r: Array is not transformed");
 
     (*myfft).dft_c2r(reinterpret_cast<twodads::cmplx_t*>((*arr).get_tlev_ptr(tidx)), (*arr).get_tlev_ptr(tidx));
-    utility :: normalize(*arr, tidx);
+    if(step_params.watchdog_check)
+    {
+        // Check for non-finite values in the same pass as the normalization. Keep the first field that has them.
+        const utility :: nonfinite_t res{utility :: normalize_check(*arr, tidx)};
+        if(res.count > 0 && nonfinite.count == 0)
+        {
+            nonfinite = res;
+            nonfinite_field = fname;
+            nonfinite_tidx = tidx;
+        }
+    }
+    else
+    {
+        utility :: normalize(*arr, tidx);
+    }
     (*arr).set_transformed(tidx, false);
 }
 
 
 void slab_bc :: initialize()
 {
+    PROFILE_SCOPE("slab_bc::initialize", 0);
     // Initialize the fields according to input.json and calculate the derivatives
 
     // Make tuples dyn_field : (field, field_x, field_y)
@@ -257,6 +454,11 @@ void slab_bc :: initialize()
                 throw not_implemented_error(std::string("Initializing turbulent bath: not implemented yet"));
             break;
 
+        case twodads::init_fun_t::init_file:
+            assert(initvals.size() == 1 && "Initializing from a file requires the number of the snapshot");
+            init_from_file(it.first, static_cast<size_t>(initvals[0]), tidx);
+            break;
+
         case twodads::init_fun_t::init_NA:
                 throw not_implemented_error(std::string("Initialization routine not available"));
             break;
@@ -296,14 +498,171 @@ void slab_bc :: initialize()
 }
 
 
+void slab_bc :: init_from_file(const twodads::dyn_field_t fname, const size_t snapshot, const size_t tidx)
+{
+    const std::map<twodads::dyn_field_t, twodads::output_t> output_name{{twodads::dyn_field_t::f_theta, twodads::output_t::o_theta},
+                                                                        {twodads::dyn_field_t::f_omega, twodads::output_t::o_omega},
+                                                                        {twodads::dyn_field_t::f_tau,   twodads::output_t::o_tau}};
+    // HDF5 is called only from the output thread while it writes
+    if(output != nullptr)
+        output -> flush();
+    input_h5_t input(get_config().get_init_file());
+    const twodads::slab_layout_t geom_src{input.get_config().get_geom()};
+    const twodads::slab_layout_t geom_dst{get_config().get_geom()};
+    arr_real* field{get_dfield_by_name.at(fname)};
+
+    // Regridding keeps the domain and the type of the grid
+    const twodads::real_t eps{1e-10};
+    if(std::fabs(geom_src.get_xleft() - geom_dst.get_xleft()) > eps * geom_dst.get_Lx() ||
+       std::fabs(geom_src.get_Lx() - geom_dst.get_Lx()) > eps * geom_dst.get_Lx() ||
+       std::fabs(geom_src.get_ylo() - geom_dst.get_ylo()) > eps * geom_dst.get_Ly() ||
+       std::fabs(geom_src.get_Ly() - geom_dst.get_Ly()) > eps * geom_dst.get_Ly())
+    {
+        throw config_error(std::string("init_from_file: ") + get_config().get_init_file() + std::string(" covers a different domain"));
+    }
+    if(geom_src.get_grid() != geom_dst.get_grid())
+        throw config_error(std::string("init_from_file: ") + get_config().get_init_file() + std::string(" uses a different grid type"));
+
+    cuda_array_bc_nogp<value_t, allocator_host> src_host(geom_src, field -> get_bvals(), 1);
+    src_host.set_tag("slab_bc", "init_file");
+    input.surface(output_name.at(fname), snapshot, src_host, 0);
+
+    // initialize takes the logarithm if the slab uses a logarithmic formulation
+    if((fname == twodads::dyn_field_t::f_theta && input.get_config().get_log_theta()) ||
+       (fname == twodads::dyn_field_t::f_tau && input.get_config().get_log_tau()))
+    {
+        src_host.apply([] (twodads::real_t input, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                       {return(exp(input));}, 0);
+    }
+
+#ifdef DEVICE
+    arr_real src(geom_src, field -> get_bvals(), 1);
+    src.set_tag("slab_bc", "init_file");
+    gpuErrchk(cudaMemcpy(src.get_tlev_ptr(0), src_host.get_tlev_ptr(0), geom_src.get_nelem_per_t() * sizeof(value_t), cudaMemcpyHostToDevice));
+    src.set_transformed(0, false);
+    regrid(src, *field, tidx);
+#endif //DEVICE
+#ifdef HOST
+    regrid(src_host, *field, tidx);
+#endif //HOST
+}
+
+
+void slab_bc :: regrid(arr_real& src, arr_real& dst, const size_t tidx)
+{
+    // Number of points of the interpolation stencil in x
+    constexpr long num_pts{6};
+    const twodads::slab_layout_t geom_src{src.get_geom()};
+    const twodads::slab_layout_t geom_dst{dst.get_geom()};
+    if(geom_src.get_nx() < num_pts)
+        throw config_error(std::string("regrid: Interpolation in x requires at least 6 grid points"));
+    assert(src.is_transformed(0) == false);
+
+    // Intermediate field with the x-resolution of src and the y-resolution of dst
+    const twodads::slab_layout_t geom_mid(geom_src.get_xleft(), geom_src.get_deltax(), geom_dst.get_ylo(), geom_dst.get_deltay(),
+                                          geom_src.get_nx(), geom_src.get_pad_x(), geom_dst.get_my(), geom_dst.get_pad_y(), geom_src.get_grid(),
+                                          geom_src.get_stretch_x());
+    arr_real mid(geom_mid, src.get_bvals(), 1);
+    mid.set_tag("slab_bc", "regrid");
+
+    // y-direction: Fourier transform each row of src and copy the modes to mid. Modes beyond the 
+    // resolution of dst are dropped, missing modes are zero. The Nyquist mode of the coarser grid is
+    // split between +-ky or merged from +-ky. The phase shift accounts for different positions of the first
+    // grid point on cell-centered grids.
+    dft_t dft_src(geom_src, twodads::dft_t::dft_1d);
+    dft_t dft_mid(geom_mid, twodads::dft_t::dft_1d);
+    dft_src.dft_r2c(src.get_tlev_ptr(0), reinterpret_cast<cmplx_t*>(src.get_tlev_ptr(0)));
+    src.set_transformed(0, true);
+
+    const value_t* src_hat{src.get_tlev_ptr(0)};
+    const size_t stride_src{geom_src.get_my() + geom_src.get_pad_y()};
+    const size_t nyq_src{geom_src.get_my() / 2};
+    const size_t nyq_dst{geom_dst.get_my() / 2};
+    const value_t inv_my_src{1.0 / static_cast<value_t>(geom_src.get_my())};
+    const value_t dphi{twodads::TWOPI * (geom_dst.get_y(0) - geom_src.get_y(0)) / geom_src.get_Ly()};
+    mid.set_transformed(0, true);
+    mid.apply([=] LAMBDACALLER (value_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> value_t
+    {
+        const size_t k{m / 2};
+        if(k > nyq_src || k > nyq_dst)
+            return(0.0);
+        value_t re{src_hat[n * stride_src + 2 * k] * inv_my_src};
+        value_t im{src_hat[n * stride_src + 2 * k + 1] * inv_my_src};
+        const value_t re_shift{re * cos(dphi * k) - im * sin(dphi * k)};
+        im = re * sin(dphi * k) + im * cos(dphi * k);
+        re = re_shift;
+        if(k == nyq_src && nyq_dst > nyq_src)
+        {
+            re *= 0.5;
+            im *= 0.5;
+        }
+        else if(k == nyq_dst && nyq_src > nyq_dst)
+        {
+            re *= 2.0;
+            im = 0.0;
+        }
+        return(m % 2 == 0 ? re : im);
+    }, 0);
+    dft_mid.dft_c2r(reinterpret_cast<cmplx_t*>(mid.get_tlev_ptr(0)), mid.get_tlev_ptr(0));
+    mid.set_transformed(0, false);
+
+    // x-direction: Lagrange interpolation with num_pts points centered around the destination point
+    const value_t* mid_ptr{mid.get_tlev_ptr(0)};
+    const size_t stride_mid{geom_mid.get_my() + geom_mid.get_pad_y()};
+    const long nx_src{static_cast<long>(geom_src.get_nx())};
+    const value_t x0_src{geom_src.get_x(0)};
+    const value_t dx_src{geom_src.get_deltax()};
+    const bool periodic{geom_src.get_grid() == twodads::grid_t::vertex_centered};
+    dst.set_transformed(tidx, false);
+    dst.apply([=] LAMBDACALLER (value_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> value_t
+    {
+        // Position in units of the source grid. On a stretched source grid, invert the grid mapping
+        // xi - a / (2 pi) sin(2 pi xi) = (x - x_left) / Lx with Newton's method. The mapping is monotonic.
+        value_t s{(geom.get_x(n) - x0_src) / dx_src};
+        if(geom_src.get_stretch_x() != 0.0)
+        {
+            const value_t a{geom_src.get_stretch_x()};
+            const value_t rhs{(geom.get_x(n) - geom_src.get_xleft()) / geom_src.get_Lx()};
+            value_t xi{rhs};
+            for(size_t it = 0; it < 50; it++)
+            {
+                const value_t res{xi - a * sin(twodads::TWOPI * xi) / twodads::TWOPI - rhs};
+                xi -= res / (1.0 - a * cos(twodads::TWOPI * xi));
+                if(fabs(res) < 1e-15)
+                    break;
+            }
+            s = xi * static_cast<value_t>(geom_src.get_nx()) - geom_src.get_cellshift();
+        }
+        long i0{static_cast<long>(floor(s)) - (num_pts / 2 - 1)};
+        if(!periodic)
+            i0 = (i0 < 0) ? 0 : ((i0 > nx_src - num_pts) ? nx_src - num_pts : i0);
+
+        value_t sum{0.0};
+        for(long j = 0; j < num_pts; j++)
+        {
+            value_t w{1.0};
+            for(long l = 0; l < num_pts; l++)
+            {
+                if(l != j)
+                    w *= (s - static_cast<value_t>(i0 + l)) / static_cast<value_t>(j - l);
+            }
+            const long i{periodic ? ((i0 + j) % nx_src + nx_src) % nx_src : i0 + j};
+            sum += w * mid_ptr[static_cast<size_t>(i) * stride_mid + m];
+        }
+        return(sum);
+    }, tidx);
+}
+
+
 // Compute x-derivative
 void slab_bc :: d_dx(const twodads::field_t fname_src, const twodads::field_t fname_dst,
                      const size_t order, const size_t t_src, const size_t t_dst)
 {
+    PROFILE_SCOPE("slab_bc::d_dx", 2 * get_nbytes_per_t());
     arr_real* arr_src{get_field_by_name.at(fname_src)};
     arr_real* arr_dst{get_field_by_name.at(fname_dst)};
 
-    switch(get_config().get_grid_type())
+    switch(step_params.grid_type)
     {
         case twodads::grid_t::cell_centered:
             // Cell-centered grids use finite difference schemes. Nothing to do here.
@@ -324,6 +683,7 @@ void slab_bc :: d_dx(const twodads::field_t fname_src, const twodads::field_t fn
 void slab_bc :: d_dy(const twodads::field_t fname_src, const twodads::field_t fname_dst,
                      const size_t order, const size_t t_src, const size_t t_dst)
 {
+    PROFILE_SCOPE("slab_bc::d_dy", 2 * get_nbytes_per_t());
     arr_real* arr_src = get_field_by_name.at(fname_src);
     arr_real* arr_dst = get_field_by_name.at(fname_dst);
 
@@ -340,6 +700,7 @@ void slab_bc :: d_dy(const twodads::field_t fname_src, const twodads::field_t fn
 // Invert the laplace equation
 void slab_bc :: invert_laplace(const twodads::field_t in, const twodads::field_t out, const size_t t_src, const size_t t_dst)
 {
+    PROFILE_SCOPE("slab_bc::invert_laplace", 2 * get_nbytes_per_t());
     arr_real* in_arr{get_field_by_name.at(in)};
     arr_real* out_arr{get_field_by_name.at(out)};
 
@@ -356,98 +717,277 @@ void slab_bc :: invert_laplace(const twodads::field_t in, const twodads::field_t
 // order gives the order of the time integration routine
 void slab_bc :: integrate(const twodads::dyn_field_t fname, const size_t order)
 {
-    const size_t tlevs{get_config().get_tint_params(fname).get_tlevs()};
-    assert(order > 0 && order < tlevs);
+    integrate(std::vector<twodads::dyn_field_t>{fname}, order);
+}
+
 
-    arr_real* arr = get_dfield_by_name.at(fname);
-    arr_real* arr_rhs{nullptr};
+// Returns true if the two fields can be integrated with the same linear system
+bool slab_bc :: same_system(const twodads::dyn_field_t f1, const twodads::dyn_field_t f2)
+{
+    const twodads::stiff_params_t& p1{step_params.tint_params.at(f1)};
+    const twodads::stiff_params_t& p2{step_params.tint_params.at(f2)};
+    return((p1.get_tlevs() == p2.get_tlevs()) && (p1.get_deltat() == p2.get_deltat()) && 
+           (p1.get_diff() == p2.get_diff()) && (p1.get_hv() == p2.get_hv()) && (p1.get_hv_order() == p2.get_hv_order()) &&
+           (step_params.bc_types.at(f1) == step_params.bc_types.at(f2)));
+}
 
+
+// Integrate several fields in time
+// Consecutive fields with the same time integration parameters and boundary condition types
+// share a linear system and are passed together to the integrator of the first field in the group.
+void slab_bc :: integrate(const std::vector<twodads::dyn_field_t>& fnames, const size_t order)
+{
+    PROFILE_SCOPE("slab_bc::integrate", fnames.size() * (2 * order + 1) * get_nbytes_per_t());
 #ifdef HOST
-    integrator_base_t<value_t, allocator_host>* tint_ptr{nullptr};
+    using tint_t = integrator_base_t<value_t, allocator_host>;
 #endif
 #ifdef DEVICE
-    integrator_base_t<value_t, allocator_device>* tint_ptr{nullptr};
+    using tint_t = integrator_base_t<value_t, allocator_device>;
 #endif
 
-    switch(fname)
+    size_t f_start{0};
+    while(f_start < fnames.size())
     {
-        case twodads::dyn_field_t::f_theta:
-            tint_ptr = tint_theta;
-            arr_rhs = &theta_rhs;
-            break;
-        case twodads::dyn_field_t::f_omega:
-            tint_ptr = tint_omega;
-            arr_rhs = &omega_rhs;
-            break;
-        case twodads::dyn_field_t::f_tau:
-            tint_ptr = tint_tau;
-            arr_rhs = &tau_rhs;
-            break;
-    }
+        const size_t tlevs{step_params.tint_params.at(fnames[f_start]).get_tlevs()};
+        assert(order > 0 && order < tlevs);
 
-    // The driver code for slab-objects shold ensure that for first order integration
-    // arr[tlevs - 1], arr[tlevs - 2], and arr_rhs[tlevs - 2] are real, irrespective of
-    // the used grid when entering slab_bc :: integrate.
-    // If we have a vertex centered grid they need to be transformed into fourier space.
-    // Second and third order integrators need more fields to be transformed. 
-    
-    if(get_config().get_grid_type() == twodads::grid_t::vertex_centered)
-    {
-        std::vector<size_t> arr_idx;
-        std::vector<size_t> arr_rhs_idx;
+        tint_t* tint_ptr{nullptr};
+        // Clearing keeps the storage of the previous steps
+        batch_fields.clear();
+        batch_fields_rhs.clear();
+
+        size_t f_end{f_start};
+        for(; f_end < fnames.size() && same_system(fnames[f_start], fnames[f_end]); f_end++)
+        {
+            arr_real* arr = get_dfield_by_name.at(fnames[f_end]);
+            arr_real* arr_rhs{nullptr};
+
+            switch(fnames[f_end])
+            {
+                case twodads::dyn_field_t::f_theta:
+                    tint_ptr = (tint_ptr == nullptr) ? tint_theta : tint_ptr;
+                    arr_rhs = &theta_rhs;
+                    break;
+                case twodads::dyn_field_t::f_omega:
+                    tint_ptr = (tint_ptr == nullptr) ? tint_omega : tint_ptr;
+                    arr_rhs = &omega_rhs;
+                    break;
+                case twodads::dyn_field_t::f_tau:
+                    tint_ptr = (tint_ptr == nullptr) ? tint_tau : tint_ptr;
+                    arr_rhs = &tau_rhs;
+                    break;
+            }
+
+            // The driver code for slab-objects shold ensure that for first order integration
+            // arr[tlevs - 1], arr[tlevs - 2], and arr_rhs[tlevs - 2] are real, irrespective of
+            // the used grid when entering slab_bc :: integrate.
+            // If we have a vertex centered grid they need to be transformed into fourier space.
+            // Second and third order integrators need more fields to be transformed. 
+            
+            if(step_params.grid_type == twodads::grid_t::vertex_centered && order > 0 && order < 4)
+            {
+                // Time index of the field and of the explicit part to transform
+                size_t arr_tidx{0};
+                size_t arr_rhs_tidx{0};
+                if(order == 1)
+                {
+                    arr_tidx = tlevs - 1;
+                    (*arr).set_transformed(tlevs - 2, true);
+                    arr_rhs_tidx = tlevs - 2;
+                } 
+                else if (order == 2)
+                {
+                    arr_tidx = tlevs - 2;
+                    (*arr).set_transformed(tlevs - 3, true);
+                    arr_rhs_tidx = tlevs - 3;
+                } 
+                else if (order == 3)
+                {
+                    arr_tidx = tlevs - 3;
+                    (*arr).set_transformed(0, true);
+                    arr_rhs_tidx = tlevs - 4;
+                }
+
+                assert(arr -> is_transformed(arr_tidx) == false);
+                (*myfft).dft_r2c((*arr).get_tlev_ptr(arr_tidx), 
+                                 reinterpret_cast<twodads::cmplx_t*>((*arr).get_tlev_ptr(arr_tidx)));
+                (*arr).set_transformed(arr_tidx, true);
+
+                assert(arr_rhs -> is_transformed(arr_rhs_tidx) == false);
+                (*myfft).dft_r2c((*arr_rhs).get_tlev_ptr(arr_rhs_tidx), 
+                                  reinterpret_cast<twodads::cmplx_t*>((*arr_rhs).get_tlev_ptr(arr_rhs_tidx)));
+                (*arr_rhs).set_transformed(arr_rhs_tidx, true);
+            }
+            batch_fields.push_back(arr);
+            batch_fields_rhs.push_back(arr_rhs);
+        }
+
+        // tint leaves gives the newest time step transformed.
         if(order == 1)
         {
-            arr_idx.push_back(tlevs - 1);
-            (*arr).set_transformed(tlevs - 2, true);
-            arr_rhs_idx.push_back(tlevs - 2);
-        } 
+            // second order integration: Source is at tlevs - 1,
+            // next time step data is writte to tlevs - 2 
+            tint_ptr -> integrate_batch(batch_fields, batch_fields_rhs, tlevs - 1, 0, 0, tlevs - 2, order);
+        }
         else if (order == 2)
         {
-            arr_idx.push_back(tlevs - 2);
-            (*arr).set_transformed(tlevs - 3, true);
-            arr_rhs_idx.push_back(tlevs - 3);
-        } 
+            // Third order:
+            // Sources at tlevs - 1, tlevs - 2
+            // Next time step data is written to tlevs - 3
+            tint_ptr -> integrate_batch(batch_fields, batch_fields_rhs, tlevs - 2, tlevs - 1, 0, tlevs - 3, order);
+        }
         else if (order == 3)
         {
-            arr_idx.push_back(tlevs - 3);
-            (*arr).set_transformed(0, true);
-            arr_rhs_idx.push_back(tlevs - 4);
+            tint_ptr -> integrate_batch(batch_fields, batch_fields_rhs, tlevs - 3, tlevs - 2, tlevs - 1, tlevs - 4, order);
         }
+        f_start = f_end;
+    }
+}
+
+
+// Advance theta, omega, and tau by one step of a single-step scheme. 
+// The explicit parts at the stages are computed by copying the stage data to t_dst of the dynamic fields,
+// and evaluating the right hand side there. The first stage is the data at t_src, where the real fields
+// are already up to date.
+void slab_bc :: integrate_stages(const size_t t_src, const size_t t_dst)
+{
+    // Includes the right hand sides at the stages
+    PROFILE_SCOPE("slab_bc::integrate_stages", 6 * get_nbytes_per_t());
+    assert(t_src != t_dst);
+
+    // All fields are advanced by one integrator, as the right hand sides couple them at each stage.
+    for(auto fname : {twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau})
+    {
+        if(!same_system(twodads::dyn_field_t::f_theta, fname))
+            throw config_error(std::string("integrate_stages: theta, omega, and tau need the same time integration parameters and boundary conditions"));
+    }
+
+    const bool spectral{step_params.grid_type == twodads::grid_t::vertex_centered};
+
+    // Explicit part for the first stage
+    rhs(0, t_src);
+
+    // Bispectral integrators work in Fourier space
+    if(spectral)
+    {
+        dft_r2c(twodads::field_t::f_theta, t_src);
+        dft_r2c(twodads::field_t::f_omega, t_src);
+        dft_r2c(twodads::field_t::f_tau, t_src);
+    }
 
-        for(auto tidx : arr_idx)
+    bool first_stage{true};
+    auto rhs_func = [&] (const std::vector<arr_real*>& src, const size_t t_stage, const std::vector<arr_real*>& dst, const size_t t_rhs) -> void
+    {
+        if(first_stage)
         {
-            assert(arr -> is_transformed(tidx) == false);
-            (*myfft).dft_r2c((*arr).get_tlev_ptr(tidx), 
-                             reinterpret_cast<twodads::cmplx_t*>((*arr).get_tlev_ptr(tidx)));
-            (*arr).set_transformed(tidx, true);
+            first_stage = false;
         }
-        for(auto tidx : arr_rhs_idx)
+        else
         {
-            assert(arr_rhs -> is_transformed(tidx) == false);
-            (*myfft).dft_r2c((*arr_rhs).get_tlev_ptr(tidx), 
-                              reinterpret_cast<twodads::cmplx_t*>((*arr_rhs).get_tlev_ptr(tidx)));
-            (*arr_rhs).set_transformed(tidx, true);
+            for(size_t f = 0; f < dyn_fields.size(); f++)
+                dyn_fields[f] -> copy(t_dst, *src[f], t_stage);
+
+            if(!spectral)
+            {
+                dft_r2c(twodads::field_t::f_theta, t_dst);
+                dft_r2c(twodads::field_t::f_omega, t_dst);
+                dft_r2c(twodads::field_t::f_tau, t_dst);
+            }
+            invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, t_dst, 0);
+            update_real_fields(t_dst);
+            rhs(0, t_dst);
         }
-    }
 
-    // tint leaves gives the newest time step transformed.
-    if(order == 1)
+        for(size_t f = 0; f < dyn_fields.size(); f++)
+        {
+            dst[f] -> copy(t_rhs, *dyn_fields_rhs[f], 0);
+            if(spectral)
+            {
+                (*myfft).dft_r2c(dst[f] -> get_tlev_ptr(t_rhs), reinterpret_cast<twodads::cmplx_t*>(dst[f] -> get_tlev_ptr(t_rhs)));
+                dst[f] -> set_transformed(t_rhs, true);
+            }
+        }
+    };
+
+    // std::function stores the reference_wrapper without allocating
+    tint_theta -> integrate_stages(dyn_fields, t_src, t_dst, std::ref(rhs_func));
+
+    // As slab_bc :: integrate, leave the new time step in Fourier space
+    if(!spectral)
     {
-        // second order integration: Source is at tlevs - 1,
-        // next time step data is writte to tlevs - 2 
-        tint_ptr -> integrate((*arr), (*arr_rhs), tlevs - 1, 0, 0, tlevs - 2, order);
+        dft_r2c(twodads::field_t::f_theta, t_dst);
+        dft_r2c(twodads::field_t::f_omega, t_dst);
+        dft_r2c(twodads::field_t::f_tau, t_dst);
     }
-    else if (order == 2)
+}
+
+
+// Set the step size of the next time step
+void slab_bc :: set_deltat(const twodads::real_t dt)
+{
+    tint_theta -> set_deltat(dt);
+    tint_omega -> set_deltat(dt);
+    tint_tau -> set_deltat(dt);
+}
+
+
+// Largest time step allowed by the CFL condition and the diffusion limit
+twodads::real_t slab_bc :: get_deltat_cfl()
+{
+    PROFILE_SCOPE("slab_bc::get_deltat_cfl", 2 * get_nbytes_per_t());
+    assert(strmf_x.is_transformed(0) == false);
+    assert(strmf_y.is_transformed(0) == false);
+
+    // v_x = -strmf_y, v_y = strmf_x
+#ifdef USE_MPI
+    const twodads::real_t max_vx{decomp != nullptr ? decomp -> max(utility :: max_abs(strmf_y, 0)) : utility :: max_abs(strmf_y, 0)};
+    const twodads::real_t max_vy{decomp != nullptr ? decomp -> max(utility :: max_abs(strmf_x, 0)) : utility :: max_abs(strmf_x, 0)};
+#else
+    const twodads::real_t max_vx{utility :: max_abs(strmf_y, 0)};
+    const twodads::real_t max_vy{utility :: max_abs(strmf_x, 0)};
+#endif //USE_MPI
+    // The smallest grid spacing limits the step size on stretched grids
+    const twodads::real_t inv_dx{1.0 / step_params.deltax_min};
+    const twodads::real_t inv_dy{1.0 / step_params.deltay};
+
+    twodads::real_t dt_max{step_params.deltat_max};
+    const twodads::real_t rate_adv{max_vx * inv_dx + max_vy * inv_dy};
+    if(rate_adv > 0.0)
+        dt_max = std::min(dt_max, step_params.cfl / rate_adv);
+
+    if(step_params.cfl_diff > 0.0)
     {
-        // Third order:
-        // Sources at tlevs - 1, tlevs - 2
-        // Next time step data is written to tlevs - 3
-        tint_ptr -> integrate((*arr), (*arr_rhs), tlevs - 2, tlevs - 1, 0, tlevs - 3, order);
+        twodads::real_t diff{0.0};
+        for(auto fname : {twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau})
+            diff = std::max(diff, step_params.tint_params.at(fname).get_diff());
+        if(diff > 0.0)
+            dt_max = std::min(dt_max, step_params.cfl_diff / (diff * (inv_dx * inv_dx + inv_dy * inv_dy)));
     }
-    else if (order == 3)
+    return(dt_max);
+}
+
+
+// Adapt the step size to the CFL limit. 
+twodads::real_t slab_bc :: adapt_deltat(const twodads::real_t dt)
+{
+    twodads::real_t dt_max{get_deltat_cfl()};
+
+    // With the ARK scheme, also limit the step size by the embedded error estimate of the last step.
+    // The embedded solution is second order, the local error scales as dt^3.
+    if(step_params.scheme == twodads::scheme_t::scheme_ark && step_params.tol > 0.0)
     {
-        tint_ptr -> integrate((*arr), (*arr_rhs), tlevs - 3, tlevs - 2, tlevs - 1, tlevs - 4, order);
+        const twodads::real_t err{tint_theta -> get_error_estimate()};
+        if(err > 0.0)
+            dt_max = std::min(dt_max, dt * std::max(deltat_shrink, std::cbrt(step_params.tol / err)));
     }
+
+    // Reduce the step size with a margin, so that it is not reduced again in the next steps
+    if(dt > dt_max)
+        return(dt_max / deltat_growth);
+    // Increase the step size only if the larger step size satisfies the limits
+    if(dt * deltat_growth <= dt_max)
+        return(dt * deltat_growth);
+    return(dt);
 }
 
 
@@ -458,11 +998,13 @@ void slab_bc :: integrate(const twodads::dyn_field_t fname, const size_t order)
  */
 void slab_bc :: update_real_fields(const size_t t_src)
 {
+    // Reads theta, omega, tau, and strmf and writes their derivatives
+    PROFILE_SCOPE("slab_bc::update_real_fields", 12 * get_nbytes_per_t());
     assert(theta.is_transformed(t_src) == true);
     assert(omega.is_transformed(t_src) == true);
     assert(tau.is_transformed(t_src) == true);
     assert(strmf.is_transformed(0) == true);
-    switch(get_config().get_grid_type())
+    switch(step_params.grid_type)
     {
         // Using semi-spectral methods, compute the y derivatives in fourier space
         // and the x derivatives in real space
@@ -556,6 +1098,7 @@ void slab_bc :: advance()
 
 void slab_bc :: write_output(const size_t t_src, const twodads::real_t time)
 {
+    PROFILE_SCOPE("slab_bc::write_output", 2 * get_config().get_output().size() * get_nbytes_per_t());
     arr_real* arr{nullptr};
     size_t t_out{0};
     // Iterate over list of fields we want in the HDF file
@@ -576,18 +1119,44 @@ void slab_bc :: write_output(const size_t t_src, const twodads::real_t time)
 
         assert(t_out < arr -> get_tlevs());
         assert(arr -> is_transformed(t_out) == false);
+#ifdef USE_MPI
+        // Gather the rows of all ranks into the buffer of the root
+        if(decomp != nullptr)
+        {
+            output_queue_t::arr_host* dst{is_root() ? output -> acquire() : nullptr};
+            decomp -> gather(arr -> get_tlev_ptr(t_out), is_root() ? dst -> get_tlev_ptr(0) : nullptr);
+            if(is_root())
+                output -> submit(it, time);
+            continue;
+        }
+#endif //USE_MPI
+        // Copy the field into a buffer of the output thread, which writes it while the time integration continues
+        output_queue_t::arr_host* dst{output -> acquire()};
 #ifdef DEVICE
-        output.surface(it, utility :: create_host_vector(arr), t_out, time);
+        gpuErrchk(cudaMemcpy(dst -> get_tlev_ptr(0), arr -> get_tlev_ptr(t_out), get_nbytes_per_t(), cudaMemcpyDeviceToHost));
 #endif
 #ifdef HOST
-        output.surface(it, arr, t_out, time);
+        dst -> copy(0, *arr, t_out);
 #endif
+        output -> submit(it, time);
     }
-    output.increment_output_counter();
+    if(output != nullptr)
+        output -> increment_output_counter();
+}
+
+
+void slab_bc :: flush_output()
+{
+    PROFILE_SCOPE("slab_bc::flush_output", 0);
+    if(output != nullptr)
+        output -> flush();
 }
 
 void slab_bc :: diagnose(const size_t t_src, const twodads::real_t time)
 {
+    // The ranks without the diagnostics thread send the same fields to the root
+    const std::vector<twodads::field_t> fields{diagnostic != nullptr ? diagnostic -> get_required_fields() : diagnostic_t :: get_required_fields(get_config())};
+    PROFILE_SCOPE("slab_bc::diagnose", 2 * fields.size() * get_nbytes_per_t());
     // Assert that all fields are real
     assert(get_array_ptr(twodads::field_t::f_theta) -> is_transformed(t_src) == false);
     assert(get_array_ptr(twodads::field_t::f_theta_x) -> is_transformed(0) == false);
@@ -603,47 +1172,320 @@ void slab_bc :: diagnose(const size_t t_src, const twodads::real_t time)
     assert(get_array_ptr(twodads::field_t::f_strmf_y) -> is_transformed(0) == false);
 
     // Get background to subtract for logarithmic density/temperature
-    twodads::real_t theta_bg{get_config().get_initc(twodads::dyn_field_t::f_theta)[0]};
-    twodads::real_t tau_bg{get_config().get_initc(twodads::dyn_field_t::f_tau)[0]};
+    const twodads::real_t theta_bg{get_config().get_initc(twodads::dyn_field_t::f_theta)[0]};
+    const twodads::real_t tau_bg{get_config().get_initc(twodads::dyn_field_t::f_tau)[0]};
 
-    // Treat logarithmic density and temperature fields
-    if(get_config().get_log_theta())
+    // Copy the fields into a buffer of the diagnostics thread, which evaluates them while the
+    // time integration continues. Logarithmic density and temperature are converted in the copy.
+    for(auto fname : fields)
     {
-        theta.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                          {return(exp(lhs));}, t_src, 0);
-        theta.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                          {return(lhs - theta_bg);}, t_src, 0);
+        const arr_real* src{get_field_by_name.at(fname)};
+        const size_t tidx{(fname == twodads::field_t::f_theta || fname == twodads::field_t::f_omega || fname == twodads::field_t::f_tau) ? t_src : 0};
+        diagnostic_queue_t::arr_real* dst{is_root() ? diagnostic -> acquire(fname) : nullptr};
+#ifdef USE_MPI
+        if(decomp != nullptr)
+        {
+            decomp -> gather(src -> get_tlev_ptr(tidx), is_root() ? dst -> get_tlev_ptr(0) : nullptr);
+            if(!is_root())
+                continue;
+        }
+        else
+#endif //USE_MPI
+#ifdef HOST
+        dst -> copy(0, *src, tidx);
+#endif //HOST
+#ifdef DEVICE
+        gpuErrchk(cudaMemcpy(dst -> get_tlev_ptr(0), src -> get_tlev_ptr(tidx), get_nbytes_per_t(), cudaMemcpyDeviceToHost));
+#endif //DEVICE
+        if(fname == twodads::field_t::f_theta && get_config().get_log_theta())
+            dst -> elementwise([=] (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
+                               {return(exp(lhs) - theta_bg);}, 0, 0);
+        if(fname == twodads::field_t::f_tau && get_config().get_log_tau())
+            dst -> elementwise([=] (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
+                               {return(exp(lhs) - tau_bg);}, 0, 0);
     }
-    if(get_config().get_log_tau())
+    if(diagnostic != nullptr)
+        diagnostic -> submit(time);
+}
+
+
+void slab_bc :: wait_diagnostics()
+{
+    PROFILE_SCOPE("slab_bc::wait_diagnostics", 0);
+    if(diagnostic != nullptr)
+        diagnostic -> wait();
+}
+
+
+// Layout of a checkpoint file:
+// checkpoint_header_t
+// For theta, omega, tau: number of entries of the integrator state, uint64_t, followed by the entries
+// For each field in get_field_by_name: number of time levels, uint64_t, the transformed flag of each 
+// time level, uint64_t, and the data of all time levels, including padding.
+// All entries are 8 bytes wide. Checkpoints are not portable between platforms of different endianness.
+namespace
+{
+    struct checkpoint_header_t
+    {
+        char magic[8];
+        uint64_t version;
+        uint64_t config_hash;
+        uint64_t nx;
+        uint64_t pad_x;
+        uint64_t my;
+        uint64_t pad_y;
+        uint64_t tstep;
+        uint64_t output_counter;
+        twodads::real_t time;
+        twodads::real_t deltat;
+    };
+
+    const char checkpoint_magic[8] = {'2', 'D', 'A', 'D', 'S', 'C', 'P', '\0'};
+    constexpr uint64_t checkpoint_version{1};
+
+    void checkpoint_write(std::FILE* fp, const void* buf, const size_t nbytes, const std::string& fname)
     {
-        tau.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                        {return(exp(lhs));}, t_src, 0);
-        tau.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                        {return(lhs - tau_bg);}, t_src, 0);
+        if(std::fwrite(buf, 1, nbytes, fp) != nbytes)
+            throw std::ios_base::failure(std::string("write_checkpoint: Error writing ") + fname);
     }
 
-    diagnostic.write_diagnostics(time, get_config());
-    if(get_config().get_log_theta())
+    void checkpoint_read(std::FILE* fp, void* buf, const size_t nbytes, const std::string& fname)
     {
-        theta.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                          {return(lhs + theta_bg);}, t_src, 0);
-        theta.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                          {return(log(lhs));}, t_src, 0);
+        if(std::fread(buf, 1, nbytes, fp) != nbytes)
+            throw std::ios_base::failure(std::string("read_checkpoint: Error reading ") + fname + std::string(", file is truncated"));
+    }
+}
+
+
+size_t slab_bc :: get_checkpoint_nbytes() const
+{
+    size_t nbytes{0};
+    for(auto it : get_field_by_name)
+        nbytes += it.second -> get_tlevs() * get_nbytes_per_t();
+    return(nbytes);
+}
+
+
+void slab_bc :: write_checkpoint(const std::string& fname, const size_t tstep, const twodads::real_t time, const twodads::real_t dt)
+{
+    PROFILE_SCOPE("slab_bc::write_checkpoint", get_checkpoint_nbytes());
+    // The output counter in the checkpoint refers to written output only
+    if(output != nullptr)
+        output -> flush();
+    const twodads::slab_layout_t geom{get_config().get_geom()};
+    const size_t nbytes_per_t{geom.get_nelem_per_t() * sizeof(value_t)};
+
+    // Write to a temporary file first, so that a crash while writing leaves the previous checkpoint intact.
+    const std::string fname_tmp{fname + std::string(".tmp")};
+    std::FILE* fp{std::fopen(fname_tmp.data(), "wb")};
+    if(fp == nullptr)
+        throw std::ios_base::failure(std::string("write_checkpoint: Could not open ") + fname_tmp);
+    // The time levels are written in one call each, bypass the stdio buffer
+    std::setvbuf(fp, nullptr, _IONBF, 0);
+
+    try
+    {
+        checkpoint_header_t header;
+        std::copy(checkpoint_magic, checkpoint_magic + 8, header.magic);
+        header.version = checkpoint_version;
+        header.config_hash = get_config().get_hash();
+        header.nx = geom.get_nx();
+        header.pad_x = geom.get_pad_x();
+        header.my = geom.get_my();
+        header.pad_y = geom.get_pad_y();
+        header.tstep = tstep;
+        header.output_counter = output != nullptr ? output -> get_output_counter() : 0;
+        header.time = time;
+        header.deltat = dt;
+        checkpoint_write(fp, &header, sizeof(header), fname_tmp);
+
+        for(auto tint : {tint_theta, tint_omega, tint_tau})
+        {
+            std::vector<value_t> state;
+            tint -> get_state(state);
+            const uint64_t num_state{static_cast<uint64_t>(state.size())};
+            checkpoint_write(fp, &num_state, sizeof(num_state), fname_tmp);
+            checkpoint_write(fp, state.data(), num_state * sizeof(value_t), fname_tmp);
+        }
+
+        for(auto it : get_field_by_name)
+        {
+            arr_real* arr{it.second};
+            const uint64_t tlevs{static_cast<uint64_t>(arr -> get_tlevs())};
+            std::vector<uint64_t> transformed(tlevs);
+            for(size_t t = 0; t < tlevs; t++)
+                transformed[t] = arr -> is_transformed(t) ? 1 : 0;
+            checkpoint_write(fp, &tlevs, sizeof(tlevs), fname_tmp);
+            checkpoint_write(fp, transformed.data(), tlevs * sizeof(uint64_t), fname_tmp);
+#ifdef DEVICE
+            cuda_array_bc_nogp<value_t, allocator_host> arr_host{utility :: create_host_vector(arr)};
+            for(size_t t = 0; t < tlevs; t++)
+                checkpoint_write(fp, arr_host.get_tlev_ptr(t), nbytes_per_t, fname_tmp);
+#endif //DEVICE
+#ifdef HOST
+            for(size_t t = 0; t < tlevs; t++)
+                checkpoint_write(fp, arr -> get_tlev_ptr(t), nbytes_per_t, fname_tmp);
+#endif //HOST
+        }
+    }
+    catch(...)
+    {
+        std::fclose(fp);
+        std::remove(fname_tmp.data());
+        throw;
+    }
+
+    if(std::fclose(fp) != 0)
+        throw std::ios_base::failure(std::string("write_checkpoint: Error closing ") + fname_tmp);
+    if(std::rename(fname_tmp.data(), fname.data()) != 0)
+        throw std::ios_base::failure(std::string("write_checkpoint: Could not rename ") + fname_tmp + std::string(" to ") + fname);
+}
+
+
+void slab_bc :: read_checkpoint(const std::string& fname, size_t& tstep, twodads::real_t& time, twodads::real_t& dt)
+{
+    PROFILE_SCOPE("slab_bc::read_checkpoint", get_checkpoint_nbytes());
+    const twodads::slab_layout_t geom{get_config().get_geom()};
+    const size_t nbytes_per_t{geom.get_nelem_per_t() * sizeof(value_t)};
+
+    std::FILE* fp{std::fopen(fname.data(), "rb")};
+    if(fp == nullptr)
+        throw std::ios_base::failure(std::string("read_checkpoint: Could not open ") + fname);
+    std::setvbuf(fp, nullptr, _IONBF, 0);
+
+    try
+    {
+        checkpoint_header_t header;
+        checkpoint_read(fp, &header, sizeof(header), fname);
+        if(!std::equal(checkpoint_magic, checkpoint_magic + 8, header.magic) || header.version != checkpoint_version)
+            throw config_error(std::string("read_checkpoint: ") + fname + std::string(" is not a checkpoint of this version"));
+        if(header.config_hash != get_config().get_hash())
+            throw config_error(std::string("read_checkpoint: ") + fname + std::string(" was written with a different geometry, model, or integrator"));
+        if(header.nx != geom.get_nx() || header.pad_x != geom.get_pad_x() || header.my != geom.get_my() || header.pad_y != geom.get_pad_y())
+            throw config_error(std::string("read_checkpoint: Grid size of ") + fname + std::string(" does not match the configuration"));
+
+        for(auto tint : {tint_theta, tint_omega, tint_tau})
+        {
+            uint64_t num_state{0};
+            checkpoint_read(fp, &num_state, sizeof(num_state), fname);
+            std::vector<value_t> state(num_state);
+            checkpoint_read(fp, state.data(), num_state * sizeof(value_t), fname);
+            tint -> set_state(state);
+        }
+
+        for(auto it : get_field_by_name)
+        {
+            arr_real* arr{it.second};
+            uint64_t tlevs{0};
+            checkpoint_read(fp, &tlevs, sizeof(tlevs), fname);
+            if(tlevs != arr -> get_tlevs())
+                throw config_error(std::string("read_checkpoint: Number of time levels in ") + fname + std::string(" does not match the configuration"));
+            std::vector<uint64_t> transformed(tlevs);
+            checkpoint_read(fp, transformed.data(), tlevs * sizeof(uint64_t), fname);
+#ifdef DEVICE
+            cuda_array_bc_nogp<value_t, allocator_host> arr_host(geom, arr -> get_bvals(), tlevs);
+            arr_host.set_tag("slab_bc", "checkpoint");
+            for(size_t t = 0; t < tlevs; t++)
+            {
+                checkpoint_read(fp, arr_host.get_tlev_ptr(t), nbytes_per_t, fname);
+                gpuErrchk(cudaMemcpy(arr -> get_tlev_ptr(t), arr_host.get_tlev_ptr(t), nbytes_per_t, cudaMemcpyHostToDevice));
+            }
+#endif //DEVICE
+#ifdef HOST
+            for(size_t t = 0; t < tlevs; t++)
+                checkpoint_read(fp, arr -> get_tlev_ptr(t), nbytes_per_t, fname);
+#endif //HOST
+            for(size_t t = 0; t < tlevs; t++)
+                arr -> set_transformed(t, transformed[t] != 0);
+        }
+
+        tstep = header.tstep;
+        time = header.time;
+        dt = header.deltat;
+        if(output != nullptr)
+            output -> set_output_counter(header.output_counter);
     }
-    if(get_config().get_log_tau())
+    catch(...)
     {
-        tau.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                        {return(lhs + tau_bg);}, t_src, 0);
-        tau.elementwise([=] LAMBDACALLER (twodads::real_t lhs, twodads::real_t dummy) -> twodads::real_t
-                          {return(log(lhs));}, t_src, 0);
+        std::fclose(fp);
+        throw;
     }
+    std::fclose(fp);
+}
+
 
+bool slab_bc :: is_finite() const
+{
+#ifdef USE_MPI
+    if(decomp != nullptr)
+        return(decomp -> count(nonfinite.count > 0) == 0);
+#endif //USE_MPI
+    return(nonfinite.count == 0);
 }
 
 
+bool slab_bc :: is_root() const
+{
+#ifdef USE_MPI
+    return(decomp == nullptr || decomp -> is_root());
+#else
+    return(true);
+#endif //USE_MPI
+}
+
+
+std::string slab_bc :: get_nonfinite_report() const
+{
+    if(nonfinite.count == 0)
+        return(std::string("All fields are finite"));
+    const twodads::slab_layout_t geom{conf.get_geom()};
+    std::stringstream report;
+    report << "Non-finite value in " << slab_config_js :: get_field_name(nonfinite_field) << " at time level " << nonfinite_tidx;
+    report << ", n = " << nonfinite.n << ", m = " << nonfinite.m << " (x = " << geom.get_x(nonfinite.n) << ", y = " << geom.get_y(nonfinite.m) << ")";
+    report << ", " << nonfinite.count << " non-finite values in the field";
+    return(report.str());
+}
+
+
+void slab_bc :: save_snapshot()
+{
+    PROFILE_SCOPE("slab_bc::save_snapshot", 2 * get_checkpoint_nbytes());
+    if(snapshot_fields.empty())
+        throw config_error(std::string("save_snapshot: Snapshots require 2dads.watchdog.retries > 0"));
+
+    for(auto it : snapshot_fields)
+    {
+        for(size_t t = 0; t < it.first -> get_tlevs(); t++)
+            it.second -> copy(t, *it.first, t);
+    }
+    tint_theta -> get_state(snapshot_states[0]);
+    tint_omega -> get_state(snapshot_states[1]);
+    tint_tau -> get_state(snapshot_states[2]);
+}
+
+
+void slab_bc :: restore_snapshot()
+{
+    PROFILE_SCOPE("slab_bc::restore_snapshot", 2 * get_checkpoint_nbytes());
+    if(snapshot_fields.empty())
+        throw config_error(std::string("restore_snapshot: Snapshots require 2dads.watchdog.retries > 0"));
+
+    for(auto it : snapshot_fields)
+    {
+        for(size_t t = 0; t < it.first -> get_tlevs(); t++)
+            it.first -> copy(t, *it.second, t);
+    }
+    tint_theta -> set_state(snapshot_states[0]);
+    tint_omega -> set_state(snapshot_states[1]);
+    tint_tau -> set_state(snapshot_states[2]);
+    nonfinite = utility :: nonfinite_t{0, 0, 0};
+}
+
 
 void slab_bc :: rhs(const size_t t_dst, const size_t t_src)
 {
+    // Reads the dynamic fields, strmf, and their derivatives, writes the explicit parts
+    PROFILE_SCOPE("slab_bc::rhs", 15 * get_nbytes_per_t());
     assert(theta.is_transformed(t_src) == false);
     assert(theta_x.is_transformed(0) == false);
     assert(theta_y.is_transformed(0) == false);
@@ -679,7 +1521,7 @@ void slab_bc :: rhs_theta_lin(const size_t t_dst, const size_t t_src)
 {
     // Compute poisson bracket, {theta, phi}
     // theta_rhs <- {phi, theta}
-    switch(get_config().get_grid_type())
+    switch(step_params.grid_type)
     {
         case twodads::grid_t::vertex_centered:
             // Derivative fields have only 1 time index. Do not use t_src here.
@@ -704,12 +1546,12 @@ void slab_bc :: rhs_theta_log(const size_t t_dst, const size_t t_src)
     // Compute poisson bracket, {theta, phi}
     // theta_rhs <- {phi, theta}
     
-    const twodads::real_t diff{conf.get_tint_params(twodads::dyn_field_t::f_theta).get_diff()};
+    const twodads::real_t diff{step_params.tint_params.at(twodads::dyn_field_t::f_theta).get_diff()};
 
     // Linear damping term is at second position in model parameters
-    const twodads::real_t damp{conf.get_model_params(twodads::dyn_field_t::f_theta)[1]};
+    const twodads::real_t damp{step_params.model_params.at(twodads::dyn_field_t::f_theta)[1]};
 
-    switch(get_config().get_grid_type())
+    switch(step_params.grid_type)
     {
         case twodads::grid_t::vertex_centered:
             // Derivative fields have only 1 time index. Do not use t_src here.
@@ -755,7 +1597,7 @@ inline void slab_bc :: rhs_omega_null(const size_t t_dst, const size_t t_src)
 
 void slab_bc :: rhs_omega_ic(const size_t t_dst, const size_t t_src)
 {
-    const std::vector<twodads::real_t> model_params{conf.get_model_params(twodads::dyn_field_t::f_omega)};
+    const std::vector<twodads::real_t>& model_params{step_params.model_params.at(twodads::dyn_field_t::f_omega)};
 
     // ic is position 2
     // damp is at position 3
@@ -764,7 +1606,7 @@ void slab_bc :: rhs_omega_ic(const size_t t_dst, const size_t t_src)
     
     // Compute poisson bracket
     // omega_rhs <- {omega, phi}
-    switch(get_config().get_grid_type())
+    switch(step_params.grid_type)
     {
         case twodads::grid_t::vertex_centered:
             // Store in t_dst time index of RHS
@@ -825,9 +1667,9 @@ void slab_bc :: rhs_tau_log(const size_t t_dst, const size_t t_src)
     // Compute poisson bracket, {tta, phi}
     // tau_rhs <- {phi, tau}
     
-    const twodads::real_t diff{conf.get_tint_params(twodads::dyn_field_t::f_tau).get_diff()};
+    const twodads::real_t diff{step_params.tint_params.at(twodads::dyn_field_t::f_tau).get_diff()};
 
-    switch(get_config().get_grid_type())
+    switch(step_params.grid_type)
     {
         case twodads::grid_t::vertex_centered:
             // Derivative fields have only 1 time index. Do not use t_src here.
@@ -855,11 +1697,80 @@ void slab_bc :: rhs_tau_log(const size_t t_dst, const size_t t_src)
 
 slab_bc :: ~slab_bc()
 {
+    if(!get_config().get_profile_file().empty())
+    {
+        try
+        {
+            profiler :: registry_t :: get().write_report(get_config().get_profile_file());
+        }
+        catch (std::ios_base::failure& e)
+        {
+            LOG_MESSAGE(logger::level_t::error, "%s", e.what());
+        }
+    }
+
+    // Written before the fields are freed, so that the report includes them
+    if(!get_config().get_memory_file().empty())
+    {
+        try
+        {
+            footprint :: registry_t :: get().write_report(get_config().get_memory_file());
+        }
+        catch (std::ios_base::failure& e)
+        {
+            LOG_MESSAGE(logger::level_t::error, "%s", e.what());
+        }
+    }
+
+    for(auto it : snapshot_fields)
+        delete it.second;
+#ifdef DEVICE
+    // Unregister the output buffers after the thread has written them
+    try
+    {
+        output -> flush();
+    }
+    catch (std::exception& e)
+    {
+        LOG_MESSAGE(logger::level_t::error, "%s", e.what());
+    }
+    for(auto it : output -> get_buffers())
+        cudaHostUnregister(it -> get_tlev_ptr(0));
+#endif //DEVICE
+    // The threads finish the submitted output and diagnostics
+    delete diagnostic;
+    delete output;
+    std::unique_lock<std::recursive_mutex> setup_lock;
+    if(shared != nullptr)
+        setup_lock = std::unique_lock<std::recursive_mutex>(shared -> get_mutex());
     delete tint_tau;
     delete tint_omega;
     delete tint_theta;
-    delete my_derivs;
-    delete myfft;
+    if(own_derivs)
+        delete my_derivs;
+    if(shared == nullptr)
+        delete myfft;
+#ifdef USE_MPI
+    delete decomp;
+#endif //USE_MPI
+}
+
+
+void slab_bc :: configure_log(const slab_config_js& cfg)
+{
+    logger :: logger_t :: get().set_level(cfg.get_log_level());
+    logger :: logger_t :: get().set_format(cfg.get_log_format());
+    if(!cfg.get_log_file().empty())
+    {
+        try
+        {
+            logger :: logger_t :: get().set_file(cfg.get_log_file());
+        }
+        catch (std::ios_base::failure& e)
+        {
+            LOG_MESSAGE(logger::level_t::error, "%s", e.what());
+        }
+    }
 }
 
 // End of file slab_bc.cpp
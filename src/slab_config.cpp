@@ -76,7 +76,8 @@ const std::map<std::string, twodads::init_fun_t> slab_config_js::init_func_map
     {"lamb_dipole", twodads::init_fun_t::init_lamb_dipole},
     {"sine", twodads::init_fun_t::init_sine},
     {"mode", twodads::init_fun_t::init_mode},
-    {"turbulent_bath", twodads::init_fun_t::init_turbulent_bath}    
+    {"turbulent_bath", twodads::init_fun_t::init_turbulent_bath},
+    {"file", twodads::init_fun_t::init_file}
 };
     
 const std::map<std::string, twodads::rhs_t> slab_config_js::rhs_func_map 
@@ -95,7 +96,8 @@ const std::map<std::string, twodads::bc_t> slab_config_js :: bc_map
 {
     {"dirichlet", twodads::bc_t::bc_dirichlet},
     {"neumann", twodads::bc_t::bc_neumann},
-    {"periodic", twodads::bc_t::bc_periodic}
+    {"periodic", twodads::bc_t::bc_periodic},
+    {"null", twodads::bc_t::bc_null}
 };
 
 const std::map<std::string, twodads::grid_t> slab_config_js :: grid_map
@@ -104,6 +106,45 @@ const std::map<std::string, twodads::grid_t> slab_config_js :: grid_map
     {"cell", twodads::grid_t::cell_centered}
 };
 
+const std::map<std::string, twodads::solver_t> slab_config_js :: solver_map
+{
+    {"tridiag", twodads::solver_t::solver_tridiag},
+    {"r2r", twodads::solver_t::solver_r2r},
+    {"thomas", twodads::solver_t::solver_thomas},
+    {"thomas_simd", twodads::solver_t::solver_thomas_simd},
+    {"thomas_real", twodads::solver_t::solver_thomas_real},
+    {"spike", twodads::solver_t::solver_spike},
+    {"spike_mpi", twodads::solver_t::solver_spike_mpi}
+};
+
+const std::map<std::string, twodads::scheme_t> slab_config_js :: scheme_map
+{
+    {"karniadakis", twodads::scheme_t::scheme_karniadakis},
+    {"ark", twodads::scheme_t::scheme_ark},
+    {"etdrk4", twodads::scheme_t::scheme_etdrk4}
+};
+
+const std::map<std::string, logger::level_t> slab_config_js :: log_level_map
+{
+    {"error", logger::level_t::error},
+    {"warning", logger::level_t::warning},
+    {"info", logger::level_t::info},
+    {"debug", logger::level_t::debug}
+};
+
+const std::map<std::string, logger::format_t> slab_config_js :: log_format_map
+{
+    {"text", logger::format_t::text},
+    {"json", logger::format_t::json}
+};
+
+std::string slab_config_js :: get_field_name(const twodads::field_t fname)
+{
+    auto it = std::find_if(fname_map.begin(), fname_map.end(), finder<twodads::field_t>(fname));
+    return(it == fname_map.end() ? std::string("unknown") : std::get<0>(*it));
+}
+
+
 slab_config_js :: slab_config_js(std::string fname) 
 	    //do_dealiasing{false},
         //particle_tracking{false},
@@ -115,9 +156,15 @@ slab_config_js :: slab_config_js(std::string fname)
     }
     catch(std::exception const& e)
     {
-        std::cerr << "Could not initialize configuration: " << e.what() << std::endl;
+        LOG_MESSAGE(logger::level_t::error, "Could not initialize configuration: %s", e.what());
     }
-    std :: cout << "log_theta = " << get_log_theta() << std::endl;
+    LOG_MESSAGE(logger::level_t::debug, "log_theta = %d", get_log_theta());
+}
+
+
+slab_config_js :: slab_config_js(const boost::property_tree::ptree& _pt) :
+    pt(_pt)
+{
 }
 
 twodads::rhs_t slab_config_js :: get_rhs_t(const twodads::dyn_field_t fname) const
@@ -183,6 +230,109 @@ std::vector<twodads::real_t> slab_config_js :: get_model_params(const twodads::d
 }
 
 
+std::vector<slab_config_js> slab_config_js :: get_ensemble_members() const
+{
+    using boost::property_tree::ptree;
+
+    // Copies the values of src into dst. Arrays, with empty keys, and values replace the node in dst.
+    std::function<void(ptree&, const ptree&)> merge = [&merge] (ptree& dst, const ptree& src) -> void
+    {
+        for(const auto& it : src)
+        {
+            if(it.second.empty() || it.second.front().first.empty())
+                dst.put_child(it.first, it.second);
+            else
+            {
+                boost::optional<ptree&> child{dst.get_child_optional(it.first)};
+                merge(child ? *child : dst.put_child(it.first, ptree()), it.second);
+            }
+        }
+    };
+
+    std::vector<slab_config_js> res;
+    boost::optional<const ptree&> members{pt.get_child_optional("2dads.ensemble.members")};
+    if(!members)
+        return(res);
+
+    ptree pt_base{pt};
+    pt_base.get_child("2dads").erase("ensemble");
+    for(const auto& it : *members)
+    {
+        if(it.second.count("ensemble") > 0)
+            throw config_error(std::string("Ensemble members can not define an ensemble"));
+
+        ptree pt_member{pt_base};
+        merge(pt_member.get_child("2dads"), it.second);
+        if(!it.second.get_child_optional("output.prefix"))
+            pt_member.put("2dads.output.prefix", std::string("member") + std::to_string(res.size()) + std::string("_"));
+        const std::string prefix{pt_member.get<std::string>("2dads.output.prefix")};
+        if(!it.second.get_child_optional("checkpoint.file"))
+            pt_member.put("2dads.checkpoint.file", prefix + slab_config_js(pt_member).get_checkpoint_file());
+        if(!it.second.get_child_optional("checkpoint.restart") && !get_restart_file().empty())
+            pt_member.put("2dads.checkpoint.restart", prefix + get_restart_file());
+        res.push_back(slab_config_js(pt_member));
+    }
+    return(res);
+}
+
+
+slab_config_js slab_config_js :: get_subdomain(const size_t rank, const size_t num_ranks) const
+{
+    // The subdomains consist of blocks of four rows. check_consistency only asserts this.
+    if(get_nx() % 4 != 0)
+        throw config_error(std::string("get_subdomain: Nx has to be a multiple of 4"));
+    check_consistency();
+    if(get_grid_type() != twodads::grid_t::cell_centered)
+        throw config_error(std::string("get_subdomain: Only the cell-centered grid can be decomposed"));
+    if(get_stretch_x() != 0.0)
+        throw config_error(std::string("get_subdomain: Stretched grids can not be decomposed"));
+    if(get_scheme_t() != twodads::scheme_t::scheme_karniadakis)
+        throw config_error(std::string("get_subdomain: Only the karniadakis scheme supports a decomposed grid"));
+    if(get_hypervisc() != 0.0)
+        throw config_error(std::string("get_subdomain: Hyperviscosity is not supported on a decomposed grid"));
+    for(auto fname : {twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau})
+    {
+        if(get_init_func_t(fname) == twodads::init_fun_t::init_file)
+            throw config_error(std::string("get_subdomain: Initialization from a file is not supported on a decomposed grid"));
+    }
+    const size_t num_blocks{get_nx() / 4};
+    if(rank >= num_ranks || num_blocks < num_ranks)
+        throw config_error(std::string("get_subdomain: Each subdomain needs at least four rows"));
+
+    // The first num_blocks % num_ranks subdomains get one more block
+    const size_t nx_local{4 * (num_blocks / num_ranks + (rank < num_blocks % num_ranks ? 1 : 0))};
+    const size_t row_lo{4 * (rank * (num_blocks / num_ranks) + std::min(rank, num_blocks % num_ranks))};
+    const twodads::real_t dx{get_deltax()};
+
+    boost::property_tree::ptree pt_sub{pt};
+    pt_sub.put("2dads.geometry.Nx", nx_local);
+    pt_sub.put("2dads.geometry.xleft", get_xleft() + static_cast<twodads::real_t>(row_lo) * dx);
+    pt_sub.put("2dads.geometry.xright", get_xleft() + static_cast<twodads::real_t>(row_lo + nx_local) * dx);
+    for(auto fname : {"theta", "omega", "tau", "strmf"})
+    {
+        if(rank > 0)
+            pt_sub.put(std::string("2dads.geometry.") + fname + std::string("_bc_left"), "null");
+        if(rank < num_ranks - 1)
+            pt_sub.put(std::string("2dads.geometry.") + fname + std::string("_bc_right"), "null");
+    }
+    pt_sub.put("2dads.integrator.solver", "spike_mpi");
+    pt_sub.put("2dads.geometry.subdomain", true);
+
+    // Each rank writes its own checkpoints, logs, and reports
+    const std::string prefix{std::string("rank") + std::to_string(rank) + std::string("_")};
+    pt_sub.put("2dads.checkpoint.file", prefix + get_checkpoint_file());
+    if(!get_restart_file().empty())
+        pt_sub.put("2dads.checkpoint.restart", prefix + get_restart_file());
+    if(!get_log_file().empty())
+        pt_sub.put("2dads.log.file", prefix + get_log_file());
+    if(!get_profile_file().empty())
+        pt_sub.put("2dads.profile.file", prefix + get_profile_file());
+    if(!get_memory_file().empty())
+        pt_sub.put("2dads.memory.file", prefix + get_memory_file());
+    return(slab_config_js(pt_sub));
+}
+
+
 twodads::dft_t slab_config_js :: get_dft_t() const
 {
     switch(get_grid_type())
@@ -225,13 +375,47 @@ twodads::stiff_params_t slab_config_js :: get_tint_params(const twodads::dyn_fie
     twodads::stiff_params_t sp(
         get_deltat(), get_Lx(), get_Ly(),
         res[0],
-        pt.get<twodads::real_t>("2dads.integrator.hypervisc"), 
-        get_nx(), get_my21(), get_tlevs()
+        get_hypervisc(),
+        get_nx(), get_my21(), get_tlevs(),
+        get_hypervisc_order()
     );
     return(sp);
 }
 
 
+uint64_t slab_config_js :: get_hash() const
+{
+    using boost::property_tree::ptree;
+    using boost::property_tree::write_json;
+
+    // Serialize the relevant parts of the configuration and hash the string with 64-bit FNV-1a,
+    // which, unlike std::hash, gives the same value on all platforms.
+    ptree pt_hash;
+    pt_hash.put_child("geometry", pt.get_child("2dads.geometry"));
+    pt_hash.put_child("model", pt.get_child("2dads.model"));
+    pt_hash.put("scheme", pt.get<std::string>("2dads.integrator.scheme", "karniadakis"));
+    pt_hash.put("level", get_tlevs());
+    pt_hash.put("solver", pt.get<std::string>("2dads.integrator.solver", "tridiag"));
+    // Only hash the hyperviscosity when it is used, checkpoints written without it stay valid.
+    if(get_hypervisc() != 0.0)
+    {
+        pt_hash.put("hypervisc", get_hypervisc());
+        pt_hash.put("hypervisc_order", get_hypervisc_order());
+    }
+
+    std::stringstream ss;
+    write_json(ss, pt_hash, false);
+
+    uint64_t hash{14695981039346656037ULL};
+    for(const char c : ss.str())
+    {
+        hash ^= static_cast<uint64_t>(static_cast<unsigned char>(c));
+        hash *= 1099511628211ULL;
+    }
+    return(hash);
+}
+
+
 bool slab_config_js :: check_consistency() const
 {
     // When using periodic boundary conditions in the x-direction a cell-centered grid
@@ -277,6 +461,57 @@ bool slab_config_js :: check_consistency() const
         throw config_error(std::string("Periodic boundary conditions in the x-direction are required when using a vertex-centered\n"));
     }
 
+    // bc_null gives the ghost points a weight of zero. It is only used between subdomains.
+    if(!is_subdomain())
+    {
+        for(auto fname : {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_tau, twodads::field_t::f_strmf})
+        {
+            if(get_bvals(fname).get_bc_left() == twodads::bc_t::bc_null || get_bvals(fname).get_bc_right() == twodads::bc_t::bc_null)
+                throw config_error(std::string("Boundary condition null is reserved for the edges between subdomains"));
+        }
+    }
+
+    // Single-step schemes keep the current time step and one time level for the stages of the right hand side.
+    if(get_scheme_t() != twodads::scheme_t::scheme_karniadakis && get_tlevs() != 2)
+    {
+        throw config_error(std::string("The ark and etdrk4 schemes require 2 time levels"));
+    }
+
+    if(get_scheme_t() == twodads::scheme_t::scheme_ark && get_grid_type() != twodads::grid_t::cell_centered)
+    {
+        throw config_error(std::string("The ark scheme requires a cell-centered grid"));
+    }
+
+    if(get_scheme_t() == twodads::scheme_t::scheme_etdrk4 && get_grid_type() != twodads::grid_t::vertex_centered)
+    {
+        throw config_error(std::string("The etdrk4 scheme requires a vertex-centered grid"));
+    }
+
+    // Stretched grids are implemented for the finite difference schemes only
+    if(get_stretch_x() < 0.0 || get_stretch_x() >= 1.0)
+    {
+        throw config_error(std::string("stretch_x has to be in the interval [0, 1)"));
+    }
+
+    if(get_stretch_x() != 0.0 && get_grid_type() != twodads::grid_t::cell_centered)
+    {
+        throw config_error(std::string("A stretched grid in x requires a cell-centered grid"));
+    }
+
+    if(get_hypervisc() < 0.0)
+    {
+        throw config_error(std::string("hypervisc has to be non-negative"));
+    }
+
+    if(get_watchdog_retries() > 0 && (get_watchdog_shrink() <= 0.0 || get_watchdog_shrink() >= 1.0))
+    {
+        throw config_error(std::string("watchdog.shrink has to be in the interval (0, 1)"));
+    }
+
+    if(get_hypervisc_order() < 2 || get_hypervisc_order() > 8)
+    {
+        throw config_error(std::string("hypervisc_order has to be in the range 2..8"));
+    }
 
     assert(get_my() % 4 == 0);
     assert(get_nx() % 4 == 0);
@@ -0,0 +1,95 @@
+/*
+ * Test the allocation guard of alloc_guard.h
+ *
+ * Checks that the guard counts allocations with operator new and that scope_t and pause_t arm and disarm it.
+ * Then repeats the derivatives and the elliptic solver of deriv_fd_t with the guard armed. An allocation
+ * in these calls aborts the test with a backtrace.
+ */
+
+#include <iostream>
+#include <cmath>
+#include "slab_bc.h"
+#include "alloc_guard.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    // Messages are not std::string, which allocates while the guard is armed
+    auto check = [&num_errors] (const bool cond, const char* msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    // Counting and arming
+    const size_t num_start{alloc_guard :: get_num_allocations()};
+    // The pointer escapes, so that the compiler can not remove the allocation
+    double* volatile ptr{new double[16]};
+    delete[] ptr;
+    check(alloc_guard :: get_num_allocations() == num_start + 1, "operator new[] is counted");
+    check(alloc_guard :: is_armed() == false, "The guard is disarmed at startup");
+    {
+        alloc_guard :: scope_t inactive(false);
+        check(alloc_guard :: is_armed() == false, "An inactive scope does not arm the guard");
+    }
+    {
+        alloc_guard :: scope_t guarded(true);
+        check(alloc_guard :: is_armed(), "scope_t arms the guard");
+        {
+            alloc_guard :: pause_t pause;
+            check(alloc_guard :: is_armed() == false, "pause_t disarms the guard");
+            ptr = new double[16];
+            delete[] ptr;
+        }
+        check(alloc_guard :: is_armed(), "pause_t re-arms the guard");
+    }
+    check(alloc_guard :: is_armed() == false, "scope_t disarms the guard");
+
+    // Derivatives and the elliptic solver
+    const twodads::slab_layout_t geom(-1.0, 2.0 / 128, -1.0, 2.0 / 128, 128, 0, 128, 2, twodads::grid_t::cell_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+    deriv_fd_t<twodads::real_t, allocator_host> der(geom, bvals);
+    fftw_object_t<twodads::real_t> dft(geom, twodads::dft_t::dft_1d);
+    real_arr u(geom, bvals, 1);
+    real_arr v(geom, bvals, 1);
+    real_arr res(geom, bvals, 1);
+    real_arr sol(geom, bvals, 1);
+    u.apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+            {return(sin(twodads::PI * geom.get_x(n)) * cos(twodads::PI * geom.get_y(m)));}, 0);
+    v.apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+            {return(cos(twodads::PI * geom.get_x(n)) * sin(twodads::PI * geom.get_y(m)));}, 0);
+
+    auto step = [&] () -> void
+    {
+        der.dx(u, res, 0, 0, 1);
+        der.dx(u, res, 0, 0, 2);
+        der.pbracket(u, v, res, 0, 0, 0);
+        res.copy(0, u, 0);
+        dft.dft_r2c(res.get_tlev_ptr(0), reinterpret_cast<twodads::cmplx_t*>(res.get_tlev_ptr(0)));
+        res.set_transformed(0, true);
+        der.invert_laplace(res, sol, 0, 0);
+        dft.dft_c2r(reinterpret_cast<twodads::cmplx_t*>(sol.get_tlev_ptr(0)), sol.get_tlev_ptr(0));
+        utility :: normalize(sol, 0);
+        sol.set_transformed(0, false);
+    };
+
+    // The first call may allocate workspaces
+    step();
+    const size_t num_warm{alloc_guard :: get_num_allocations()};
+    {
+        alloc_guard :: scope_t guarded(true);
+        for(size_t n = 0; n < 10; n++)
+            step();
+    }
+    check(alloc_guard :: get_num_allocations() == num_warm, "No allocations after the first call");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,114 @@
+/*
+ * Test checkpoint and restart
+ *
+ * Runs the interchange model for num_steps time steps, writing a checkpoint after num_check steps.
+ * A second slab restarts from the checkpoint and integrates the remaining steps.
+ * Both runs have to give bitwise identical fields.
+ *
+ * Also reports the time to write and read the checkpoint.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+int main(void)
+{
+    slab_config_js my_config(std::string("input_test_checkpoint.json"));
+    const size_t order{my_config.get_tint_params(twodads::dyn_field_t::f_theta).get_tlevs()};
+    const size_t num_steps{50};
+    const size_t num_check{20};
+    const std::string fname{my_config.get_checkpoint_file()};
+    const std::vector<twodads::dyn_field_t> dyn_fields{twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau};
+
+    // One time step of the main loop
+    auto step = [&] (slab_bc& slab) -> void
+    {
+        slab.integrate(dyn_fields, order - 1);
+        slab.advance();
+        slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, 1, 0);
+        slab.update_real_fields(1);
+        slab.rhs(0, 1);
+    };
+
+    const size_t nelem{my_config.get_geom().get_nelem_per_t()};
+    std::vector<std::vector<twodads::real_t>> result;
+    size_t tstep{0};
+    {
+        slab_bc my_slab(my_config);
+        my_slab.initialize();
+        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
+        my_slab.update_real_fields(order - 1);
+        my_slab.rhs(order - 2, order - 1);
+        for(size_t t = 1; t < order - 1; t++)
+        {
+            my_slab.integrate(dyn_fields, t);
+            my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1 - t, 0);
+            my_slab.update_real_fields(order - 1 - t);
+            my_slab.rhs(order - 2 - t, order - 1 - t);
+            tstep++;
+        }
+
+        for(; tstep < num_check; tstep++)
+            step(my_slab);
+
+        const auto t_start = std::chrono::high_resolution_clock::now();
+        my_slab.write_checkpoint(fname, tstep, static_cast<twodads::real_t>(tstep) * my_config.get_deltat(), my_config.get_deltat());
+        const auto t_end = std::chrono::high_resolution_clock::now();
+        cout << "Writing checkpoint took " << std::chrono::duration<double>(t_end - t_start).count() << "s" << endl;
+
+        for(; tstep < num_steps; tstep++)
+            step(my_slab);
+
+        // Real fields at the last time step: theta and omega at time level 1, strmf at 0
+        for(auto f : {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_strmf})
+        {
+            const real_arr* arr{my_slab.get_array_ptr(f)};
+            const size_t tlev{f == twodads::field_t::f_strmf ? 0ul : 1ul};
+            result.push_back(std::vector<twodads::real_t>(arr -> get_tlev_ptr(tlev), arr -> get_tlev_ptr(tlev) + nelem));
+        }
+    }
+
+    size_t tstep_restart{0};
+    twodads::real_t time{0.0};
+    twodads::real_t dt{0.0};
+    twodads::real_t max_diff{0.0};
+    {
+        slab_bc my_slab(my_config);
+        const auto t_start = std::chrono::high_resolution_clock::now();
+        my_slab.read_checkpoint(fname, tstep_restart, time, dt);
+        const auto t_end = std::chrono::high_resolution_clock::now();
+        cout << "Reading checkpoint took " << std::chrono::duration<double>(t_end - t_start).count() << "s" << endl;
+        cout << "Restarting at step " << tstep_restart << ", t = " << time << ", dt = " << dt << endl;
+
+        for(tstep = tstep_restart; tstep < num_steps; tstep++)
+            step(my_slab);
+
+        size_t idx{0};
+        for(auto f : {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_strmf})
+        {
+            const real_arr* arr{my_slab.get_array_ptr(f)};
+            const size_t tlev{f == twodads::field_t::f_strmf ? 0ul : 1ul};
+            for(size_t n = 0; n < nelem; n++)
+                max_diff = std::max(max_diff, std::fabs(arr -> get_tlev_ptr(tlev)[n] - result[idx][n]));
+            idx++;
+        }
+    }
+    std::remove(fname.data());
+
+    cout << "Maximum difference after restart: " << max_diff << endl;
+    if(max_diff != 0.0)
+    {
+        cout << "Restart is not bitwise identical" << endl;
+        return(1);
+    }
+    return(0);
+}
@@ -0,0 +1,144 @@
+/*
+ * Test that slab_bc rejects inconsistent configurations
+ *
+ * Each case changes the integrator, the grid, the hyperviscosity, or the watchdog of the input file
+ * and constructs a slab from it. The constructor has to throw config_error, see
+ * slab_config_js :: check_consistency. The unchanged input, its variant with the ark scheme, and the
+ * periodic vertex-centered grid are consistent and have to construct without an error.
+ * Last, slab_config_js :: get_subdomain has to reject grids that can not be split in blocks of four rows
+ * and boundary conditions that are reserved for the edges between subdomains.
+ */
+
+#include <iostream>
+#include <string>
+#include "slab_bc.h"
+
+using namespace std;
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    // True if the constructor of slab_bc throws config_error for this input
+    auto throws_config_error = [] (const boost::property_tree::ptree& pt) -> bool
+    {
+        try
+        {
+            slab_bc my_slab{slab_config_js(pt)};
+        }
+        catch(const config_error& err)
+        {
+            cout << "config_error: " << err.what() << endl;
+            return(true);
+        }
+        return(false);
+    };
+
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(std::string("input_test_config_checks.json"), pt);
+    check(!throws_config_error(pt), "The input file is consistent");
+
+    boost::property_tree::ptree pt_ark{pt};
+    pt_ark.put("2dads.integrator.scheme", "ark");
+    pt_ark.put("2dads.integrator.level", 2);
+    check(!throws_config_error(pt_ark), "ark with 2 time levels on a cell-centered grid is consistent");
+
+    // Time levels and grid of the single-step schemes
+    boost::property_tree::ptree pt_bad{pt_ark};
+    pt_bad.put("2dads.integrator.level", 4);
+    check(throws_config_error(pt_bad), "ark with 4 time levels is rejected");
+
+    pt_bad = pt;
+    pt_bad.put("2dads.integrator.scheme", "etdrk4");
+    check(throws_config_error(pt_bad), "etdrk4 with 4 time levels is rejected");
+
+    pt_bad.put("2dads.integrator.level", 2);
+    check(throws_config_error(pt_bad), "etdrk4 on a cell-centered grid is rejected");
+
+    // Vertex-centered grids require periodic boundaries, so that only the scheme or the stretch is inconsistent
+    boost::property_tree::ptree pt_vertex{pt};
+    pt_vertex.put("2dads.geometry.grid_type", "vertex");
+    for(const std::string fname : {"theta", "omega", "tau", "strmf"})
+    {
+        pt_vertex.put("2dads.geometry." + fname + "_bc_left", "periodic");
+        pt_vertex.put("2dads.geometry." + fname + "_bc_right", "periodic");
+    }
+    check(!throws_config_error(pt_vertex), "A periodic vertex-centered grid is consistent");
+    pt_bad = pt_vertex;
+    pt_bad.put("2dads.integrator.scheme", "ark");
+    pt_bad.put("2dads.integrator.level", 2);
+    check(throws_config_error(pt_bad), "ark on a vertex-centered grid is rejected");
+
+    // Stretched grids
+    pt_bad = pt;
+    pt_bad.put("2dads.geometry.stretch_x", 1.0);
+    check(throws_config_error(pt_bad), "stretch_x = 1 is rejected");
+
+    pt_bad.put("2dads.geometry.stretch_x", -0.5);
+    check(throws_config_error(pt_bad), "Negative stretch_x is rejected");
+
+    pt_bad = pt_vertex;
+    pt_bad.put("2dads.geometry.stretch_x", 0.5);
+    check(throws_config_error(pt_bad), "A stretched vertex-centered grid is rejected");
+
+    // Hyperviscosity
+    pt_bad = pt;
+    pt_bad.put("2dads.integrator.hypervisc", -1e-4);
+    check(throws_config_error(pt_bad), "Negative hypervisc is rejected");
+
+    pt_bad = pt;
+    pt_bad.put("2dads.integrator.hypervisc", 1e-4);
+    pt_bad.put("2dads.integrator.hypervisc_order", 1);
+    check(throws_config_error(pt_bad), "hypervisc_order 1 is rejected");
+
+    pt_bad.put("2dads.integrator.hypervisc_order", 9);
+    check(throws_config_error(pt_bad), "hypervisc_order 9 is rejected");
+
+    // Shrink factor of the time step when the watchdog repeats a step
+    pt_bad = pt;
+    pt_bad.put("2dads.watchdog.shrink", 1.0);
+    check(throws_config_error(pt_bad), "watchdog.shrink = 1 is rejected");
+
+    pt_bad.put("2dads.watchdog.shrink", 0.0);
+    check(throws_config_error(pt_bad), "watchdog.shrink = 0 is rejected");
+
+    // bc_null is reserved for the edges between subdomains
+    pt_bad = pt;
+    pt_bad.put("2dads.geometry.omega_bc_right", "null");
+    check(throws_config_error(pt_bad), "Boundary condition null is rejected");
+
+    // Subdomains consist of blocks of four rows
+    auto subdomain_throws = [] (const boost::property_tree::ptree& pt) -> bool
+    {
+        try
+        {
+            slab_config_js(pt).get_subdomain(0, 2);
+        }
+        catch(const config_error& err)
+        {
+            cout << "config_error: " << err.what() << endl;
+            return(true);
+        }
+        return(false);
+    };
+    check(!subdomain_throws(pt), "The input file can be decomposed");
+    check(slab_config_js(pt).get_subdomain(1, 2).is_subdomain() && !slab_config_js(pt).is_subdomain(), "Subdomains are marked");
+    pt_bad = pt;
+    pt_bad.put("2dads.geometry.Nx", pt.get<size_t>("2dads.geometry.Nx") + 2);
+    check(subdomain_throws(pt_bad), "Nx not a multiple of 4 can not be decomposed");
+    pt_bad = pt;
+    pt_bad.put("2dads.geometry.theta_bc_left", "null");
+    check(subdomain_throws(pt_bad), "Boundary condition null is rejected on the decomposed grid");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
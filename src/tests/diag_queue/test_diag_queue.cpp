@@ -0,0 +1,121 @@
+/*
+ * Test the diagnostics thread of diagnostic_queue_t
+ *
+ * Submits a Gaussian blob that moves in x to the queue and checks that the center-of-mass diagnostics
+ * are written in the order of submission and follow the blob. The files written by the thread have to be
+ * identical to those written with zero buffers, which evaluates the diagnostics in the calling thread.
+ * Also reports the time the caller spends in submit, compared to the synchronous evaluation.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "diagnostics.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+// Submits num_steps snapshots of a blob at x = 0.1 * step and returns the time spent in the calls
+double run_queue(const slab_config_js& config, const size_t num_steps)
+{
+    double t_submit{0.0};
+    diagnostic_queue_t queue(config);
+    for(size_t step = 0; step < num_steps; step++)
+    {
+        const twodads::real_t x0{0.1 * static_cast<twodads::real_t>(step)};
+        for(auto fname : queue.get_required_fields())
+        {
+            real_arr* arr{queue.acquire(fname)};
+            arr -> apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                         {return(exp(-(geom.get_x(n) - x0) * (geom.get_x(n) - x0) - geom.get_y(m) * geom.get_y(m)));}, 0);
+        }
+        const auto t_start = std::chrono::steady_clock::now();
+        queue.submit(static_cast<twodads::real_t>(step));
+        t_submit += std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+    }
+    queue.wait();
+    return(t_submit);
+}
+
+
+std::string read_file(const std::string& fname)
+{
+    std::ifstream ifs(fname);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return(ss.str());
+}
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    const size_t num_steps{50};
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(std::string("input_test_diag_queue.json"), pt);
+
+    // Synchronous evaluation. Probes are appended to existing files.
+    std::remove("probe003.dat");
+    pt.put("2dads.diagnostics.buffers", 0);
+    const double t_sync{run_queue(slab_config_js(pt), num_steps)};
+    const std::string com_sync{read_file("com_theta.dat")};
+    const std::string probe_sync{read_file("probe003.dat")};
+
+    // Evaluation on the thread
+    std::remove("probe003.dat");
+    pt.put("2dads.diagnostics.buffers", 2);
+    const double t_async{run_queue(slab_config_js(pt), num_steps)};
+    check(read_file("com_theta.dat") == com_sync, "Center-of-mass diagnostics are identical");
+    check(read_file("probe003.dat") == probe_sync, "Probes are identical");
+
+    // Order and values of the center-of-mass diagnostics
+    std::ifstream ifs("com_theta.dat");
+    std::string line;
+    std::getline(ifs, line);
+    size_t num_lines{0};
+    twodads::real_t time{0.0};
+    twodads::real_t x_c{0.0};
+    twodads::real_t y_c{0.0};
+    while(ifs >> time >> x_c >> y_c)
+    {
+        std::getline(ifs, line);
+        check(time == static_cast<twodads::real_t>(num_lines), "Diagnostics are written in the order of submission");
+        check(std::fabs(x_c - 0.1 * time) < 1e-6 && std::fabs(y_c) < 1e-6, "Center of mass follows the blob");
+        num_lines++;
+    }
+    check(num_lines == num_steps, "All submitted snapshots are evaluated");
+
+    // Fields that are not read by the diagnostics
+    {
+        diagnostic_queue_t queue{slab_config_js(pt)};
+        bool thrown{false};
+        try
+        {
+            queue.acquire(twodads::field_t::f_tau);
+        }
+        catch(const diagnostics_error& err)
+        {
+            thrown = true;
+        }
+        check(thrown, "acquire throws for fields that are not read");
+    }
+
+    cout << "Time in submit: " << t_sync / num_steps * 1e3 << "ms synchronous, " << t_async / num_steps * 1e3 << "ms with the thread" << endl;
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,125 @@
+/*
+ * Test ensemble members that share FFT plans and derivation objects
+ *
+ * Checks the configurations returned by slab_config_js :: get_ensemble_members and that shared_objects_t
+ * hands the same objects to slabs with the same geometry. The last member has the same number of grid points
+ * as the others on a smaller domain. It shares the FFT plans, but not the derivation objects. Then runs the members at the same time on
+ * separate threads, with shared objects, and one after another without. The fields after the time
+ * steps have to be bitwise identical.
+ */
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+// Runs num_steps time steps and returns theta, omega, and strmf
+std::vector<twodads::real_t> run_member(const slab_config_js& my_config, shared_objects_t* shared, const size_t num_steps)
+{
+    const size_t order{my_config.get_tint_params(twodads::dyn_field_t::f_theta).get_tlevs()};
+    const std::vector<twodads::dyn_field_t> dyn_fields{twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau};
+    const size_t nelem{my_config.get_geom().get_nelem_per_t()};
+
+    slab_bc my_slab(my_config, shared);
+    my_slab.initialize();
+    my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
+    my_slab.update_real_fields(order - 1);
+    my_slab.rhs(order - 2, order - 1);
+    for(size_t t = 1; t < order - 1; t++)
+    {
+        my_slab.integrate(dyn_fields, t);
+        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1 - t, 0);
+        my_slab.update_real_fields(order - 1 - t);
+        my_slab.rhs(order - 2 - t, order - 1 - t);
+    }
+    for(size_t tstep = 0; tstep < num_steps; tstep++)
+    {
+        my_slab.integrate(dyn_fields, order - 1);
+        my_slab.advance();
+        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, 1, 0);
+        my_slab.update_real_fields(1);
+        my_slab.rhs(0, 1);
+    }
+
+    std::vector<twodads::real_t> result;
+    for(auto f : {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_strmf})
+    {
+        const real_arr* arr{my_slab.get_array_ptr(f)};
+        const size_t tlev{f == twodads::field_t::f_strmf ? 0ul : 1ul};
+        result.insert(result.end(), arr -> get_tlev_ptr(tlev), arr -> get_tlev_ptr(tlev) + nelem);
+    }
+    return(result);
+}
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    // Configuration of the members
+    slab_config_js my_config(std::string("input_test_ensemble.json"));
+    const std::vector<slab_config_js> members{my_config.get_ensemble_members()};
+    check(members.size() == 4, "Four members");
+    check(members[0].get_file_prefix() == "member0_" && members[1].get_file_prefix() == "member1_", "Default file prefix");
+    check(members[2].get_file_prefix() == "r2r_", "File prefix is overridden");
+    check(members[1].get_checkpoint_file() == "member1_checkpoint.bin", "Prefix of the checkpoint file");
+    check(members[0].get_model_params(twodads::dyn_field_t::f_theta)[0] == 0.001, "Parameters are taken from the ensemble");
+    check(members[1].get_model_params(twodads::dyn_field_t::f_theta)[0] == 0.01 &&
+          members[1].get_model_params(twodads::dyn_field_t::f_theta).size() == 3, "Parameters are overridden");
+    check(members[1].get_model_params(twodads::dyn_field_t::f_omega)[0] == 0.01, "Arrays are replaced");
+    check(members[0].get_solver_t() == twodads::solver_t::solver_thomas_simd && members[2].get_solver_t() == twodads::solver_t::solver_r2r, "Solver is overridden");
+    check(members[0].get_ensemble_members().empty(), "Members do not define an ensemble");
+    check(members[3].get_Lx() == 10.0 && members[3].get_nx() == members[0].get_nx(), "Geometry is overridden");
+
+    // Objects handed out to the members
+    {
+        shared_objects_t shared;
+        check(shared.get_dft(members[0]) == shared.get_dft(members[1]) && shared.get_dft(members[0]) == shared.get_dft(members[2]) &&
+              shared.get_dft(members[0]) == shared.get_dft(members[3]), "FFT plans are shared");
+        check(shared.get_derivs(members[0]) != nullptr && shared.get_derivs(members[0]) == shared.get_derivs(members[1]),
+              "Derivation objects with the same solver are shared");
+        check(shared.get_derivs(members[2]) == nullptr, "Derivation objects with a workspace in the solver are not shared");
+        check(shared.get_derivs(members[3]) != nullptr && shared.get_derivs(members[3]) != shared.get_derivs(members[0]),
+              "Derivation objects are not shared between domains of different size");
+    }
+
+    // Members with shared objects on separate threads and without one after another
+    const size_t num_steps{20};
+    std::vector<std::vector<twodads::real_t>> result_ensemble(members.size());
+    {
+        shared_objects_t shared;
+        std::vector<std::thread> threads;
+        for(size_t k = 0; k < members.size(); k++)
+            threads.emplace_back([&, k] () -> void {result_ensemble[k] = run_member(members[k], &shared, num_steps);});
+        for(auto& it : threads)
+            it.join();
+    }
+    for(size_t k = 0; k < members.size(); k++)
+    {
+        const std::vector<twodads::real_t> result{run_member(members[k], nullptr, num_steps)};
+        size_t num_diff{0};
+        for(size_t n = 0; n < result.size(); n++)
+            num_diff += (result[n] != result_ensemble[k][n]) ? 1 : 0;
+        check(num_diff == 0, std::string("Member ") + std::to_string(k) + std::string(" is bitwise identical to a single run"));
+    }
+
+    size_t num_diff{0};
+    for(size_t n = 0; n < result_ensemble[0].size(); n++)
+        num_diff += (result_ensemble[0][n] != result_ensemble[1][n]) ? 1 : 0;
+    check(num_diff > 0, "Members with different parameters differ");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
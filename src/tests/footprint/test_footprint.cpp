@@ -0,0 +1,101 @@
+/*
+ * Test the memory footprint of footprint.h
+ *
+ * Checks the bytes of tagged arrays, copies of arrays, and the arrays of deriv_fd_t in the
+ * JSON report, which is read back with boost::property_tree. Freed arrays are removed from the
+ * total, but not from the peak. Components without live allocations remain in the report. An allocation that can not be satisfied throws std::bad_alloc
+ * after writing the report to std::cerr.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <new>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "slab_bc.h"
+#include "footprint.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+int main(void)
+{
+    footprint :: registry_t& registry = footprint :: registry_t :: get();
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    const twodads::slab_layout_t geom(-1.0, 2.0 / 128, -1.0, 2.0 / 128, 128, 0, 128, 2, twodads::grid_t::cell_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+    constexpr size_t tlevs{3};
+    // Data and the pointers to the time levels
+    const size_t arr_bytes{tlevs * geom.get_nelem_per_t() * sizeof(twodads::real_t) + tlevs * sizeof(twodads::real_t*)};
+
+    const size_t bytes_start{registry.get_total_bytes()};
+    {
+        real_arr u(geom, bvals, tlevs);
+        check(registry.get_component_bytes("untagged") == arr_bytes, "Arrays are untagged after construction");
+        u.set_tag("test", "u");
+        check(registry.get_component_bytes("untagged") == 0, "Tagging moves the bytes to the owner");
+        check(registry.get_component_bytes("test") == arr_bytes, "Bytes of test::u");
+        {
+            real_arr u_copy(u);
+            check(registry.get_component_bytes("test") == 2 * arr_bytes, "Copies are accounted to the owner");
+            check(registry.get_name(u_copy.get_data()) == "u copy", "Name of the copy");
+            check(registry.get_total_bytes() == bytes_start + 2 * arr_bytes, "Total bytes with the copy");
+        }
+        check(registry.get_component_bytes("test") == arr_bytes, "Freeing the copy removes its bytes");
+        check(registry.get_component_peak_bytes("test") == 2 * arr_bytes, "The peak includes the copy");
+
+        deriv_fd_t<twodads::real_t, allocator_host> der(geom, bvals, twodads::solver_t::solver_tridiag);
+        real_arr v(geom, bvals, 1);
+
+        std::stringstream report;
+        registry.write_report(report);
+        cout << report.str();
+        boost::property_tree::ptree pt;
+        boost::property_tree::read_json(report, pt);
+        check(pt.get<size_t>("total_bytes") == registry.get_total_bytes(), "Total bytes in the report");
+        check(pt.get<size_t>("peak_bytes") >= pt.get<size_t>("total_bytes"), "Peak bytes exceed the total bytes");
+        check(pt.get<size_t>("components.test.bytes") == arr_bytes, "Bytes of test in the report");
+        check(pt.get<size_t>("components.test.peak_bytes") == 2 * arr_bytes, "Peak bytes of test in the report");
+        check(pt.get<size_t>("components.test.names.u") == arr_bytes, "Bytes of test::u in the report");
+        check(pt.get<size_t>("components.deriv_fd_t.allocations") == 10, "deriv_fd_t allocates 5 arrays");
+        const size_t diag_bytes{(geom.get_my() + geom.get_pad_y()) / 2 * geom.get_nx() * sizeof(CuCmplx<twodads::real_t>) + sizeof(CuCmplx<twodads::real_t>*)};
+        check(pt.get<size_t>("components.deriv_fd_t.names.diag") == diag_bytes, "Bytes of deriv_fd_t::diag in the report");
+        check(pt.get<size_t>("components.untagged.bytes") == geom.get_nelem_per_t() * sizeof(twodads::real_t) + sizeof(twodads::real_t*), "Bytes of the untagged array");
+        check(pt.get_optional<size_t>("components.untagged.peak_bytes") == boost::none, "untagged has no peak");
+    }
+    check(registry.get_total_bytes() == bytes_start, "All arrays are freed");
+    check(registry.get_component_bytes("deriv_fd_t") == 0, "The arrays of deriv_fd_t are freed");
+    std::stringstream report_freed;
+    registry.write_report(report_freed);
+    boost::property_tree::ptree pt_freed;
+    boost::property_tree::read_json(report_freed, pt_freed);
+    check(pt_freed.get<size_t>("components.deriv_fd_t.peak_bytes") > 0, "Components without live allocations are listed");
+
+    // Allocation failure
+    bool caught{false};
+    cerr << "Expecting an allocation failure:" << endl;
+    try
+    {
+        allocator_host<twodads::real_t> alloc;
+        auto ptr = alloc.allocate(size_t(1) << 58);
+    }
+    catch(std::bad_alloc& e)
+    {
+        caught = true;
+    }
+    check(caught, "Failed allocations throw std::bad_alloc");
+    check(registry.get_total_bytes() == bytes_start, "Failed allocations are not registered");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
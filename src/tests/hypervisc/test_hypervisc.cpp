@@ -0,0 +1,246 @@
+/*
+ * Test the hyperviscosity in the implicit part of the time integrators
+ *
+ * Integrate
+ * du/dt = D nabla^2 u - hv (-nabla^2)^p u
+ * for p = 2, 3, 8. All terms are treated by the implicit part of the schemes.
+ *
+ * Bispectral methods: Each Fourier mode evolves as u_k(t) = exp(-(D k^2 + hv k^(2p)) t) u_k(0).
+ * ETDRK4 integrates the linear problem exactly. The third order Karniadakis scheme is started from the
+ * exact solution at the first three time steps and should converge with third order, the error decreases 
+ * by a factor of 8 when halving the step size. hv is chosen such that hv k_max^(2p) is large, which is 
+ * stable only for implicit schemes.
+ *
+ * Finite-difference / semi-spectral methods: With Dirichlet boundary conditions, the discrete eigenfunctions of
+ * the Laplace operator are u(x, y) = sin(kx pi (n + 1/2) / Nx) cos(ky y), with eigenvalue
+ * -mu = -4 / dx^2 sin^2(kx pi / 2 Nx) - ky^2. The linear profile u_b between the non-zero boundary values
+ * is a steady state, so that the solution of the semi-discrete equation is
+ * u(x, y, t) = u_b(x) + exp(-(D mu + hv mu^p) t) sin(kx pi (n + 1/2) / Nx) cos(ky y).
+ * The Karniadakis scheme, started from the exact solution, and the ARK scheme should converge with third order.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+using cmplx_t = twodads::cmplx_t;
+using dft_t = fftw_object_t<twodads::real_t>;
+
+
+// Bispectral integrators, Karniadakis and ETDRK4
+void test_bs(const size_t p)
+{
+    constexpr size_t Nx{64};
+    constexpr size_t My{64};
+    const twodads::slab_layout_t geom(-10.0, 20.0 / static_cast<twodads::real_t>(Nx), -10.0, 20.0 / static_cast<twodads::real_t>(My),
+                                      Nx, 0, My, 2, twodads::grid_t::vertex_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_periodic, twodads::bc_t::bc_periodic, 0.0, 0.0);
+    const size_t My21{(My + geom.get_pad_y()) / 2};
+
+    const twodads::real_t diff{0.01};
+    const twodads::real_t t_end{1.0};
+
+    auto kx = [=] (const size_t n) -> twodads::real_t
+    {
+        return(twodads::TWOPI * ((n < Nx / 2 + 1) ? twodads::real_t(n) : (twodads::real_t(n) - twodads::real_t(Nx))) / geom.get_Lx());
+    };
+    auto ky = [=] (const size_t m) -> twodads::real_t {return(twodads::TWOPI * twodads::real_t(m) / geom.get_Ly());};
+    // Damping of the largest wave number is 1e4
+    const twodads::real_t k2_max{kx(Nx / 2) * kx(Nx / 2) + ky(My / 2) * ky(My / 2)};
+    const twodads::real_t hv{1e4 / pow(k2_max, static_cast<twodads::real_t>(p))};
+
+    dft_t dft(geom, twodads::dft_t::dft_2d);
+    real_arr u0(geom, bvals, 1);
+    u0.apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+             {
+                const twodads::real_t x{geom.get_x(n)};
+                const twodads::real_t y{geom.get_y(m)};
+                return(exp(-0.5 * (x * x + y * y)));
+             }, 0);
+    dft.dft_r2c(u0.get_tlev_ptr(0), reinterpret_cast<cmplx_t*>(u0.get_tlev_ptr(0)));
+    u0.set_transformed(0, true);
+
+    auto exact = [&] (real_arr& arr, const size_t tidx, const twodads::real_t t) -> void
+    {
+        const cmplx_t* src{reinterpret_cast<cmplx_t*>(u0.get_tlev_ptr(0))};
+        cmplx_t* dst{reinterpret_cast<cmplx_t*>(arr.get_tlev_ptr(tidx))};
+        for(size_t n = 0; n < Nx; n++)
+            for(size_t m = 0; m < My21; m++)
+            {
+                const twodads::real_t k2{kx(n) * kx(n) + ky(m) * ky(m)};
+                dst[n * My21 + m] = src[n * My21 + m] * exp(-(diff * k2 + hv * pow(k2, static_cast<twodads::real_t>(p))) * t);
+            }
+        arr.set_transformed(tidx, true);
+    };
+
+    real_arr sol(geom, bvals, 1);
+    exact(sol, 0, t_end);
+    auto error = [&] (const real_arr& arr, const size_t tidx) -> twodads::real_t
+    {
+        const cmplx_t* u{reinterpret_cast<cmplx_t*>(arr.get_tlev_ptr(tidx))};
+        const cmplx_t* u_ex{reinterpret_cast<cmplx_t*>(sol.get_tlev_ptr(0))};
+        twodads::real_t max_diff{0.0};
+        twodads::real_t max_val{0.0};
+        for(size_t idx = 0; idx < Nx * My21; idx++)
+        {
+            max_diff = max(max_diff, (u[idx] - u_ex[idx]).abs());
+            max_val = max(max_val, u_ex[idx].abs());
+        }
+        return(max_diff / max_val);
+    };
+
+    cout << "Bispectral, p = " << p << ", hv * k_max^(2p) = " << hv * pow(k2_max, static_cast<twodads::real_t>(p)) << endl;
+    cout << setw(10) << "steps" << setw(16) << "dt" << setw(16) << "ETDRK4" << setw(16) << "Karniadakis" << setw(16) << "ratio" << endl;
+
+    twodads::real_t err_ka_old{0.0};
+    for(size_t num_steps = 16; num_steps <= 256; num_steps *= 2)
+    {
+        const twodads::real_t dt{t_end / static_cast<twodads::real_t>(num_steps)};
+        const twodads::stiff_params_t params(dt, geom.get_Lx(), geom.get_Ly(), diff, hv, My, Nx / 2 + 1, 4, p);
+
+        integrator_etdrk4_bs_t<twodads::real_t, allocator_host> tint_etd(geom, bvals, params);
+        real_arr u(geom, bvals, 1);
+        exact(u, 0, 0.0);
+        for(size_t s = 0; s < num_steps; s++)
+        {
+            tint_etd.integrate_stages({&u}, 0, 0,
+                                      [&] (const std::vector<real_arr*>& src, const size_t t_src, const std::vector<real_arr*>& dst, const size_t t_dst) -> void
+                                      {
+                                          for(auto it : dst)
+                                          {
+                                              it -> apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t {return(0.0);}, t_dst);
+                                              it -> set_transformed(t_dst, true);
+                                          }
+                                      });
+        }
+        const twodads::real_t err_etd{error(u, 0)};
+
+        integrator_karniadakis_bs_t<twodads::real_t, allocator_host> tint_ka(geom, bvals, params);
+        real_arr v(geom, bvals, 4);
+        real_arr v_rhs(geom, bvals, 3);
+        for(size_t t = 0; t < 3; t++)
+            v_rhs.set_transformed(t, true);
+        // Start from the exact solution at t = 2 dt, dt, 0. Extrapolating to negative times would amplify the stiff modes.
+        for(size_t t = 1; t < 4; t++)
+            exact(v, t, static_cast<twodads::real_t>(3 - t) * dt);
+        for(size_t s = 2; s < num_steps; s++)
+        {
+            v.set_transformed(0, true);
+            tint_ka.integrate(v, v_rhs, 1, 2, 3, 0, 3);
+            v.advance();
+        }
+        const twodads::real_t err_ka{error(v, 1)};
+
+        cout << setw(10) << num_steps << setw(16) << dt << setw(16) << err_etd;
+        cout << setw(16) << err_ka << setw(16) << (err_ka_old > 0.0 ? err_ka_old / err_ka : 0.0) << endl;
+        err_ka_old = err_ka;
+    }
+}
+
+
+// Finite-difference integrators, Karniadakis and ARK
+void test_fd(const size_t p)
+{
+    constexpr size_t Nx{64};
+    constexpr size_t My{64};
+    const twodads::slab_layout_t geom(-10.0, 20.0 / static_cast<twodads::real_t>(Nx), -10.0, 20.0 / static_cast<twodads::real_t>(My),
+                                      Nx, 0, My, 2, twodads::grid_t::cell_centered);
+    const twodads::real_t bval_l{1.0};
+    const twodads::real_t bval_r{2.0};
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, bval_l, bval_r);
+
+    const twodads::real_t diff{0.01};
+    const twodads::real_t t_end{1.0};
+    const size_t kx{16};
+    const twodads::real_t ky{twodads::TWOPI * 8.0 / geom.get_Ly()};
+    const twodads::real_t sin_kx{sin(twodads::PI * static_cast<twodads::real_t>(kx) / (2.0 * static_cast<twodads::real_t>(geom.get_nx())))};
+    const twodads::real_t mu{4.0 * sin_kx * sin_kx / (geom.get_deltax() * geom.get_deltax()) + ky * ky};
+    const twodads::real_t mu_max{4.0 / (geom.get_deltax() * geom.get_deltax()) + 4.0 / (geom.get_deltay() * geom.get_deltay())};
+    // The hyperviscous damping of the test mode is 1
+    const twodads::real_t hv{1.0 / pow(mu, static_cast<twodads::real_t>(p))};
+    const twodads::real_t rate{-diff * mu - hv * pow(mu, static_cast<twodads::real_t>(p))};
+
+    auto u_exact = [=] (const twodads::real_t t, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+    {
+        const twodads::real_t u_b{bval_l + (bval_r - bval_l) * (geom.get_x(n) - geom.get_xleft()) / geom.get_Lx()};
+        return(u_b + exp(rate * t) * sin(twodads::PI * static_cast<twodads::real_t>(kx) * (static_cast<twodads::real_t>(n) + 0.5) / static_cast<twodads::real_t>(geom.get_nx())) * cos(ky * geom.get_y(m)));
+    };
+
+    auto error = [=] (const real_arr& arr, const size_t tidx) -> twodads::real_t
+    {
+        twodads::real_t max_diff{0.0};
+        for(size_t n = 0; n < Nx; n++)
+            for(size_t m = 0; m < My; m++)
+                max_diff = max(max_diff, fabs(arr.get_tlev_ptr(tidx)[n * (My + geom.get_pad_y()) + m] - u_exact(t_end, n, m, geom)));
+        return(max_diff / exp(rate * t_end));
+    };
+
+    cout << "Finite difference, p = " << p << ", hv * mu_max^p = " << hv * pow(mu_max, static_cast<twodads::real_t>(p)) << endl;
+    cout << setw(10) << "steps" << setw(16) << "dt" << setw(16) << "Karniadakis" << setw(16) << "ratio" << setw(16) << "ARK" << setw(16) << "ratio" << endl;
+
+    dft_t dft(geom, twodads::dft_t::dft_1d);
+    twodads::real_t err_ka_old{0.0};
+    twodads::real_t err_ark_old{0.0};
+    for(size_t num_steps = 16; num_steps <= 256; num_steps *= 2)
+    {
+        const twodads::real_t dt{t_end / static_cast<twodads::real_t>(num_steps)};
+        const twodads::stiff_params_t params(dt, geom.get_Lx(), geom.get_Ly(), diff, hv, My, Nx / 2 + 1, 4, p);
+
+        // Karniadakis, third order, previous time steps from the exact solution
+        integrator_karniadakis_fd_t<twodads::real_t, allocator_host> tint_ka(geom, bvals, params);
+        real_arr v(geom, bvals, 4);
+        real_arr v_rhs(geom, bvals, 3);
+        for(size_t t = 1; t < 4; t++)
+        {
+            const twodads::real_t t_old{-static_cast<twodads::real_t>(t - 1) * dt};
+            v.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                    {return(u_exact(t_old, n, m, geom));}, t);
+        }
+        for(size_t s = 0; s < num_steps; s++)
+        {
+            tint_ka.integrate(v, v_rhs, 1, 2, 3, 0, 3);
+            dft.dft_c2r(reinterpret_cast<cmplx_t*>(v.get_tlev_ptr(0)), v.get_tlev_ptr(0));
+            utility :: normalize(v, 0);
+            v.set_transformed(0, false);
+            v.advance();
+        }
+        const twodads::real_t err_ka{error(v, 1)};
+
+        // ARK
+        integrator_ark_fd_t<twodads::real_t, allocator_host> tint_ark(geom, bvals, params);
+        real_arr u(geom, bvals, 1);
+        u.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                {return(u_exact(0.0, n, m, geom));}, 0);
+        for(size_t s = 0; s < num_steps; s++)
+        {
+            tint_ark.integrate_stages({&u}, 0, 0,
+                                      [&] (const std::vector<real_arr*>& src, const size_t t_src, const std::vector<real_arr*>& dst, const size_t t_dst) -> void
+                                      {
+                                          for(auto it : dst)
+                                          {
+                                              it -> apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t {return(0.0);}, t_dst);
+                                              it -> set_transformed(t_dst, false);
+                                          }
+                                      });
+        }
+        const twodads::real_t err_ark{error(u, 0)};
+
+        cout << setw(10) << num_steps << setw(16) << dt << setw(16) << err_ka << setw(16) << (err_ka_old > 0.0 ? err_ka_old / err_ka : 0.0);
+        cout << setw(16) << err_ark << setw(16) << (err_ark_old > 0.0 ? err_ark_old / err_ark : 0.0) << endl;
+        err_ka_old = err_ka;
+        err_ark_old = err_ark;
+    }
+}
+
+
+int main(void)
+{
+    for(const size_t p : {2, 3, 8})
+        test_bs(p);
+    for(const size_t p : {2, 3, 8})
+        test_fd(p);
+}
@@ -0,0 +1,128 @@
+/*
+ * Test the boundary terms of deriv_fd_t :: invert_laplace
+ *
+ * Invert nabla^2 u = f with
+ * u(x, y) = p(x) + h(x) cos(ky y)
+ * p(x) = exp(x / 2)
+ * h(x) = (x - x_l)^2 (x - x_r)^2
+ * on x_l = -1 < x < x_r = 1. h and h' vanish at the boundaries, so that only the ky = 0 mode
+ * has non-zero boundary values, p(x_l), p(x_r) for Dirichlet and p'(x_l), p'(x_r) for Neumann boundaries.
+ *
+ * The boundary values enter through the right hand side of the outermost rows. They are scaled
+ * as the stencil, by 1 / dx^2, and the Neumann terms have opposite signs at the two boundaries.
+ * The solution has to converge with second order for all combinations of Dirichlet and Neumann
+ * boundaries, on a uniform and on a stretched grid.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+using dft_t = fftw_object_t<twodads::real_t>;
+using deriv_t = deriv_fd_t<twodads::real_t, allocator_host>;
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    constexpr size_t My{16};
+    const twodads::real_t x_l{-1.0};
+    const twodads::real_t x_r{1.0};
+    const twodads::real_t Lx{x_r - x_l};
+    const twodads::real_t Ly{2.0};
+    const twodads::real_t ky{twodads::TWOPI / Ly};
+
+    // p(x) and its derivatives
+    auto p = [=] (const twodads::real_t x, const size_t d) -> twodads::real_t
+    {
+        return(exp(0.5 * x) * (d == 0 ? 1.0 : (d == 1 ? 0.5 : 0.25)));
+    };
+    // h(x) and its second derivative
+    auto h = [=] (const twodads::real_t x, const size_t d) -> twodads::real_t
+    {
+        const twodads::real_t a{x - x_l};
+        const twodads::real_t b{x - x_r};
+        return(d == 0 ? a * a * b * b : 2.0 * b * b + 8.0 * a * b + 2.0 * a * a);
+    };
+
+    cout << setw(12) << "bc_left" << setw(12) << "bc_right" << setw(10) << "stretch" << setw(8) << "Nx" << setw(16) << "max error" << setw(16) << "order" << endl;
+    for(const twodads::bc_t bc_left : {twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_neumann})
+    {
+        for(const twodads::bc_t bc_right : {twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_neumann})
+        {
+            // The ky = 0 mode is singular for Neumann boundaries on both sides
+            if(bc_left == twodads::bc_t::bc_neumann && bc_right == twodads::bc_t::bc_neumann)
+                continue;
+
+            const twodads::real_t bval_left{bc_left == twodads::bc_t::bc_dirichlet ? p(x_l, 0) : p(x_l, 1)};
+            const twodads::real_t bval_right{bc_right == twodads::bc_t::bc_dirichlet ? p(x_r, 0) : p(x_r, 1)};
+            const twodads::bvals_t<twodads::real_t> bvals(bc_left, bc_right, bval_left, bval_right);
+
+            for(const twodads::real_t stretch : {0.0, 0.5})
+            {
+                twodads::real_t err_old{0.0};
+                for(size_t Nx : {32, 64, 128, 256})
+                {
+                    const twodads::slab_layout_t geom(x_l, Lx / static_cast<twodads::real_t>(Nx), -1.0, Ly / static_cast<twodads::real_t>(My),
+                                                      Nx, 0, My, 2, twodads::grid_t::cell_centered, stretch);
+                    deriv_t der(geom, bvals);
+                    dft_t dft(geom, twodads::dft_t::dft_1d);
+
+                    real_arr rhs(geom, bvals, 1);
+                    real_arr sol(geom, bvals, 1);
+                    rhs.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                    {
+                        const twodads::real_t x{geom.get_x(n)};
+                        const twodads::real_t c{cos(ky * (geom.get_y(m) + 1.0))};
+                        return(p(x, 2) + (h(x, 2) - ky * ky * h(x, 0)) * c);
+                    }, 0);
+                    dft.dft_r2c(rhs.get_tlev_ptr(0), reinterpret_cast<twodads::cmplx_t*>(rhs.get_tlev_ptr(0)));
+                    rhs.set_transformed(0, true);
+                    der.invert_laplace(rhs, sol, 0, 0);
+                    dft.dft_c2r(reinterpret_cast<twodads::cmplx_t*>(sol.get_tlev_ptr(0)), sol.get_tlev_ptr(0));
+                    utility :: normalize(sol, 0);
+                    sol.set_transformed(0, false);
+
+                    twodads::real_t err{0.0};
+                    for(size_t n = 0; n < Nx; n++)
+                    {
+                        const twodads::real_t x{geom.get_x(n)};
+                        for(size_t m = 0; m < My; m++)
+                        {
+                            const twodads::real_t u_ex{p(x, 0) + h(x, 0) * cos(ky * (geom.get_y(m) + 1.0))};
+                            err = max(err, fabs(sol.get_tlev_ptr(0)[n * (My + geom.get_pad_y()) + m] - u_ex));
+                        }
+                    }
+
+                    cout << setw(12) << (bc_left == twodads::bc_t::bc_dirichlet ? "dirichlet" : "neumann");
+                    cout << setw(12) << (bc_right == twodads::bc_t::bc_dirichlet ? "dirichlet" : "neumann");
+                    cout << setw(10) << stretch << setw(8) << Nx << setw(16) << err;
+                    if(err_old > 0.0)
+                    {
+                        const twodads::real_t order{log2(err_old / err)};
+                        cout << setw(16) << order;
+                        check(order > 1.8, "Second order convergence");
+                    }
+                    cout << endl;
+                    err_old = err;
+                }
+                check(err_old < 1e-4, "Error at Nx = 256");
+            }
+        }
+    }
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,116 @@
+/*
+ * Invert the laplace equation with the real-to-real DFT solver and compare to the
+ * tridiagonal solver
+ *
+ * Invert
+ * g(x,y) = exp(-(x^2 + y^2) / 2)
+ * \nabla^2 g(x,y) = f(x,y)
+ * where
+ * f(x,y) = exp(-(x^2 + y^2) / 2) (-2 + x^2 + y^2)
+ *
+ * Both solvers solve the same linear system. Their solutions should agree to round-off.
+ */
+
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+using dft_t = fftw_object_t<twodads::real_t>;
+using deriv_t = deriv_fd_t<twodads::real_t, allocator_host>;
+
+int main(void)
+{
+    constexpr size_t num_solve{100};
+    const size_t t_src{0};
+    slab_config_js my_config(std::string("input_test_laplace_fd.json"));
+    const twodads::bvals_t<twodads::real_t> bvals{my_config.get_bvals(twodads::field_t::f_theta)};
+
+    deriv_t der_tridiag(my_config.get_geom(), bvals, twodads::solver_t::solver_tridiag);
+    deriv_t der_r2r(my_config.get_geom(), bvals, twodads::solver_t::solver_r2r);
+    dft_t dft(my_config.get_geom(), my_config.get_dft_t());
+
+    {
+        // Analytic solution
+        real_arr sol_an(my_config.get_geom(), bvals, 1);
+        // Input array
+        real_arr input(my_config.get_geom(), bvals, 1);
+        // numerical solutions
+        real_arr sol_tridiag(my_config.get_geom(), bvals, 1);
+        real_arr sol_r2r(my_config.get_geom(), bvals, 1);
+
+        // Initialize input for laplace solver
+        input.apply([] (twodads::real_t dummy, size_t n, size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+        {
+            const twodads::real_t x{geom.get_x(n)};
+            const twodads::real_t y{geom.get_y(m)};
+            return(exp(-0.5 * (x * x + y * y)) * (-2.0 + x * x + y * y));
+        }, t_src);
+
+        // Initialize analytic solution
+        sol_an.apply([] (twodads::real_t dummy, size_t n, size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                {
+                    const twodads::real_t x{geom.get_x(n)};
+                    const twodads::real_t y{geom.get_y(m)};
+                    return(exp(-0.5 * (x * x + y * y)));
+                },
+        t_src);
+
+        dft.dft_r2c(input.get_tlev_ptr(t_src), reinterpret_cast<twodads::cmplx_t*>(input.get_tlev_ptr(t_src)));
+        input.set_transformed(t_src, true);
+
+        auto t_start = chrono::high_resolution_clock::now();
+        for(size_t n = 0; n < num_solve; n++)
+            der_tridiag.invert_laplace(input, sol_tridiag, t_src, t_src);
+        auto t_tridiag = chrono::high_resolution_clock::now() - t_start;
+
+        t_start = chrono::high_resolution_clock::now();
+        for(size_t n = 0; n < num_solve; n++)
+            der_r2r.invert_laplace(input, sol_r2r, t_src, t_src);
+        auto t_r2r = chrono::high_resolution_clock::now() - t_start;
+
+        for(auto arr : {&sol_tridiag, &sol_r2r})
+        {
+            dft.dft_c2r(reinterpret_cast<twodads::cmplx_t*>((*arr).get_tlev_ptr(t_src)), (*arr).get_tlev_ptr(t_src));
+            utility :: normalize(*arr, t_src);
+            (*arr).set_transformed(t_src, false);
+        }
+
+        // Difference between the two numerical solutions
+        sol_tridiag.elementwise([] LAMBDACALLER (twodads::real_t lhs, twodads::real_t rhs) -> twodads::real_t
+            {
+                return(lhs - rhs);
+            }, sol_r2r, t_src, t_src);
+
+        // Difference between the r2r solution and the analytic solution
+        sol_r2r.elementwise([] LAMBDACALLER (twodads::real_t lhs, twodads::real_t rhs) -> twodads::real_t
+            {
+                return(lhs - rhs);
+            }, sol_an, t_src, t_src);
+
+        cout << "Nx = " << my_config.get_nx() << ", My = " << my_config.get_my() << endl;
+        cout << "L2(r2r - analytic) = " << utility :: L2(sol_r2r, t_src) << endl;
+        cout << "L2(r2r - tridiag) = " << utility :: L2(sol_tridiag, t_src) << endl;
+        cout << "tridiag: " << chrono::duration<double, milli>(t_tridiag).count() / num_solve << " ms per solve" << endl;
+        cout << "r2r:     " << chrono::duration<double, milli>(t_r2r).count() / num_solve << " ms per solve" << endl;
+    }
+
+    // The factorization reads an interior element of the main diagonal, a grid with a single row is rejected
+    bool thrown{false};
+    {
+        const twodads::slab_layout_t geom_row(-1.0, 2.0, -1.0, 2.0 / 16, 1, 0, 16, 2, twodads::grid_t::cell_centered);
+        try
+        {
+            solvers :: elliptic_r2r_t solver(geom_row, twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet);
+        }
+        catch(const config_error& err)
+        {
+            thrown = true;
+        }
+        cout << "Nx = 1 rejected: " << (thrown ? "yes" : "no") << endl;
+    }
+    return(thrown ? 0 : 1);
+}
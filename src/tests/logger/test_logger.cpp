@@ -0,0 +1,134 @@
+/*
+ * Test the log of logger.h
+ *
+ * Writes JSON records to a file, reads them back with boost::property_tree and checks that messages
+ * below the level are discarded, that LOG_EVERY writes one message per interval and counts the
+ * suppressed ones, that the background thread writes the buffer without an explicit flush, and that
+ * long messages are written completely. Also reports the cost of a disabled and a suppressed message.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "logger.h"
+
+using namespace std;
+
+
+// Records in the log file, one JSON object per line
+std::vector<boost::property_tree::ptree> read_records(const std::string& fname)
+{
+    std::vector<boost::property_tree::ptree> records;
+    std::ifstream ifs(fname);
+    std::string line;
+    while(std::getline(ifs, line))
+    {
+        std::stringstream ss(line);
+        boost::property_tree::ptree pt;
+        boost::property_tree::read_json(ss, pt);
+        records.push_back(pt);
+    }
+    return(records);
+}
+
+
+void log_progress(const size_t step, const double interval)
+{
+    LOG_EVERY(logger::level_t::info, interval, "step %zu", step);
+}
+
+
+int main(void)
+{
+    logger :: logger_t& log = logger :: logger_t :: get();
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    const std::string fname{"test_logger.log"};
+    log.set_file(fname);
+    log.set_format(logger::format_t::json);
+    log.set_level(logger::level_t::warning);
+
+    // Levels
+    LOG_MESSAGE(logger::level_t::info, "not written");
+    LOG_MESSAGE(logger::level_t::warning, "warning %d", 1);
+    LOG_MESSAGE(logger::level_t::error, "error \"%s\"", "quoted");
+    log.flush();
+    std::vector<boost::property_tree::ptree> records{read_records(fname)};
+    check(records.size() == 2, "Info messages are discarded at level warning");
+    if(records.size() == 2)
+    {
+        check(records[0].get<std::string>("level") == "warning", "Level of the first record");
+        check(records[0].get<std::string>("msg") == "warning 1", "Message of the first record");
+        check(records[1].get<std::string>("msg") == "error \"quoted\"", "Quotes are escaped");
+        check(records[1].get<double>("t") >= records[0].get<double>("t"), "Records are ordered");
+    }
+
+    // Rate limit
+    log.set_file(fname);
+    log.set_level(logger::level_t::info);
+    for(size_t n = 0; n < 1000; n++)
+        log_progress(n, 100.0);
+    // Interval 0 allows the next message, which reports the suppressed ones
+    log_progress(1000, 0.0);
+    log.flush();
+    records = read_records(fname);
+    check(records.size() == 2, "LOG_EVERY writes one message per interval");
+    if(records.size() == 2)
+    {
+        check(records[0].get<std::string>("msg") == "step 0", "The first message is written");
+        check(records[1].get<std::string>("msg") == "step 1000", "The message after the interval is written");
+        check(records[1].get<size_t>("suppressed") == 999, "999 messages are suppressed");
+    }
+
+    // Background flush
+    log.set_file(fname);
+    log.set_flush_interval(0.01);
+    LOG_MESSAGE(logger::level_t::info, "flushed by the thread");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    records = read_records(fname);
+    check(records.size() == 1 && records[0].get<std::string>("msg") == "flushed by the thread", "The thread writes the buffer");
+
+    // Long messages
+    log.set_file(fname);
+    const std::string long_msg(4 * logger::max_msg_len, 'x');
+    LOG_MESSAGE(logger::level_t::info, "short");
+    LOG_MESSAGE(logger::level_t::info, "%s", long_msg.c_str());
+    log.flush();
+    records = read_records(fname);
+    check(records.size() == 2, "Long messages are written");
+    if(records.size() == 2)
+    {
+        check(records[0].get<std::string>("msg") == "short", "Buffered records are written before a long message");
+        check(records[1].get<std::string>("msg") == long_msg, "Long messages are not truncated");
+    }
+    check(log.get_num_dropped() == 0, "No messages are dropped");
+
+    // Cost of messages that are not written
+    constexpr size_t num_calls{10000000};
+    auto t_start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < num_calls; n++)
+        LOG_MESSAGE(logger::level_t::debug, "step %zu", n);
+    cout << "Disabled message: " << std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t_start).count() / num_calls << "ns per call" << endl;
+    t_start = std::chrono::steady_clock::now();
+    for(size_t n = 0; n < num_calls; n++)
+        log_progress(n, 100.0);
+    cout << "Suppressed message: " << std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t_start).count() / num_calls << "ns per call" << endl;
+
+    log.set_file(std::string());
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,186 @@
+/*
+ * Test the finite difference slab on a grid distributed in x over MPI ranks
+ *
+ * Run with mpirun -np 4. Checks the configurations returned by slab_config_js :: get_subdomain. Then runs
+ * the slab on all ranks and writes output and diagnostics. Rank 0 runs the same steps on the whole grid,
+ * with MPI_COMM_SELF, as the serial reference. The fields in the output of the distributed slab and the
+ * diagnostics have to agree with the reference up to rounding. The distributed tridiagonal solver and
+ * the grid spacing of the subdomains change the last digits, they are not bitwise identical.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+// Runs num_steps time steps, then writes output and diagnostics. Returns the time step allowed by the CFL condition.
+twodads::real_t run_slab(const slab_config_js& my_config, MPI_Comm comm, const size_t num_steps)
+{
+    const size_t order{my_config.get_tint_params(twodads::dyn_field_t::f_theta).get_tlevs()};
+    const std::vector<twodads::dyn_field_t> dyn_fields{twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau};
+
+    slab_bc my_slab(my_config, nullptr, comm);
+    my_slab.initialize();
+    my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
+    my_slab.update_real_fields(order - 1);
+    my_slab.rhs(order - 2, order - 1);
+    for(size_t t = 1; t < order - 1; t++)
+    {
+        my_slab.integrate(dyn_fields, t);
+        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1 - t, 0);
+        my_slab.update_real_fields(order - 1 - t);
+        my_slab.rhs(order - 2 - t, order - 1 - t);
+    }
+    for(size_t tstep = 0; tstep < num_steps; tstep++)
+    {
+        my_slab.integrate(dyn_fields, order - 1);
+        my_slab.advance();
+        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, 1, 0);
+        my_slab.update_real_fields(1);
+        my_slab.rhs(0, 1);
+    }
+    if(!my_slab.is_finite())
+        throw numerics_error(my_slab.get_nonfinite_report());
+
+    const twodads::real_t time{static_cast<twodads::real_t>(num_steps) * my_config.get_deltat()};
+    my_slab.write_output(1, time);
+    my_slab.diagnose(1, time);
+    my_slab.flush_output();
+    my_slab.wait_diagnostics();
+    return(my_slab.get_deltat_cfl());
+}
+
+
+// Largest difference between the numbers in two text files, relative to the largest number
+twodads::real_t max_diff_dat(const std::string& fname_a, const std::string& fname_b)
+{
+    std::ifstream file_a(fname_a);
+    std::ifstream file_b(fname_b);
+    std::string line_a;
+    std::string line_b;
+    twodads::real_t max_diff{0.0};
+    twodads::real_t max_val{0.0};
+    size_t num_values{0};
+    while(std::getline(file_a, line_a) && std::getline(file_b, line_b))
+    {
+        if(line_a.empty() || line_a[0] == '#')
+            continue;
+        std::istringstream ss_a(line_a);
+        std::istringstream ss_b(line_b);
+        twodads::real_t val_a{0.0};
+        twodads::real_t val_b{0.0};
+        while(ss_a >> val_a && ss_b >> val_b)
+        {
+            max_diff = std::max(max_diff, std::fabs(val_a - val_b));
+            max_val = std::max(max_val, std::fabs(val_a));
+            num_values++;
+        }
+    }
+    return(num_values == 0 || max_val == 0.0 ? 1.0 : max_diff / max_val);
+}
+
+
+int main(int argc, char* argv[])
+{
+    MPI_Init(&argc, &argv);
+    int rank{0};
+    int num_ranks{1};
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(std::string("input_test_mpi_decomp.json"), pt);
+    const slab_config_js my_config(pt);
+    const twodads::slab_layout_t geom{my_config.get_geom()};
+    const twodads::real_t eps{1e-10};
+
+    // Configuration of the subdomains, 72 rows on 4 ranks
+    if(rank == 0)
+    {
+        std::vector<slab_config_js> subdomains;
+        for(size_t k = 0; k < 4; k++)
+            subdomains.push_back(my_config.get_subdomain(k, 4));
+        check(subdomains[0].get_nx() == 20 && subdomains[1].get_nx() == 20 && subdomains[2].get_nx() == 16 && subdomains[3].get_nx() == 16,
+              "The first subdomains get one more block of rows");
+        check(std::fabs(subdomains[1].get_xleft() - (geom.get_xleft() + 20.0 * geom.get_deltax())) < eps &&
+              std::fabs(subdomains[3].get_xright() - geom.get_xright()) < eps, "Subdomains cover the domain");
+        check(std::fabs(subdomains[2].get_deltax() - geom.get_deltax()) < eps, "Subdomains have the grid spacing of the domain");
+        check(subdomains[0].get_bvals(twodads::field_t::f_theta).get_bc_left() == twodads::bc_t::bc_dirichlet &&
+              subdomains[0].get_bvals(twodads::field_t::f_theta).get_bc_right() == twodads::bc_t::bc_null &&
+              subdomains[1].get_bvals(twodads::field_t::f_strmf).get_bc_left() == twodads::bc_t::bc_null &&
+              subdomains[3].get_bvals(twodads::field_t::f_theta).get_bc_right() == twodads::bc_t::bc_neumann,
+              "Boundary conditions between subdomains are bc_null");
+        check(subdomains[2].get_solver_t() == twodads::solver_t::solver_spike_mpi, "Subdomains use the distributed solver");
+        check(subdomains[1].get_checkpoint_file() == "rank1_" + my_config.get_checkpoint_file(), "Prefix of the checkpoint file");
+
+        bool thrown{false};
+        try
+        {
+            my_config.get_subdomain(0, 40);
+        }
+        catch(const config_error& err)
+        {
+            thrown = true;
+        }
+        check(thrown, "Subdomains with less than four rows are rejected");
+    }
+
+    // Distributed slab on all ranks and the reference on rank 0
+    const size_t num_steps{20};
+    const twodads::real_t dt_cfl{run_slab(my_config, MPI_COMM_WORLD, num_steps)};
+    if(rank == 0)
+    {
+        boost::property_tree::ptree pt_serial{pt};
+        pt_serial.put("2dads.output.prefix", "serial_");
+        const twodads::real_t dt_cfl_serial{run_slab(slab_config_js(pt_serial), MPI_COMM_SELF, num_steps)};
+        check(std::fabs(dt_cfl - dt_cfl_serial) < eps * dt_cfl_serial, "CFL limit covers all ranks");
+
+        input_h5_t input(std::string("output.h5"));
+        input_h5_t input_serial(std::string("serial_output.h5"));
+        check(input.get_config().get_geom() == geom, "Output has the geometry of the whole grid");
+        const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+        real_arr arr(geom, bvals, 1);
+        real_arr arr_serial(geom, bvals, 1);
+        for(auto fname : {twodads::output_t::o_theta, twodads::output_t::o_omega, twodads::output_t::o_strmf})
+        {
+            input.surface(fname, 0, arr, 0);
+            input_serial.surface(fname, 0, arr_serial, 0);
+            twodads::real_t max_diff{0.0};
+            twodads::real_t max_val{0.0};
+            for(size_t n = 0; n < geom.get_nx(); n++)
+                for(size_t m = 0; m < geom.get_my(); m++)
+                {
+                    const size_t idx{n * (geom.get_my() + geom.get_pad_y()) + m};
+                    max_diff = std::max(max_diff, std::fabs(arr.get_tlev_ptr(0)[idx] - arr_serial.get_tlev_ptr(0)[idx]));
+                    max_val = std::max(max_val, std::fabs(arr_serial.get_tlev_ptr(0)[idx]));
+                }
+            cout << "Field " << static_cast<int>(fname) << ": maximum difference to the serial run " << max_diff << " of " << max_val << endl;
+            check(max_val > 0.0 && max_diff < eps * max_val, "Output agrees with the serial run");
+        }
+        check(max_diff_dat("com_theta.dat", "serial_com_theta.dat") < eps, "Diagnostics agree with the serial run");
+    }
+
+    int num_errors_all{0};
+    const int num_errors_rank{static_cast<int>(num_errors)};
+    MPI_Reduce(&num_errors_rank, &num_errors_all, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if(rank == 0)
+        cout << (num_errors_all == 0 ? "All tests passed" : "Tests failed") << endl;
+    MPI_Finalize();
+    return(num_errors_all == 0 ? 0 : 1);
+}
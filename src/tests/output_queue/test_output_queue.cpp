@@ -0,0 +1,109 @@
+/*
+ * Test the output thread of output_queue_t
+ *
+ * Submits num_out outputs of two fields, each with different values, and reads them back with input_h5_t.
+ * Two buffers hold a single output, so that acquire waits for the thread. The snapshots have to be bitwise
+ * identical to the submitted fields, in the order of submission. Also reports the time the caller spends in
+ * acquire and submit per output, with the output written in the calling thread and by the thread.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include "output.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+// Value of output k of field f
+twodads::real_t field_value(const size_t k, const size_t f, const size_t n, const size_t m, const twodads::slab_layout_t& geom)
+{
+    return(static_cast<twodads::real_t>(k) + static_cast<twodads::real_t>(f) * sin(geom.get_x(n)) * cos(geom.get_y(m)));
+}
+
+
+// Writes num_out outputs of theta and omega and returns the time spent in the calls per output
+double run_queue(const slab_config_js& config, const size_t num_out)
+{
+    const std::vector<twodads::output_t> fields{twodads::output_t::o_theta, twodads::output_t::o_omega};
+    double t_write{0.0};
+    output_queue_t queue(config);
+    for(size_t k = 0; k < num_out; k++)
+    {
+        for(size_t f = 0; f < fields.size(); f++)
+        {
+            auto t_start = std::chrono::steady_clock::now();
+            real_arr* arr{queue.acquire()};
+            t_write += std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+            arr -> apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                         {return(field_value(k, f, n, m, geom));}, 0);
+            t_start = std::chrono::steady_clock::now();
+            queue.submit(fields[f], 0.1 * static_cast<twodads::real_t>(k));
+            t_write += std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+        }
+        queue.increment_output_counter();
+    }
+    queue.flush();
+    return(t_write / static_cast<double>(num_out));
+}
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    const size_t num_out{10};
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(std::string("input_test_output_queue.json"), pt);
+
+    pt.put("2dads.output.buffers", 0);
+    const double t_sync{run_queue(slab_config_js(pt), num_out)};
+    pt.put("2dads.output.buffers", 2);
+    const double t_async{run_queue(slab_config_js(pt), num_out)};
+
+    // Read back the snapshots of the second run
+    input_h5_t input(std::string("output.h5"));
+    const twodads::slab_layout_t geom{input.get_config().get_geom()};
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+    real_arr arr(geom, bvals, 1);
+    size_t num_diff{0};
+    for(size_t k = 0; k < num_out; k++)
+    {
+        size_t f{0};
+        for(auto fname : {twodads::output_t::o_theta, twodads::output_t::o_omega})
+        {
+            input.surface(fname, k, arr, 0);
+            for(size_t n = 0; n < geom.get_nx(); n++)
+                for(size_t m = 0; m < geom.get_my(); m++)
+                    num_diff += (arr.get_tlev_ptr(0)[n * (geom.get_my() + geom.get_pad_y()) + m] != field_value(k, f, n, m, geom)) ? 1 : 0;
+            f++;
+        }
+    }
+    check(num_diff == 0, "Snapshots are written in order and bitwise identical");
+
+    bool thrown{false};
+    try
+    {
+        input.surface(twodads::output_t::o_theta, num_out, arr, 0);
+    }
+    catch(const config_error& err)
+    {
+        thrown = true;
+    }
+    check(thrown, "No snapshots are written after the submitted ones");
+
+    cout << "Time per output: " << t_sync * 1e3 << "ms synchronous, " << t_async * 1e3 << "ms with the thread" << endl;
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,160 @@
+/*
+ * Test the scoped timers of profiler.h
+ *
+ * Times nested regions with known durations and checks the call counts, the times, and the bytes
+ * in the JSON report, which is read back with boost::property_tree. Scopes that run while the
+ * registry is disabled are not counted. Also reports the cost of a disabled and an enabled timed scope
+ * and the timers of a derivative and a DFT.
+ *
+ * Hardware counters: If perf_event_open is permitted, a loop of known length has to execute at least as 
+ * many instructions as iterations. Otherwise the report has to give the reason and no events.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <cmath>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "slab_bc.h"
+#include "profiler.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+void sleep_region(const size_t ms)
+{
+    PROFILE_SCOPE("test::sleep", 1024);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+
+void outer_region()
+{
+    PROFILE_SCOPE("test::outer", 0);
+    sleep_region(2);
+    sleep_region(4);
+}
+
+
+// Time per call of an empty timed scope, in nanoseconds
+double time_empty_scope(const size_t num_calls)
+{
+    const auto t_start = profiler :: timer_clock_t :: now();
+    for(size_t n = 0; n < num_calls; n++)
+    {
+        PROFILE_SCOPE("test::empty", 8);
+    }
+    return(std::chrono::duration<double, std::nano>(profiler :: timer_clock_t :: now() - t_start).count() / static_cast<double>(num_calls));
+}
+
+
+int main(void)
+{
+    profiler :: registry_t& registry = profiler :: registry_t :: get();
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    // Not counted, the registry is disabled
+    outer_region();
+
+    registry.enable();
+    outer_region();
+    outer_region();
+    registry.disable();
+    outer_region();
+
+    std::stringstream report;
+    registry.write_report(report);
+    cout << report.str();
+
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(report, pt);
+    check(pt.get<size_t>("regions.test::outer.calls") == 2, "2 calls of test::outer");
+    check(pt.get<size_t>("regions.test::sleep.calls") == 4, "4 calls of test::sleep");
+    check(pt.get<size_t>("regions.test::sleep.bytes") == 4 * 1024, "4 KiB touched by test::sleep");
+    check(pt.get<double>("regions.test::sleep.min_s") >= 2e-3, "test::sleep takes at least 2ms");
+    check(pt.get<double>("regions.test::sleep.max_s") >= 4e-3, "test::sleep takes at least 4ms");
+    check(pt.get<double>("regions.test::outer.min_s") >= 6e-3, "test::outer takes at least 6ms");
+    check(pt.get<double>("regions.test::outer.total_s") >= pt.get<double>("regions.test::sleep.total_s"), "test::outer includes test::sleep");
+    check(pt.get<double>("wall_time_s") >= pt.get<double>("regions.test::outer.total_s"), "Wall time exceeds test::outer");
+
+    // Overhead of the timers
+    constexpr size_t num_calls{10000000};
+    cout << "Disabled scope: " << time_empty_scope(num_calls) << "ns per call" << endl;
+    registry.enable();
+    cout << "Enabled scope: " << time_empty_scope(num_calls / 10) << "ns per call" << endl;
+
+    // Timers in the library
+    registry.reset();
+    const twodads::slab_layout_t geom(-1.0, 2.0 / 128, -1.0, 2.0 / 128, 128, 0, 128, 2, twodads::grid_t::cell_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+    deriv_fd_t<twodads::real_t, allocator_host> der(geom, bvals);
+    fftw_object_t<twodads::real_t> dft(geom, twodads::dft_t::dft_1d);
+    real_arr u(geom, bvals, 1);
+    real_arr u_x(geom, bvals, 1);
+    u.apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+            {return(sin(twodads::PI * geom.get_x(n)));}, 0);
+    for(size_t n = 0; n < 10; n++)
+        der.dx(u, u_x, 0, 0, 1);
+    dft.dft_r2c(u.get_tlev_ptr(0), reinterpret_cast<twodads::cmplx_t*>(u.get_tlev_ptr(0)));
+    registry.disable();
+
+    std::stringstream report_lib;
+    registry.write_report(report_lib);
+    cout << report_lib.str();
+    boost::property_tree::ptree pt_lib;
+    boost::property_tree::read_json(report_lib, pt_lib);
+    check(pt_lib.get<size_t>("regions.deriv_fd_t::dx.calls") == 10, "10 calls of deriv_fd_t::dx");
+    check(pt_lib.get<size_t>("regions.deriv_fd_t::dx.bytes") == 10 * 2 * geom.get_nelem_per_t() * sizeof(twodads::real_t), "Bytes of deriv_fd_t::dx");
+    check(pt_lib.get<size_t>("regions.fftw_object_t::dft_r2c.calls") == 1, "1 call of fftw_object_t::dft_r2c");
+    check(pt_lib.get_child_optional("regions.test::outer") == boost::none, "Reset clears test::outer");
+
+    // Hardware counters
+    registry.reset();
+    registry.enable();
+    const bool counting{registry.enable_counters()};
+    constexpr size_t num_iter{10000000};
+    volatile twodads::real_t sum{0.0};
+    {
+        PROFILE_SCOPE("test::loop", num_iter * sizeof(twodads::real_t));
+        for(size_t n = 0; n < num_iter; n++)
+            sum = sum + 1.0;
+    }
+    der.dx(u, u_x, 0, 0, 1);
+    registry.disable();
+
+    std::stringstream report_hw;
+    registry.write_report(report_hw);
+    cout << report_hw.str();
+    boost::property_tree::ptree pt_hw;
+    boost::property_tree::read_json(report_hw, pt_hw);
+    if(counting)
+    {
+        check(pt_hw.get_child("counters").size() > 0, "Counted events are listed");
+        if(pt_hw.get_optional<uint64_t>("regions.test::loop.instructions"))
+            check(pt_hw.get<uint64_t>("regions.test::loop.instructions") >= num_iter, "test::loop executes at least num_iter instructions");
+        if(pt_hw.get_optional<uint64_t>("regions.test::loop.cycles"))
+            check(pt_hw.get<uint64_t>("regions.test::loop.cycles") > 0, "test::loop takes cycles");
+    }
+    else
+    {
+        cout << "Hardware counters are not available: " << registry.get_counter_error() << endl;
+        check(pt_hw.get_child("counters").size() == 0, "No counted events");
+        check(pt_hw.get_optional<std::string>("counters_error") != boost::none, "Report gives the reason");
+        check(pt_hw.get_optional<uint64_t>("regions.test::loop.cycles") == boost::none, "No events in the regions");
+    }
+    check(pt_hw.get<size_t>("regions.test::loop.calls") == 1, "1 call of test::loop");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
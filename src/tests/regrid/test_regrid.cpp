@@ -0,0 +1,147 @@
+/*
+ * Test initialization from an output file with a different resolution
+ *
+ * A slab with Nx_src x My_src points writes
+ * f(x, y) = exp(-x^2 / 4) (1 + 0.5 cos(2 pi y / Ly) + 0.3 sin(4 pi y / Ly))
+ * to an output file. A slab with the resolution of input_test_regrid.json is initialized from this file.
+ *
+ * f is resolved in y on all grids, so the error comes from the interpolation in x, with
+ * Lagrange polynomials of degree 5. Doubling Nx_src should reduce the error by a factor of 64.
+ * With Nx_src = 512, the points of the cell-centered grids do not coincide and f is interpolated
+ * in x as well. With Nx_src = 3 Nx, every third cell center of the source grid is a cell center of
+ * the destination grid, and f is reproduced up to round-off.
+ *
+ * Last, the field regridded from Nx_src = 128, My_src = 16 is written and read back at the source
+ * resolution. The error of this round trip is bounded by twice the interpolation error at Nx_src = 128.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    slab_config_js my_config(std::string("input_test_regrid.json"));
+    const size_t tidx{my_config.get_tlevs() - 1};
+    const twodads::real_t Ly{my_config.get_Ly()};
+    const size_t nx_dst{my_config.get_nx()};
+
+    auto f_exact = [=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+    {
+        const twodads::real_t x{geom.get_x(n)};
+        const twodads::real_t y{geom.get_y(m)};
+        return(exp(-0.25 * x * x) * (1.0 + 0.5 * cos(twodads::TWOPI * y / Ly) + 0.3 * sin(2.0 * twodads::TWOPI * y / Ly)));
+    };
+
+    // Configuration of my_config with a different resolution
+    auto resized_pt = [&] (const size_t nx, const size_t my) -> boost::property_tree::ptree
+    {
+        boost::property_tree::ptree pt{my_config.get_pt()};
+        pt.put("2dads.geometry.Nx", nx);
+        pt.put("2dads.geometry.My", my);
+        return(pt);
+    };
+
+    // Maximum deviation of theta, omega, and tau from f_exact, after initializing the slab from the file
+    auto max_error = [&] (slab_bc& slab) -> twodads::real_t
+    {
+        twodads::real_t err{0.0};
+        for(auto f : {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_tau})
+        {
+            slab.dft_c2r(f, tidx);
+            const cuda_array_bc_nogp<twodads::real_t, allocator_host>* arr{slab.get_array_ptr(f)};
+            const twodads::slab_layout_t geom{arr -> get_geom()};
+            for(size_t n = 0; n < geom.get_nx(); n++)
+                for(size_t m = 0; m < geom.get_my(); m++)
+                    err = std::max(err, std::fabs(arr -> get_tlev_ptr(tidx)[n * (geom.get_my() + geom.get_pad_y()) + m] - f_exact(0.0, n, m, geom)));
+        }
+        return(err);
+    };
+
+    cout << setw(10) << "Nx_src" << setw(10) << "My_src" << setw(16) << "max error" << setw(16) << "ratio" << endl;
+    twodads::real_t err_old{0.0};
+    for(size_t nx_src : {32ul, 64ul, 128ul, 512ul, 3 * nx_dst})
+    {
+        const size_t my_src{nx_src == 512 ? 512ul : 16ul};
+        {
+            // Write the snapshot at the source resolution
+            boost::property_tree::ptree pt_src{resized_pt(nx_src, my_src)};
+            for(const std::string f : {"theta", "omega", "tau"})
+                pt_src.put("2dads.initial.init_func_" + f, "constant");
+            slab_config_js config_src(pt_src);
+            slab_bc slab_src(config_src);
+            for(auto f : {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_tau})
+            {
+                slab_src.get_array_ptr(f) -> apply(f_exact, tidx);
+                slab_src.get_array_ptr(f) -> set_transformed(tidx, false);
+            }
+            slab_src.write_output(tidx, 0.0);
+        }
+        std::rename("output.h5", my_config.get_init_file().data());
+
+        twodads::real_t err{0.0};
+        {
+            slab_bc my_slab(my_config);
+            my_slab.initialize();
+            err = max_error(my_slab);
+            // The output is complete when my_slab is destroyed
+            if(nx_src == 128)
+                my_slab.write_output(tidx, 0.0);
+        }
+
+        cout << setw(10) << nx_src << setw(10) << my_src << setw(16) << err;
+        // Doubling Nx_src, same My_src
+        if(nx_src == 64 || nx_src == 128)
+            cout << setw(16) << err_old / err;
+        cout << endl;
+
+        switch(nx_src)
+        {
+            case 32:
+                check(err < 1e-3, "Interpolation error for Nx_src = 32");
+                break;
+            case 64:
+            case 128:
+                check(err_old / err > 40.0, "Fifth order convergence in x");
+                break;
+            case 512:
+                check(err < 1e-8, "Interpolation error for Nx_src = 512, My_src = 512");
+                break;
+            default:
+                check(err < 1e-12, "f is reproduced on a sub-sampled source grid");
+        }
+        err_old = err;
+
+        if(nx_src == 128)
+        {
+            // Round trip back to the source resolution
+            std::rename("output.h5", my_config.get_init_file().data());
+            slab_config_js config_back(resized_pt(nx_src, my_src));
+            slab_bc slab_back(config_back);
+            slab_back.initialize();
+            const twodads::real_t err_back{max_error(slab_back)};
+            cout << "Round trip to Nx = " << nx_src << ", My = " << my_src << ": max error = " << err_back << endl;
+            check(err_back < 2.0 * err, "Round trip error");
+        }
+    }
+    std::remove(my_config.get_init_file().data());
+    std::remove("output.h5");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
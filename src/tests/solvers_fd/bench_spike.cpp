@@ -0,0 +1,88 @@
+/*
+ * Benchmark the partitioned tridiagonal solver elliptic_spike_t
+ *
+ * Large Nx and few Fourier modes. Compares elliptic_spike_t for different numbers of
+ * chunks against elliptic_mkl_t. The linear systems are those of the Laplace inversion,
+ * see deriv_fd_t :: init_diagonals.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include "solvers.h"
+
+using namespace std;
+using cmplx_t = CuCmplx<twodads::real_t>;
+
+
+int main(void)
+{
+    constexpr size_t num_solve{20};
+    cout << "Threads: " << solvers :: get_max_threads() << endl;
+    cout << setw(8) << "Nx" << setw(8) << "My21" << setw(8) << "parts" << setw(16) << "mkl[ms]" << setw(16) << "spike[ms]" << setw(16) << "rel. diff" << endl;
+
+    for(size_t Nx = 8192; Nx <= 32768; Nx *= 2)
+    {
+        const size_t My{8};
+        const twodads::slab_layout_t geom(-10.0, 20.0 / static_cast<twodads::real_t>(Nx), -10.0, 20.0 / static_cast<twodads::real_t>(My),
+                                          Nx, 0, My, 2, twodads::grid_t::cell_centered);
+        const size_t My21{(geom.get_my() + geom.get_pad_y()) / 2};
+        const twodads::real_t inv_dx2{1.0 / (geom.get_deltax() * geom.get_deltax())};
+
+        // Diagonals are stored transposed, see deriv_fd_t :: init_diagonals
+        vector<cmplx_t> diag(My21 * Nx);
+        vector<cmplx_t> diag_l(Nx, cmplx_t(inv_dx2, 0.0));
+        vector<cmplx_t> diag_u(Nx, cmplx_t(inv_dx2, 0.0));
+        diag_l[0] = cmplx_t(0.0, 0.0);
+        diag_u[Nx - 1] = cmplx_t(0.0, 0.0);
+        for(size_t m = 0; m < My21; m++)
+        {
+            const twodads::real_t ky{twodads::TWOPI * static_cast<twodads::real_t>(m) / geom.get_Ly()};
+            for(size_t n = 0; n < Nx; n++)
+                diag[m * Nx + n] = cmplx_t(((n == 0 || n == Nx - 1) ? -3.0 : -2.0) * inv_dx2 - ky * ky, 0.0);
+        }
+
+        vector<cmplx_t> rhs(Nx * My21);
+        for(size_t n = 0; n < Nx; n++)
+            for(size_t m = 0; m < My21; m++)
+                rhs[n * My21 + m] = cmplx_t(sin(0.1 * static_cast<twodads::real_t>(n + m)), cos(0.3 * static_cast<twodads::real_t>(n * m)));
+
+        solvers :: elliptic_mkl_t solver_mkl(geom);
+        vector<cmplx_t> sol_mkl(rhs);
+        auto t_start = chrono::high_resolution_clock::now();
+        for(size_t t = 0; t < num_solve; t++)
+        {
+            sol_mkl = rhs;
+            solver_mkl.solve(nullptr, sol_mkl.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+        }
+        auto t_mkl = chrono::high_resolution_clock::now() - t_start;
+
+        for(size_t num_parts = 1; num_parts <= 16; num_parts *= 2)
+        {
+            solvers :: elliptic_spike_t solver_spike(geom, num_parts);
+            vector<cmplx_t> sol_spike(rhs);
+            t_start = chrono::high_resolution_clock::now();
+            for(size_t t = 0; t < num_solve; t++)
+            {
+                sol_spike = rhs;
+                solver_spike.solve(nullptr, sol_spike.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+            }
+            auto t_spike = chrono::high_resolution_clock::now() - t_start;
+
+            twodads::real_t max_diff{0.0};
+            twodads::real_t max_sol{0.0};
+            for(size_t idx = 0; idx < Nx * My21; idx++)
+            {
+                max_diff = max(max_diff, (sol_mkl[idx] - sol_spike[idx]).abs());
+                max_sol = max(max_sol, sol_mkl[idx].abs());
+            }
+
+            cout << setw(8) << Nx << setw(8) << My21 << setw(8) << solver_spike.get_num_parts();
+            cout << setw(16) << chrono::duration<double, milli>(t_mkl).count() / num_solve;
+            cout << setw(16) << chrono::duration<double, milli>(t_spike).count() / num_solve;
+            cout << setw(16) << max_diff / max_sol << endl;
+        }
+    }
+}
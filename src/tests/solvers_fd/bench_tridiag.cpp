@@ -0,0 +1,149 @@
+/*
+ * Benchmark the tridiagonal solver elliptic_mkl_t
+ *
+ * Compares the OpenMP-batched solver with preallocated workspaces against the
+ * serial implementation that allocates the diagonal copies on each call.
+ * elliptic_thomas_t factorizes the systems in the first solve and only performs the 
+ * substitution afterwards. elliptic_thomas_simd_t does the same with SIMD over the modes,
+ * elliptic_thomas_real_t uses real factors.
+ * The linear systems are those of the Laplace inversion, see deriv_fd_t :: init_diagonals.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include "solvers.h"
+
+using namespace std;
+using cmplx_t = CuCmplx<twodads::real_t>;
+
+
+// Reference implementation: Serial loop over the modes, allocate the diagonal copies for each solve
+void solve_reference(const int Nx, const int My21, cmplx_t* dummy_dst, cmplx_t* dummy_diag_l, cmplx_t* dummy_diag, cmplx_t* dummy_diag_u)
+{
+    lapack_complex_double* dst = reinterpret_cast<lapack_complex_double*>(dummy_dst);
+    lapack_complex_double* diag = reinterpret_cast<lapack_complex_double*>(dummy_diag);
+    lapack_complex_double* diag_u = reinterpret_cast<lapack_complex_double*>(dummy_diag_u);
+    lapack_complex_double* diag_l = reinterpret_cast<lapack_complex_double*>(dummy_diag_l);
+
+    lapack_complex_double* diag_l_copy = new lapack_complex_double[Nx];
+    lapack_complex_double* diag_u_copy = new lapack_complex_double[Nx];
+    lapack_complex_double* diag_copy = new lapack_complex_double[Nx];
+
+    for(size_t m = 0; m < static_cast<size_t>(My21); m++)
+    {
+        memcpy(diag_l_copy, diag_l, static_cast<size_t>(Nx) * sizeof(lapack_complex_double));
+        memcpy(diag_u_copy, diag_u, static_cast<size_t>(Nx) * sizeof(lapack_complex_double));
+        memcpy(diag_copy, diag + m * static_cast<size_t>(Nx), static_cast<size_t>(Nx) * sizeof(lapack_complex_double));
+        LAPACKE_zgtsv(LAPACK_ROW_MAJOR, Nx, 1, diag_l_copy, diag_copy, diag_u_copy, dst + m, My21);
+    }
+    delete [] diag_copy;
+    delete [] diag_u_copy;
+    delete [] diag_l_copy;
+}
+
+
+int main(void)
+{
+    constexpr size_t num_solve{20};
+    cout << setw(8) << "Nx" << setw(8) << "My21" << setw(16) << "reference[ms]" << setw(16) << "batched[ms]" << setw(16) << "thomas[ms]" << setw(16) << "simd[ms]" << setw(16) << "real[ms]" << setw(16) << "max. diff" << setw(20) << "max. diff thomas" << setw(20) << "max. diff simd" << setw(20) << "max. diff real" << endl;
+
+    for(size_t Nx = 256; Nx <= 4096; Nx *= 2)
+    {
+        const size_t My{Nx};
+        const twodads::slab_layout_t geom(-10.0, 20.0 / static_cast<twodads::real_t>(Nx), -10.0, 20.0 / static_cast<twodads::real_t>(My),
+                                          Nx, 0, My, 2, twodads::grid_t::cell_centered);
+        solvers :: elliptic_mkl_t solver(geom);
+        solvers :: elliptic_thomas_t solver_thomas(geom);
+        solvers :: elliptic_thomas_simd_t solver_simd(geom);
+        solvers :: elliptic_thomas_real_t solver_real(geom);
+        const size_t My21{(geom.get_my() + geom.get_pad_y()) / 2};
+        const twodads::real_t inv_dx2{1.0 / (geom.get_deltax() * geom.get_deltax())};
+
+        // Diagonals are stored transposed, see deriv_fd_t :: init_diagonals
+        vector<cmplx_t> diag(My21 * Nx);
+        vector<cmplx_t> diag_l(Nx, cmplx_t(inv_dx2, 0.0));
+        vector<cmplx_t> diag_u(Nx, cmplx_t(inv_dx2, 0.0));
+        diag_l[0] = cmplx_t(0.0, 0.0);
+        diag_u[Nx - 1] = cmplx_t(0.0, 0.0);
+        for(size_t m = 0; m < My21; m++)
+        {
+            const twodads::real_t ky{twodads::TWOPI * static_cast<twodads::real_t>(m) / geom.get_Ly()};
+            for(size_t n = 0; n < Nx; n++)
+                diag[m * Nx + n] = cmplx_t(((n == 0 || n == Nx - 1) ? -3.0 : -2.0) * inv_dx2 - ky * ky, 0.0);
+        }
+
+        vector<cmplx_t> rhs(Nx * My21);
+        for(size_t n = 0; n < Nx; n++)
+            for(size_t m = 0; m < My21; m++)
+                rhs[n * My21 + m] = cmplx_t(sin(0.1 * static_cast<twodads::real_t>(n + m)), cos(0.3 * static_cast<twodads::real_t>(n * m)));
+
+        vector<cmplx_t> sol_ref(rhs);
+        vector<cmplx_t> sol_bat(rhs);
+        vector<cmplx_t> sol_thomas(rhs);
+        vector<cmplx_t> sol_simd(rhs);
+        vector<cmplx_t> sol_real(rhs);
+
+        auto t_start = chrono::high_resolution_clock::now();
+        for(size_t t = 0; t < num_solve; t++)
+        {
+            sol_ref = rhs;
+            solve_reference(static_cast<int>(Nx), static_cast<int>(My21), sol_ref.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+        }
+        auto t_ref = chrono::high_resolution_clock::now() - t_start;
+
+        t_start = chrono::high_resolution_clock::now();
+        for(size_t t = 0; t < num_solve; t++)
+        {
+            sol_bat = rhs;
+            solver.solve(nullptr, sol_bat.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+        }
+        auto t_bat = chrono::high_resolution_clock::now() - t_start;
+
+        t_start = chrono::high_resolution_clock::now();
+        for(size_t t = 0; t < num_solve; t++)
+        {
+            sol_thomas = rhs;
+            solver_thomas.solve(nullptr, sol_thomas.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+        }
+        auto t_thomas = chrono::high_resolution_clock::now() - t_start;
+
+        t_start = chrono::high_resolution_clock::now();
+        for(size_t t = 0; t < num_solve; t++)
+        {
+            sol_simd = rhs;
+            solver_simd.solve(nullptr, sol_simd.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+        }
+        auto t_simd = chrono::high_resolution_clock::now() - t_start;
+
+        t_start = chrono::high_resolution_clock::now();
+        for(size_t t = 0; t < num_solve; t++)
+        {
+            sol_real = rhs;
+            solver_real.solve(nullptr, sol_real.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+        }
+        auto t_real = chrono::high_resolution_clock::now() - t_start;
+
+        twodads::real_t max_diff{0.0};
+        twodads::real_t max_diff_thomas{0.0};
+        twodads::real_t max_diff_simd{0.0};
+        twodads::real_t max_diff_real{0.0};
+        for(size_t idx = 0; idx < Nx * My21; idx++)
+        {
+            max_diff = max(max_diff, (sol_ref[idx] - sol_bat[idx]).abs());
+            max_diff_thomas = max(max_diff_thomas, (sol_ref[idx] - sol_thomas[idx]).abs());
+            max_diff_simd = max(max_diff_simd, (sol_ref[idx] - sol_simd[idx]).abs());
+            max_diff_real = max(max_diff_real, (sol_ref[idx] - sol_real[idx]).abs());
+        }
+
+        cout << setw(8) << Nx << setw(8) << My21;
+        cout << setw(16) << chrono::duration<double, milli>(t_ref).count() / num_solve;
+        cout << setw(16) << chrono::duration<double, milli>(t_bat).count() / num_solve;
+        cout << setw(16) << chrono::duration<double, milli>(t_thomas).count() / num_solve;
+        cout << setw(16) << chrono::duration<double, milli>(t_simd).count() / num_solve;
+        cout << setw(16) << chrono::duration<double, milli>(t_real).count() / num_solve;
+        cout << setw(16) << max_diff << setw(20) << max_diff_thomas << setw(20) << max_diff_simd << setw(20) << max_diff_real << endl;
+    }
+}
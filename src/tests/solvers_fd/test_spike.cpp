@@ -0,0 +1,138 @@
+/*
+ * Test the partitioned tridiagonal solver elliptic_spike_t
+ *
+ * Solves the linear systems of the Laplace inversion, see deriv_fd_t :: init_diagonals, and checks
+ * the residual. The chunks are independent, so the solution has to be bitwise identical when
+ * they are distributed over fewer threads than chunks.
+ *
+ * With Neumann boundary conditions, the system of the mode ky = 0 is singular. The factorization
+ * has to report the zero pivot with a numerics_error. The pivot vanishes in the reduced system for the
+ * separators. A mode with a vanishing main diagonal has a zero pivot in the first row of each chunk,
+ * inside the parallel region, and has to be reported the same way.
+ */
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "solvers.h"
+
+using namespace std;
+using cmplx_t = CuCmplx<twodads::real_t>;
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    constexpr size_t Nx{256};
+    constexpr size_t My{8};
+    constexpr size_t num_parts{4};
+    const twodads::slab_layout_t geom(0.0, 1.0, 0.0, 1.0, Nx, 0, My, 2, twodads::grid_t::cell_centered);
+    const size_t My21{(geom.get_my() + geom.get_pad_y()) / 2};
+
+    // Diagonals are stored transposed, see deriv_fd_t :: init_diagonals. bval is the contribution
+    // of the ghost point to the boundary elements of the main diagonal, -1 for Dirichlet and +1 for Neumann.
+    auto init_diag = [&] (const twodads::real_t bval) -> vector<cmplx_t>
+    {
+        vector<cmplx_t> diag(My21 * Nx);
+        for(size_t m = 0; m < My21; m++)
+        {
+            const twodads::real_t ky{twodads::TWOPI * static_cast<twodads::real_t>(m) / geom.get_Ly()};
+            for(size_t n = 0; n < Nx; n++)
+                diag[m * Nx + n] = cmplx_t(((n == 0 || n == Nx - 1) ? -2.0 + bval : -2.0) - ky * ky, 0.0);
+        }
+        return(diag);
+    };
+    vector<cmplx_t> diag_l(Nx, cmplx_t(1.0, 0.0));
+    vector<cmplx_t> diag_u(Nx, cmplx_t(1.0, 0.0));
+    diag_l[0] = cmplx_t(0.0, 0.0);
+    diag_u[Nx - 1] = cmplx_t(0.0, 0.0);
+
+    vector<cmplx_t> rhs(Nx * My21);
+    for(size_t n = 0; n < Nx; n++)
+        for(size_t m = 0; m < My21; m++)
+            rhs[n * My21 + m] = cmplx_t(sin(0.1 * static_cast<twodads::real_t>(n + m)), cos(0.3 * static_cast<twodads::real_t>(n * m)));
+
+    // Dirichlet boundary conditions
+    vector<cmplx_t> diag{init_diag(-1.0)};
+    solvers :: elliptic_spike_t solver(geom, num_parts);
+    check(solver.get_num_parts() == num_parts, "Number of chunks");
+    vector<cmplx_t> sol(rhs);
+    solver.solve(nullptr, sol.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+
+    twodads::real_t max_res{0.0};
+    for(size_t n = 0; n < Nx; n++)
+    {
+        for(size_t m = 0; m < My21; m++)
+        {
+            cmplx_t res{diag[m * Nx + n] * sol[n * My21 + m] - rhs[n * My21 + m]};
+            if(n > 0)
+                res += diag_l[n] * sol[(n - 1) * My21 + m];
+            if(n < Nx - 1)
+                res += diag_u[n] * sol[(n + 1) * My21 + m];
+            max_res = max(max_res, res.abs());
+        }
+    }
+    cout << "Maximum residual: " << max_res << endl;
+    check(max_res < 1e-10, "The solution satisfies the linear system");
+
+    // Fewer threads than chunks
+    const int max_threads{solvers :: get_max_threads()};
+#ifdef _OPENMP
+    omp_set_num_threads(2);
+#endif //_OPENMP
+    solvers :: elliptic_spike_t solver_2(geom, num_parts);
+    vector<cmplx_t> sol_2(rhs);
+    solver_2.solve(nullptr, sol_2.data(), diag_l.data() + 1, diag.data(), diag_u.data());
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif //_OPENMP
+    size_t num_diff{0};
+    for(size_t idx = 0; idx < Nx * My21; idx++)
+        num_diff += (sol[idx].re() != sol_2[idx].re() || sol[idx].im() != sol_2[idx].im()) ? 1 : 0;
+    check(num_diff == 0, "The solution does not depend on the number of threads");
+
+    // Neumann boundary conditions, singular for ky = 0
+    vector<cmplx_t> diag_neumann{init_diag(1.0)};
+    solvers :: elliptic_spike_t solver_neumann(geom, num_parts);
+    vector<cmplx_t> sol_neumann(rhs);
+    bool thrown{false};
+    try
+    {
+        solver_neumann.solve(nullptr, sol_neumann.data(), diag_l.data() + 1, diag_neumann.data(), diag_u.data());
+    }
+    catch(const numerics_error& err)
+    {
+        cout << "numerics_error: " << err.what() << endl;
+        thrown = true;
+    }
+    check(thrown, "The singular mode is reported");
+
+    // Vanishing main diagonal of the mode ky = 0
+    for(size_t n = 0; n < Nx; n++)
+        diag_neumann[n] = cmplx_t(0.0, 0.0);
+    solvers :: elliptic_spike_t solver_zero(geom, num_parts);
+    sol_neumann = rhs;
+    thrown = false;
+    try
+    {
+        solver_zero.solve(nullptr, sol_neumann.data(), diag_l.data() + 1, diag_neumann.data(), diag_u.data());
+    }
+    catch(const numerics_error& err)
+    {
+        cout << "numerics_error: " << err.what() << endl;
+        thrown = true;
+    }
+    check(thrown, "A zero pivot in the chunks is reported");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,116 @@
+/*
+ * Test convergence of the additive Runge-Kutta integrator, finite-difference / semi-spectral methods
+ *
+ * Integrate
+ * du/dt = D nabla^2 u - mu u
+ * with the diffusion treated by the implicit and -mu u by the explicit part of the scheme.
+ *
+ * For Dirichlet boundary conditions, u = 0, the discrete eigenfunctions of the Laplace operator are
+ * u(x, y) = sin(kx pi (n + 1/2) / Nx) cos(ky y), with eigenvalue
+ * lambda = -4 / dx^2 sin^2(kx pi / 2 Nx) - ky^2
+ * so that the solution of the semi-discrete equation is
+ * u(x, y, t) = exp((D lambda - mu) t) u(x, y, 0)
+ *
+ * The scheme is third order from the first step, halving the step size should reduce the error by a factor of 8.
+ * The embedded error estimate of the last step is printed for comparison.
+ *
+ * A linear profile between non-zero boundary values is a steady state of the diffusion equation and
+ * should be preserved up to round-off.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+int main(void)
+{
+    constexpr size_t Nx{128};
+    constexpr size_t My{128};
+    const twodads::slab_layout_t geom(-10.0, 20.0 / static_cast<twodads::real_t>(Nx), -10.0, 20.0 / static_cast<twodads::real_t>(My),
+                                      Nx, 0, My, 2, twodads::grid_t::cell_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+
+    const twodads::real_t diff{0.1};
+    const twodads::real_t mu{0.5};
+    const twodads::real_t t_end{2.0};
+    const size_t kx{3};
+    const twodads::real_t ky{twodads::TWOPI * 2.0 / geom.get_Ly()};
+    const twodads::real_t sin_kx{sin(twodads::PI * static_cast<twodads::real_t>(kx) / (2.0 * static_cast<twodads::real_t>(geom.get_nx())))};
+    const twodads::real_t rate{-diff * (4.0 * sin_kx * sin_kx / (geom.get_deltax() * geom.get_deltax()) + ky * ky) - mu};
+
+    auto u_exact = [=] (const twodads::real_t t, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+    {
+        return(exp(rate * t) * sin(twodads::PI * static_cast<twodads::real_t>(kx) * (static_cast<twodads::real_t>(n) + 0.5) / static_cast<twodads::real_t>(geom.get_nx())) * cos(ky * geom.get_y(m)));
+    };
+
+    // Explicit part, -mu u
+    auto rhs_func = [=] (const std::vector<real_arr*>& src, const size_t t_src, const std::vector<real_arr*>& dst, const size_t t_dst) -> void
+    {
+        for(size_t f = 0; f < src.size(); f++)
+        {
+            dst[f] -> elementwise([=] (twodads::real_t lhs, twodads::real_t rhs) -> twodads::real_t {return(-mu * rhs);}, *src[f], t_dst, t_src);
+            dst[f] -> set_transformed(t_dst, false);
+        }
+    };
+
+    twodads::real_t err_old{0.0};
+
+    cout << setw(10) << "steps" << setw(16) << "L2 error" << setw(16) << "ratio" << setw(16) << "est. error" << endl;
+    for(size_t num_steps = 10; num_steps <= 160; num_steps *= 2)
+    {
+        const twodads::real_t dt{t_end / static_cast<twodads::real_t>(num_steps)};
+        twodads::stiff_params_t params(dt, geom.get_Lx(), geom.get_Ly(), diff, 0.0, geom.get_my(), geom.get_nx() / 2 + 1, 2);
+        integrator_ark_fd_t<twodads::real_t, allocator_host> tint(geom, bvals, params, twodads::solver_t::solver_thomas_real);
+
+        // Only the initial condition is needed, no bootstrap steps
+        real_arr u(geom, bvals, 2);
+        u.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                {return(u_exact(0.0, n, m, geom));}, 0);
+        u.set_transformed(0, false);
+
+        for(size_t s = 0; s < num_steps; s++)
+            tint.integrate_stages({&u}, 0, 0, rhs_func);
+
+        // Compare to exact solution at t_end
+        u.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                {return(u_exact(t_end, n, m, geom));}, 1);
+        u.elementwise([=] (twodads::real_t lhs, twodads::real_t rhs) -> twodads::real_t {return(lhs - rhs);}, 0, 1);
+        const twodads::real_t err{utility :: L2(u, 0)};
+
+        cout << setw(10) << num_steps << setw(16) << err << setw(16) << (err_old > 0.0 ? err_old / err : 0.0) << setw(16) << tint.get_error_estimate() << endl;
+        err_old = err;
+    }
+
+    // Steady state with non-zero boundary values
+    const twodads::real_t bv_left{1.0};
+    const twodads::real_t bv_right{-0.5};
+    const twodads::bvals_t<twodads::real_t> bvals_lin(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, bv_left, bv_right);
+    const twodads::real_t x_l{geom.get_xleft()};
+    const twodads::real_t L_x{geom.get_Lx()};
+    twodads::stiff_params_t params(0.1, geom.get_Lx(), geom.get_Ly(), diff, 0.0, geom.get_my(), geom.get_nx() / 2 + 1, 2);
+    integrator_ark_fd_t<twodads::real_t, allocator_host> tint(geom, bvals_lin, params, twodads::solver_t::solver_thomas_real);
+
+    real_arr u(geom, bvals_lin, 2);
+    u.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+            {return(bv_left + (bv_right - bv_left) * (geom.get_x(n) - x_l) / L_x);}, 1);
+    u.set_transformed(1, false);
+    u.copy(0, 1);
+    auto rhs_null = [] (const std::vector<real_arr*>& src, const size_t t_src, const std::vector<real_arr*>& dst, const size_t t_dst) -> void
+    {
+        for(size_t f = 0; f < src.size(); f++)
+        {
+            dst[f] -> apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t {return(0.0);}, t_dst);
+            dst[f] -> set_transformed(t_dst, false);
+        }
+    };
+    for(size_t s = 0; s < 10; s++)
+        tint.integrate_stages({&u}, 0, 0, rhs_null);
+    u.elementwise([=] (twodads::real_t lhs, twodads::real_t rhs) -> twodads::real_t {return(lhs - rhs);}, 0, 1);
+    cout << "Steady state, linear profile: L2 deviation = " << utility :: L2(u, 0) << ", est. error = " << tint.get_error_estimate() << endl;
+}
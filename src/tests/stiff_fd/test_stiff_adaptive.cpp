@@ -0,0 +1,109 @@
+/*
+ * Test the variable step size coefficients of the time integrator
+ *
+ * Integrate
+ * du/dt = D nabla^2 u - mu u
+ * with the diffusion treated implicitly and -mu u explicitly, using third order steps of varying size.
+ *
+ * For Dirichlet boundary conditions, u = 0, the discrete eigenfunctions of the Laplace operator are
+ * u(x, y) = sin(kx pi (n + 1/2) / Nx) cos(ky y), with eigenvalue
+ * lambda = -4 / dx^2 sin^2(kx pi / 2 Nx) - ky^2
+ * so that the solution of the semi-discrete equation is
+ * u(x, y, t) = exp((D lambda - mu) t) u(x, y, 0)
+ *
+ * Halving all step sizes should reduce the error by a factor of 8.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+using dft_t = fftw_object_t<twodads::real_t>;
+
+
+int main(void)
+{
+    constexpr size_t Nx{128};
+    constexpr size_t My{128};
+    const twodads::slab_layout_t geom(-10.0, 20.0 / static_cast<twodads::real_t>(Nx), -10.0, 20.0 / static_cast<twodads::real_t>(My),
+                                      Nx, 0, My, 2, twodads::grid_t::cell_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+
+    const twodads::real_t diff{0.1};
+    const twodads::real_t mu{0.5};
+    const twodads::real_t t_end{2.0};
+    const size_t kx{3};
+    const twodads::real_t ky{twodads::TWOPI * 2.0 / geom.get_Ly()};
+    const twodads::real_t sin_kx{sin(twodads::PI * static_cast<twodads::real_t>(kx) / (2.0 * static_cast<twodads::real_t>(geom.get_nx())))};
+    const twodads::real_t rate{-diff * (4.0 * sin_kx * sin_kx / (geom.get_deltax() * geom.get_deltax()) + ky * ky) - mu};
+
+    auto u_exact = [=] (const twodads::real_t t, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+    {
+        return(exp(rate * t) * sin(twodads::PI * static_cast<twodads::real_t>(kx) * (static_cast<twodads::real_t>(n) + 0.5) / static_cast<twodads::real_t>(geom.get_nx())) * cos(ky * geom.get_y(m)));
+    };
+
+    dft_t dft(geom, twodads::dft_t::dft_1d);
+    twodads::real_t err_old{0.0};
+
+    cout << setw(10) << "steps" << setw(16) << "L2 error" << setw(16) << "ratio" << endl;
+    for(size_t num_steps = 20; num_steps <= 160; num_steps *= 2)
+    {
+        // Step sizes vary by up to a factor of 3 between consecutive steps. Steps 1 and 2 end at t = -dt[2] and t = 0.
+        std::vector<twodads::real_t> dt(num_steps + 3);
+        twodads::real_t sum_w{0.0};
+        for(size_t s = 0; s < num_steps + 3; s++)
+        {
+            dt[s] = 1.0 + 0.5 * sin(1.7 * static_cast<twodads::real_t>(s));
+            if(s >= 3)
+                sum_w += dt[s];
+        }
+        for(auto& it : dt)
+            it *= t_end / sum_w;
+
+        // Initialize the three previous time steps with the exact solution
+        twodads::stiff_params_t params(dt[2], geom.get_Lx(), geom.get_Ly(), diff, 0.0, geom.get_my(), geom.get_nx() / 2 + 1, 4);
+        integrator_karniadakis_fd_t<twodads::real_t, allocator_host> tint(geom, bvals, params, twodads::solver_t::solver_thomas_real);
+        real_arr u(geom, bvals, 4);
+        real_arr expl(geom, bvals, 4);
+        tint.set_deltat(dt[1]);
+        tint.set_deltat(dt[2]);
+        const twodads::real_t time[4] = {0.0, 0.0, -dt[2], -dt[2] - dt[1]};
+        for(size_t t = 1; t < 4; t++)
+        {
+            const twodads::real_t t_init{time[t]};
+            u.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                    {return(u_exact(t_init, n, m, geom));}, t);
+            u.set_transformed(t, false);
+        }
+
+        for(size_t s = 3; s < num_steps + 3; s++)
+        {
+            // Explicit part from the previous time steps
+            for(size_t t = 1; t < 4; t++)
+                expl.elementwise([=] (twodads::real_t lhs, twodads::real_t rhs) -> twodads::real_t {return(-mu * rhs);}, u, t - 1, t);
+
+            tint.set_deltat(dt[s]);
+            tint.integrate(u, expl, 1, 2, 3, 0, 3);
+            dft.dft_c2r(reinterpret_cast<twodads::cmplx_t*>(u.get_tlev_ptr(0)), u.get_tlev_ptr(0));
+            utility :: normalize(u, 0);
+            u.set_transformed(0, false);
+            u.advance();
+        }
+
+        // Compare to exact solution at t_end
+        expl.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                   {return(u_exact(t_end, n, m, geom));}, 0);
+        u.elementwise([=] (twodads::real_t lhs, twodads::real_t rhs) -> twodads::real_t {return(lhs - rhs);}, expl, 1, 0);
+        const twodads::real_t err{utility :: L2(u, 1)};
+
+        cout << setw(10) << num_steps << setw(16) << err;
+        if(err_old > 0.0)
+            cout << setw(16) << err_old / err;
+        cout << endl;
+        err_old = err;
+    }
+}
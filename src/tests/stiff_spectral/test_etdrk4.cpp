@@ -0,0 +1,147 @@
+/*
+ * Test convergence of the ETDRK4 integrator, spectral methods
+ *
+ * Integrate the advection-diffusion equation
+ * du/dt = D nabla^2 u - v du/dy
+ * with the diffusion treated by the integrator and the advection as explicit part.
+ * Each Fourier mode evolves as
+ * u_k(t) = exp(-(D k^2 + i v ky) t) u_k(0)
+ *
+ * ETDRK4 should converge with fourth order, the error decreases by a factor of 16
+ * when halving the step size. For comparison, the third order Karniadakis scheme
+ * is started from the exact solution at the previous time steps.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+using cmplx_t = twodads::cmplx_t;
+using dft_t = fftw_object_t<twodads::real_t>;
+
+
+int main(void)
+{
+    constexpr size_t Nx{64};
+    constexpr size_t My{64};
+    const twodads::slab_layout_t geom(-10.0, 20.0 / static_cast<twodads::real_t>(Nx), -10.0, 20.0 / static_cast<twodads::real_t>(My),
+                                      Nx, 0, My, 2, twodads::grid_t::vertex_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_periodic, twodads::bc_t::bc_periodic, 0.0, 0.0);
+    const size_t My21{(My + geom.get_pad_y()) / 2};
+
+    const twodads::real_t diff{0.1};
+    const twodads::real_t vel{2.0};
+    const twodads::real_t t_end{1.0};
+
+    auto kx = [=] (const size_t n) -> twodads::real_t
+    {
+        return(twodads::TWOPI * ((n < Nx / 2 + 1) ? twodads::real_t(n) : (twodads::real_t(n) - twodads::real_t(Nx))) / geom.get_Lx());
+    };
+    auto ky = [=] (const size_t m) -> twodads::real_t {return(twodads::TWOPI * twodads::real_t(m) / geom.get_Ly());};
+
+    // Fourier coefficients of the initial condition
+    dft_t dft(geom, twodads::dft_t::dft_2d);
+    real_arr u0(geom, bvals, 1);
+    u0.apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+             {
+                const twodads::real_t x{geom.get_x(n)};
+                const twodads::real_t y{geom.get_y(m)};
+                return(exp(-0.5 * (x * x + y * y)));
+             }, 0);
+    dft.dft_r2c(u0.get_tlev_ptr(0), reinterpret_cast<cmplx_t*>(u0.get_tlev_ptr(0)));
+    u0.set_transformed(0, true);
+
+    // Writes the exact solution at time t to arr
+    auto exact = [&] (real_arr& arr, const size_t tidx, const twodads::real_t t) -> void
+    {
+        const cmplx_t* src{reinterpret_cast<cmplx_t*>(u0.get_tlev_ptr(0))};
+        cmplx_t* dst{reinterpret_cast<cmplx_t*>(arr.get_tlev_ptr(tidx))};
+        for(size_t n = 0; n < Nx; n++)
+            for(size_t m = 0; m < My21; m++)
+            {
+                const twodads::real_t k2{kx(n) * kx(n) + ky(m) * ky(m)};
+                const twodads::real_t decay{exp(-diff * k2 * t)};
+                dst[n * My21 + m] = src[n * My21 + m] * cmplx_t(decay * cos(vel * ky(m) * t), -decay * sin(vel * ky(m) * t));
+            }
+        arr.set_transformed(tidx, true);
+    };
+
+    // Explicit part: -v du/dy = -i v ky u
+    auto advection = [=] (const real_arr& src, const size_t t_src, real_arr& dst, const size_t t_dst) -> void
+    {
+        const cmplx_t* u{reinterpret_cast<cmplx_t*>(src.get_tlev_ptr(t_src))};
+        cmplx_t* res{reinterpret_cast<cmplx_t*>(dst.get_tlev_ptr(t_dst))};
+        for(size_t n = 0; n < Nx; n++)
+            for(size_t m = 0; m < My21; m++)
+                res[n * My21 + m] = cmplx_t(vel * ky(m) * u[n * My21 + m].im(), -vel * ky(m) * u[n * My21 + m].re());
+        dst.set_transformed(t_dst, true);
+    };
+
+    // Relative maximum difference of the Fourier coefficients
+    real_arr sol(geom, bvals, 1);
+    exact(sol, 0, t_end);
+    auto error = [&] (const real_arr& arr, const size_t tidx) -> twodads::real_t
+    {
+        const cmplx_t* u{reinterpret_cast<cmplx_t*>(arr.get_tlev_ptr(tidx))};
+        const cmplx_t* u_ex{reinterpret_cast<cmplx_t*>(sol.get_tlev_ptr(0))};
+        twodads::real_t max_diff{0.0};
+        twodads::real_t max_val{0.0};
+        for(size_t idx = 0; idx < Nx * My21; idx++)
+        {
+            max_diff = max(max_diff, (u[idx] - u_ex[idx]).abs());
+            max_val = max(max_val, u_ex[idx].abs());
+        }
+        return(max_diff / max_val);
+    };
+
+    cout << "D * k_max^2 = " << diff * (kx(Nx / 2) * kx(Nx / 2) + ky(My / 2) * ky(My / 2)) << endl;
+    cout << setw(10) << "steps" << setw(10) << "dt" << setw(16) << "ETDRK4" << setw(10) << "ratio" << setw(16) << "Karniadakis" << setw(10) << "ratio" << endl;
+
+    twodads::real_t err_etd_old{0.0};
+    twodads::real_t err_ka_old{0.0};
+    for(size_t num_steps = 4; num_steps <= 128; num_steps *= 2)
+    {
+        const twodads::real_t dt{t_end / static_cast<twodads::real_t>(num_steps)};
+        const twodads::stiff_params_t params(dt, geom.get_Lx(), geom.get_Ly(), diff, 0.0, My, Nx / 2 + 1, 4);
+
+        // ETDRK4
+        integrator_etdrk4_bs_t<twodads::real_t, allocator_host> tint_etd(geom, bvals, params);
+        real_arr u(geom, bvals, 1);
+        exact(u, 0, 0.0);
+        for(size_t s = 0; s < num_steps; s++)
+        {
+            tint_etd.integrate_stages({&u}, 0, 0,
+                                      [&] (const std::vector<real_arr*>& src, const size_t t_src, const std::vector<real_arr*>& dst, const size_t t_dst) -> void
+                                      {
+                                          for(size_t f = 0; f < src.size(); f++)
+                                              advection(*src[f], t_src, *dst[f], t_dst);
+                                      });
+        }
+        const twodads::real_t err_etd{error(u, 0)};
+
+        // Karniadakis, third order, previous time steps from the exact solution
+        integrator_karniadakis_bs_t<twodads::real_t, allocator_host> tint_ka(geom, bvals, params);
+        real_arr v(geom, bvals, 4);
+        real_arr v_rhs(geom, bvals, 3);
+        for(size_t t = 1; t < 4; t++)
+            exact(v, t, -static_cast<twodads::real_t>(t - 1) * dt);
+        for(size_t s = 0; s < num_steps; s++)
+        {
+            for(size_t t = 1; t < 4; t++)
+                advection(v, t, v_rhs, t - 1);
+            v.set_transformed(0, true);
+            tint_ka.integrate(v, v_rhs, 1, 2, 3, 0, 3);
+            v.advance();
+        }
+        const twodads::real_t err_ka{error(v, 1)};
+
+        cout << setw(10) << num_steps << setw(10) << dt << setw(16) << err_etd << setw(10) << (err_etd_old > 0.0 ? err_etd_old / err_etd : 0.0);
+        cout << setw(16) << err_ka << setw(10) << (err_ka_old > 0.0 ? err_ka_old / err_ka : 0.0) << endl;
+        err_etd_old = err_etd;
+        err_ka_old = err_ka;
+    }
+}
@@ -0,0 +1,178 @@
+/*
+ * Test finite difference derivatives on a stretched grid
+ *
+ * f(x, y) = g(x) + sin(pi (x - x_l) / Lx) g(x) cos(2 pi y / Ly)
+ * g(x) = exp(-(x - x_l) / delta) + exp((x - x_r) / delta)
+ * has boundary layers of width delta at both domain boundaries. f is constant along
+ * the boundaries, f = g(x_l), which is used as the Dirichlet boundary value.
+ *
+ * Computes f_x, f_xx, the Poisson bracket {f, v} with v = sin(2 pi y / Ly), and
+ * solves nabla^2 u = nabla^2 f on a uniform grid and on a grid with stretch_x = 0.8.
+ * The stretched grid has five times smaller cells at the boundaries and should reach the
+ * accuracy of the uniform grid with about a quarter of the grid points.
+ *
+ * All errors have to be smaller on the stretched grid than on the uniform grid with the same Nx
+ * and converge with second order once the boundary layers are resolved, for Nx >= 256.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <array>
+#include <vector>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+using dft_t = fftw_object_t<twodads::real_t>;
+using deriv_t = deriv_fd_t<twodads::real_t, allocator_host>;
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    constexpr size_t My{32};
+    const twodads::real_t x_l{-1.0};
+    const twodads::real_t Lx{2.0};
+    const twodads::real_t Ly{2.0};
+    const twodads::real_t delta{0.02};
+    const twodads::real_t kx{twodads::PI / Lx};
+    const twodads::real_t ky{twodads::TWOPI / Ly};
+
+    // g(x) and its derivatives
+    auto g = [=] (const twodads::real_t x, const size_t d) -> twodads::real_t
+    {
+        const twodads::real_t gl{exp(-(x - x_l) / delta)};
+        const twodads::real_t gr{exp((x - x_l - Lx) / delta)};
+        return(d == 0 ? gl + gr : (d == 1 ? (gr - gl) / delta : (gl + gr) / (delta * delta)));
+    };
+    // h(x) = sin(kx (x - x_l)) g(x) and its derivatives
+    auto h = [=] (const twodads::real_t x, const size_t d) -> twodads::real_t
+    {
+        const twodads::real_t s{sin(kx * (x - x_l))};
+        const twodads::real_t c{cos(kx * (x - x_l))};
+        if(d == 0)
+            return(s * g(x, 0));
+        if(d == 1)
+            return(kx * c * g(x, 0) + s * g(x, 1));
+        return(-kx * kx * s * g(x, 0) + 2.0 * kx * c * g(x, 1) + s * g(x, 2));
+    };
+    // d^d f / dx^d, and f_yy for d = 3
+    auto f_exact = [=] (const twodads::real_t x, const twodads::real_t y, const size_t d) -> twodads::real_t
+    {
+        if(d == 3)
+            return(-ky * ky * h(x, 0) * cos(ky * (y + 1.0)));
+        return(g(x, d) + h(x, d) * cos(ky * (y + 1.0)));
+    };
+
+    constexpr size_t num_tests{4};
+    const std::string test_names[num_tests] = {"f_x", "f_xx", "{f, v}", "laplace"};
+    // Errors on the uniform grid, indexed by log2(Nx / 64)
+    std::vector<std::array<twodads::real_t, num_tests>> err_uniform;
+
+    cout << setw(8) << "Nx" << setw(10) << "stretch";
+    for(const auto& name : test_names)
+        cout << setw(14) << name;
+    cout << endl;
+    for(const twodads::real_t stretch : {0.0, 0.8})
+    {
+        std::array<twodads::real_t, num_tests> err_old;
+        size_t n_res{0};
+        for(size_t Nx : {64, 128, 256, 512, 1024})
+        {
+            std::array<twodads::real_t, num_tests> err;
+            const twodads::slab_layout_t geom(x_l, Lx / static_cast<twodads::real_t>(Nx), -1.0, Ly / static_cast<twodads::real_t>(My),
+                                              Nx, 0, My, 2, twodads::grid_t::cell_centered, stretch);
+            const twodads::real_t bval{g(x_l, 0)};
+            const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, bval, bval);
+            const twodads::bvals_t<twodads::real_t> bvals_v(twodads::bc_t::bc_neumann, twodads::bc_t::bc_neumann, 0.0, 0.0);
+            deriv_t der(geom, bvals);
+            dft_t dft(geom, twodads::dft_t::dft_1d);
+
+            real_arr f(geom, bvals, 1);
+            real_arr v(geom, bvals_v, 1);
+            real_arr res(geom, bvals, 1);
+            real_arr rhs(geom, bvals, 1);
+            f.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                    {return(f_exact(geom.get_x(n), geom.get_y(m), 0));}, 0);
+            v.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                    {return(sin(ky * (geom.get_y(m) + 1.0)));}, 0);
+
+            // Maximum error of res, relative to the maximum of the exact solution. 
+            // The derivatives are compared away from the boundaries, where the ghost points are 
+            // interpolated with first order accuracy.
+            auto error = [&] (std::function<twodads::real_t(twodads::real_t, twodads::real_t)> sol, const size_t n_bnd) -> twodads::real_t
+            {
+                twodads::real_t max_err{0.0};
+                twodads::real_t max_val{0.0};
+                for(size_t n = n_bnd; n < Nx - n_bnd; n++)
+                    for(size_t m = 0; m < My; m++)
+                    {
+                        const twodads::real_t u_ex{sol(geom.get_x(n), geom.get_y(m))};
+                        max_err = max(max_err, fabs(res.get_tlev_ptr(0)[n * (My + geom.get_pad_y()) + m] - u_ex));
+                        max_val = max(max_val, fabs(u_ex));
+                    }
+                return(max_err / max_val);
+            };
+
+            der.dx(f, res, 0, 0, 1);
+            err[0] = error([=] (twodads::real_t x, twodads::real_t y) {return(f_exact(x, y, 1));}, 1);
+
+            der.dx(f, res, 0, 0, 2);
+            err[1] = error([=] (twodads::real_t x, twodads::real_t y) {return(f_exact(x, y, 2));}, 1);
+
+            // {f, v} = f_x v_y - f_y v_x = f_x v_y. Compare to the limit dx -> 0 of the Arakawa scheme at fixed dy, 
+            // to measure only the discretization error in x. For v = v(y), two of its three terms give f_x times the
+            // central difference of v_y. The third one multiplies f_x at y +- dy with the one-sided differences of v.
+            const twodads::real_t dy{geom.get_deltay()};
+            auto c = [=] (const twodads::real_t y) -> twodads::real_t {return(cos(ky * (y + 1.0)));};
+            auto s = [=] (const twodads::real_t y) -> twodads::real_t {return(sin(ky * (y + 1.0)));};
+            der.pbracket(f, v, res, 0, 0, 0);
+            err[2] = error([=] (twodads::real_t x, twodads::real_t y) -> twodads::real_t
+                           {
+                               const twodads::real_t v_y{(s(y + dy) - s(y - dy)) / (2.0 * dy)};
+                               const twodads::real_t v_y_diag{(c(y + dy) * (s(y + dy) - s(y)) + c(y - dy) * (s(y) - s(y - dy))) / (2.0 * dy)};
+                               return(g(x, 1) * v_y + h(x, 1) * (2.0 * c(y) * v_y + v_y_diag) / 3.0);
+                           }, 1);
+
+            rhs.apply([=] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+                      {return(f_exact(geom.get_x(n), geom.get_y(m), 2) + f_exact(geom.get_x(n), geom.get_y(m), 3));}, 0);
+            dft.dft_r2c(rhs.get_tlev_ptr(0), reinterpret_cast<twodads::cmplx_t*>(rhs.get_tlev_ptr(0)));
+            rhs.set_transformed(0, true);
+            der.invert_laplace(rhs, res, 0, 0);
+            dft.dft_c2r(reinterpret_cast<twodads::cmplx_t*>(res.get_tlev_ptr(0)), res.get_tlev_ptr(0));
+            utility :: normalize(res, 0);
+            res.set_transformed(0, false);
+            err[3] = error([=] (twodads::real_t x, twodads::real_t y) {return(f_exact(x, y, 0));}, 0);
+
+            cout << setw(8) << Nx << setw(10) << stretch;
+            for(size_t i = 0; i < num_tests; i++)
+                cout << setw(14) << err[i];
+            cout << endl;
+
+            if(stretch == 0.0)
+                err_uniform.push_back(err);
+            for(size_t i = 0; i < num_tests; i++)
+            {
+                if(stretch != 0.0)
+                    check(err[i] < err_uniform[n_res][i], test_names[i] + ": The stretched grid is more accurate, Nx = " + std::to_string(Nx));
+                if(Nx >= 256)
+                    check(log2(err_old[i] / err[i]) > 1.8, test_names[i] + ": Second order convergence, Nx = " + std::to_string(Nx));
+            }
+            err_old = err;
+            n_res++;
+        }
+    }
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,128 @@
+/*
+ * Test apply and elementwise restricted to a region of the array
+ *
+ * Updates the boundary rows, a column slab and a single element with the region-restricted
+ * member functions and compares to a full-array pass that branches on the indices and to the
+ * expected values. A region that extends beyond the array is clipped.
+ */
+
+#include "cuda_array_bc_nogp.h"
+
+#include <iostream>
+#include <chrono>
+
+using namespace std;
+using value_t = double;
+using arr_t = cuda_array_bc_nogp<value_t, allocator_host>;
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    constexpr size_t num_rep{100};
+    constexpr size_t Nx{64};
+    constexpr size_t My{32};
+
+    twodads::slab_layout_t my_geom(0.0, 1.0 / twodads::real_t(Nx), 0.0, 1.0 / twodads::real_t(My), Nx, 0, My, 2, twodads::grid_t::cell_centered);
+    twodads::bvals_t<value_t> my_bvals{twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0}; 
+
+    arr_t arr_full(my_geom, my_bvals, 2);
+    arr_t arr_region(my_geom, my_bvals, 2);
+    for(auto arr : {&arr_full, &arr_region})
+    {
+        for(size_t t = 0; t < 2; t++)
+        {
+            (*arr).apply([=] (value_t dummy, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t 
+                         {return(static_cast<value_t>(n * (geom.get_my() + geom.get_pad_y()) + m + t));}, t);
+        }
+    }
+
+    // Boundary rows, n = 0 and n = Nx - 1
+    arr_full.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t
+                   {return((n == 0 || n == geom.get_nx() - 1) ? -val : val);}, 0);
+    arr_region.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t {return(-val);}, twodads::region_t::row(0), 0);
+    arr_region.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t {return(-val);}, twodads::region_t::row(Nx - 1), 0);
+
+    // Column slab 2 <= m < 5, on all rows. Add time level 1
+    arr_full.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t
+                   {return((m >= 2 && m < 5) ? val + static_cast<value_t>(n * (geom.get_my() + geom.get_pad_y()) + m + 1) : val);}, 0);
+    arr_region.elementwise([] (value_t lhs, value_t rhs) -> value_t {return(lhs + rhs);}, twodads::region_t::cols(2, 5), 0, 1);
+
+    // Single element, and a region that extends beyond the array
+    arr_full.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t
+                   {return((n == 1 && m == 0) ? 0.0 : val);}, 0);
+    arr_region.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t {return(0.0);}, twodads::region_t::elem(1, 0), 0);
+    arr_region.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t {return(0.0);}, twodads::region_t::elem(Nx, 0), 0);
+
+    // Expected values: the initial value n (My + pad_y) + m, negated on the boundary rows, plus the value of
+    // time level 1 in the column slab, and zero at (1, 0)
+    const size_t my_plus_pad{my_geom.get_my() + my_geom.get_pad_y()};
+    auto expected = [=] (const size_t n, const size_t m) -> value_t
+    {
+        if(n == 1 && m == 0)
+            return(0.0);
+        value_t val{static_cast<value_t>(n * my_plus_pad + m)};
+        if(n == 0 || n == Nx - 1)
+            val = -val;
+        if(m >= 2 && m < 5)
+            val += static_cast<value_t>(n * my_plus_pad + m + 1);
+        return(val);
+    };
+
+    value_t max_diff{0.0};
+    size_t num_wrong{0};
+    for(size_t n = 0; n < Nx; n++)
+    {
+        for(size_t m = 0; m < My; m++)
+        {
+            max_diff = max(max_diff, fabs(arr_full.get_tlev_ptr(0)[n * my_plus_pad + m] - arr_region.get_tlev_ptr(0)[n * my_plus_pad + m]));
+            num_wrong += (arr_region.get_tlev_ptr(0)[n * my_plus_pad + m] != expected(n, m)) ? 1 : 0;
+        }
+    }
+    cout << "max. diff = " << max_diff << endl;
+    check(max_diff == 0.0, "Regions agree with the full-array pass");
+    check(num_wrong == 0, "Regions give the expected values");
+
+    // Time level 1 is only read
+    num_wrong = 0;
+    for(size_t n = 0; n < Nx; n++)
+        for(size_t m = 0; m < My; m++)
+            num_wrong += (arr_region.get_tlev_ptr(1)[n * my_plus_pad + m] != static_cast<value_t>(n * my_plus_pad + m + 1)) ? 1 : 0;
+    check(num_wrong == 0, "The source time level is unchanged");
+
+    // Timing: boundary correction on two elements with a full-array pass and with regions
+    auto t_start = chrono::high_resolution_clock::now();
+    for(size_t r = 0; r < num_rep; r++)
+        arr_full.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t
+                       {return((m == 0 && (n == 0 || n == geom.get_nx() - 1)) ? val + 1.0 : val);}, 0);
+    auto t_full = chrono::high_resolution_clock::now() - t_start;
+
+    t_start = chrono::high_resolution_clock::now();
+    for(size_t r = 0; r < num_rep; r++)
+    {
+        arr_region.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t {return(val + 1.0);}, twodads::region_t::elem(0, 0), 0);
+        arr_region.apply([] (value_t val, const size_t n, const size_t m, const twodads::slab_layout_t geom) -> value_t {return(val + 1.0);}, twodads::region_t::elem(Nx - 1, 0), 0);
+    }
+    auto t_region = chrono::high_resolution_clock::now() - t_start;
+
+    cout << "full array: " << chrono::duration<double, micro>(t_full).count() / num_rep << " us per pass" << endl;
+    cout << "region:     " << chrono::duration<double, micro>(t_region).count() / num_rep << " us per pass" << endl;
+
+    // Both passes add num_rep to the elements (0, 0) and (Nx - 1, 0)
+    check(arr_region.get_tlev_ptr(0)[0] == expected(0, 0) + static_cast<value_t>(num_rep) &&
+          arr_region.get_tlev_ptr(0)[(Nx - 1) * my_plus_pad] == expected(Nx - 1, 0) + static_cast<value_t>(num_rep) &&
+          arr_region.get_tlev_ptr(0)[my_plus_pad] == expected(1, 0), "Single-element regions");
+    check(arr_full.get_tlev_ptr(0)[0] == arr_region.get_tlev_ptr(0)[0] &&
+          arr_full.get_tlev_ptr(0)[(Nx - 1) * my_plus_pad] == arr_region.get_tlev_ptr(0)[(Nx - 1) * my_plus_pad], "Timed passes agree");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}
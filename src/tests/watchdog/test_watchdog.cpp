@@ -0,0 +1,123 @@
+/*
+ * Test the detection of non-finite values and the rollback of slab_bc
+ *
+ * Checks that utility::normalize_check gives the same result as utility::normalize and finds the first
+ * non-finite value of an array. Then runs the interchange model, injects a NaN into theta, and checks
+ * that the next time step is reported as non-finite. After restoring the snapshot, the repeated step
+ * has to be bitwise identical to a step without the NaN.
+ */
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include "slab_bc.h"
+
+using namespace std;
+using real_arr = cuda_array_bc_nogp<twodads::real_t, allocator_host>;
+
+
+int main(void)
+{
+    size_t num_errors{0};
+    auto check = [&num_errors] (const bool cond, const std::string& msg) -> void
+    {
+        if(!cond)
+        {
+            cerr << "Failed: " << msg << endl;
+            num_errors++;
+        }
+    };
+
+    // Normalization with and without the check
+    const twodads::slab_layout_t geom(-1.0, 2.0 / 64, -1.0, 2.0 / 64, 64, 0, 64, 2, twodads::grid_t::cell_centered);
+    const twodads::bvals_t<twodads::real_t> bvals(twodads::bc_t::bc_dirichlet, twodads::bc_t::bc_dirichlet, 0.0, 0.0);
+    real_arr u(geom, bvals, 1);
+    real_arr v(geom, bvals, 1);
+    u.apply([] (twodads::real_t dummy, const size_t n, const size_t m, twodads::slab_layout_t geom) -> twodads::real_t
+            {return(sin(twodads::PI * geom.get_x(n)) * cos(twodads::PI * geom.get_y(m)));}, 0);
+    v.copy(0, u, 0);
+    utility :: normalize(u, 0);
+    utility :: nonfinite_t res{utility :: normalize_check(v, 0)};
+    check(res.count == 0, "No non-finite values in a finite array");
+    const size_t my_plus_pad{geom.get_my() + geom.get_pad_y()};
+    size_t num_diff{0};
+    for(size_t n = 0; n < geom.get_nx(); n++)
+        for(size_t m = 0; m < geom.get_my(); m++)
+            num_diff += (u.get_tlev_ptr(0)[n * my_plus_pad + m] != v.get_tlev_ptr(0)[n * my_plus_pad + m]) ? 1 : 0;
+    check(num_diff == 0, "normalize_check is bitwise identical to normalize");
+
+    v.get_tlev_ptr(0)[41 * my_plus_pad + 3] = std::numeric_limits<twodads::real_t>::infinity();
+    v.get_tlev_ptr(0)[17 * my_plus_pad + 60] = std::numeric_limits<twodads::real_t>::quiet_NaN();
+    res = utility :: normalize_check(v, 0);
+    check(res.count == 2, "Two non-finite values");
+    check(res.n == 17 && res.m == 60, "The first non-finite value is reported");
+
+    // Rollback of a time step
+    slab_config_js my_config(std::string("input_test_watchdog.json"));
+    const size_t order{my_config.get_tint_params(twodads::dyn_field_t::f_theta).get_tlevs()};
+    const std::vector<twodads::dyn_field_t> dyn_fields{twodads::dyn_field_t::f_theta, twodads::dyn_field_t::f_omega, twodads::dyn_field_t::f_tau};
+    const size_t nelem{my_config.get_geom().get_nelem_per_t()};
+
+    // One time step of the main loop, without the explicit terms for the next step
+    auto step = [&] (slab_bc& slab) -> void
+    {
+        slab.integrate(dyn_fields, order - 1);
+        slab.advance();
+        slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, 1, 0);
+        slab.update_real_fields(1);
+    };
+    auto get_fields = [&] (slab_bc& slab) -> std::vector<twodads::real_t>
+    {
+        std::vector<twodads::real_t> result;
+        for(auto f : {twodads::field_t::f_theta, twodads::field_t::f_omega, twodads::field_t::f_strmf})
+        {
+            const real_arr* arr{slab.get_array_ptr(f)};
+            const size_t tlev{f == twodads::field_t::f_strmf ? 0ul : 1ul};
+            result.insert(result.end(), arr -> get_tlev_ptr(tlev), arr -> get_tlev_ptr(tlev) + nelem);
+        }
+        return(result);
+    };
+
+    slab_bc my_slab(my_config);
+    my_slab.initialize();
+    my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1, 0);
+    my_slab.update_real_fields(order - 1);
+    my_slab.rhs(order - 2, order - 1);
+    for(size_t t = 1; t < order - 1; t++)
+    {
+        my_slab.integrate(dyn_fields, t);
+        my_slab.invert_laplace(twodads::field_t::f_omega, twodads::field_t::f_strmf, order - 1 - t, 0);
+        my_slab.update_real_fields(order - 1 - t);
+        my_slab.rhs(order - 2 - t, order - 1 - t);
+    }
+    for(size_t tstep = 0; tstep < 10; tstep++)
+    {
+        step(my_slab);
+        my_slab.rhs(0, 1);
+    }
+    check(my_slab.is_finite(), "The fields are finite");
+
+    my_slab.save_snapshot();
+    step(my_slab);
+    const std::vector<twodads::real_t> reference{get_fields(my_slab)};
+    check(my_slab.is_finite(), "The fields are finite after a step");
+
+    my_slab.restore_snapshot();
+    my_slab.get_array_ptr(twodads::field_t::f_theta) -> get_tlev_ptr(1)[32 * my_plus_pad + 32] = std::numeric_limits<twodads::real_t>::quiet_NaN();
+    step(my_slab);
+    check(my_slab.is_finite() == false, "The NaN is detected");
+    cout << my_slab.get_nonfinite_report() << endl;
+
+    my_slab.restore_snapshot();
+    check(my_slab.is_finite(), "Restoring the snapshot clears the report");
+    step(my_slab);
+    const std::vector<twodads::real_t> repeated{get_fields(my_slab)};
+    num_diff = 0;
+    for(size_t n = 0; n < reference.size(); n++)
+        num_diff += (reference[n] != repeated[n]) ? 1 : 0;
+    check(num_diff == 0, "The repeated step is bitwise identical");
+
+    cout << (num_errors == 0 ? "All tests passed" : "Tests failed") << endl;
+    return(num_errors == 0 ? 0 : 1);
+}